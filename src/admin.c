@@ -652,7 +652,6 @@ add_user(char* users_path, char* username, char* password, bool generate_pwd, in
    char* encoded = NULL;
    size_t encoded_length;
    char un[MAX_USERNAME_LENGTH];
-   int number_of_users = 0;
    bool do_verify = true;
    char* verify = NULL;
    bool do_free = true;
@@ -699,7 +698,6 @@ add_user(char* users_path, char* username, char* password, bool generate_pwd, in
       {
          while (fgets(line, sizeof(line), users_file))
          {
-            number_of_users++;
             ptr = strtok(line, ":");
             if (ptr == NULL)
             {
@@ -713,22 +711,9 @@ add_user(char* users_path, char* username, char* password, bool generate_pwd, in
             }
          }
       }
-      else
-      {
-         while (fgets(line, sizeof(line), users_file))
-         {
-            number_of_users++;
-         }
-      }
 
       fclose(users_file);
       users_file = NULL;
-
-      if (number_of_users >= NUMBER_OF_USERS)
-      {
-         warnx("Maximum number of users reached (%d)", NUMBER_OF_USERS);
-         goto error;
-      }
    }
 
    users_file = fopen(users_path, "a+");
@@ -33,8 +33,10 @@
 #include <memory.h>
 #include <report.h>
 #include <postgresql.h>
+#include <registry.h>
 #include <shmem.h>
 #include <utils.h>
+#include <watch.h>
 
 #include <err.h>
 #include <stdio.h>
@@ -44,6 +46,7 @@
 
 #define ACTION_UNKNOWN 0
 #define ACTION_REPORT  1
+#define ACTION_WATCH   2
 
 static bool
 load_config(void* shmem, const char* default_path, char* user_path, char** resolved_path, int (*read_func)(void*, char*), const char* label)
@@ -89,11 +92,13 @@ usage(void)
    printf("\n");
    printf("Usage:\n");
    printf("  pgvictoria-cli [ OPTIONS ] report [ CONFIG_FILE ]\n");
+   printf("  pgvictoria-cli [ OPTIONS ] watch CONFIG_FILE [ CONFIG_FILE ... ]\n");
    printf("\n");
    printf("Commands:\n");
    printf("  report                       Generate a configuration report against the version baseline\n");
    printf("                                 no arguments  - scan the live server (online mode)\n");
    printf("                                 CONFIG_FILE   - compare a postgresql.conf file (offline mode)\n");
+   printf("  watch                        Watch postgresql.conf files and their includes, reporting drift as it happens\n");
    printf("\n");
    printf("Options:\n");
    printf("  -c, --config CONFIG_FILE      Set the path to the pgvictoria.conf file\n");
@@ -103,9 +108,9 @@ usage(void)
    printf("  -U, --user USER               Set the database user (default: postgres)\n");
    printf("  -W, --password PASSWORD       Set the database password\n");
    printf("  -pg, --postgresql VERSION     Override the baseline version to compare against (14-19)\n");
-   printf("  -f, --format FORMAT           Report format: text|html|md (default: auto-detected from output file extension, fallback: text)\n");
+   printf("  -f, --format FORMAT           Report format: text|html|md|fleet (default: auto-detected from output file extension, fallback: text)\n");
    printf("  -t, --type TYPE               Report type: full|changed (default: changed)\n");
-   printf("  -o, --output OUTPUT_FILE      Write the report to OUTPUT_FILE (required)\n");
+   printf("  -o, --output OUTPUT_FILE      Write the report to OUTPUT_FILE (required for report, appended to by watch)\n");
    printf("  -V, --version                 Display version information\n");
    printf("  -?, --help                    Display help\n");
    printf("\n");
@@ -157,6 +162,14 @@ main(int argc, char** argv)
          .action = ACTION_REPORT,
          .deprecated = false,
          .log_message = "report",
+      },
+      {
+         .command = "watch",
+         .subcommand = "",
+         .accepted_argument_count = {1, MISC_LENGTH - 1},
+         .action = ACTION_WATCH,
+         .deprecated = false,
+         .log_message = "watch",
       }};
 
    cli_result results[sizeof(options) / sizeof(options[0])];
@@ -241,9 +254,13 @@ main(int argc, char** argv)
          {
             output_format = PGVICTORIA_OUTPUT_MD;
          }
+         else if (!strcmp(optarg, "fleet"))
+         {
+            output_format = PGVICTORIA_OUTPUT_FLEET;
+         }
          else
          {
-            warnx("pgvictoria-cli: Unsupported output format: %s (expected text|html|md)", optarg);
+            warnx("pgvictoria-cli: Unsupported output format: %s (expected text|html|md|fleet)", optarg);
             exit(1);
          }
       }
@@ -306,7 +323,11 @@ main(int argc, char** argv)
       goto error;
    }
 
-   pgvictoria_init_main_configuration(shmem);
+   if (pgvictoria_init_main_configuration(shmem))
+   {
+      warnx("pgvictoria-cli: Error in creating the server registry");
+      goto error;
+   }
    pgvictoria_memory_init();
 
    char* resolved_config_path = NULL;
@@ -330,15 +351,14 @@ main(int argc, char** argv)
          goto error;
       }
 
-      config->common.number_of_servers = 1;
-
+      struct server srv = {0};
       char* tmp = NULL;
 
       // Server name
       tmp = pgvictoria_append(tmp, "cli_target");
       if (tmp)
       {
-         snprintf(config->common.servers[0].name, sizeof(config->common.servers[0].name), "%s", tmp);
+         snprintf(srv.name, sizeof(srv.name), "%s", tmp);
          free(tmp);
          tmp = NULL;
       }
@@ -347,21 +367,28 @@ main(int argc, char** argv)
       tmp = pgvictoria_append(tmp, host ? host : "127.0.0.1");
       if (tmp)
       {
-         snprintf(config->common.servers[0].host, sizeof(config->common.servers[0].host), "%s", tmp);
+         snprintf(srv.host, sizeof(srv.host), "%s", tmp);
          free(tmp);
          tmp = NULL;
       }
 
-      config->common.servers[0].port = port ? port : 5432;
+      srv.port = port ? port : 5432;
 
       // Server username
       tmp = pgvictoria_append(tmp, user ? user : "postgres");
       if (tmp)
       {
-         snprintf(config->common.servers[0].username, sizeof(config->common.servers[0].username), "%s", tmp);
+         snprintf(srv.username, sizeof(srv.username), "%s", tmp);
          free(tmp);
          tmp = NULL;
       }
+
+      pgvictoria_registry_clear_servers(&config->common);
+      if (pgvictoria_registry_add_server(&config->common, &srv, NULL))
+      {
+         warnx("pgvictoria-cli: Unable to add server");
+         goto error;
+      }
    }
 
    char* pgpass = getenv("PGPASSWORD");
@@ -383,15 +410,14 @@ main(int argc, char** argv)
          goto error;
       }
 
-      config->common.number_of_users = 1;
-
+      struct user usr = {0};
       char* tmp = NULL;
 
       // User username
       tmp = pgvictoria_append(tmp, user ? user : "postgres");
       if (tmp)
       {
-         snprintf(config->common.users[0].username, sizeof(config->common.users[0].username), "%s", tmp);
+         snprintf(usr.username, sizeof(usr.username), "%s", tmp);
          free(tmp);
          tmp = NULL;
       }
@@ -408,14 +434,20 @@ main(int argc, char** argv)
 
       if (tmp)
       {
-         snprintf(config->common.users[0].password, sizeof(config->common.users[0].password), "%s", tmp);
+         snprintf(usr.password, sizeof(usr.password), "%s", tmp);
+         pgvictoria_cleanse(tmp, strlen(tmp));
          free(tmp);
          tmp = NULL;
       }
-      else
+
+      pgvictoria_registry_clear_users(&config->common);
+      if (pgvictoria_registry_add_user(&config->common, &usr, NULL))
       {
-         config->common.users[0].password[0] = '\0';
+         pgvictoria_cleanse(usr.password, sizeof(usr.password));
+         warnx("pgvictoria-cli: Unable to add user");
+         goto error;
       }
+      pgvictoria_cleanse(usr.password, sizeof(usr.password));
    }
 
    if (parsed.cmd->action == ACTION_REPORT)
@@ -451,6 +483,14 @@ main(int argc, char** argv)
             goto error;
          }
       }
+      else if (output_format == PGVICTORIA_OUTPUT_FLEET)
+      {
+         if (pgvictoria_report_fleet(report_type, output_file))
+         {
+            warnx("pgvictoria-cli: Failed to generate fleet report");
+            goto error;
+         }
+      }
       else
       {
          if (pgvictoria_report_online(0, output_format, report_type, output_file))
@@ -460,6 +500,21 @@ main(int argc, char** argv)
          }
       }
    }
+   else if (parsed.cmd->action == ACTION_WATCH)
+   {
+      int number_of_files = 0;
+
+      while (number_of_files < MISC_LENGTH && parsed.args[number_of_files] != NULL)
+      {
+         number_of_files++;
+      }
+
+      if (pgvictoria_watch(parsed.args, number_of_files, override_version, output_file))
+      {
+         warnx("pgvictoria-cli: Failed to watch configuration files");
+         goto error;
+      }
+   }
    else
    {
       warnx("pgvictoria-cli: Unknown action");
@@ -472,6 +527,7 @@ main(int argc, char** argv)
       {
          pgvictoria_cleanse(config->common.users[i].password, sizeof(config->common.users[i].password));
       }
+      pgvictoria_registry_destroy(&config->common);
    }
 
    if (resolved_config_path)
@@ -494,6 +550,7 @@ error:
       {
          pgvictoria_cleanse(config->common.users[i].password, sizeof(config->common.users[i].password));
       }
+      pgvictoria_registry_destroy(&config->common);
    }
 
    if (resolved_config_path)
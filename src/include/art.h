@@ -36,9 +36,22 @@ extern "C" {
 #include <deque.h>
 #include <value.h>
 
+#include <stdbool.h>
 #include <stdint.h>
 
-#define MAX_PREFIX_LEN 10
+/*
+ * The number of prefix bytes stored in a node. The prefix fills the rest of the
+ * 64 byte node header, so the shared segments of GUC names such as
+ * "autovacuum_vacuum_" are compared in place. Longer prefixes are skipped
+ * optimistically and verified against the leaf
+ */
+#define MAX_PREFIX_LEN 56
+
+/* The number of inner nodes an iterator can descend through without allocating */
+#define ART_ITERATOR_DEPTH 32
+
+struct art_node;
+struct art_leaf;
 
 typedef int (*art_callback)(void* data, char* key, struct value* value);
 
@@ -49,20 +62,65 @@ typedef void (*value_destroy_callback)(void* value);
  */
 struct art
 {
-   struct art_node* root; /**< The root node of ART */
-   uint64_t size;         /**< The size of the ART */
+   struct art_node* root;      /**< The root node of ART */
+   uint64_t size;              /**< The size of the ART */
+   bool case_insensitive;      /**< Are keys matched regardless of ASCII case */
+   struct memory_arena* arena; /**< The arena the tree lives in, or NULL */
+   struct memory_arena* bulk;  /**< The arena owned by the tree for bulk loaded nodes and leaves */
+   bool owns_data;             /**< Has the arena been told to release the data of the values */
+};
+
+/** @struct art_entry
+ * Defines a key value pair for a bulk load
+ */
+struct art_entry
+{
+   char* key;            /**< The key */
+   uintptr_t value;      /**< The value */
+   enum value_type type; /**< The value type */
+};
+
+/** @struct art_statistics
+ * Defines the shape of an ART
+ */
+struct art_statistics
+{
+   uint64_t leaves;     /**< The number of leaves */
+   uint64_t node4;      /**< The number of node4 */
+   uint64_t node16;     /**< The number of node16 */
+   uint64_t node48;     /**< The number of node48 */
+   uint64_t node256;    /**< The number of node256 */
+   uint64_t memory;     /**< The number of bytes used by the nodes and the leaves */
+   uint64_t visits;     /**< The number of nodes visited to look up every key once, leaves included */
+   uint64_t optimistic; /**< The number of nodes whose prefix is longer than MAX_PREFIX_LEN */
+};
+
+/** @struct art_iterator_frame
+ * Defines an inner node on the path of an art_iterator
+ */
+struct art_iterator_frame
+{
+   struct art_node* node; /**< The node */
+   uint32_t position;     /**< The next child slot to visit */
 };
 
 /** @struct art_iterator
- * Defines an art_iterator
+ * Defines an art_iterator. The path from the root is kept on a stack of
+ * frames, so stepping does not allocate. The stack only moves to the heap
+ * for paths deeper than ART_ITERATOR_DEPTH
  */
 struct art_iterator
 {
-   struct deque* que;   /**< The deque */
-   struct art* tree;    /**< The ART */
-   uint32_t count;      /**< The count of the iterator */
-   char* key;           /**< The key */
-   struct value* value; /**< The value */
+   struct art* tree;                                      /**< The ART */
+   uint32_t count;                                        /**< The count of the iterator */
+   char* key;                                             /**< The key */
+   struct value* value;                                   /**< The value */
+   struct art_leaf* next;                                 /**< The leaf returned by the next step */
+   struct art_node* pending;                              /**< The subtree to descend into before the stack */
+   uint32_t depth;                                        /**< The number of frames */
+   uint32_t capacity;                                     /**< The capacity of the stack */
+   struct art_iterator_frame* stack;                      /**< The stack */
+   struct art_iterator_frame frames[ART_ITERATOR_DEPTH];  /**< The inline frames */
 };
 
 /**
@@ -73,6 +131,49 @@ struct art_iterator
 int
 pgvictoria_art_create(struct art** tree);
 
+/**
+ * Initializes an adaptive radix tree in an arena. Nodes, leaves and values are
+ * allocated from the arena, and destroying the tree leaves them to the arena
+ * @param arena The arena
+ * @param tree [out] The tree
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_create_arena(struct memory_arena* arena, struct art** tree);
+
+/**
+ * Initializes an adaptive radix tree that matches keys regardless of ASCII case.
+ * Keys are folded to lower case on insert and search, and keep the spelling
+ * they were first inserted with for iteration and display
+ * @param tree [out] The tree
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_create_case_insensitive(struct art** tree);
+
+/**
+ * Make an adaptive radix tree case-insensitive, folding the keys it holds.
+ * Of keys that differ only in case the last one wins
+ * @param t The tree
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_set_case_insensitive(struct art* t);
+
+/**
+ * Load key value pairs into an empty tree in one pass. Every node is created
+ * at its final size, and nodes and leaves come from the arena of the tree,
+ * or from one that is released with the tree. Pairs in key order (folded in a case-insensitive
+ * tree) are loaded in linear time, others are sorted first. Of equal keys
+ * the last one wins
+ * @param t The tree
+ * @param entries The key value pairs
+ * @param number_of_entries The number of pairs
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_bulk_load(struct art* t, struct art_entry* entries, uint64_t number_of_entries);
+
 /**
  * inserts a new value into the art tree,note that the key is copied while the value is sometimes not(depending on value type)
  * @param t The tree
@@ -105,7 +206,8 @@ bool
 pgvictoria_art_contains_key(struct art* t, char* key);
 
 /**
- * Prefix search for a string in the ART tree
+ * Prefix search for a string in the ART tree, copying the matching keys.
+ * pgvictoria_art_prefix_scan visits them without copying
  * @param t The tree
  * @param prefix The prefix to search for
  * @param matches [out] Array of matching strings
@@ -115,6 +217,33 @@ pgvictoria_art_contains_key(struct art* t, char* key);
 int
 pgvictoria_art_prefix_search(struct art* t, char* prefix, char*** matches, int max_matches);
 
+/**
+ * Visit every key that starts with a prefix, in key order. Keys and values
+ * are passed without copying and are only valid during the callback, which
+ * must not modify the tree. A non-zero return from the callback ends the scan
+ * @param t The tree
+ * @param prefix The prefix, NULL or empty visits the whole tree
+ * @param cb The callback
+ * @param data The data for the callback
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_prefix_scan(struct art* t, char* prefix, art_callback cb, void* data);
+
+/**
+ * Visit every key in the range [start, end), in key order. Keys and values
+ * are passed without copying and are only valid during the callback, which
+ * must not modify the tree. A non-zero return from the callback ends the scan
+ * @param t The tree
+ * @param start The first key, NULL to start at the smallest key
+ * @param end The key after the range, NULL to end at the largest key
+ * @param cb The callback
+ * @param data The data for the callback
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_range_scan(struct art* t, char* start, char* end, art_callback cb, void* data);
+
 /**
  * Searches for a value in the ART tree
  * @param t The tree
@@ -152,7 +281,7 @@ int
 pgvictoria_art_clear(struct art* t);
 
 /**
- * Get the next key value pair into iterator
+ * Get the next key value pair into iterator. Pairs are returned in key order
  * @param iter The iterator
  * @return true if iterator has next, otherwise false
  */
@@ -184,6 +313,17 @@ pgvictoria_art_iterator_remove(struct art_iterator* iter);
 int
 pgvictoria_art_iterator_create(struct art* t, struct art_iterator** iter);
 
+/**
+ * Position the iterator so the next step returns the first key that is
+ * equal to or greater than the given key. A prefix scan seeks to the prefix
+ * and stops at the first key that does not start with it
+ * @param iter The iterator
+ * @param key The key
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_art_iterator_seek(struct art_iterator* iter, char* key);
+
 /**
  * Destroy the iterator
  * @param iter The iterator
@@ -191,6 +331,15 @@ pgvictoria_art_iterator_create(struct art* t, struct art_iterator** iter);
 void
 pgvictoria_art_iterator_destroy(struct art_iterator* iter);
 
+/**
+ * Get the shape of the ART tree
+ * @param t The ART tree
+ * @param stats [out] The statistics
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_statistics(struct art* t, struct art_statistics* stats);
+
 /**
  * Convert the ART tree to string
  * @param t The ART tree
@@ -202,6 +351,18 @@ pgvictoria_art_iterator_destroy(struct art_iterator* iter);
 char*
 pgvictoria_art_to_string(struct art* t, int32_t format, char* tag, int indent);
 
+/**
+ * Append the ART tree as a string to a string builder
+ * @param t The ART tree
+ * @param format The format
+ * @param tag The optional tag
+ * @param indent The indent
+ * @param builder The string builder
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_art_to_builder(struct art* t, int32_t format, char* tag, int indent, struct string_builder* builder);
+
 /**
  * Destroys an ART tree
  * @return 0 on success, 1 if otherwise
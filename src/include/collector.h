@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PGVICTORIA_COLLECTOR_H
+#define PGVICTORIA_COLLECTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define COLLECTOR_RING_SIZE (256 * 1024)
+
+#define COLLECTOR_OK      0
+#define COLLECTOR_EMPTY   1
+#define COLLECTOR_DROPPED 2
+#define COLLECTOR_ERROR   3
+
+/** @struct collector_result
+ * Defines the result of one collection from a server. On the ring it is
+ * followed by drift_length bytes of rendered drift samples
+ */
+struct collector_result
+{
+   int server;             /**< The server index */
+   bool up;                /**< Was the collection successful */
+   int version;            /**< The major version of the server */
+   int number_of_default;  /**< The number of settings at their baseline default */
+   int number_of_modified; /**< The number of settings that differ from the baseline */
+   int number_of_custom;   /**< The number of settings not in the baseline */
+   double duration;        /**< The duration of the collection in seconds */
+   time_t timestamp;       /**< The time of the collection */
+   size_t drift_length;    /**< The length of the drift samples */
+};
+
+/**
+ * Create the ring the collectors publish their results on
+ * @param number_of_collectors The number of collectors
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_collector_init(int number_of_collectors);
+
+/**
+ * Run a collector. Collects the servers owned by the collector every
+ * collection_interval and publishes the results on its ring. Does not return
+ * @param collector The collector index
+ * @param number_of_collectors The number of collectors
+ * @param notify_fd The descriptor written to after each result
+ */
+void
+pgvictoria_collector_run(int collector, int number_of_collectors, int notify_fd);
+
+/**
+ * The number of collectors to run
+ * @param collectors The configured number of collectors
+ * @param number_of_servers The number of servers
+ * @return The number of collectors, at least 1 and at most one per server
+ */
+int
+pgvictoria_collector_count(int collectors, int number_of_servers);
+
+/**
+ * The next server a collector owns
+ * @param collector The collector index
+ * @param number_of_collectors The number of collectors
+ * @param number_of_servers The number of servers
+ * @param server The current server, or -1 for the first one
+ * @return The server index, or -1 if there are no more
+ */
+int
+pgvictoria_collector_next(int collector, int number_of_collectors, int number_of_servers, int server);
+
+/**
+ * The number of seconds to sleep before the next collection round
+ * @param interval The collection interval in seconds
+ * @param start The start of the round
+ * @param now The current time
+ * @return The number of seconds, 0 if the round took the whole interval
+ */
+int
+pgvictoria_collector_delay(int interval, time_t start, time_t now);
+
+/**
+ * Publish a result on the collector ring
+ * @param result The result
+ * @param drift The rendered drift samples, may be NULL
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_collector_publish(struct collector_result* result, char* drift);
+
+/**
+ * Consume the oldest result from the collector ring
+ * @param result [out] The result
+ * @param drift [out] The drift samples, owned by the caller, NULL if there were none
+ * @return COLLECTOR_OK upon success, COLLECTOR_EMPTY if the ring is empty,
+ * COLLECTOR_DROPPED if a malformed record was removed, or COLLECTOR_ERROR if
+ * the record could not be read and was left in place
+ */
+int
+pgvictoria_collector_consume(struct collector_result* result, char** drift);
+
+/**
+ * Destroy the collector ring
+ */
+void
+pgvictoria_collector_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,18 +36,67 @@ extern "C" {
 #include <value.h>
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
-/** @struct deque_node
- * Defines a deque node
+/* The number of entries of the first block of a deque */
+#define DEQUE_FIRST_BLOCK 4
+
+/* The number of entries of the largest block of a deque */
+#define DEQUE_MAX_BLOCK 64
+
+/** @struct deque_entry
+ * Defines a deque entry
+ */
+struct deque_entry
+{
+   struct value value; /**< The value */
+   char* tag;          /**< The tag */
+};
+
+/**
+ * Compare two deque entries
+ * @param e1 The first entry
+ * @param e2 The second entry
+ * @return Less than, equal to or greater than 0 when e1 goes before, with or after e2
+ */
+typedef int (*deque_compare_cb)(struct deque_entry* e1, struct deque_entry* e2);
+
+/** @struct deque_block
+ * Defines a block of deque entries. Entries [first, last) are in use
+ */
+struct deque_block
+{
+   struct deque_block* next;     /**< The next block */
+   struct deque_block* prev;     /**< The previous block */
+   uint32_t first;               /**< The first entry in use */
+   uint32_t last;                /**< The entry after the last one in use */
+   uint32_t capacity;            /**< The number of entries */
+   struct deque_entry entries[]; /**< The entries */
+};
+
+/** @struct deque_slot
+ * Defines a slot of a concurrent deque
+ */
+struct deque_slot
+{
+   atomic_ullong sequence;   /**< The position the slot is ready for, see deque_ring */
+   struct deque_entry entry; /**< The entry */
+};
+
+/** @struct deque_ring
+ * Defines the bounded multi-producer multi-consumer queue of a concurrent deque.
+ * A slot is free for the producer at position p when its sequence is p, and
+ * holds an entry for the consumer at position p when its sequence is p + 1
  */
-struct deque_node
+struct deque_ring
 {
-   struct value* data;      /**< The value */
-   char* tag;               /**< The tag */
-   struct deque_node* next; /**< The next pointer */
-   struct deque_node* prev; /**< The previous pointer */
+   uint64_t mask;                                      /**< The number of slots minus one */
+   atomic_ullong enqueue __attribute__((aligned(64))); /**< The next position to add at */
+   atomic_ullong dequeue __attribute__((aligned(64))); /**< The next position to poll from */
+   atomic_bool settled __attribute__((aligned(64)));   /**< Have entries been moved to the blocks */
+   struct deque_slot slots[];                          /**< The slots */
 };
 
 /** @struct deque
@@ -55,11 +104,14 @@ struct deque_node
  */
 struct deque
 {
-   uint32_t size;            /**< The size of the deque */
-   bool thread_safe;         /**< If the deque is thread safe */
-   pthread_rwlock_t mutex;   /**< The mutex of the deque */
-   struct deque_node* start; /**< The start node */
-   struct deque_node* end;   /**< The end node */
+   uint32_t size;              /**< The size of the deque */
+   bool thread_safe;           /**< If the deque is thread safe */
+   bool owns_data;             /**< Has the arena been told to release the data of the values */
+   pthread_rwlock_t mutex;     /**< The mutex of the deque */
+   struct deque_block* start;  /**< The first block */
+   struct deque_block* end;    /**< The last block */
+   struct memory_arena* arena; /**< The arena the deque lives in, or NULL */
+   struct deque_ring* ring;    /**< The queue of a concurrent deque, or NULL */
 };
 
 /** @struct deque_iterator
@@ -67,10 +119,11 @@ struct deque
  */
 struct deque_iterator
 {
-   struct deque* deque;    /**< The deque */
-   struct deque_node* cur; /**< The current deque node */
-   char* tag;              /**< The current tag */
-   struct value* value;    /**< The current value */
+   struct deque* deque;       /**< The deque */
+   struct deque_block* block; /**< The block of the current entry, NULL before the first one */
+   int32_t index;             /**< The index of the current entry */
+   char* tag;                 /**< The current tag */
+   struct value* value;       /**< The current value */
 };
 
 /**
@@ -82,6 +135,29 @@ struct deque_iterator
 int
 pgvictoria_deque_create(bool thread_safe, struct deque** deque);
 
+/**
+ * Create a deque in an arena. Its blocks, tags and values are allocated from
+ * the arena and released with it
+ * @param arena The arena
+ * @param thread_safe If the deque needs to be thread safe
+ * @param deque The deque
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_deque_create_arena(struct memory_arena* arena, bool thread_safe, struct deque** deque);
+
+/**
+ * Create a concurrent deque. Add and poll are lock-free and go through a
+ * bounded queue, add fails when the queue is full.
+ * The other operations first move the queued entries to the deque under the
+ * lock, and should not run while other threads add or poll
+ * @param capacity The capacity of the queue, rounded up to a power of two
+ * @param deque The deque
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_deque_create_concurrent(uint32_t capacity, struct deque** deque);
+
 /**
  * Add a node to deque's tail, the tag will be copied
  * This function is thread safe
@@ -219,7 +295,7 @@ bool
 pgvictoria_deque_iterator_has_next(struct deque_iterator* iter);
 
 /**
- * Remove the current node iterator points to and place the iterator to the previous node
+ * Remove the current entry iterator points to and place the iterator to the previous entry
  * @param iter The iterator
  */
 void
@@ -256,12 +332,46 @@ void
 pgvictoria_deque_list(struct deque* deque);
 
 /**
- * Sort the deque
+ * Sort the deque by tag, entries without a tag go last
  * @param deque The deque
  */
 void
 pgvictoria_deque_sort(struct deque* deque);
 
+/**
+ * Sort the deque with a comparator. The sort is stable
+ * @param deque The deque
+ * @param compare The comparator
+ */
+void
+pgvictoria_deque_sort_by(struct deque* deque, deque_compare_cb compare);
+
+/**
+ * Add a node to a sorted deque, after the entries that compare equal to it,
+ * the tag will be copied. Adding in order, or nearly so, is the cheap case
+ * This function is thread safe
+ * @param deque The deque
+ * @param tag The tag,optional
+ * @param data The data
+ * @param type The data type
+ * @param compare The comparator the deque is sorted by
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_deque_add_sorted(struct deque* deque, char* tag, uintptr_t data, enum value_type type, deque_compare_cb compare);
+
+/**
+ * Merge sorted deques into a new sorted deque. The entries are moved, so the
+ * deques are left empty. Entries that compare equal keep the order of the deques
+ * @param deques The deques, distinct and not in an arena
+ * @param number The number of deques
+ * @param compare The comparator the deques are sorted by
+ * @param merged [out] The merged deque
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_deque_merge(struct deque** deques, int number, deque_compare_cb compare, struct deque** merged);
+
 /**
  * Convert what's inside deque to string
  * @param deque The deque
@@ -273,6 +383,18 @@ pgvictoria_deque_sort(struct deque* deque);
 char*
 pgvictoria_deque_to_string(struct deque* deque, int32_t format, char* tag, int indent);
 
+/**
+ * Append what's inside deque as a string to a string builder
+ * @param deque The deque
+ * @param format The format
+ * @param tag [Optional] The tag, which will be applied before the content if not null
+ * @param indent The current indentation
+ * @param builder The string builder
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_deque_to_builder(struct deque* deque, int32_t format, char* tag, int indent, struct string_builder* builder);
+
 /**
  * Destroy the deque and free its and its nodes' memory
  * @param deque The deque
@@ -38,6 +38,49 @@ extern "C" {
 
 #include <stdbool.h>
 
+/* The id of a setting that is not in any baseline */
+#define GUC_UNKNOWN -1
+
+/**
+ * Build the table of interned setting names. Every setting of every supported
+ * baseline gets a dense id, in case-insensitive name order, so data about
+ * settings can be kept in arrays indexed by id. The table is built on first
+ * use, call this before forking or starting threads to share it. A build that
+ * failed on first use is only tried again by calling this
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_guc_intern_init(void);
+
+/**
+ * Release the table of interned setting names
+ */
+void
+pgvictoria_guc_intern_destroy(void);
+
+/**
+ * Look up the id of a setting, matching the name regardless of case
+ * @param guc_name The setting name
+ * @return The id, or GUC_UNKNOWN if the setting is in no baseline
+ */
+int
+pgvictoria_guc_id(char* guc_name);
+
+/**
+ * Get the name of a setting, spelled as in the baselines
+ * @param id The id
+ * @return The interned name, or NULL for an unknown id
+ */
+char*
+pgvictoria_guc_name(int id);
+
+/**
+ * Get the number of interned setting names, ids are below it
+ * @return The number of names
+ */
+int
+pgvictoria_guc_number_of_names(void);
+
 /**
  * Decide whether a live GUC value differs from its baseline default.
  *
@@ -61,6 +104,19 @@ extern "C" {
 int
 pgvictoria_check_guc(char* guc_name, enum value_type type, char* baseline_val, char* current_val, bool* modified);
 
+/**
+ * Decide whether a live GUC value differs from its baseline default, for a
+ * setting already resolved with pgvictoria_guc_id()
+ * @param id The setting id, or GUC_UNKNOWN
+ * @param type The baseline value type (as stored in the JSON baseline)
+ * @param baseline_val The baseline default, rendered as text
+ * @param current_val The live value from the server
+ * @param modified Set to true when the values differ, false when equivalent
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_check_guc_id(int id, enum value_type type, char* baseline_val, char* current_val, bool* modified);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,10 +29,111 @@
 #ifndef PGVICTORIA_HTML_REPORT_H
 #define PGVICTORIA_HTML_REPORT_H
 
+#include <art.h>
 #include <deque.h>
 #include <pgvictoria.h>
 #include <report.h>
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTML_BUFFER_SIZE 65536
+
+/** @struct html_report
+ * Defines an HTML report that is written while its rows arrive. Text is
+ * escaped into a buffer that is written out whenever it fills, so the memory
+ * used does not depend on the number of rows.
+ *
+ * A fleet report holds the rows of many servers as data for a script in the
+ * page, which only renders the rows in view. A row is five numbers, the
+ * server and the indexes of its key, baseline, value and status in a table
+ * of the distinct strings, which is written after the rows.
+ */
+struct html_report
+{
+   int fd;                        /**< The file descriptor */
+   size_t length;                 /**< The number of bytes in the buffer */
+   bool error;                    /**< Has a write failed */
+   bool fleet;                    /**< Is this a fleet report */
+   struct art* strings;           /**< The index of each distinct string of a fleet report */
+   uint32_t number_of_strings;    /**< The number of distinct strings */
+   uint32_t number_of_rows;       /**< The number of rows of a fleet report */
+   struct deque* servers;         /**< The servers of a fleet report, tagged by name, with their version */
+   char buffer[HTML_BUFFER_SIZE]; /**< The buffer */
+};
+
+/**
+ * Start an HTML report: the head, the metadata table and the table header.
+ * @param output_html_path The destination path of the HTML file.
+ * @param version The resolved PostgreSQL version.
+ * @param scope_label What kind of source was audited ("File" or "Online").
+ * @param scope_value Which source it was: a configuration file path, or a host:port.
+ * @param report [out] The report, NULL upon failure.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_html_report_open(const char* output_html_path, int version, const char* scope_label, const char* scope_value, struct html_report** report);
+
+/**
+ * Add a row to an HTML report.
+ * @param report The report.
+ * @param item The comparison result.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_html_report_row(struct html_report* report, struct pgvictoria_diff_item* item);
+
+/**
+ * Finish an HTML report and release it.
+ * @param report The report.
+ * @return 0 if the whole report was written, otherwise 1.
+ */
+int pgvictoria_html_report_close(struct html_report* report);
+
+/**
+ * Start a fleet report: the head, the metadata table and the controls.
+ * @param output_html_path The destination path of the HTML file.
+ * @param scope_label What kind of source was audited ("File" or "Online").
+ * @param scope_value Which source it was: a configuration file path, or the servers.
+ * @param report [out] The report, NULL upon failure.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_html_fleet_open(const char* output_html_path, const char* scope_label, const char* scope_value, struct html_report** report);
+
+/**
+ * Start the rows of a server in a fleet report.
+ * @param report The report.
+ * @param name The name of the server.
+ * @param version The PostgreSQL version of the server.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_html_fleet_server(struct html_report* report, const char* name, int version);
+
+/**
+ * Add a row of the current server to a fleet report.
+ * @param report The report.
+ * @param item The comparison result.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_html_fleet_row(struct html_report* report, struct pgvictoria_diff_item* item);
+
+/**
+ * Finish a fleet report and release it.
+ * @param report The report.
+ * @return 0 if the whole report was written, otherwise 1.
+ */
+int pgvictoria_html_fleet_close(struct html_report* report);
+
+/**
+ * Generate a fleet report of a single source from difference items.
+ * @param output_html_path The destination path of the HTML file.
+ * @param version The resolved PostgreSQL version.
+ * @param items The deque of comparison results.
+ * @param scope_label What kind of source was audited ("File" or "Online").
+ * @param scope_value Which source it was: a configuration file path, or a host:port.
+ * @return 0 upon success, otherwise 1.
+ */
+int pgvictoria_generate_html_fleet_report(const char* output_html_path, int version, struct deque* items, const char* scope_label, const char* scope_value);
+
 /**
  * Generate a beautifully formatted HTML report from difference items.
  * @param output_html_path The destination path of the HTML file.
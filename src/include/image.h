@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGVICTORIA_IMAGE_H
+#define PGVICTORIA_IMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+#include <value.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_MAGIC   "PGVIMAGE"
+#define IMAGE_VERSION 1
+
+/** @struct image
+ * Defines a read-only image of a JSON object, an ART or a deque. An image
+ * holds no pointers, every reference is an offset from its start, so it can
+ * be mapped from a file and queried in place without being deserialized.
+ * Objects and trees keep their entries in key order and are searched in
+ * place. A mapped file is shared with the processes forked after it is
+ * opened, and with every other process that maps the same file
+ */
+struct image
+{
+   void* data;  /**< The image */
+   size_t size; /**< The size of the image */
+   bool mapped; /**< Is the image a mapped file */
+};
+
+/** @struct image_value
+ * Defines a value read in place from an image
+ */
+struct image_value
+{
+   enum value_type type; /**< The type, ValueJSON, ValueART or ValueDeque for a container */
+   uintptr_t data;       /**< The data, strings point into the image */
+   uint32_t length;      /**< The length of a string, or the number of entries of a container */
+   uint32_t offset;      /**< The offset of a container in the image */
+};
+
+/**
+ * Create an image of a JSON object, an ART or a deque. The values may be
+ * numbers, strings and nested JSON objects, trees or deques
+ * @param type The type, ValueJSON, ValueART or ValueDeque
+ * @param data The object
+ * @param image [out] The image, free() it when done
+ * @param size [out] The size of the image
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_create(enum value_type type, uintptr_t data, void** image, size_t* size);
+
+/**
+ * Write an image of a JSON object, an ART or a deque to a file. The file is
+ * replaced atomically, so readers that have it mapped keep their version
+ * @param path The path
+ * @param type The type, ValueJSON, ValueART or ValueDeque
+ * @param data The object
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_write_file(char* path, enum value_type type, uintptr_t data);
+
+/**
+ * Map an image file read-only. The image is verified before it is used
+ * @param path The path
+ * @param image [out] The image
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_open(char* path, struct image** image);
+
+/**
+ * Use an image in memory owned by the caller, f.ex. a shared memory segment.
+ * The image is verified before it is used
+ * @param data The image
+ * @param size The size of the image
+ * @param image [out] The image
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_attach(void* data, size_t size, struct image** image);
+
+/**
+ * Get the object the image was created from
+ * @param image The image
+ * @param value [out] The object
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_root(struct image* image, struct image_value* value);
+
+/**
+ * Look up a key in a JSON object or an ART of the image, or the first entry
+ * with the tag in a deque
+ * @param image The image
+ * @param container The object, tree or deque
+ * @param key The key
+ * @param value [out] The value
+ * @return 0 if the key was found, otherwise 1
+ */
+int
+pgvictoria_image_get(struct image* image, struct image_value* container, char* key, struct image_value* value);
+
+/**
+ * Get an entry of a container of the image by position, in key order for
+ * objects and trees
+ * @param image The image
+ * @param container The container
+ * @param index The position
+ * @param key [out] The key or tag, may be NULL
+ * @param value [out] The value
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_at(struct image* image, struct image_value* container, uint32_t index, char** key, struct image_value* value);
+
+/**
+ * Load a container of the image into a JSON object, an ART or a deque.
+ * Containers nested too deep or referring back to a parent are rejected
+ * @param image The image
+ * @param container The container
+ * @param data [out] The object, of the type of the container
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_image_load(struct image* image, struct image_value* container, uintptr_t* data);
+
+/**
+ * Close an image
+ * @param image The image
+ */
+void
+pgvictoria_image_close(struct image* image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
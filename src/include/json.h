@@ -75,6 +75,9 @@ struct json
    enum json_type type; /**< The json object type */
    // if the object is an array, it can have at most one json element
    void* elements; /**< The json elements, could be an array or some kv pairs */
+   // an object in an arena allocates its elements from it too
+   struct memory_arena* arena; /**< The arena the object lives in, or NULL */
+   bool owner;                 /**< Does the object release the arena when destroyed */
 };
 
 /** @struct json_reader
@@ -87,6 +90,70 @@ struct json_reader
    enum parse_state state;       /**< The current reader state of the JSON reader */
 };
 
+/**
+ * What a JSON parser accepts next
+ */
+enum json_expect {
+   JSONExpectValue,
+   JSONExpectKey,
+   JSONExpectColon,
+   JSONExpectNext
+};
+
+/**
+ * The events of a JSON stream
+ */
+enum json_event_type {
+   JSONEventNone,
+   JSONEventObjectStart,
+   JSONEventObjectEnd,
+   JSONEventArrayStart,
+   JSONEventArrayEnd,
+   JSONEventKey,
+   JSONEventString,
+   JSONEventInteger,
+   JSONEventFloat,
+   JSONEventBool,
+   JSONEventNull,
+   JSONEventEnd
+};
+
+#define JSON_STREAM_MAX_DEPTH 1024
+
+/** @struct json_event
+ * Defines an event of a JSON stream
+ */
+struct json_event
+{
+   enum json_event_type type; /**< The event type */
+   int depth;                 /**< The number of objects and arrays around the event */
+   char* string;              /**< The key or string, valid until the next event */
+   size_t length;             /**< The length of the key or string */
+   int64_t integer;           /**< The integer */
+   double number;             /**< The floating point number */
+   bool boolean;              /**< The boolean */
+};
+
+/** @struct json_stream
+ * Defines a JSON stream, which reads a document one event at a time.
+ * Only the read buffer, the longest string and a bit per nesting level
+ * are kept, so the memory used does not grow with the document
+ */
+struct json_stream
+{
+   struct stream_buffer* buffer;                 /**< The read buffer */
+   int fd;                                       /**< The file descriptor */
+   bool owns_fd;                                 /**< Is the file descriptor closed with the stream */
+   bool error;                                   /**< Has the stream failed */
+   enum json_expect expect;                      /**< What the stream accepts next */
+   enum json_event_type last;                    /**< The last event */
+   int depth;                                    /**< The number of open objects and arrays */
+   uint64_t objects[JSON_STREAM_MAX_DEPTH / 64]; /**< A bit per open object or array, set for an object */
+   char* token;                                  /**< The string that spans reads or has escapes */
+   size_t token_length;                          /**< The length of the string */
+   size_t token_size;                            /**< The size of the string buffer */
+};
+
 /** @struct json_iterator
  * Defines a JSON iterator
  */
@@ -122,6 +189,16 @@ pgvictoria_json_reader_close(struct json_reader* reader);
 int
 pgvictoria_json_create(struct json** object);
 
+/**
+ * Create a json object in an arena. The object and everything put into it
+ * are allocated from the arena, and destroying it leaves them to the arena
+ * @param arena The arena
+ * @param item [out] The json item
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgvictoria_json_create_arena(struct memory_arena* arena, struct json** object);
+
 /**
  * Put a key value pair into the json item,
  * if the key exists, value will be overwritten,
@@ -183,6 +260,15 @@ pgvictoria_json_get_typed(struct json* item, char* tag, enum value_type* type);
 bool
 pgvictoria_json_contains_key(struct json* item, char* key);
 
+/**
+ * Match the keys of a json item regardless of ASCII case, f.ex. DateStyle
+ * and datestyle. Keys keep their spelling for output
+ * @param item The json item
+ * @return 0 if success, otherwise 1
+ */
+int
+pgvictoria_json_case_insensitive(struct json* item);
+
 /**
  * Navigate the reader to the target json object(array or item) according to the key prefix array,
  * it currently does not handle escape character
@@ -216,6 +302,53 @@ pgvictoria_json_append(struct json* array, uintptr_t entry, enum value_type type
 bool
 pgvictoria_json_next_array_item(struct json_reader* reader, struct json** item);
 
+/**
+ * Open a JSON stream on a file. The file may hold one document,
+ * or a sequence of them such as a jsonlog file with one object per line
+ * @param path The file path
+ * @param stream [out] The stream
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgvictoria_json_stream_init(char* path, struct json_stream** stream);
+
+/**
+ * Open a JSON stream on a file descriptor, such as a pipe.
+ * The file descriptor is left open when the stream is closed
+ * @param fd The file descriptor
+ * @param stream [out] The stream
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgvictoria_json_stream_init_fd(int fd, struct json_stream** stream);
+
+/**
+ * Read the next event of a JSON stream. A JSONEventEnd event is returned
+ * once the input is used up between documents
+ * @param stream The stream
+ * @param event [out] The event
+ * @return 0 if success, 1 if the input is not valid JSON or can't be read
+ */
+int
+pgvictoria_json_stream_next(struct json_stream* stream, struct json_event* event);
+
+/**
+ * Skip a value without reporting its events. After a key event the value
+ * of the key is skipped, after an object or array start event the rest of
+ * the object or array is. Skipped values are only checked for balance
+ * @param stream The stream
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgvictoria_json_stream_skip(struct json_stream* stream);
+
+/**
+ * Close a JSON stream
+ * @param stream The stream
+ */
+void
+pgvictoria_json_stream_close(struct json_stream* stream);
+
 /**
  * Get json array length
  * @param array The json array
@@ -256,7 +389,8 @@ void
 pgvictoria_json_iterator_destroy(struct json_iterator* iter);
 
 /**
- * Parse a string into json item
+ * Parse a string into json item. The document is allocated from one arena,
+ * which is released when the returned object is destroyed
  * @param str The string
  * @param obj [out] The json object
  * @return 0 if success, 1 if otherwise
@@ -284,6 +418,18 @@ pgvictoria_json_clone(struct json* from, struct json** to);
 char*
 pgvictoria_json_to_string(struct json* object, int32_t format, char* tag, int indent);
 
+/**
+ * Append a json as a string to a string builder
+ * @param object The json object
+ * @param format The format
+ * @param tag The optional tag
+ * @param indent The indent
+ * @param builder The string builder
+ * @return 0 if success, 1 if otherwise
+ */
+int
+pgvictoria_json_to_builder(struct json* object, int32_t format, char* tag, int indent, struct string_builder* builder);
+
 /**
  * Print a json object
  * @param object The object
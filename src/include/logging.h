@@ -59,6 +59,8 @@ extern "C" {
 
 #define PGVICTORIA_LOGGING_DEFAULT_LOG_LINE_PREFIX "%Y-%m-%d %H:%M:%S"
 
+#define PGVICTORIA_LOGGING_RING_SIZE               (4 * 1024 * 1024)
+
 #define pgvictoria_log_trace(...)                  pgvictoria_log_line(PGVICTORIA_LOGGING_LEVEL_DEBUG5, __FILE__, __LINE__, __VA_ARGS__)
 #define pgvictoria_log_debug(...)                  pgvictoria_log_line(PGVICTORIA_LOGGING_LEVEL_DEBUG1, __FILE__, __LINE__, __VA_ARGS__)
 #define pgvictoria_log_info(...)                   pgvictoria_log_line(PGVICTORIA_LOGGING_LEVEL_INFO, __FILE__, __LINE__, __VA_ARGS__)
@@ -80,6 +82,32 @@ pgvictoria_start_logging(void);
 int
 pgvictoria_stop_logging(void);
 
+/**
+ * Initialize the log writer. From now on the log lines of this process, and
+ * of the processes forked from it, are pushed to a shared memory ring instead
+ * of being written. A line is dropped, and counted, if the ring is full, so
+ * logging never waits for I/O. The ring is written by the process that calls
+ * pgvictoria_log_writer_run. Syslog is not affected
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_log_writer_init(void);
+
+/**
+ * Run the log writer in a forked process. The lines are written in batches,
+ * the log is rotated here, and the process exits once it is asked to stop
+ * with SIGTERM and every pushed line is written
+ */
+void
+pgvictoria_log_writer_run(void);
+
+/**
+ * Destroy the log writer after its process has exited. Lines are written
+ * directly again, to a log that is reopened in case the writer rotated it
+ */
+void
+pgvictoria_log_writer_destroy(void);
+
 /**
  * Is the logging level enabled
  * @param level The level
@@ -35,8 +35,46 @@ extern "C" {
 
 #include <pgvictoria.h>
 
+#include <stdbool.h>
 #include <stdlib.h>
 
+/* The default size of an arena block */
+#define MEMORY_ARENA_BLOCK (64 * 1024)
+
+/** @struct memory_arena_block
+ * Defines a block of an arena
+ */
+struct memory_arena_block
+{
+   struct memory_arena_block* next; /**< The previous block */
+   size_t size;                     /**< The size of the data */
+   size_t used;                     /**< The number of bytes handed out */
+   char data[] __attribute__((aligned(16)));
+};
+
+/** @struct memory_arena_cleanup
+ * Defines a callback run when an arena is released
+ */
+struct memory_arena_cleanup
+{
+   struct memory_arena_cleanup* next; /**< The previously registered callback */
+   void (*cleanup)(void* data);       /**< The callback */
+   void* data;                        /**< The data of the callback */
+};
+
+/** @struct memory_arena
+ * Defines an arena. Allocations are carved from large blocks and are
+ * never freed one by one; the whole arena is released at once
+ */
+struct memory_arena
+{
+   struct memory_arena_block* block;     /**< The current block */
+   struct memory_arena_block* first;     /**< The block the arena was created with, kept on reset */
+   struct memory_arena_cleanup* cleanup; /**< The callbacks to run on release */
+   size_t block_size;                    /**< The size of new blocks */
+   size_t allocated;                     /**< The number of bytes handed out */
+};
+
 /**
  * Initialize a memory segment for the process local message structure
  */
@@ -89,6 +127,58 @@ pgvictoria_memory_dynamic_destroy(void* data);
 void*
 pgvictoria_memory_dynamic_append(void* orig, size_t orig_size, void* append, size_t append_size, size_t* new_size);
 
+/**
+ * Create an arena
+ * @param block_size The size of the blocks, or 0 for the default
+ * @param arena The arena
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_memory_arena_create(size_t block_size, struct memory_arena** arena);
+
+/**
+ * Allocate zeroed memory from an arena. The memory is 16 byte aligned
+ * @param arena The arena
+ * @param size The size
+ * @return The memory, or NULL
+ */
+void*
+pgvictoria_memory_arena_alloc(struct memory_arena* arena, size_t size);
+
+/**
+ * Copy a string into an arena
+ * @param arena The arena
+ * @param s The string
+ * @return The copy, or NULL
+ */
+char*
+pgvictoria_memory_arena_string(struct memory_arena* arena, char* s);
+
+/**
+ * Register a callback that is run when the arena is reset or destroyed.
+ * Used for heap memory owned by objects that live in the arena
+ * @param arena The arena
+ * @param cleanup The callback
+ * @param data The data of the callback
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_memory_arena_cleanup(struct memory_arena* arena, void (*cleanup)(void* data), void* data);
+
+/**
+ * Release everything allocated from an arena, but keep its first block
+ * @param arena The arena
+ */
+void
+pgvictoria_memory_arena_reset(struct memory_arena* arena);
+
+/**
+ * Destroy an arena and everything allocated from it
+ * @param arena The arena
+ */
+void
+pgvictoria_memory_arena_destroy(struct memory_arena* arena);
+
 #ifdef __cplusplus
 }
 #endif
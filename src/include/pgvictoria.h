@@ -70,6 +70,11 @@ extern "C" {
 #define MAX_EXTRA                    64
 #define NUMBER_OF_SERVERS            64
 #define NUMBER_OF_USERS              64
+#define MAX_NUMBER_OF_COLLECTORS     32
+
+#define TRACE_PROTOCOL               0
+#define TRACE_SECURITY               1
+#define NUMBER_OF_TRACE_SUBSYSTEMS   2
 
 #define STATE_FREE                   0
 #define STATE_IN_USE                 1
@@ -180,6 +185,8 @@ struct version
    int patch; /**< Patch version number (-1 if not specified) */
 } __attribute__((aligned(64)));
 
+struct registry;
+
 /** @struct server
  * Defines a server
  */
@@ -203,6 +210,15 @@ struct user
    char password[MAX_PASSWORD_LENGTH]; /**< The password */
 } __attribute__((aligned(64)));
 
+/** @struct trace_configuration
+ * Defines the tracing of a subsystem
+ */
+struct trace_configuration
+{
+   int sample; /**< The percentage of exchanges that are traced, 0 disables tracing */
+   int rate;   /**< The maximum number of trace lines per second in each process, 0 for no limit */
+};
+
 /** @struct common_configuration
  * Defines configurations that are common between all tools
  */
@@ -218,9 +234,16 @@ struct common_configuration
    int log_rotation_age;              /**< minutes for log rotation */
    char log_line_prefix[MISC_LENGTH]; /**< The logging prefix */
    atomic_schar log_lock;             /**< The logging lock */
+   atomic_bool log_reopen;            /**< Should the log writer reopen the log */
+   atomic_ullong log_dropped;         /**< The number of log lines dropped by a full log ring */
+   atomic_bool log_waiting;           /**< Is the log writer waiting to be woken by a new line */
+
+   struct trace_configuration trace[NUMBER_OF_TRACE_SUBSYSTEMS]; /**< The tracing of each subsystem */
+   int trace_payload;                                            /**< The number of payload bytes in a trace line */
 
-   struct server servers[NUMBER_OF_SERVERS]; /**< The servers */
-   struct user users[NUMBER_OF_USERS];       /**< The users */
+   struct registry* registry; /**< The registry holding the servers and the users */
+   struct server* servers;    /**< The servers, inside the registry */
+   struct user* users;        /**< The users, inside the registry */
 
    int number_of_servers; /**< The number of servers */
    int number_of_users;   /**< The number of users */
@@ -250,6 +273,10 @@ struct main_configuration
    unsigned char hugepage;  /**< Huge page support */
 
    char unix_socket_dir[MISC_LENGTH]; /**< The directory for the Unix Domain Socket */
+
+   int metrics;             /**< The metrics port */
+   int collection_interval; /**< The collection interval in seconds */
+   int collectors;          /**< The maximum number of collector processes */
 } __attribute__((aligned(64)));
 
 #ifdef __cplusplus
@@ -42,6 +42,7 @@ extern "C" {
 
 /**
  * Get the PostgreSQL baseline configuration for a specific version.
+ * Setting names are matched regardless of case, as PostgreSQL does.
  * 
  * @param version The PostgreSQL version (e.g. 14, 15, 16, 17, 18, 19)
  * @return The JSON baseline object, or NULL if the version is not supported or parsing fails.
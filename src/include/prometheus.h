@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PGVICTORIA_PROMETHEUS_H
+#define PGVICTORIA_PROMETHEUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+#include <collector.h>
+#include <deque.h>
+
+#include <ev.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PROMETHEUS_REQUEST_SIZE 2048
+#define PROMETHEUS_TIMEOUT      5.0
+
+/** @struct prometheus_server
+ * Defines the result of the last collection from a server
+ */
+struct prometheus_server
+{
+   char label[MISC_LENGTH * 2]; /**< The escaped server name */
+   bool up;                     /**< Was the last collection successful */
+   int version;                 /**< The major version of the server */
+   int number_of_default;       /**< The number of settings at their baseline default */
+   int number_of_modified;      /**< The number of settings that differ from the baseline */
+   int number_of_custom;        /**< The number of settings not in the baseline */
+   double duration;             /**< The duration of the last collection in seconds */
+   time_t last_collection;      /**< The time of the last successful collection */
+   uint64_t collections;        /**< The number of collections */
+   uint64_t errors;             /**< The number of failed collections */
+   char* drift;                 /**< The rendered pgvictoria_setting_drift samples */
+};
+
+/**
+ * Initialize the metrics cache
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_init(void);
+
+/**
+ * Collect the configuration of a server and render its drift samples.
+ * Runs in a collector
+ * @param server The server index
+ * @param result [out] The result of the collection
+ * @param drift [out] The rendered drift samples, NULL if there were none
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_collect(int server, struct collector_result* result, char** drift);
+
+/**
+ * Count the settings of a collection by status and render its drift samples
+ * @param server The server index
+ * @param items The diff items of the collection
+ * @param result The result of the collection, the counts are added to it
+ * @param drift [out] The rendered drift samples, NULL if there were none
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_drift(int server, struct deque* items, struct collector_result* result, char** drift);
+
+/**
+ * Apply a collection result to the latest state of a server. Runs in main
+ * @param result The result of the collection
+ * @param drift The rendered drift samples, ownership is taken
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_update(struct collector_result* result, char* drift);
+
+/**
+ * Render the metrics cache from the latest collection results. Upon failure
+ * the cache keeps the last complete render
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_render(void);
+
+/**
+ * Serve a metrics client on the event loop. The request is read and the
+ * response written without blocking; the response body is a copy of the
+ * metrics cache
+ * @param loop The event loop
+ * @param client_fd The client descriptor
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_prometheus_client(struct ev_loop* loop, int client_fd);
+
+/**
+ * Get the metrics cache as last rendered
+ * @param length [out] The length of the metrics
+ * @return The metrics, owned by the cache
+ */
+char*
+pgvictoria_prometheus_metrics(size_t* length);
+
+/**
+ * Destroy the metrics cache
+ */
+void
+pgvictoria_prometheus_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
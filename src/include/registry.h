@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PGVICTORIA_REGISTRY_H
+#define PGVICTORIA_REGISTRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @struct registry
+ * Defines the shared memory segment holding the servers and the users.
+ *
+ * The segment starts with this header followed by the server array, the user
+ * array and three open addressing hash indexes of int32 slots: servers by
+ * name, servers by host:port and users by name. The layout only uses offsets
+ * so the segment can be copied into a bigger one when it fills up
+ */
+struct registry
+{
+   size_t size;                     /**< The size of the segment */
+   int server_capacity;             /**< The number of server entries */
+   int user_capacity;               /**< The number of user entries */
+   uint32_t server_slots;           /**< The number of slots in a server index, a power of two */
+   uint32_t user_slots;             /**< The number of slots in the user index, a power of two */
+   size_t servers_offset;           /**< The offset of the servers */
+   size_t users_offset;             /**< The offset of the users */
+   size_t server_names_offset;      /**< The offset of the server name index */
+   size_t server_endpoints_offset;  /**< The offset of the server host:port index */
+   size_t user_names_offset;        /**< The offset of the user name index */
+} __attribute__((aligned(64)));
+
+/**
+ * Create the registry of a configuration
+ * @param config The configuration
+ * @param servers The initial number of servers
+ * @param users The initial number of users
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_registry_create(struct common_configuration* config, int servers, int users);
+
+/**
+ * Add a server. The registry grows when it is full, which moves the servers
+ * and the users, so only add entries before other processes are forked
+ * @param config The configuration
+ * @param server The server
+ * @param index [out] The index of the server, may be NULL
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_registry_add_server(struct common_configuration* config, struct server* server, int* index);
+
+/**
+ * Add a user. The registry grows when it is full, which moves the servers
+ * and the users, so only add entries before other processes are forked
+ * @param config The configuration
+ * @param user The user
+ * @param index [out] The index of the user, may be NULL
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_registry_add_user(struct common_configuration* config, struct user* user, int* index);
+
+/**
+ * Find the first server with a name
+ * @param config The configuration
+ * @param name The name
+ * @return The index of the server, or -1 if not found
+ */
+int
+pgvictoria_registry_find_server(struct common_configuration* config, char* name);
+
+/**
+ * Find the first server with a host and port
+ * @param config The configuration
+ * @param host The host
+ * @param port The port
+ * @return The index of the server, or -1 if not found
+ */
+int
+pgvictoria_registry_find_endpoint(struct common_configuration* config, char* host, int port);
+
+/**
+ * Find the first user with a name
+ * @param config The configuration
+ * @param username The user name
+ * @return The index of the user, or -1 if not found
+ */
+int
+pgvictoria_registry_find_user(struct common_configuration* config, char* username);
+
+/**
+ * Remove all servers, keeping the capacity
+ * @param config The configuration
+ */
+void
+pgvictoria_registry_clear_servers(struct common_configuration* config);
+
+/**
+ * Remove all users, keeping the capacity
+ * @param config The configuration
+ */
+void
+pgvictoria_registry_clear_users(struct common_configuration* config);
+
+/**
+ * Destroy the registry of a configuration
+ * @param config The configuration
+ */
+void
+pgvictoria_registry_destroy(struct common_configuration* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
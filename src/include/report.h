@@ -34,6 +34,8 @@ extern "C" {
 #endif
 
 #include <pgvictoria.h>
+#include <deque.h>
+#include <json.h>
 #include <openssl/ssl.h>
 
 /**
@@ -41,6 +43,7 @@ extern "C" {
  */
 struct pgvictoria_diff_item
 {
+   int id;                  /**< The interned id of the parameter, or GUC_UNKNOWN if it is in no baseline */
    char key[128];           /**< The configuration parameter name */
    char baseline_val[1024]; /**< The expected value from the version baseline */
    char current_val[1024];  /**< The value reported by the live server */
@@ -48,13 +51,15 @@ struct pgvictoria_diff_item
 };
 
 /**
- * Output format for the configuration report (text, HTML, or Markdown). Selected
- * with -f/--format in both online and file mode.
+ * Output format for the configuration report (text, HTML, Markdown, or the
+ * interactive HTML fleet report). Selected with -f/--format in both online and
+ * file mode.
  */
 enum pgvictoria_output_format {
    PGVICTORIA_OUTPUT_TEXT = 0,
    PGVICTORIA_OUTPUT_HTML,
    PGVICTORIA_OUTPUT_MD,
+   PGVICTORIA_OUTPUT_FLEET,
 };
 
 /**
@@ -67,6 +72,16 @@ enum pgvictoria_report_type {
    PGVICTORIA_REPORT_FULL,
 };
 
+/**
+ * Collect the configuration of a server and classify it against its version baseline
+ * @param server The server index
+ * @param type Which GUCs to collect (changed or full)
+ * @param version [out] The major version of the server
+ * @param items [out] The diff items, one struct pgvictoria_diff_item per setting
+ * @return 0 upon success, otherwise 1
+ */
+int pgvictoria_report_collect(int server, enum pgvictoria_report_type type, int* version, struct deque** items);
+
 /**
  * Generate a configuration report for the specified server online
  * @param server The server index
@@ -77,6 +92,15 @@ enum pgvictoria_report_type {
  */
 int pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum pgvictoria_report_type type, char* output_file);
 
+/**
+ * Generate an interactive HTML fleet report covering every configured server.
+ * Servers that can not be reached are reported and left out
+ * @param type Which GUCs to list (changed or full)
+ * @param output_file Destination path for the report (required)
+ * @return 0 upon success, otherwise 1 if no server could be reported
+ */
+int pgvictoria_report_fleet(enum pgvictoria_report_type type, char* output_file);
+
 /**
  * Generate a configuration report from a file directly on disk
  * @param filename The configuration file path
@@ -88,6 +112,33 @@ int pgvictoria_report_online(int server, enum pgvictoria_output_format format, e
  */
 int pgvictoria_report_file(char* filename, enum pgvictoria_output_format format, enum pgvictoria_report_type type, char* output_file, int override_version);
 
+/**
+ * Extract the key and value from a single postgresql.conf line
+ * @param line The line
+ * @param key [out] The key buffer (128 bytes)
+ * @param value [out] The value buffer (1024 bytes)
+ * @return 0 upon success, 1 for a comment or empty line, otherwise a negative parse error
+ */
+int pgvictoria_report_extract_key_value(char* line, char* key, char* value);
+
+/**
+ * Classify a single setting against the version baseline
+ * @param baseline The baseline
+ * @param key The configuration parameter name
+ * @param val The current value, or NULL for an empty setting
+ * @param item [out] The diff item to fill in
+ * @return 0 upon success, otherwise 1
+ */
+int pgvictoria_report_classify(struct json* baseline, char* key, char* val, struct pgvictoria_diff_item* item);
+
+/**
+ * Detect the baseline version for a configuration file
+ * @param filename The configuration file path, or NULL
+ * @param override_version The requested version, or 0 to auto-detect
+ * @return The version
+ */
+int pgvictoria_report_detect_version(char* filename, int override_version);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PGVICTORIA_RING_H
+#define PGVICTORIA_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define RING_OK        0
+#define RING_EMPTY     1
+#define RING_FULL      2
+#define RING_TOO_BIG   3
+#define RING_TOO_SMALL 4
+
+/** @struct ring
+ * Defines a bounded multi-producer, single-consumer ring of variable-length
+ * records. The ring holds no pointers so it can live in a shared memory segment
+ * and be used from every process that maps it.
+ *
+ * Producers claim space by advancing head with a compare-and-swap, stamp the
+ * record with their pid, copy it and publish it by setting its header. The
+ * consumer reads records in claim order, clears them and advances tail. A
+ * record whose producer is still copying stops the consumer until it is
+ * published; one whose producer has died is skipped
+ */
+struct ring
+{
+   uint64_t capacity __attribute__((aligned(64))); /**< The capacity of data in bytes, a power of two */
+   bool shared;                                     /**< Was the ring created in its own segment */
+   uint64_t skipped;                                /**< The records skipped because their producer died, consumer only */
+   atomic_ullong head __attribute__((aligned(64))); /**< The next byte to claim, advanced by producers */
+   atomic_ullong tail __attribute__((aligned(64))); /**< The next byte to read, advanced by the consumer */
+   char data[] __attribute__((aligned(64)));        /**< The records */
+};
+
+/**
+ * Get the number of bytes needed for a ring
+ * @param capacity The capacity in bytes, rounded up to a power of two
+ * @return The number of bytes
+ */
+size_t
+pgvictoria_ring_size(size_t capacity);
+
+/**
+ * Initialize a ring in memory owned by the caller, f.ex. inside a shared
+ * memory segment. The memory must be 64 byte aligned and at least
+ * pgvictoria_ring_size(capacity) bytes
+ * @param memory The memory
+ * @param capacity The capacity in bytes, rounded up to a power of two
+ * @param ring [out] The ring
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_ring_init(void* memory, size_t capacity, struct ring** ring);
+
+/**
+ * Create a ring in its own shared memory segment
+ * @param capacity The capacity in bytes, rounded up to a power of two
+ * @param ring [out] The ring
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_ring_create(size_t capacity, struct ring** ring);
+
+/**
+ * Get the largest record the ring accepts
+ * @param ring The ring
+ * @return The length in bytes
+ */
+size_t
+pgvictoria_ring_max_length(struct ring* ring);
+
+/**
+ * Publish a record. Safe to call from several producers at once
+ * @param ring The ring
+ * @param data The data
+ * @param length The length of the data
+ * @return RING_OK, RING_FULL or RING_TOO_BIG
+ */
+int
+pgvictoria_ring_push(struct ring* ring, void* data, size_t length);
+
+/**
+ * Publish a record gathered from several buffers. Safe to call from several
+ * producers at once
+ * @param ring The ring
+ * @param iov The buffers
+ * @param iovcnt The number of buffers
+ * @return RING_OK, RING_FULL or RING_TOO_BIG
+ */
+int
+pgvictoria_ring_pushv(struct ring* ring, struct iovec* iov, int iovcnt);
+
+/**
+ * Get the length of the oldest published record. Consumer only.
+ * Records left unpublished by a producer that no longer exists are
+ * dropped on the way and counted in skipped
+ * @param ring The ring
+ * @param length [out] The length
+ * @return RING_OK or RING_EMPTY
+ */
+int
+pgvictoria_ring_peek(struct ring* ring, size_t* length);
+
+/**
+ * Remove the oldest published record. Consumer only
+ * @param ring The ring
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @param length [out] The length of the record
+ * @return RING_OK, RING_EMPTY or RING_TOO_SMALL if the record was left in place
+ */
+int
+pgvictoria_ring_pop(struct ring* ring, void* buffer, size_t size, size_t* length);
+
+/**
+ * Is the ring empty
+ * @param ring The ring
+ * @return true if there are no claimed records, otherwise false
+ */
+bool
+pgvictoria_ring_empty(struct ring* ring);
+
+/**
+ * Destroy a ring created by pgvictoria_ring_create
+ * @param ring The ring
+ */
+void
+pgvictoria_ring_destroy(struct ring* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGVICTORIA_TRACE_H
+#define PGVICTORIA_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+#include <message.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Should an exchange of a subsystem be traced. Decides once per exchange, so
+ * the messages of a sampled exchange are traced together
+ * @param subsystem The subsystem, f.ex. TRACE_PROTOCOL
+ * @return true if the exchange is sampled, otherwise false
+ */
+bool
+pgvictoria_trace_sample(int subsystem);
+
+/**
+ * Take a token from the bucket of a subsystem. The bucket holds a second
+ * worth of trace lines and is refilled at the configured rate
+ * @param subsystem The subsystem
+ * @return true if a trace line may be written, otherwise false
+ */
+bool
+pgvictoria_trace_allow(int subsystem);
+
+/**
+ * Trace a message: its type, its length and the start of its payload.
+ * The payload of security messages is never traced
+ * @param subsystem The subsystem
+ * @param direction '>' for a message sent, '<' for a message received
+ * @param msg The message
+ */
+void
+pgvictoria_trace_message(int subsystem, char direction, struct message* msg);
+
+/**
+ * Trace the messages of a response, one line for each message type with
+ * the number of messages, their bytes and the payload of the first one,
+ * and one line with the timing
+ * @param subsystem The subsystem
+ * @param data The messages
+ * @param size The size of the messages
+ * @param first_read The microseconds until the first read of the response returned
+ * @param total The microseconds until the response was complete
+ */
+void
+pgvictoria_trace_response(int subsystem, void* data, size_t size, long first_read, long total);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -77,6 +77,19 @@ struct signal_info
    int slot;                /**< The slot */
 };
 
+/** @struct string_builder
+ * Defines a string that is built by appending to it. The length is tracked
+ * and the buffer grows geometrically, so building a string takes time
+ * linear in its length
+ */
+struct string_builder
+{
+   char* str;       /**< The string, or NULL while nothing is appended */
+   size_t length;   /**< The length of the string */
+   size_t capacity; /**< The size of the buffer */
+   bool error;      /**< Has an allocation failed */
+};
+
 /** @struct pgvictoria_command
  * Defines pgvictoria commands.
  * The necessary fields are marked with an ">".
@@ -563,6 +576,93 @@ pgvictoria_append_double_precision(char* orig, double d, int precision);
 char*
 pgvictoria_append_bool(char* orig, bool b);
 
+/**
+ * Initialize a string builder
+ * @param builder The string builder
+ */
+void
+pgvictoria_string_builder_init(struct string_builder* builder);
+
+/**
+ * Append a string to a string builder
+ * @param builder The string builder
+ * @param s The string, may be NULL
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_append(struct string_builder* builder, char* s);
+
+/**
+ * Append the first bytes of a string to a string builder
+ * @param builder The string builder
+ * @param s The string
+ * @param length The number of bytes
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_append_length(struct string_builder* builder, char* s, size_t length);
+
+/**
+ * Append a char to a string builder
+ * @param builder The string builder
+ * @param c The char
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_append_char(struct string_builder* builder, char c);
+
+/**
+ * Append a formatted string to a string builder
+ * @param builder The string builder
+ * @param format The printf format
+ * @param ... The arguments
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_append_format(struct string_builder* builder, char* format, ...)
+__attribute__((format(printf, 2, 3)));
+
+/**
+ * Append a string escaped like pgvictoria_escape_string() to a string builder
+ * @param builder The string builder
+ * @param s The string, may be NULL
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_append_escaped(struct string_builder* builder, char* s);
+
+/**
+ * Append an indent and a tag to a string builder, like pgvictoria_indent()
+ * @param builder The string builder
+ * @param tag The tag, may be NULL
+ * @param indent The number of spaces
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_string_builder_indent(struct string_builder* builder, char* tag, int indent);
+
+/**
+ * Empty a string builder, keeping its buffer for reuse
+ * @param builder The string builder
+ */
+void
+pgvictoria_string_builder_clear(struct string_builder* builder);
+
+/**
+ * Take the string out of a string builder, which is left empty
+ * @param builder The string builder
+ * @return The string, or NULL if it is empty or an allocation failed
+ */
+char*
+pgvictoria_string_builder_finish(struct string_builder* builder);
+
+/**
+ * Release the string of a string builder
+ * @param builder The string builder
+ */
+void
+pgvictoria_string_builder_destroy(struct string_builder* builder);
+
 /**
  * Remove whitespace from a string
  * @param orig The original string
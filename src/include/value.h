@@ -36,6 +36,12 @@ extern "C" {
 #include <inttypes.h>
 #include <stdbool.h>
 
+struct memory_arena;
+struct string_builder;
+
+/** The longest string stored inside a value, including the terminator */
+#define VALUE_INLINE_SIZE 16
+
 typedef void (*data_destroy_cb)(uintptr_t data);
 typedef char* (*data_to_string_cb)(uintptr_t data, int32_t format, char* tag, int indent);
 
@@ -69,14 +75,18 @@ enum value_type {
 
 /**
  * @struct value
- * Defines a universal value
+ * Defines a universal value. Short strings are kept in the value itself, so a
+ * value that is copied bytewise has to be relocated before it is used
  */
 struct value
 {
-   enum value_type type;         /**< The type of value data */
-   uintptr_t data;               /**< The data, could be passed by value or by reference */
-   data_destroy_cb destroy_data; /**< The callback to destroy data */
-   data_to_string_cb to_string;  /**< The callback to convert data to string */
+   enum value_type type;           /**< The type of value data */
+   bool arena;                     /**< Does the value live in an arena or a container, and is not freed on its own */
+   bool inlined;                   /**< Is the string data stored in the buffer */
+   uintptr_t data;                 /**< The data, could be passed by value or by reference */
+   data_destroy_cb destroy_data;   /**< The callback to destroy data */
+   data_to_string_cb to_string;    /**< The callback to convert data to string */
+   char buffer[VALUE_INLINE_SIZE]; /**< The inline storage for short strings */
 };
 
 /**
@@ -113,7 +123,58 @@ int
 pgvictoria_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value);
 
 /**
- * Destroy a value along with the data within
+ * Create a value in an arena. Strings are copied into the arena, and data that
+ * lives on the heap is destroyed when the arena is released
+ * @param arena The arena, or NULL for the heap
+ * @param type The value type
+ * @param data The value data, type cast it to uintptr_t before passing into function
+ * @param value [out] The value
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_value_create_arena(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value** value);
+
+/**
+ * Create a value with a config in an arena, the type will default to ValueRef
+ * @param arena The arena, or NULL for the heap
+ * @param data The value data, type cast it to uintptr_t before passing into function
+ * @param config The configuration
+ * @param value [out] The value
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_value_create_arena_with_config(struct memory_arena* arena, uintptr_t data, struct value_config* config, struct value** value);
+
+/**
+ * Initialize a value stored inside a container. In an arena strings are copied
+ * into it, but heap data is left for the container to release
+ * @param arena The arena, or NULL for the heap
+ * @param value The value
+ * @param type The value type
+ * @param data The value data, type cast it to uintptr_t before passing into function
+ * @return 0 on success, 1 if otherwise
+ */
+int
+pgvictoria_value_init(struct memory_arena* arena, struct value* value, enum value_type type, uintptr_t data);
+
+/**
+ * Point the data of a value that was copied bytewise back at its own buffer
+ * @param value The value
+ */
+void
+pgvictoria_value_relocate(struct value* value);
+
+/**
+ * Does destroying the value release data it owns
+ * @param value The value
+ * @return True if the data is released with the value
+ */
+bool
+pgvictoria_value_owns_data(struct value* value);
+
+/**
+ * Destroy a value along with the data within. A value in an arena only
+ * releases its data, the value itself goes with the arena
  * @param value The value
  * @return 0 on success, 1 if otherwise
  */
@@ -147,6 +208,18 @@ pgvictoria_value_type(struct value* value);
 char*
 pgvictoria_value_to_string(struct value* value, int32_t format, char* tag, int indent);
 
+/**
+ * Append a value as a string to a string builder
+ * @param value The value
+ * @param format The format
+ * @param tag The optional tag
+ * @param indent The indent
+ * @param builder The string builder
+ * @return 0 on success, otherwise 1
+ */
+int
+pgvictoria_value_to_builder(struct value* value, int32_t format, char* tag, int indent, struct string_builder* builder);
+
 /**
  * Convert a double value to value data, since straight type cast discards the decimal part
  * @param val The value
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PGVICTORIA_WATCH_H
+#define PGVICTORIA_WATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pgvictoria.h>
+
+#include <stdio.h>
+
+struct watch_state;
+
+/**
+ * Watch postgresql.conf files and report drift as it happens.
+ *
+ * Every file is a configuration of its own with its own version baseline. The
+ * files, the files they pull in through include / include_if_exists and the
+ * contents of include_dir directories are parsed once and cached. The parent
+ * directories are then registered with inotify and the call blocks until
+ * something changes, so an idle watch costs no CPU. On an event only the
+ * modified file is re-parsed, the cached files are applied again in server
+ * order and only the settings whose effective value changed are classified and
+ * written as a delta to the output stream.
+ *
+ * The call returns when SIGINT or SIGTERM is received.
+ *
+ * @param files The configuration files
+ * @param number_of_files The number of configuration files
+ * @param override_version The baseline version to compare against, or 0 to auto-detect
+ * @param output_file The file the deltas are appended to, or NULL for stdout
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_watch(char** files, int number_of_files, int override_version, char* output_file);
+
+/**
+ * Create a watch: parse the files and their includes and start watching
+ * the directories they live in
+ * @param files The configuration files
+ * @param number_of_files The number of configuration files
+ * @param override_version The baseline version to compare against, or 0 to auto-detect
+ * @param out The stream the deltas are written to, or NULL for stdout
+ * @param watch [out] The watch
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_watch_create(char** files, int number_of_files, int override_version, FILE* out, struct watch_state** watch);
+
+/**
+ * Wait for changes and process every event that is queued
+ * @param watch The watch
+ * @param timeout The time to wait in milliseconds, or -1 to wait forever
+ * @return 0 upon success, otherwise 1
+ */
+int
+pgvictoria_watch_process(struct watch_state* watch, int timeout);
+
+/**
+ * Get the effective value of a setting
+ * @param watch The watch
+ * @param root The index of the configuration file, in command line order
+ * @param key The lower case setting name
+ * @return The value, or NULL if the setting is not set
+ */
+char*
+pgvictoria_watch_value(struct watch_state* watch, int root, char* key);
+
+/**
+ * Destroy a watch
+ * @param watch The watch
+ */
+void
+pgvictoria_watch_destroy(struct watch_state* watch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
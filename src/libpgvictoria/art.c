@@ -29,14 +29,29 @@
 #include <art.h>
 #include <json.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
+#include <stddef.h>
 #include <string.h>
 
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
 #define IS_LEAF(x)  (((uintptr_t)(x) & 1))
 #define SET_LEAF(x) ((void*)((uintptr_t)(x) | 1))
 #define GET_LEAF(x) ((struct art_leaf*)((void*)((uintptr_t)(x) & ~1)))
 
+// The size of a leaf, a case-insensitive tree keeps the key as inserted after the folded one
+#define LEAF_SIZE(key_len, fold) (offsetof(struct art_leaf, key) + ((fold) ? 2 * (size_t)(key_len) : (size_t)(key_len)))
+#define LEAF_ORIGINAL(l)         ((l)->folded ? (l)->key + (l)->key_len : (l)->key)
+
+// Keys up to this length are folded on the stack
+#define ART_FOLD_BUFFER 128
+
 enum art_node_type {
    Node4,
    Node16,
@@ -55,20 +70,25 @@ enum art_node_type {
 struct art_node
 {
    uint32_t prefix_len;                  /**< The actual length of the prefix segment */
-   enum art_node_type type;              /**< The node type */
-   uint8_t num_children;                 /**< The number of children */
+   uint8_t type;                         /**< The node type, an enum art_node_type */
+   uint8_t arena;                        /**< Does the node live in the arena of the tree */
+   uint16_t num_children;                /**< The number of children, a node256 can hold 256 */
    unsigned char prefix[MAX_PREFIX_LEN]; /**< The (potentially partial) prefix, only record up to MAX_PREFIX_LEN characters */
 } __attribute__((aligned(64)));
 
 /**
- * The ART leaf with key buffer of arbitrary size
+ * The ART leaf with key buffer of arbitrary size, the value is kept in the leaf.
+ * The header takes 54 bytes, so the key directly follows it instead of starting
+ * a line of its own
  */
 struct art_leaf
 {
-   struct value* value;
+   struct value value;
    uint32_t key_len;
+   bool arena;  // does the leaf live in the arena of the tree
+   bool folded; // is the key as inserted kept after the folded key
    unsigned char key[];
-} __attribute__((aligned(64)));
+};
 
 /**
  * The ART node with only 4 children,
@@ -118,7 +138,8 @@ struct art_node256
 
 struct to_string_param
 {
-   char* str;
+   struct string_builder* builder;
+   struct string_builder key;
    int indent;
    uint64_t cnt;
    char* tag;
@@ -132,28 +153,112 @@ node_get_child(struct art_node* node, unsigned char ch);
 static struct art_leaf*
 node_get_minimum(struct art_node* node);
 
+static int
+create_art_leaf(struct art* t, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool fold);
+
+// Release a leaf that did not make it into the tree, and the copy of the value it made
 static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config);
+discard_art_leaf(struct art_leaf* leaf, enum value_type type);
 
+// Values live in the arena of the tree, which releases the data they own through art_arena_cleanup
 static void
-create_art_node(struct art_node** node, enum art_node_type type);
+init_art_leaf(struct art* t, struct art_leaf* l, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool fold);
 
 static void
-create_art_node4(struct art_node4** node);
+art_arena_cleanup(void* data);
 
+static int
+art_value_destroy_cb(void* data, char* key, struct value* value);
+
+// Free a node or a leaf unless it lives in the arena
 static void
-create_art_node16(struct art_node16** node);
+free_node(struct art_node* node);
 
 static void
-create_art_node48(struct art_node48** node);
+free_leaf(struct art_leaf* leaf);
+
+/**
+ * Get the arena bulk loaded nodes and leaves are carved from, which is the arena
+ * of the tree or one the tree owns
+ * @param t The tree
+ * @return The arena, or NULL
+ */
+static struct memory_arena*
+bulk_arena(struct art* t);
+
+/**
+ * Create a leaf in the arena of a tree
+ * @return The leaf, or NULL
+ */
+static struct art_leaf*
+create_arena_leaf(struct art* t, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, bool fold);
+
+/**
+ * Load leaves into an empty tree. Leaves that are not in key order are sorted,
+ * and of equal keys the one latest in the array wins. The leaves that lost are
+ * moved behind the loaded ones. No value is released, so on failure the tree
+ * is left empty and the caller still owns every leaf
+ * @param t The tree
+ * @param leaves The leaves
+ * @param number_of_leaves The number of leaves
+ * @param loaded [out] The number of leaves loaded, at the start of leaves
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+art_load(struct art* t, struct art_leaf** leaves, uint64_t number_of_leaves, uint64_t* loaded);
+
+/**
+ * Build the subtree for sorted, distinct leaves [lo, hi) that share the first depth bytes.
+ * Every node is created at its final size
+ * @param t The tree
+ * @param leaves The leaves
+ * @param lo The first leaf
+ * @param hi The leaf after the last
+ * @param depth The depth
+ * @return The subtree, or NULL if out of memory
+ */
+static struct art_node*
+art_build(struct art* t, struct art_leaf** leaves, uint64_t lo, uint64_t hi, uint32_t depth);
 
+/**
+ * Compare the keys of two leaves
+ * @return Less than, equal to or greater than 0
+ */
+static int
+leaf_compare(struct art_leaf* a, struct art_leaf* b);
+
+/**
+ * Collect the leaves of a subtree in key order
+ * @param node The subtree
+ * @param leaves The leaves
+ * @param number_of_leaves [in/out] The number of leaves
+ */
 static void
-create_art_node256(struct art_node256** node);
+art_node_collect(struct art_node* node, struct art_leaf** leaves, uint64_t* number_of_leaves);
+
+static int
+create_art_node(struct memory_arena* arena, struct art_node** node, enum art_node_type type);
+
+static int
+create_art_node4(struct memory_arena* arena, struct art_node4** node);
+
+static int
+create_art_node16(struct memory_arena* arena, struct art_node16** node);
+
+static int
+create_art_node48(struct memory_arena* arena, struct art_node48** node);
+
+static int
+create_art_node256(struct memory_arena* arena, struct art_node256** node);
 
 // Destroy ART nodes/leaves recursively
 static void
 destroy_art_node(struct art_node* node);
 
+// Free ART nodes/leaves recursively, leaving the values alone
+static void
+release_art_node(struct art_node* node);
+
 static int
 art_iterate(struct art* t, art_callback cb, void* data);
 
@@ -203,22 +308,50 @@ leaf_match(struct art_leaf* leaf, unsigned char* key, uint32_t key_len);
 static int
 find_index(unsigned char ch, unsigned char* keys, int length);
 
+/**
+ * Find the index of an exact key character among the first length keys
+ * @param ch The key character
+ * @param keys The keys
+ * @param length The number of keys
+ * @return The index, or -1 if not found
+ */
+static int
+find_child(unsigned char ch, unsigned char* keys, int length);
+
+/**
+ * Find the index of an exact key character in a node16 with a single vector
+ * compare when SIMD is available, otherwise with find_child
+ * @param ch The key character
+ * @param keys The 16 keys of the node
+ * @param length The number of keys in use
+ * @return The index, or -1 if not found
+ */
+static int
+find_child16(unsigned char ch, unsigned char* keys, int length);
+
+/**
+ * Get the first position where two byte strings differ, 16 bytes at a time
+ * when SIMD is available
+ * @param a The first string
+ * @param b The second string
+ * @param length The number of bytes to compare
+ * @return The position of the first difference, or length if they are equal
+ */
+static uint32_t
+mismatch(unsigned char* a, unsigned char* b, uint32_t length);
+
 /**
  * Insert a value into a node recursively, adopting lazy expansion and path compression --
  * Expand the leaf, or split inner node should keys diverge within node's prefix range
  * @param node The node
  * @param node_ref The reference to node pointer
  * @param depth The depth into the node, which is the same as the total prefix length
- * @param key The key
- * @param key_len The length of the key
- * @param value The value data
- * @param type The value type
- * @param config The config
+ * @param leaf The new leaf, freed if the key exists and its value replaces the one of the existing leaf
  * @param new If the key value is newly inserted (not replaced)
- * @return Old value if the key exists, otherwise NULL
+ * @return 0 on success, 1 if a node could not be allocated, in which case the tree is unchanged
  */
-static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new);
+static int
+art_node_insert(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, struct art_leaf* leaf, bool* new);
 
 /**
  * Delete a value from a node recursively.
@@ -230,13 +363,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
  * @return Deleted value if the key exists, otherwise NULL
  */
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
+art_node_delete(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len);
 
 static int
 art_node_iterate(struct art_node* node, art_callback cb, void* data);
 
-static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
+static int
+node_add_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 /**
  * Add a child to the node. The function assumes node is not NULL,
@@ -247,15 +380,16 @@ node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char
  * @param node_ref The reference of the node pointer
  * @param ch The key character
  * @param child The child
+ * @return 0 on success, 1 if the larger node could not be allocated, in which case node is unchanged
  */
-static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
+static int
+node4_add_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child);
 
-static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
+static int
+node16_add_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child);
 
-static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
+static int
+node48_add_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child);
 
 static void
 node256_add_child(struct art_node256* node, unsigned char ch, void* child);
@@ -264,19 +398,19 @@ node256_add_child(struct art_node256* node, unsigned char ch, void* child);
 // They also do not free the leaf node for bookkeeping purpose. The key insight is that due to path compression,
 // no node will have only one child, if node has only one child after deletion, it merges with this child
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch);
+node_remove_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch);
 
 static void
 node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch);
+node16_remove_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch);
+node48_remove_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch);
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch);
+node256_remove_child(struct memory_arena* arena, struct art_node256* node, struct art_node** node_ref, unsigned char ch);
 
 static void
 copy_header(struct art_node* dest, struct art_node* src);
@@ -287,6 +421,105 @@ min(uint32_t a, uint32_t b);
 static struct value*
 art_search(struct art* t, unsigned char* key, uint32_t key_len);
 
+/**
+ * Search a case-insensitive tree, folding the key byte by byte on the way down
+ * @param t The tree
+ * @param key The key
+ * @param key_len The length of the key
+ * @return The value, or NULL if not found
+ */
+static struct value*
+art_search_folded(struct art* t, unsigned char* key, uint32_t key_len);
+
+/**
+ * Fold an ASCII character to lower case
+ * @param ch The character
+ * @return The folded character
+ */
+static unsigned char
+fold_char(unsigned char ch);
+
+/**
+ * Get the key to descend a tree with. A case-insensitive tree gets a folded
+ * copy, in buffer when it fits
+ * @param t The tree
+ * @param key The key
+ * @param key_len The number of bytes to fold
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @return The key, or NULL if a copy could not be allocated
+ */
+static unsigned char*
+fold_key(struct art* t, char* key, uint32_t key_len, unsigned char* buffer, uint32_t size);
+
+/**
+ * Release a key from fold_key
+ * @param folded The folded key
+ * @param key The key
+ * @param buffer The buffer
+ */
+static void
+release_key(unsigned char* folded, char* key, unsigned char* buffer);
+
+
+static void
+art_node_statistics(struct art_node* node, uint64_t depth, struct art_statistics* stats);
+
+/**
+ * Initialize an iterator positioned at the first key of a tree
+ * @param iter The iterator
+ * @param t The tree
+ */
+static void
+iterator_init(struct art_iterator* iter, struct art* t);
+
+/**
+ * Push an inner node on the iterator stack, moving the stack to the heap
+ * when the inline frames are used up
+ * @param iter The iterator
+ * @param node The node
+ * @param position The first child slot to visit
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+iterator_push(struct art_iterator* iter, struct art_node* node, uint32_t position);
+
+/**
+ * Find the leaf the next step returns, descending into the pending subtree
+ * before resuming from the stack
+ * @param iter The iterator
+ */
+static void
+iterator_advance(struct art_iterator* iter);
+
+/**
+ * Rebuild the iterator stack for the first key equal to or greater than key
+ * @param iter The iterator
+ * @param key The key
+ * @param key_len The length of the key
+ * @return 0 on success, 1 if otherwise
+ */
+static int
+iterator_seek(struct art_iterator* iter, unsigned char* key, uint32_t key_len);
+
+/**
+ * Get the child slot of the first child whose key byte is equal to or greater than ch
+ * @param node The node
+ * @param ch The key byte
+ * @return The slot
+ */
+static uint32_t
+frame_position(struct art_node* node, unsigned char ch);
+
+/**
+ * Get the child at or after the position of a frame and move past it
+ * @param frame The frame
+ * @param ch [out] The key byte of the child, may be NULL
+ * @return The child, or NULL if the node has no more children
+ */
+static struct art_node*
+frame_next_child(struct art_iterator_frame* frame, unsigned char* ch);
+
 static int
 art_to_json_string_cb(void* param, char* key, struct value* value);
 
@@ -296,26 +529,200 @@ art_to_text_string_cb(void* param, char* key, struct value* value);
 static int
 art_to_compact_json_string_cb(void* param, char* key, struct value* value);
 
-static char*
-to_json_string(struct art* t, char* tag, int indent);
+static int
+to_json_string(struct art* t, char* tag, int indent, struct string_builder* builder);
 
-static char*
-to_compact_json_string(struct art* t, char* tag, int indent);
+static int
+to_compact_json_string(struct art* t, char* tag, int indent, struct string_builder* builder);
 
-static char*
-to_text_string(struct art* t, char* tag, int indent);
+static int
+to_text_string(struct art* t, char* tag, int indent, struct string_builder* builder);
 
 int
 pgvictoria_art_create(struct art** tree)
+{
+   return pgvictoria_art_create_arena(NULL, tree);
+}
+
+int
+pgvictoria_art_create_arena(struct memory_arena* arena, struct art** tree)
 {
    struct art* t = NULL;
-   t = malloc(sizeof(struct art));
+   if (arena != NULL)
+   {
+      t = pgvictoria_memory_arena_alloc(arena, sizeof(struct art));
+   }
+   else
+   {
+      t = malloc(sizeof(struct art));
+   }
+   if (t == NULL)
+   {
+      return 1;
+   }
    t->size = 0;
    t->root = NULL;
+   t->case_insensitive = false;
+   t->arena = arena;
+   t->bulk = NULL;
+   t->owns_data = false;
    *tree = t;
    return 0;
 }
 
+int
+pgvictoria_art_create_case_insensitive(struct art** tree)
+{
+   if (pgvictoria_art_create(tree))
+   {
+      return 1;
+   }
+   (*tree)->case_insensitive = true;
+   return 0;
+}
+
+int
+pgvictoria_art_set_case_insensitive(struct art* t)
+{
+   struct art_node* root = NULL;
+   struct memory_arena* bulk = NULL;
+   struct art_leaf** leaves = NULL;
+   struct art_leaf** folded = NULL;
+   uint64_t number_of_leaves = 0;
+   uint64_t size = 0;
+   uint64_t loaded = 0;
+
+   if (t == NULL)
+   {
+      return 1;
+   }
+   if (t->case_insensitive)
+   {
+      return 0;
+   }
+
+   leaves = malloc((t->size + 1) * sizeof(struct art_leaf*));
+   folded = malloc((t->size + 1) * sizeof(struct art_leaf*));
+   if (leaves == NULL || folded == NULL)
+   {
+      goto error;
+   }
+
+   art_node_collect(t->root, leaves, &number_of_leaves);
+
+   // The old tree stays untouched until the folded one is built, so a failure can go back to it.
+   // Its nodes may live in the old bulk arena, so keep that until they are gone
+   root = t->root;
+   size = t->size;
+   bulk = t->bulk;
+   t->root = NULL;
+   t->size = 0;
+   t->bulk = NULL;
+   t->case_insensitive = true;
+
+   for (uint64_t i = 0; i < number_of_leaves; i++)
+   {
+      // the value moves over, so only the leaf is recreated (ValueNone initializes no value)
+      folded[i] = create_arena_leaf(t, leaves[i]->key, leaves[i]->key_len, 0, ValueNone, true);
+      if (folded[i] == NULL)
+      {
+         goto rollback;
+      }
+      folded[i]->value = leaves[i]->value;
+      pgvictoria_value_relocate(&folded[i]->value);
+   }
+
+   if (art_load(t, folded, number_of_leaves, &loaded))
+   {
+      goto rollback;
+   }
+
+   // Keys that only differed in case collapse into the last one
+   for (uint64_t i = loaded; i < number_of_leaves; i++)
+   {
+      pgvictoria_value_destroy(&folded[i]->value);
+   }
+
+   release_art_node(root);
+   pgvictoria_memory_arena_destroy(bulk);
+   free(folded);
+   free(leaves);
+   return 0;
+
+rollback:
+   if (t->bulk != NULL)
+   {
+      pgvictoria_memory_arena_destroy(t->bulk);
+   }
+   t->root = root;
+   t->size = size;
+   t->bulk = bulk;
+   t->case_insensitive = false;
+error:
+   free(folded);
+   free(leaves);
+   return 1;
+}
+
+int
+pgvictoria_art_bulk_load(struct art* t, struct art_entry* entries, uint64_t number_of_entries)
+{
+   struct art_leaf** leaves = NULL;
+   uint64_t loaded = 0;
+   int ret = 1;
+
+   if (t == NULL || t->root != NULL || (entries == NULL && number_of_entries > 0))
+   {
+      return 1;
+   }
+   if (number_of_entries == 0)
+   {
+      return 0;
+   }
+
+   leaves = malloc(number_of_entries * sizeof(struct art_leaf*));
+   if (leaves == NULL)
+   {
+      return 1;
+   }
+
+   for (uint64_t i = 0; i < number_of_entries; i++)
+   {
+      leaves[i] = create_arena_leaf(t, (unsigned char*)entries[i].key, strlen(entries[i].key) + 1,
+                                    entries[i].value, entries[i].type, t->case_insensitive);
+      if (leaves[i] == NULL)
+      {
+         for (uint64_t j = 0; j < i; j++)
+         {
+            pgvictoria_value_destroy(&leaves[j]->value);
+         }
+         goto done;
+      }
+   }
+
+   if (art_load(t, leaves, number_of_entries, &loaded))
+   {
+      // the leaves live in the arena, only their values need releasing
+      for (uint64_t i = 0; i < number_of_entries; i++)
+      {
+         pgvictoria_value_destroy(&leaves[i]->value);
+      }
+      goto done;
+   }
+
+   // Of equal keys only the last one was loaded
+   for (uint64_t i = loaded; i < number_of_entries; i++)
+   {
+      pgvictoria_value_destroy(&leaves[i]->value);
+   }
+
+   ret = 0;
+
+done:
+   free(leaves);
+   return ret;
+}
+
 int
 pgvictoria_art_destroy(struct art* tree)
 {
@@ -323,7 +730,13 @@ pgvictoria_art_destroy(struct art* tree)
    {
       return 0;
    }
+   if (tree->arena != NULL)
+   {
+      // the nodes, leaves and values are released with the arena
+      return 0;
+   }
    destroy_art_node(tree->root);
+   pgvictoria_memory_arena_destroy(tree->bulk);
    free(tree);
    return 0;
 }
@@ -412,8 +825,6 @@ struct prefix_search_state
    char*** matches;
    int max_matches;
    int current_count;
-   uint32_t key_len;
-   char* prefix;
 };
 
 static int
@@ -436,13 +847,7 @@ prefix_search_cb(void* param, char* key, struct value* value)
 int
 pgvictoria_art_prefix_search(struct art* t, char* prefix, char*** matches, int max_matches)
 {
-   struct art_node* node = NULL;
-   struct art_node** child = NULL;
-   uint32_t depth = 0;
-   uint32_t key_len = 0;
-   unsigned char* key = (unsigned char*)prefix;
    struct prefix_search_state state;
-   struct art_leaf* min_leaf = NULL;
 
    if (t == NULL || t->root == NULL || matches == NULL || max_matches <= 0)
    {
@@ -459,45 +864,71 @@ pgvictoria_art_prefix_search(struct art* t, char* prefix, char*** matches, int m
    state.matches = matches;
    state.max_matches = max_matches;
    state.current_count = 0;
-   state.prefix = prefix;
+
+   pgvictoria_art_prefix_scan(t, prefix, prefix_search_cb, &state);
+
+   return state.current_count;
+}
+
+int
+pgvictoria_art_prefix_scan(struct art* t, char* prefix, art_callback cb, void* data)
+{
+   struct art_node* node = NULL;
+   struct art_node** child = NULL;
+   struct art_leaf* leaf = NULL;
+   uint32_t depth = 0;
+   uint32_t key_len = 0;
+   unsigned char* key = NULL;
+   unsigned char buffer[ART_FOLD_BUFFER];
+
+   if (t == NULL || cb == NULL)
+   {
+      return 1;
+   }
 
    if (prefix == NULL || strlen(prefix) == 0)
    {
-      art_node_iterate(t->root, prefix_search_cb, &state);
-      return state.current_count;
+      art_node_iterate(t->root, cb, data);
+      return 0;
    }
 
    key_len = strlen(prefix);
-   state.key_len = key_len;
+   key = fold_key(t, prefix, key_len, buffer, sizeof(buffer));
+   if (key == NULL)
+   {
+      return 1;
+   }
    node = t->root;
 
+   // Descend to the first node that all the keys with the prefix share
    while (node != NULL)
    {
       if (IS_LEAF(node))
       {
-         struct art_leaf* leaf = GET_LEAF(node);
-         if (leaf->key_len >= key_len && strncmp((char*)leaf->key, prefix, key_len) == 0)
+         leaf = GET_LEAF(node);
+         if (leaf->key_len >= key_len && memcmp(leaf->key, key, key_len) == 0)
          {
-            prefix_search_cb(&state, (char*)leaf->key, leaf->value);
+            cb(data, (char*)LEAF_ORIGINAL(leaf), &leaf->value);
          }
-         return state.current_count;
+         break;
       }
 
       uint32_t cpl = check_prefix_partial(node, key, depth, key_len);
       if (cpl < min(node->prefix_len, MAX_PREFIX_LEN) && depth + cpl < key_len)
       {
-         return state.current_count;
+         break;
       }
 
       depth += node->prefix_len;
       if (depth >= key_len)
       {
-         min_leaf = node_get_minimum(node);
-         if (min_leaf != NULL && min_leaf->key_len >= key_len && strncmp((char*)min_leaf->key, prefix, key_len) == 0)
+         // the prefix may end past the stored bytes, so verify it against a leaf
+         leaf = node_get_minimum(node);
+         if (leaf != NULL && leaf->key_len >= key_len && memcmp(leaf->key, key, key_len) == 0)
          {
-            art_node_iterate(node, prefix_search_cb, &state);
+            art_node_iterate(node, cb, data);
          }
-         return state.current_count;
+         break;
       }
 
       child = node_get_child(node, key[depth]);
@@ -505,20 +936,83 @@ pgvictoria_art_prefix_search(struct art* t, char* prefix, char*** matches, int m
       depth++;
    }
 
-   return state.current_count;
+   release_key(key, prefix, buffer);
+
+   return 0;
 }
 
 int
-pgvictoria_art_insert(struct art* t, char* key, uintptr_t value, enum value_type type)
+pgvictoria_art_range_scan(struct art* t, char* start, char* end, art_callback cb, void* data)
 {
-   struct value* old_val = NULL;
-   bool new = false;
-
-#ifdef CORE_DEBUG
-   char* vs = NULL;
-   struct value* v = NULL;
+   struct art_iterator iter;
+   struct art_leaf* leaf = NULL;
+   unsigned char buffer[ART_FOLD_BUFFER];
+   unsigned char* e = NULL;
+   uint32_t end_len = 0;
+   int ret = 0;
 
-   if (t == NULL)
+   if (t == NULL || cb == NULL)
+   {
+      return 1;
+   }
+
+   iterator_init(&iter, t);
+
+   if (start != NULL && pgvictoria_art_iterator_seek(&iter, start))
+   {
+      ret = 1;
+      goto done;
+   }
+
+   if (end != NULL)
+   {
+      end_len = strlen(end);
+      e = fold_key(t, end, end_len, buffer, sizeof(buffer));
+      if (e == NULL)
+      {
+         ret = 1;
+         goto done;
+      }
+   }
+
+   while ((leaf = iter.next) != NULL)
+   {
+      // the terminating zero sorts a key before every longer key it is a prefix of
+      if (e != NULL && memcmp(leaf->key, e, min(leaf->key_len, end_len)) >= 0)
+      {
+         break;
+      }
+      iterator_advance(&iter);
+      if (cb(data, (char*)LEAF_ORIGINAL(leaf), &leaf->value))
+      {
+         break;
+      }
+   }
+
+done:
+   if (e != NULL)
+   {
+      release_key(e, end, buffer);
+   }
+   if (iter.stack != iter.frames)
+   {
+      free(iter.stack);
+   }
+
+   return ret;
+}
+
+int
+pgvictoria_art_insert(struct art* t, char* key, uintptr_t value, enum value_type type)
+{
+   struct art_leaf* leaf = NULL;
+   bool new = false;
+
+#ifdef CORE_DEBUG
+   char* vs = NULL;
+   struct value* v = NULL;
+
+   if (t == NULL)
    {
       pgvictoria_log_debug("pgvictoria_art_insert: ART is NULL");
    }
@@ -548,8 +1042,15 @@ pgvictoria_art_insert(struct art* t, char* key, uintptr_t value, enum value_type
       // c'mon, at least create a tree first...
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, type, NULL, &new);
-   pgvictoria_value_destroy(old_val);
+   if (create_art_leaf(t, &leaf, (unsigned char*)key, strlen(key) + 1, value, type, NULL, t->case_insensitive))
+   {
+      goto error;
+   }
+   if (art_node_insert(t->arena, t->root, &t->root, 0, leaf, &new))
+   {
+      discard_art_leaf(leaf, type);
+      goto error;
+   }
    if (new)
    {
       t->size++;
@@ -562,14 +1063,21 @@ error:
 int
 pgvictoria_art_insert_with_config(struct art* t, char* key, uintptr_t value, struct value_config* config)
 {
-   struct value* old_val = NULL;
+   struct art_leaf* leaf = NULL;
    bool new = false;
    if (t == NULL || key == NULL)
    {
       goto error;
    }
-   old_val = art_node_insert(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, &new);
-   pgvictoria_value_destroy(old_val);
+   if (create_art_leaf(t, &leaf, (unsigned char*)key, strlen(key) + 1, value, ValueRef, config, t->case_insensitive))
+   {
+      goto error;
+   }
+   if (art_node_insert(t->arena, t->root, &t->root, 0, leaf, &new))
+   {
+      discard_art_leaf(leaf, ValueRef);
+      goto error;
+   }
    if (new)
    {
       t->size++;
@@ -583,18 +1091,26 @@ int
 pgvictoria_art_delete(struct art* t, char* key)
 {
    struct art_leaf* l = NULL;
+   unsigned char buffer[ART_FOLD_BUFFER];
+   unsigned char* k = NULL;
    if (t == NULL || key == NULL)
    {
       return 1;
    }
-   l = art_node_delete(t->root, &t->root, 0, (unsigned char*)key, strlen(key) + 1);
+   k = fold_key(t, key, strlen(key) + 1, buffer, sizeof(buffer));
+   if (k == NULL)
+   {
+      return 1;
+   }
+   l = art_node_delete(t->arena, t->root, &t->root, 0, k, strlen(key) + 1);
+   release_key(k, key, buffer);
    if (l != NULL)
    {
       t->size--;
-      pgvictoria_value_destroy(l->value);
+      pgvictoria_value_destroy(&l->value);
    }
 
-   free(l);
+   free_leaf(l);
    return 0;
 }
 
@@ -606,27 +1122,51 @@ pgvictoria_art_clear(struct art* t)
       return 0;
    }
    destroy_art_node(t->root);
+   pgvictoria_memory_arena_destroy(t->bulk);
    t->root = NULL;
+   t->bulk = NULL;
    t->size = 0;
    return 0;
 }
 
+int
+pgvictoria_art_statistics(struct art* t, struct art_statistics* stats)
+{
+   if (t == NULL || stats == NULL)
+   {
+      return 1;
+   }
+   memset(stats, 0, sizeof(struct art_statistics));
+   art_node_statistics(t->root, 1, stats);
+   return 0;
+}
+
 char*
 pgvictoria_art_to_string(struct art* t, int32_t format, char* tag, int indent)
+{
+   struct string_builder builder;
+
+   pgvictoria_string_builder_init(&builder);
+   pgvictoria_art_to_builder(t, format, tag, indent, &builder);
+   return pgvictoria_string_builder_finish(&builder);
+}
+
+int
+pgvictoria_art_to_builder(struct art* t, int32_t format, char* tag, int indent, struct string_builder* builder)
 {
    if (format == FORMAT_JSON)
    {
-      return to_json_string(t, tag, indent);
+      return to_json_string(t, tag, indent, builder);
    }
    else if (format == FORMAT_TEXT)
    {
-      return to_text_string(t, tag, indent);
+      return to_text_string(t, tag, indent, builder);
    }
    else if (format == FORMAT_JSON_COMPACT)
    {
-      return to_compact_json_string(t, tag, indent);
+      return to_compact_json_string(t, tag, indent, builder);
    }
-   return NULL;
+   return 0;
 }
 
 static uint32_t
@@ -639,98 +1179,160 @@ min(uint32_t a, uint32_t b)
    return a;
 }
 
-static void
-create_art_leaf(struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config)
+static int
+create_art_leaf(struct art* t, struct art_leaf** leaf, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool fold)
 {
    struct art_leaf* l = NULL;
-   l = malloc(sizeof(struct art_leaf) + key_len);
-   memset(l, 0, sizeof(struct art_leaf) + key_len);
-   if (config != NULL)
+   size_t size = LEAF_SIZE(key_len, fold);
+   *leaf = NULL;
+   if (t->arena != NULL)
    {
-      pgvictoria_value_create_with_config(value, config, &l->value);
+      l = pgvictoria_memory_arena_alloc(t->arena, size);
+      if (l == NULL)
+      {
+         return 1;
+      }
+      l->arena = true;
    }
    else
    {
-      pgvictoria_value_create(type, value, &l->value);
+      l = malloc(size);
+      if (l == NULL)
+      {
+         return 1;
+      }
+      memset(l, 0, size);
    }
-
-   l->key_len = key_len;
-   memcpy(l->key, key, key_len);
+   init_art_leaf(t, l, key, key_len, value, type, config, fold);
    *leaf = l;
+   return 0;
+}
+
+static void
+discard_art_leaf(struct art_leaf* leaf, enum value_type type)
+{
+   // Only strings are copied, any other data is still the caller's
+   if (type == ValueString || type == ValueBASE64)
+   {
+      pgvictoria_value_destroy(&leaf->value);
+   }
+   free_leaf(leaf);
 }
 
 static void
-create_art_node(struct art_node** node, enum art_node_type type)
+init_art_leaf(struct art* t, struct art_leaf* l, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool fold)
+{
+   // ValueNone leaves the value to the caller
+   if (pgvictoria_value_init(t->arena, &l->value, config != NULL ? ValueRef : type, value) == 0)
+   {
+      if (config != NULL && config->destroy_data != NULL)
+      {
+         l->value.destroy_data = config->destroy_data;
+      }
+      if (config != NULL && config->to_string != NULL)
+      {
+         l->value.to_string = config->to_string;
+      }
+      if (t->arena != NULL && !t->owns_data && pgvictoria_value_owns_data(&l->value))
+      {
+         t->owns_data = pgvictoria_memory_arena_cleanup(t->arena, art_arena_cleanup, t) == 0;
+      }
+   }
+
+   l->key_len = key_len;
+   if (fold)
+   {
+      for (uint32_t i = 0; i < key_len; i++)
+      {
+         l->key[i] = fold_char(key[i]);
+      }
+      memcpy(l->key + key_len, key, key_len);
+   }
+   else
+   {
+      memcpy(l->key, key, key_len);
+   }
+   l->folded = fold;
+}
+
+static int
+create_art_node(struct memory_arena* arena, struct art_node** node, enum art_node_type type)
 {
    struct art_node* n = NULL;
+   size_t size = 0;
+   *node = NULL;
    switch (type)
    {
       case Node4:
-      {
-         struct art_node4* n4 = malloc(sizeof(struct art_node4));
-         memset(n4, 0, sizeof(struct art_node4));
-         n4->node.type = Node4;
-         n = (struct art_node*)n4;
+         size = sizeof(struct art_node4);
          break;
-      }
       case Node16:
-      {
-         struct art_node16* n16 = malloc(sizeof(struct art_node16));
-         memset(n16, 0, sizeof(struct art_node16));
-         n16->node.type = Node16;
-         n = (struct art_node*)n16;
+         size = sizeof(struct art_node16);
          break;
-      }
       case Node48:
-      {
-         struct art_node48* n48 = malloc(sizeof(struct art_node48));
-         memset(n48, 0, sizeof(struct art_node48));
-         n48->node.type = Node48;
-         n = (struct art_node*)n48;
+         size = sizeof(struct art_node48);
          break;
-      }
       case Node256:
-      {
-         struct art_node256* n256 = malloc(sizeof(struct art_node256));
-         memset(n256, 0, sizeof(struct art_node256));
-         n256->node.type = Node256;
-         n = (struct art_node*)n256;
+         size = sizeof(struct art_node256);
          break;
+   }
+   if (arena != NULL)
+   {
+      n = pgvictoria_memory_arena_alloc(arena, size);
+      if (n == NULL)
+      {
+         return 1;
+      }
+      n->arena = 1;
+   }
+   else
+   {
+      n = malloc(size);
+      if (n == NULL)
+      {
+         return 1;
       }
+      memset(n, 0, size);
    }
+   n->type = type;
    *node = n;
+   return 0;
 }
 
-static void
-create_art_node4(struct art_node4** node)
+static int
+create_art_node4(struct memory_arena* arena, struct art_node4** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node4);
+   int ret = create_art_node(arena, &n, Node4);
    *node = (struct art_node4*)n;
+   return ret;
 }
 
-static void
-create_art_node16(struct art_node16** node)
+static int
+create_art_node16(struct memory_arena* arena, struct art_node16** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node16);
+   int ret = create_art_node(arena, &n, Node16);
    *node = (struct art_node16*)n;
+   return ret;
 }
 
-static void
-create_art_node48(struct art_node48** node)
+static int
+create_art_node48(struct memory_arena* arena, struct art_node48** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node48);
+   int ret = create_art_node(arena, &n, Node48);
    *node = (struct art_node48*)n;
+   return ret;
 }
 
-static void
-create_art_node256(struct art_node256** node)
+static int
+create_art_node256(struct memory_arena* arena, struct art_node256** node)
 {
    struct art_node* n = NULL;
-   create_art_node(&n, Node256);
+   int ret = create_art_node(arena, &n, Node256);
    *node = (struct art_node256*)n;
+   return ret;
 }
 
 static void
@@ -742,8 +1344,8 @@ destroy_art_node(struct art_node* node)
    }
    if (IS_LEAF(node))
    {
-      pgvictoria_value_destroy(GET_LEAF(node)->value);
-      free(GET_LEAF(node));
+      pgvictoria_value_destroy(&GET_LEAF(node)->value);
+      free_leaf(GET_LEAF(node));
       return;
    }
    switch (node->type)
@@ -795,7 +1397,71 @@ destroy_art_node(struct art_node* node)
          break;
       }
    }
-   free(node);
+   free_node(node);
+}
+
+static void
+release_art_node(struct art_node* node)
+{
+   if (node == NULL)
+   {
+      return;
+   }
+   if (IS_LEAF(node))
+   {
+      free_leaf(GET_LEAF(node));
+      return;
+   }
+   switch (node->type)
+   {
+      case Node4:
+      {
+         struct art_node4* n = (struct art_node4*)node;
+         for (int i = 0; i < node->num_children; i++)
+         {
+            release_art_node(n->children[i]);
+         }
+         break;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         for (int i = 0; i < node->num_children; i++)
+         {
+            release_art_node(n->children[i]);
+         }
+         break;
+      }
+      case Node48:
+      {
+         struct art_node48* n = (struct art_node48*)node;
+         for (int i = 0; i < 256; i++)
+         {
+            int idx = n->keys[i];
+            if (idx == 0)
+            {
+               continue;
+            }
+            release_art_node(n->children[idx - 1]);
+         }
+         break;
+      }
+
+      case Node256:
+      {
+         struct art_node256* n = (struct art_node256*)node;
+         for (int i = 0; i < 256; i++)
+         {
+            if (n->children[i] == NULL)
+            {
+               continue;
+            }
+            release_art_node(n->children[i]);
+         }
+         break;
+      }
+   }
+   free_node(node);
 }
 
 static struct art_node**
@@ -806,8 +1472,8 @@ node_get_child(struct art_node* node, unsigned char ch)
       case Node4:
       {
          struct art_node4* n = (struct art_node4*)node;
-         int idx = find_index(ch, n->keys, n->node.num_children);
-         if (idx == -1 || n->keys[idx] != ch)
+         int idx = find_child(ch, n->keys, n->node.num_children);
+         if (idx == -1)
          {
             goto error;
          }
@@ -816,8 +1482,8 @@ node_get_child(struct art_node* node, unsigned char ch)
       case Node16:
       {
          struct art_node16* n = (struct art_node16*)node;
-         int idx = find_index(ch, n->keys, n->node.num_children);
-         if (idx == -1 || n->keys[idx] != ch)
+         int idx = find_child16(ch, n->keys, n->node.num_children);
+         if (idx == -1)
          {
             goto error;
          }
@@ -842,43 +1508,37 @@ error:
    return NULL;
 }
 
-static struct value*
-art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, struct value_config* config, bool* new)
+static int
+art_node_insert(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, struct art_leaf* leaf, bool* new)
 {
-   struct art_leaf* leaf = NULL;
+   unsigned char* key = leaf->key;
+   uint32_t key_len = leaf->key_len;
    struct art_leaf* min_leaf = NULL;
    uint32_t idx = 0;
    uint32_t diff_len = 0; // where the keys diverge
    struct art_node* new_node = NULL;
    struct art_node** next = NULL;
    unsigned char* leaf_key = NULL;
-   void* old_val = NULL;
    if (node == NULL)
    {
       // Lazy expansion, skip creating an inner node since it currently will have only this one leaf.
       // We will compare keys when reach leaf anyway, the path doesn't need to 100% match the key along the way
-      create_art_leaf(&leaf, key, key_len, value, type, config);
       *node_ref = SET_LEAF(leaf);
       *new = true;
-      return NULL;
+      return 0;
    }
    // base case, reaching leaf, either replace or expand
    if (IS_LEAF(node))
    {
       // Lazy expansion, expand the leaf node to an inner node with 2 leaves
-      // If the key already exists, replace with new value and return old value
+      // If the key already exists, replace with the new value
       if (leaf_match(GET_LEAF(node), key, key_len))
       {
-         old_val = GET_LEAF(node)->value;
-         if (config != NULL)
-         {
-            pgvictoria_value_create_with_config(value, config, &(GET_LEAF(node)->value));
-         }
-         else
-         {
-            pgvictoria_value_create(type, value, &(GET_LEAF(node)->value));
-         }
-         return old_val;
+         pgvictoria_value_destroy(&GET_LEAF(node)->value);
+         GET_LEAF(node)->value = leaf->value;
+         pgvictoria_value_relocate(&GET_LEAF(node)->value);
+         free_leaf(leaf);
+         return 0;
       }
       // If the key does not match with existing key, old key and new key diverged some point after depth
       // Even if we merely store a partial prefix for each node, it couldn't have diverged before depth.
@@ -886,8 +1546,10 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       // we compare with the existing key in the left most leaf and find an exact diverging point to split the node (see details below).
       // This way we inductively guarantee that all children to a parent share the same prefix even if it's only partially stored
       leaf_key = GET_LEAF(node)->key;
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      if (create_art_node(arena, &new_node, Node4))
+      {
+         return 1;
+      }
       // Get the diverging index after point of depth
       for (idx = depth; idx < min(key_len, GET_LEAF(node)->key_len); idx++)
       {
@@ -902,12 +1564,13 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       new_node->prefix_len = idx - depth;
       depth += new_node->prefix_len;
-      node_add_child(new_node, &new_node, key[depth], SET_LEAF(leaf));
-      node_add_child(new_node, &new_node, leaf_key[depth], (void*)node);
+      // A new node4 has room for both, so adding them cannot fail
+      node_add_child(arena, new_node, &new_node, key[depth], SET_LEAF(leaf));
+      node_add_child(arena, new_node, &new_node, leaf_key[depth], (void*)node);
       // replace with new node
       *node_ref = new_node;
       *new = true;
-      return NULL;
+      return 0;
    }
 
    // There are several cases,
@@ -918,7 +1581,7 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
    // For case 1, go to the next child to add node recursively, or add leaf to current node in place
    // For case 2, split the current node and add child to new node.
    // Note that it's tricky to check case 2.2, or in that case know the exact diverging point,
-   // since we merely store the first 10 (MAX_PREFIX_LEN) bytes of the prefix.
+   // since we merely store the first MAX_PREFIX_LEN bytes of the prefix.
    // In this case we use the key in the left most leaf of the node to determine the diverging point.
    // Theoretically we inductively guarantee that all children to the same parent share the same prefixes.
    // So we can use the key inside any leaf under this node to see if the diverging point goes beyond the current prefix,
@@ -927,9 +1590,11 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
    diff_len = check_prefix(node, key, depth, key_len);
    if (diff_len < node->prefix_len)
    {
-      // case 2, split the node
-      create_art_node(&new_node, Node4);
-      create_art_leaf(&leaf, key, key_len, value, type, config);
+      // case 2, split the node; allocate before anything is changed
+      if (create_art_node(arena, &new_node, Node4))
+      {
+         return 1;
+      }
       new_node->prefix_len = diff_len;
       memcpy(new_node->prefix, node->prefix, min(MAX_PREFIX_LEN, diff_len));
       // We need to know if new bytes that were once outside the partial prefix range will now come into the range
@@ -938,8 +1603,8 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       if (node->prefix_len <= MAX_PREFIX_LEN)
       {
          node->prefix_len = node->prefix_len - (diff_len + 1);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, node->prefix[diff_len], node);
+         node_add_child(arena, new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
+         node_add_child(arena, new_node, &new_node, node->prefix[diff_len], node);
          // Update node's prefix info since we move it downwards
          // The first diverging character serves as the key byte in keys array,
          // so we don't duplicate store it in the prefix.
@@ -953,15 +1618,15 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       {
          node->prefix_len = node->prefix_len - (diff_len + 1);
          min_leaf = node_get_minimum(node);
-         node_add_child(new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
-         node_add_child(new_node, &new_node, min_leaf->key[depth + diff_len], node);
+         node_add_child(arena, new_node, &new_node, key[depth + diff_len], SET_LEAF(leaf));
+         node_add_child(arena, new_node, &new_node, min_leaf->key[depth + diff_len], node);
          // node is moved downwards
          memmove(node->prefix, min_leaf->key + depth + diff_len + 1, min(MAX_PREFIX_LEN, node->prefix_len));
       }
       // replace
       *node_ref = new_node;
       *new = true;
-      return NULL;
+      return 0;
    }
    else
    {
@@ -970,26 +1635,28 @@ art_node_insert(struct art_node* node, struct art_node** node_ref, uint32_t dept
       next = node_get_child(node, key[depth]);
       if (next != NULL)
       {
-         // recursively add node
+         // recursively add node; an empty slot takes the leaf as is, which cannot fail
          if (*next == NULL)
          {
             node->num_children++;
          }
-         return art_node_insert(*next, next, depth + 1, key, key_len, value, type, config, new);
+         return art_node_insert(arena, *next, next, depth + 1, leaf, new);
       }
       else
       {
          // add a child to current node since the spot is available
-         create_art_leaf(&leaf, key, key_len, value, type, config);
-         node_add_child(node, node_ref, key[depth], SET_LEAF(leaf));
+         if (node_add_child(arena, node, node_ref, key[depth], SET_LEAF(leaf)))
+         {
+            return 1;
+         }
          *new = true;
-         return NULL;
+         return 0;
       }
    }
 }
 
 static struct art_leaf*
-art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
+art_node_delete(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, uint32_t depth, unsigned char* key, uint32_t key_len)
 {
    struct art_leaf* l = NULL;
    struct art_node** child = NULL;
@@ -1032,7 +1699,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
          if (leaf_match(GET_LEAF(*child), key, key_len))
          {
             l = GET_LEAF(*child);
-            node_remove_child(node, node_ref, key[depth]);
+            node_remove_child(arena, node, node_ref, key[depth]);
             return l;
          }
          else
@@ -1042,7 +1709,7 @@ art_node_delete(struct art_node* node, struct art_node** node_ref, uint32_t dept
       }
       else
       {
-         return art_node_delete(*child, child, depth + 1, key, key_len);
+         return art_node_delete(arena, *child, child, depth + 1, key, key_len);
       }
    }
 }
@@ -1061,7 +1728,7 @@ art_node_iterate(struct art_node* node, art_callback cb, void* data)
    if (IS_LEAF(node))
    {
       l = GET_LEAF(node);
-      return cb(data, (char*)l->key, l->value);
+      return cb(data, (char*)LEAF_ORIGINAL(l), &l->value);
    }
    switch (node->type)
    {
@@ -1134,28 +1801,26 @@ art_node_iterate(struct art_node* node, art_callback cb, void* data)
    return 0;
 }
 
-static void
-node_add_child(struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
+static int
+node_add_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    switch (node->type)
    {
       case Node4:
-         node4_add_child((struct art_node4*)node, node_ref, ch, child);
-         break;
+         return node4_add_child(arena, (struct art_node4*)node, node_ref, ch, child);
       case Node16:
-         node16_add_child((struct art_node16*)node, node_ref, ch, child);
-         break;
+         return node16_add_child(arena, (struct art_node16*)node, node_ref, ch, child);
       case Node48:
-         node48_add_child((struct art_node48*)node, node_ref, ch, child);
-         break;
+         return node48_add_child(arena, (struct art_node48*)node, node_ref, ch, child);
       case Node256:
          node256_add_child((struct art_node256*)node, ch, child);
          break;
    }
+   return 0;
 }
 
-static void
-node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
+static int
+node4_add_child(struct memory_arena* arena, struct art_node4* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 4)
    {
@@ -1172,20 +1837,24 @@ node4_add_child(struct art_node4* node, struct art_node** node_ref, unsigned cha
    {
       // expand
       struct art_node16* new_node = NULL;
-      create_art_node16(&new_node);
+      if (create_art_node16(arena, &new_node))
+      {
+         return 1;
+      }
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       memcpy(new_node->keys, node->keys, node->node.num_children);
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      free_node((struct art_node*)node);
 
-      node16_add_child(new_node, node_ref, ch, child);
+      return node16_add_child(arena, new_node, node_ref, ch, child);
    }
+   return 0;
 }
 
-static void
-node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
+static int
+node16_add_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 16)
    {
@@ -1202,7 +1871,10 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node48* new_node = NULL;
-      create_art_node48(&new_node);
+      if (create_art_node48(arena, &new_node))
+      {
+         return 1;
+      }
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
       for (int i = 0; i < node->node.num_children; i++)
@@ -1211,13 +1883,14 @@ node16_add_child(struct art_node16* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
-      node48_add_child(new_node, node_ref, ch, child);
+      free_node((struct art_node*)node);
+      return node48_add_child(arena, new_node, node_ref, ch, child);
    }
+   return 0;
 }
 
-static void
-node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
+static int
+node48_add_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch, void* child)
 {
    if (node->node.num_children < 48)
    {
@@ -1235,7 +1908,10 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
    {
       // expand
       struct art_node256* new_node = NULL;
-      create_art_node256(&new_node);
+      if (create_art_node256(arena, &new_node))
+      {
+         return 1;
+      }
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1247,9 +1923,10 @@ node48_add_child(struct art_node48* node, struct art_node** node_ref, unsigned c
       }
       // replace the node through node reference
       *node_ref = (struct art_node*)new_node;
-      free(node);
+      free_node((struct art_node*)node);
       node256_add_child(new_node, ch, child);
    }
+   return 0;
 }
 
 static void
@@ -1296,24 +1973,95 @@ find_index(unsigned char ch, unsigned char* keys, int length)
    return -1;
 }
 
-static void
-copy_header(struct art_node* dest, struct art_node* src)
+static int
+find_child(unsigned char ch, unsigned char* keys, int length)
 {
-   dest->num_children = src->num_children;
-   dest->prefix_len = src->prefix_len;
-   memcpy(dest->prefix, src->prefix, min(MAX_PREFIX_LEN, src->prefix_len));
+   for (int i = 0; i < length; i++)
+   {
+      if (keys[i] == ch)
+      {
+         return i;
+      }
+   }
+   return -1;
 }
 
-static uint32_t
-check_prefix_partial(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len)
+static int
+find_child16(unsigned char ch, unsigned char* keys, int length)
 {
-   uint32_t len = 0;
-   uint32_t max_cmp = min(min(node->prefix_len, MAX_PREFIX_LEN), key_len - depth);
-   while (len < max_cmp && key[depth + len] == node->prefix[len])
+#if defined(HAVE_SSE2)
+   __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)ch), _mm_loadu_si128((__m128i*)keys));
+   unsigned int bits = (unsigned int)_mm_movemask_epi8(cmp) & ((1U << length) - 1);
+
+   return bits != 0 ? __builtin_ctz(bits) : -1;
+#elif defined(HAVE_NEON)
+   uint8x16_t cmp = vceqq_u8(vdupq_n_u8(ch), vld1q_u8(keys));
+   // narrow every byte of the compare to a nibble of a 64 bit mask
+   uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+
+   if (length < 16)
    {
-      len++;
+      bits &= (1ULL << (length * 4)) - 1;
    }
-   return len;
+   return bits != 0 ? __builtin_ctzll(bits) / 4 : -1;
+#else
+   return find_child(ch, keys, length);
+#endif
+}
+
+static uint32_t
+mismatch(unsigned char* a, unsigned char* b, uint32_t length)
+{
+   uint32_t i = 0;
+
+#if defined(HAVE_SSE2)
+   for (; i + 16 <= length; i += 16)
+   {
+      __m128i cmp = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(a + i)), _mm_loadu_si128((__m128i*)(b + i)));
+      unsigned int bits = (unsigned int)_mm_movemask_epi8(cmp) ^ 0xFFFF;
+
+      if (bits != 0)
+      {
+         return i + __builtin_ctz(bits);
+      }
+   }
+#elif defined(HAVE_NEON)
+   for (; i + 16 <= length; i += 16)
+   {
+      uint8x16_t cmp = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+      uint64_t bits = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+
+      if (bits != 0)
+      {
+         return i + __builtin_ctzll(bits) / 4;
+      }
+   }
+#endif
+
+   for (; i < length; i++)
+   {
+      if (a[i] != b[i])
+      {
+         return i;
+      }
+   }
+   return length;
+}
+
+static void
+copy_header(struct art_node* dest, struct art_node* src)
+{
+   dest->num_children = src->num_children;
+   dest->prefix_len = src->prefix_len;
+   memcpy(dest->prefix, src->prefix, min(MAX_PREFIX_LEN, src->prefix_len));
+}
+
+static uint32_t
+check_prefix_partial(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t key_len)
+{
+   uint32_t max_cmp = min(min(node->prefix_len, MAX_PREFIX_LEN), key_len - depth);
+
+   return mismatch(node->prefix, key + depth, max_cmp);
 }
 
 static uint32_t
@@ -1322,10 +2070,8 @@ check_prefix(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t
    uint32_t len = 0;
    struct art_leaf* leaf = NULL;
    uint32_t max_cmp = min(min(node->prefix_len, MAX_PREFIX_LEN), key_len - depth);
-   while (len < max_cmp && key[depth + len] == node->prefix[len])
-   {
-      len++;
-   }
+
+   len = mismatch(node->prefix, key + depth, max_cmp);
    // diverge within partial prefix range
    if (len < MAX_PREFIX_LEN)
    {
@@ -1335,9 +2081,9 @@ check_prefix(struct art_node* node, unsigned char* key, uint32_t depth, uint32_t
    leaf = node_get_minimum(node);
    max_cmp = min(leaf->key_len, key_len) - depth;
    // continue comparing the real keys
-   while (len < max_cmp && leaf->key[depth + len] == key[depth + len])
+   if (len < max_cmp)
    {
-      len++;
+      len += mismatch(leaf->key + depth + len, key + depth + len, max_cmp - len);
    }
    return len;
 }
@@ -1349,7 +2095,7 @@ leaf_match(struct art_leaf* leaf, unsigned char* key, uint32_t key_len)
    {
       return false;
    }
-   return memcmp(leaf->key, key, key_len) == 0;
+   return mismatch(leaf->key, key, key_len) == key_len;
 }
 
 static struct art_leaf*
@@ -1407,7 +2153,7 @@ node_get_minimum(struct art_node* node)
 }
 
 static void
-node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned char ch)
+node_remove_child(struct memory_arena* arena, struct art_node* node, struct art_node** node_ref, unsigned char ch)
 {
    switch (node->type)
    {
@@ -1415,13 +2161,13 @@ node_remove_child(struct art_node* node, struct art_node** node_ref, unsigned ch
          node4_remove_child((struct art_node4*)node, node_ref, ch);
          break;
       case Node16:
-         node16_remove_child((struct art_node16*)node, node_ref, ch);
+         node16_remove_child(arena, (struct art_node16*)node, node_ref, ch);
          break;
       case Node48:
-         node48_remove_child((struct art_node48*)node, node_ref, ch);
+         node48_remove_child(arena, (struct art_node48*)node, node_ref, ch);
          break;
       case Node256:
-         node256_remove_child((struct art_node256*)node, node_ref, ch);
+         node256_remove_child(arena, (struct art_node256*)node, node_ref, ch);
          break;
    }
 }
@@ -1443,7 +2189,7 @@ node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned
       if (IS_LEAF(child))
       {
          // replace directly
-         free(node);
+         free_node((struct art_node*)node);
          *node_ref = child;
          return;
       }
@@ -1461,14 +2207,14 @@ node4_remove_child(struct art_node4* node, struct art_node** node_ref, unsigned
       }
       child->prefix_len = node->node.prefix_len + 1 + child->prefix_len;
       memcpy(child->prefix, node->node.prefix, min(child->prefix_len, MAX_PREFIX_LEN));
-      free(node);
+      free_node((struct art_node*)node);
       // replace
       *node_ref = child;
    }
 }
 
 static void
-node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigned char ch)
+node16_remove_child(struct memory_arena* arena, struct art_node16* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = 0;
    struct art_node4* new_node = NULL;
@@ -1478,19 +2224,18 @@ node16_remove_child(struct art_node16* node, struct art_node** node_ref, unsigne
    node->node.num_children--;
    // downgrade node
    // Trick from libart, do not downgrade immediately to avoid jumping on 4/5 boundary
-   if (node->node.num_children <= 3)
+   if (node->node.num_children <= 3 && create_art_node4(arena, &new_node) == 0)
    {
-      create_art_node4(&new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       memcpy(new_node->keys, node->keys, node->node.num_children);
       memcpy(new_node->children, node->children, node->node.num_children * sizeof(void*));
-      free(node);
+      free_node((struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigned char ch)
+node48_remove_child(struct memory_arena* arena, struct art_node48* node, struct art_node** node_ref, unsigned char ch)
 {
    int idx = node->keys[ch];
    int cnt = 0;
@@ -1499,9 +2244,8 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
    node->keys[ch] = 0;
    node->node.num_children--;
 
-   if (node->node.num_children <= 12)
+   if (node->node.num_children <= 12 && create_art_node16(arena, &new_node) == 0)
    {
-      create_art_node16(&new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1512,34 +2256,21 @@ node48_remove_child(struct art_node48* node, struct art_node** node_ref, unsigne
             cnt++;
          }
       }
-      free(node);
+      free_node((struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
 
 static void
-node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsigned char ch)
+node256_remove_child(struct memory_arena* arena, struct art_node256* node, struct art_node** node_ref, unsigned char ch)
 {
-   int num = 0;
-   for (int i = 0; i < 48; i++)
-   {
-      if (node->children[i] != NULL)
-      {
-         num++;
-      }
-   }
-   if (num != node->node.num_children)
-   {
-      num++;
-   }
    struct art_node48* new_node = NULL;
    int cnt = 0;
    node->children[ch] = NULL;
    node->node.num_children--;
 
-   if (node->node.num_children <= 37)
+   if (node->node.num_children <= 37 && create_art_node48(arena, &new_node) == 0)
    {
-      create_art_node48(&new_node);
       copy_header((struct art_node*)new_node, (struct art_node*)node);
       for (int i = 0; i < 256; i++)
       {
@@ -1550,7 +2281,7 @@ node256_remove_child(struct art_node256* node, struct art_node** node_ref, unsig
             cnt++;
          }
       }
-      free(node);
+      free_node((struct art_node*)node);
       *node_ref = (struct art_node*)new_node;
    }
 }
@@ -1564,97 +2295,48 @@ pgvictoria_art_iterator_create(struct art* t, struct art_iterator** iter)
       return 1;
    }
    i = malloc(sizeof(struct art_iterator));
-   i->count = 0;
-   i->tree = t;
-   i->key = NULL;
-   i->value = NULL;
-   pgvictoria_deque_create(false, &i->que);
+   if (i == NULL)
+   {
+      return 1;
+   }
+   iterator_init(i, t);
    *iter = i;
    return 0;
 }
 
-bool
-pgvictoria_art_iterator_next(struct art_iterator* iter)
+int
+pgvictoria_art_iterator_seek(struct art_iterator* iter, char* key)
 {
-   struct deque* que = NULL;
-   struct art* tree = NULL;
-   struct art_node* node = NULL;
-   struct art_node* child = NULL;
-   int idx = 0;
-   if (iter == NULL || iter->que == NULL || iter->tree == NULL || iter->count == iter->tree->size)
+   unsigned char buffer[ART_FOLD_BUFFER];
+   unsigned char* k = NULL;
+   int ret;
+
+   if (iter == NULL || iter->tree == NULL || key == NULL)
    {
-      return false;
+      return 1;
    }
-   que = iter->que;
-   tree = iter->tree;
-   if (iter->count == 0)
+   k = fold_key(iter->tree, key, strlen(key), buffer, sizeof(buffer));
+   if (k == NULL)
    {
-      pgvictoria_deque_add(que, NULL, (uintptr_t)tree->root, ValueRef);
+      return 1;
    }
-   while (!pgvictoria_deque_empty(que))
+   ret = iterator_seek(iter, k, strlen(key));
+   release_key(k, key, buffer);
+   return ret;
+}
+
+bool
+pgvictoria_art_iterator_next(struct art_iterator* iter)
+{
+   if (iter == NULL || iter->tree == NULL || iter->next == NULL)
    {
-      node = (struct art_node*)pgvictoria_deque_poll(que, NULL);
-      if (IS_LEAF(node))
-      {
-         iter->count++;
-         iter->key = (char*)GET_LEAF(node)->key;
-         iter->value = GET_LEAF(node)->value;
-         return true;
-      }
-      switch (node->type)
-      {
-         case Node4:
-         {
-            struct art_node4* n = (struct art_node4*)node;
-            for (int i = 0; i < node->num_children; i++)
-            {
-               child = n->children[i];
-               pgvictoria_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node16:
-         {
-            struct art_node16* n = (struct art_node16*)node;
-            for (int i = 0; i < node->num_children; i++)
-            {
-               child = n->children[i];
-               pgvictoria_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node48:
-         {
-            struct art_node48* n = (struct art_node48*)node;
-            for (int i = 0; i < 256; i++)
-            {
-               idx = n->keys[i];
-               if (idx == 0)
-               {
-                  continue;
-               }
-               child = n->children[idx - 1];
-               pgvictoria_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-         case Node256:
-         {
-            struct art_node256* n = (struct art_node256*)node;
-            for (int i = 0; i < 256; i++)
-            {
-               if (n->children[i] == NULL)
-               {
-                  continue;
-               }
-               child = n->children[i];
-               pgvictoria_deque_add(que, NULL, (uintptr_t)child, ValueRef);
-            }
-            break;
-         }
-      }
+      return false;
    }
-   return false;
+   iter->count++;
+   iter->key = (char*)LEAF_ORIGINAL(iter->next);
+   iter->value = &iter->next->value;
+   iterator_advance(iter);
+   return true;
 }
 
 bool
@@ -1664,21 +2346,30 @@ pgvictoria_art_iterator_has_next(struct art_iterator* iter)
    {
       return false;
    }
-   return iter->count < iter->tree->size;
+   return iter->next != NULL;
 }
 
 void
 pgvictoria_art_iterator_remove(struct art_iterator* iter)
 {
+   struct art_leaf* next = NULL;
+
    if (iter == NULL || iter->tree == NULL || iter->key == NULL)
    {
       return;
    }
 
+   // The delete may shrink or merge nodes on the stack, so find the next leaf again afterwards
+   next = iter->next;
    pgvictoria_art_delete(iter->tree, iter->key);
    iter->key = NULL;
    iter->value = NULL;
    iter->count--;
+
+   if (next != NULL)
+   {
+      iterator_seek(iter, next->key, next->key_len);
+   }
 }
 
 void
@@ -1688,7 +2379,10 @@ pgvictoria_art_iterator_destroy(struct art_iterator* iter)
    {
       return;
    }
-   pgvictoria_deque_destroy(iter->que);
+   if (iter->stack != iter->frames)
+   {
+      free(iter->stack);
+   }
    free(iter);
 }
 
@@ -1714,6 +2408,10 @@ art_search(struct art* t, unsigned char* key, uint32_t key_len)
    {
       return NULL;
    }
+   if (t->case_insensitive)
+   {
+      return art_search_folded(t, key, key_len);
+   }
    node = t->root;
    while (node != NULL)
    {
@@ -1723,7 +2421,7 @@ art_search(struct art* t, unsigned char* key, uint32_t key_len)
          {
             return NULL;
          }
-         return GET_LEAF(node)->value;
+         return &GET_LEAF(node)->value;
       }
       // optimistically check the prefix,
       // we move forward as long as up to MAX_PREFIX_LEN characters match
@@ -1745,174 +2443,883 @@ art_search(struct art* t, unsigned char* key, uint32_t key_len)
    return NULL;
 }
 
-static int
-art_to_json_string_cb(void* param, char* key, struct value* value)
+static struct value*
+art_search_folded(struct art* t, unsigned char* key, uint32_t key_len)
 {
-   struct to_string_param* p = (struct to_string_param*)param;
-   char* str = NULL;
-   char* tag = NULL;
-   char* translated_key = NULL;
-   p->cnt++;
-   bool has_next = p->cnt < p->t->size;
-   tag = pgvictoria_append_char(tag, '"');
-   translated_key = pgvictoria_escape_string((char*)key);
-   tag = pgvictoria_append(tag, translated_key);
-   free(translated_key);
-   tag = pgvictoria_append_char(tag, '"');
-   tag = pgvictoria_append(tag, ": ");
-   str = pgvictoria_value_to_string(value, FORMAT_JSON, tag, p->indent);
-   free(tag);
-   p->str = pgvictoria_append(p->str, str);
-   p->str = pgvictoria_append(p->str, has_next ? ",\n" : "\n");
-
-   free(str);
-   return 0;
+   struct art_node* node = t->root;
+   struct art_node** child = NULL;
+   struct art_leaf* leaf = NULL;
+   uint32_t depth = 0;
+   uint32_t len = 0;
+
+   while (node != NULL)
+   {
+      if (IS_LEAF(node))
+      {
+         leaf = GET_LEAF(node);
+         if (leaf->key_len != key_len)
+         {
+            return NULL;
+         }
+         for (uint32_t i = 0; i < key_len; i++)
+         {
+            if (leaf->key[i] != fold_char(key[i]))
+            {
+               return NULL;
+            }
+         }
+         return &leaf->value;
+      }
+      // optimistically check the stored prefix, the leaf verifies the rest
+      len = min(node->prefix_len, MAX_PREFIX_LEN);
+      if (len > key_len - depth)
+      {
+         return NULL;
+      }
+      for (uint32_t i = 0; i < len; i++)
+      {
+         if (node->prefix[i] != fold_char(key[depth + i]))
+         {
+            return NULL;
+         }
+      }
+      depth += node->prefix_len;
+      if (depth >= key_len)
+      {
+         return NULL;
+      }
+      child = node_get_child(node, fold_char(key[depth]));
+      node = child != NULL ? *child : NULL;
+      depth++;
+   }
+   return NULL;
 }
 
-static int
-art_to_compact_json_string_cb(void* param, char* key, struct value* value)
+static unsigned char
+fold_char(unsigned char ch)
 {
-   struct to_string_param* p = (struct to_string_param*)param;
-   char* str = NULL;
-   char* tag = NULL;
-   char* translated_key = NULL;
-   p->cnt++;
-   bool has_next = p->cnt < p->t->size;
-   tag = pgvictoria_append_char(tag, '"');
-   translated_key = pgvictoria_escape_string((char*)key);
-   tag = pgvictoria_append(tag, (char*)translated_key);
-   free(translated_key);
-   tag = pgvictoria_append_char(tag, '"');
-   tag = pgvictoria_append(tag, ":");
-   str = pgvictoria_value_to_string(value, FORMAT_JSON_COMPACT, tag, p->indent);
-   free(tag);
-   p->str = pgvictoria_append(p->str, str);
-   p->str = pgvictoria_append(p->str, has_next ? "," : "");
-
-   free(str);
-   return 0;
+   return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
 }
 
-static int
-art_to_text_string_cb(void* param, char* key, struct value* value)
+static unsigned char*
+fold_key(struct art* t, char* key, uint32_t key_len, unsigned char* buffer, uint32_t size)
 {
-   struct to_string_param* p = (struct to_string_param*)param;
-   char* str = NULL;
-   char* tag = NULL;
-   p->cnt++;
-   bool has_next = p->cnt < p->t->size;
-   tag = pgvictoria_append(tag, (char*)key);
-   tag = pgvictoria_append(tag, ":");
-   if (value->type == ValueJSON && ((struct json*)value->data)->type != JSONUnknown)
+   unsigned char* folded = buffer;
+
+   if (!t->case_insensitive)
    {
-      tag = pgvictoria_append(tag, "\n");
+      return (unsigned char*)key;
    }
-   else
+   if (key_len > size)
    {
-      tag = pgvictoria_append(tag, " ");
+      folded = malloc(key_len);
+      if (folded == NULL)
+      {
+         return NULL;
+      }
    }
-   if (pgvictoria_compare_string(p->tag, BULLET_POINT))
+   for (uint32_t i = 0; i < key_len; i++)
    {
-      if (p->cnt == 1)
+      folded[i] = fold_char((unsigned char)key[i]);
+   }
+   return folded;
+}
+
+static void
+release_key(unsigned char* folded, char* key, unsigned char* buffer)
+{
+   if (folded != (unsigned char*)key && folded != buffer)
+   {
+      free(folded);
+   }
+}
+
+static void
+art_node_collect(struct art_node* node, struct art_leaf** leaves, uint64_t* number_of_leaves)
+{
+   if (node == NULL)
+   {
+      return;
+   }
+   if (IS_LEAF(node))
+   {
+      leaves[(*number_of_leaves)++] = GET_LEAF(node);
+      return;
+   }
+   switch (node->type)
+   {
+      case Node4:
       {
-         if (value->type != ValueJSON || ((struct json*)value->data)->type == JSONUnknown)
+         struct art_node4* n = (struct art_node4*)node;
+         for (int i = 0; i < node->num_children; i++)
          {
-            str = pgvictoria_value_to_string(value, FORMAT_TEXT, tag, 0);
+            art_node_collect(n->children[i], leaves, number_of_leaves);
          }
-         else
+         break;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         for (int i = 0; i < node->num_children; i++)
          {
-            p->str = pgvictoria_indent(p->str, tag, 0);
-            str = pgvictoria_value_to_string(value, FORMAT_TEXT, NULL, p->indent + INDENT_PER_LEVEL);
+            art_node_collect(n->children[i], leaves, number_of_leaves);
          }
+         break;
       }
-      else
+      case Node48:
       {
-         str = pgvictoria_value_to_string(value, FORMAT_TEXT, tag, p->indent + INDENT_PER_LEVEL);
+         struct art_node48* n = (struct art_node48*)node;
+         for (int i = 0; i < 256; i++)
+         {
+            if (n->keys[i] != 0)
+            {
+               art_node_collect(n->children[n->keys[i] - 1], leaves, number_of_leaves);
+            }
+         }
+         break;
+      }
+      case Node256:
+      {
+         struct art_node256* n = (struct art_node256*)node;
+         for (int i = 0; i < 256; i++)
+         {
+            art_node_collect(n->children[i], leaves, number_of_leaves);
+         }
+         break;
       }
    }
-   else
-   {
-      str = pgvictoria_value_to_string(value, FORMAT_TEXT, tag, p->indent);
-   }
-   free(tag);
-   p->str = pgvictoria_append(p->str, str);
-   p->str = pgvictoria_append(p->str, has_next ? "\n" : "");
-
-   free(str);
-   return 0;
 }
 
-static char*
-to_json_string(struct art* t, char* tag, int indent)
+static void
+free_node(struct art_node* node)
 {
-   char* ret = NULL;
-   ret = pgvictoria_indent(ret, tag, indent);
-   if (t == NULL || t->size == 0)
+   if (node != NULL && !node->arena)
    {
-      ret = pgvictoria_append(ret, "{}");
-      return ret;
+      free(node);
    }
-   ret = pgvictoria_append(ret, "{\n");
-   struct to_string_param param = {
-      .indent = indent + INDENT_PER_LEVEL,
-      .str = ret,
-      .t = t,
-      .cnt = 0,
-   };
-   art_iterate(t, art_to_json_string_cb, &param);
-   ret = param.str;
-   ret = pgvictoria_indent(ret, NULL, indent);
-   ret = pgvictoria_append(ret, "}");
-   return ret;
 }
 
-static char*
-to_compact_json_string(struct art* t, char* tag, int indent)
+static void
+free_leaf(struct art_leaf* leaf)
 {
-   char* ret = NULL;
-   ret = pgvictoria_indent(ret, tag, indent);
-   if (t == NULL || t->size == 0)
+   if (leaf != NULL && !leaf->arena)
    {
-      ret = pgvictoria_append(ret, "{}");
-      return ret;
+      free(leaf);
    }
-   ret = pgvictoria_append(ret, "{");
-   struct to_string_param param = {
-      .indent = indent,
-      .str = ret,
-      .t = t,
-      .cnt = 0,
-   };
-   art_iterate(t, art_to_compact_json_string_cb, &param);
-   ret = param.str;
-   ret = pgvictoria_append(ret, "}");
-   return ret;
 }
 
-static char*
-to_text_string(struct art* t, char* tag, int indent)
+static void
+art_arena_cleanup(void* data)
 {
-   char* ret = NULL;
-   int next_indent = indent;
-   if (tag != NULL && !pgvictoria_compare_string(tag, BULLET_POINT))
-   {
-      ret = pgvictoria_indent(ret, tag, indent);
-      next_indent += INDENT_PER_LEVEL;
-   }
+   art_iterate((struct art*)data, art_value_destroy_cb, NULL);
+}
+
+static int
+art_value_destroy_cb(void* data, char* key, struct value* value)
+{
+   (void)data;
+   (void)key;
+   pgvictoria_value_destroy(value);
+   return 0;
+}
+
+static struct memory_arena*
+bulk_arena(struct art* t)
+{
+   if (t->arena != NULL)
+   {
+      return t->arena;
+   }
+   if (t->bulk == NULL)
+   {
+      pgvictoria_memory_arena_create(0, &t->bulk);
+   }
+   return t->bulk;
+}
+
+static struct art_leaf*
+create_arena_leaf(struct art* t, unsigned char* key, uint32_t key_len, uintptr_t value, enum value_type type, bool fold)
+{
+   struct art_leaf* l = NULL;
+
+   l = pgvictoria_memory_arena_alloc(bulk_arena(t), LEAF_SIZE(key_len, fold));
+   if (l == NULL)
+   {
+      return NULL;
+   }
+   // values only live in an arena the tree itself lives in
+   init_art_leaf(t, l, key, key_len, value, type, NULL, fold);
+   l->arena = true;
+   return l;
+}
+
+struct art_load_entry
+{
+   struct art_leaf* leaf;
+   uint64_t index;
+};
+
+static int
+art_load_compare(const void* a, const void* b)
+{
+   const struct art_load_entry* x = (const struct art_load_entry*)a;
+   const struct art_load_entry* y = (const struct art_load_entry*)b;
+   int cmp = leaf_compare(x->leaf, y->leaf);
+
+   if (cmp != 0)
+   {
+      return cmp;
+   }
+   return x->index < y->index ? -1 : 1;
+}
+
+static int
+art_load(struct art* t, struct art_leaf** leaves, uint64_t number_of_leaves, uint64_t* loaded)
+{
+   struct art_load_entry* entries = NULL;
+   bool sorted = true;
+   uint64_t n = 0;
+   uint64_t dropped = 0;
+
+   *loaded = 0;
+
+   for (uint64_t i = 1; sorted && i < number_of_leaves; i++)
+   {
+      sorted = leaf_compare(leaves[i - 1], leaves[i]) < 0;
+   }
+
+   if (!sorted)
+   {
+      entries = malloc(number_of_leaves * sizeof(struct art_load_entry));
+      if (entries == NULL)
+      {
+         return 1;
+      }
+      for (uint64_t i = 0; i < number_of_leaves; i++)
+      {
+         entries[i].leaf = leaves[i];
+         entries[i].index = i;
+      }
+      qsort(entries, number_of_leaves, sizeof(struct art_load_entry), art_load_compare);
+
+      // Of equal keys the last one wins, like a replacing insert; the others go to the back
+      for (uint64_t i = 0; i < number_of_leaves; i++)
+      {
+         if (i + 1 < number_of_leaves && leaf_compare(entries[i].leaf, entries[i + 1].leaf) == 0)
+         {
+            leaves[number_of_leaves - ++dropped] = entries[i].leaf;
+         }
+         else
+         {
+            leaves[n++] = entries[i].leaf;
+         }
+      }
+      free(entries);
+   }
+   else
+   {
+      n = number_of_leaves;
+   }
+
+   if (n == 0)
+   {
+      return 0;
+   }
+
+   t->root = art_build(t, leaves, 0, n, 0);
+   if (t->root == NULL)
+   {
+      return 1;
+   }
+   t->size = n;
+   *loaded = n;
+   return 0;
+}
+
+static struct art_node*
+art_build(struct art* t, struct art_leaf** leaves, uint64_t lo, uint64_t hi, uint32_t depth)
+{
+   struct art_leaf* first = leaves[lo];
+   struct art_leaf* last = leaves[hi - 1];
+   struct art_node* node = NULL;
+   struct art_node* child = NULL;
+   enum art_node_type type;
+   uint32_t prefix_len = 0;
+   uint32_t d = 0;
+   uint64_t groups = 0;
+   uint64_t i = lo;
+   uint64_t j = 0;
+   int c = 0;
+   unsigned char ch;
+   size_t size;
+
+   if (hi - lo == 1)
+   {
+      return SET_LEAF(first);
+   }
+
+   // Sorted keys share what the first and the last share
+   prefix_len = mismatch(first->key + depth, last->key + depth, min(first->key_len, last->key_len) - depth);
+   d = depth + prefix_len;
+
+   for (uint64_t k = lo; k < hi; k++)
+   {
+      if (k == lo || leaves[k]->key[d] != leaves[k - 1]->key[d])
+      {
+         groups++;
+      }
+   }
+
+   if (groups <= 4)
+   {
+      type = Node4;
+      size = sizeof(struct art_node4);
+   }
+   else if (groups <= 16)
+   {
+      type = Node16;
+      size = sizeof(struct art_node16);
+   }
+   else if (groups <= 48)
+   {
+      type = Node48;
+      size = sizeof(struct art_node48);
+   }
+   else
+   {
+      type = Node256;
+      size = sizeof(struct art_node256);
+   }
+
+   node = pgvictoria_memory_arena_alloc(bulk_arena(t), size);
+   if (node == NULL)
+   {
+      return NULL;
+   }
+   node->type = type;
+   node->arena = 1;
+   node->prefix_len = prefix_len;
+   memcpy(node->prefix, first->key + depth, min(prefix_len, MAX_PREFIX_LEN));
+
+   while (i < hi)
+   {
+      ch = leaves[i]->key[d];
+      j = i + 1;
+      while (j < hi && leaves[j]->key[d] == ch)
+      {
+         j++;
+      }
+
+      child = art_build(t, leaves, i, j, d + 1);
+      if (child == NULL)
+      {
+         return NULL;
+      }
+
+      switch (type)
+      {
+         case Node4:
+            ((struct art_node4*)node)->keys[c] = ch;
+            ((struct art_node4*)node)->children[c] = child;
+            break;
+         case Node16:
+            ((struct art_node16*)node)->keys[c] = ch;
+            ((struct art_node16*)node)->children[c] = child;
+            break;
+         case Node48:
+            ((struct art_node48*)node)->keys[ch] = c + 1;
+            ((struct art_node48*)node)->children[c] = child;
+            break;
+         case Node256:
+            ((struct art_node256*)node)->children[ch] = child;
+            break;
+      }
+      c++;
+      i = j;
+   }
+   node->num_children = c;
+
+   return node;
+}
+
+static int
+leaf_compare(struct art_leaf* a, struct art_leaf* b)
+{
+   int cmp = memcmp(a->key, b->key, min(a->key_len, b->key_len));
+
+   if (cmp != 0)
+   {
+      return cmp;
+   }
+   return a->key_len < b->key_len ? -1 : (a->key_len > b->key_len ? 1 : 0);
+}
+
+static void
+art_node_statistics(struct art_node* node, uint64_t depth, struct art_statistics* stats)
+{
+   if (node == NULL)
+   {
+      return;
+   }
+   if (IS_LEAF(node))
+   {
+      stats->leaves++;
+      stats->memory += LEAF_SIZE(GET_LEAF(node)->key_len, GET_LEAF(node)->folded);
+      stats->visits += depth;
+      return;
+   }
+   if (node->prefix_len > MAX_PREFIX_LEN)
+   {
+      stats->optimistic++;
+   }
+   switch (node->type)
+   {
+      case Node4:
+      {
+         struct art_node4* n = (struct art_node4*)node;
+         stats->node4++;
+         stats->memory += sizeof(struct art_node4);
+         for (int i = 0; i < node->num_children; i++)
+         {
+            art_node_statistics(n->children[i], depth + 1, stats);
+         }
+         break;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         stats->node16++;
+         stats->memory += sizeof(struct art_node16);
+         for (int i = 0; i < node->num_children; i++)
+         {
+            art_node_statistics(n->children[i], depth + 1, stats);
+         }
+         break;
+      }
+      case Node48:
+      {
+         struct art_node48* n = (struct art_node48*)node;
+         stats->node48++;
+         stats->memory += sizeof(struct art_node48);
+         for (int i = 0; i < 256; i++)
+         {
+            if (n->keys[i] != 0)
+            {
+               art_node_statistics(n->children[n->keys[i] - 1], depth + 1, stats);
+            }
+         }
+         break;
+      }
+      case Node256:
+      {
+         struct art_node256* n = (struct art_node256*)node;
+         stats->node256++;
+         stats->memory += sizeof(struct art_node256);
+         for (int i = 0; i < 256; i++)
+         {
+            art_node_statistics(n->children[i], depth + 1, stats);
+         }
+         break;
+      }
+   }
+}
+
+static void
+iterator_init(struct art_iterator* iter, struct art* t)
+{
+   iter->count = 0;
+   iter->tree = t;
+   iter->key = NULL;
+   iter->value = NULL;
+   iter->next = NULL;
+   iter->pending = t->root;
+   iter->depth = 0;
+   iter->capacity = ART_ITERATOR_DEPTH;
+   iter->stack = iter->frames;
+   iterator_advance(iter);
+}
+
+static int
+iterator_push(struct art_iterator* iter, struct art_node* node, uint32_t position)
+{
+   struct art_iterator_frame* stack = NULL;
+
+   if (iter->depth == iter->capacity)
+   {
+      if (iter->stack == iter->frames)
+      {
+         stack = malloc(2 * iter->capacity * sizeof(struct art_iterator_frame));
+         if (stack != NULL)
+         {
+            memcpy(stack, iter->frames, iter->depth * sizeof(struct art_iterator_frame));
+         }
+      }
+      else
+      {
+         stack = realloc(iter->stack, 2 * iter->capacity * sizeof(struct art_iterator_frame));
+      }
+      if (stack == NULL)
+      {
+         return 1;
+      }
+      iter->stack = stack;
+      iter->capacity *= 2;
+   }
+
+   iter->stack[iter->depth].node = node;
+   iter->stack[iter->depth].position = position;
+   iter->depth++;
+   return 0;
+}
+
+static void
+iterator_advance(struct art_iterator* iter)
+{
+   struct art_node* node = iter->pending;
+
+   iter->pending = NULL;
+   iter->next = NULL;
+
+   while (true)
+   {
+      if (node == NULL)
+      {
+         if (iter->depth == 0)
+         {
+            return;
+         }
+         node = frame_next_child(&iter->stack[iter->depth - 1], NULL);
+         if (node == NULL)
+         {
+            iter->depth--;
+            continue;
+         }
+      }
+      if (IS_LEAF(node))
+      {
+         iter->next = GET_LEAF(node);
+         return;
+      }
+      if (iterator_push(iter, node, 0))
+      {
+         // out of memory ends the iteration
+         iter->depth = 0;
+         return;
+      }
+      node = NULL;
+   }
+}
+
+static int
+iterator_seek(struct art_iterator* iter, unsigned char* key, uint32_t key_len)
+{
+   struct art_node* node = iter->tree->root;
+   struct art_leaf* leaf = NULL;
+   unsigned char* prefix = NULL;
+   unsigned char ch = 0;
+   uint32_t depth = 0;
+   int cmp = 0;
+
+   iter->depth = 0;
+   iter->pending = NULL;
+   iter->next = NULL;
+
+   while (node != NULL)
+   {
+      if (IS_LEAF(node))
+      {
+         leaf = GET_LEAF(node);
+         cmp = memcmp(leaf->key, key, min(leaf->key_len, key_len));
+         if (cmp > 0 || (cmp == 0 && leaf->key_len >= key_len))
+         {
+            iter->pending = node;
+         }
+         break;
+      }
+      // bytes past the stored prefix are the same in every leaf below the node
+      prefix = node->prefix_len <= MAX_PREFIX_LEN ? node->prefix : node_get_minimum(node)->key + depth;
+      cmp = memcmp(prefix, key + depth, min(node->prefix_len, key_len - depth));
+      if (cmp < 0)
+      {
+         // the whole subtree sorts before the key
+         break;
+      }
+      if (cmp > 0 || depth + node->prefix_len >= key_len)
+      {
+         // the whole subtree sorts after the key
+         iter->pending = node;
+         break;
+      }
+      depth += node->prefix_len;
+      if (iterator_push(iter, node, frame_position(node, key[depth])))
+      {
+         iter->depth = 0;
+         return 1;
+      }
+      node = frame_next_child(&iter->stack[iter->depth - 1], &ch);
+      if (node != NULL && ch != key[depth])
+      {
+         iter->pending = node;
+         break;
+      }
+      depth++;
+   }
+
+   iterator_advance(iter);
+   return 0;
+}
+
+static uint32_t
+frame_position(struct art_node* node, unsigned char ch)
+{
+   uint32_t i = 0;
+
+   switch (node->type)
+   {
+      case Node4:
+         while (i < node->num_children && ((struct art_node4*)node)->keys[i] < ch)
+         {
+            i++;
+         }
+         return i;
+      case Node16:
+         while (i < node->num_children && ((struct art_node16*)node)->keys[i] < ch)
+         {
+            i++;
+         }
+         return i;
+      default:
+         return ch;
+   }
+}
+
+static struct art_node*
+frame_next_child(struct art_iterator_frame* frame, unsigned char* ch)
+{
+   struct art_node* node = frame->node;
+   uint32_t i = frame->position;
+
+   switch (node->type)
+   {
+      case Node4:
+      {
+         struct art_node4* n = (struct art_node4*)node;
+         if (i < node->num_children)
+         {
+            frame->position = i + 1;
+            if (ch != NULL)
+            {
+               *ch = n->keys[i];
+            }
+            return n->children[i];
+         }
+         break;
+      }
+      case Node16:
+      {
+         struct art_node16* n = (struct art_node16*)node;
+         if (i < node->num_children)
+         {
+            frame->position = i + 1;
+            if (ch != NULL)
+            {
+               *ch = n->keys[i];
+            }
+            return n->children[i];
+         }
+         break;
+      }
+      case Node48:
+      {
+         struct art_node48* n = (struct art_node48*)node;
+         while (i < 256 && n->keys[i] == 0)
+         {
+            i++;
+         }
+         if (i < 256)
+         {
+            frame->position = i + 1;
+            if (ch != NULL)
+            {
+               *ch = (unsigned char)i;
+            }
+            return n->children[n->keys[i] - 1];
+         }
+         break;
+      }
+      case Node256:
+      {
+         struct art_node256* n = (struct art_node256*)node;
+         while (i < 256 && n->children[i] == NULL)
+         {
+            i++;
+         }
+         if (i < 256)
+         {
+            frame->position = i + 1;
+            if (ch != NULL)
+            {
+               *ch = (unsigned char)i;
+            }
+            return n->children[i];
+         }
+         break;
+      }
+   }
+
+   frame->position = 256;
+   return NULL;
+}
+
+static int
+art_to_json_string_cb(void* param, char* key, struct value* value)
+{
+   struct to_string_param* p = (struct to_string_param*)param;
+   p->cnt++;
+   bool has_next = p->cnt < p->t->size;
+   pgvictoria_string_builder_clear(&p->key);
+   pgvictoria_string_builder_append_char(&p->key, '"');
+   pgvictoria_string_builder_append_escaped(&p->key, key);
+   pgvictoria_string_builder_append(&p->key, "\": ");
+   pgvictoria_value_to_builder(value, FORMAT_JSON, p->key.str, p->indent, p->builder);
+   pgvictoria_string_builder_append(p->builder, has_next ? ",\n" : "\n");
+   return 0;
+}
+
+static int
+art_to_compact_json_string_cb(void* param, char* key, struct value* value)
+{
+   struct to_string_param* p = (struct to_string_param*)param;
+   p->cnt++;
+   bool has_next = p->cnt < p->t->size;
+   pgvictoria_string_builder_clear(&p->key);
+   pgvictoria_string_builder_append_char(&p->key, '"');
+   pgvictoria_string_builder_append_escaped(&p->key, key);
+   pgvictoria_string_builder_append(&p->key, "\":");
+   pgvictoria_value_to_builder(value, FORMAT_JSON_COMPACT, p->key.str, p->indent, p->builder);
+   if (has_next)
+   {
+      pgvictoria_string_builder_append_char(p->builder, ',');
+   }
+   return 0;
+}
+
+static int
+art_to_text_string_cb(void* param, char* key, struct value* value)
+{
+   struct to_string_param* p = (struct to_string_param*)param;
+   char* tag = NULL;
+   p->cnt++;
+   bool has_next = p->cnt < p->t->size;
+   pgvictoria_string_builder_clear(&p->key);
+   pgvictoria_string_builder_append(&p->key, key);
+   pgvictoria_string_builder_append_char(&p->key, ':');
+   if (value->type == ValueJSON && ((struct json*)value->data)->type != JSONUnknown)
+   {
+      pgvictoria_string_builder_append_char(&p->key, '\n');
+   }
+   else
+   {
+      pgvictoria_string_builder_append_char(&p->key, ' ');
+   }
+   tag = p->key.str;
+   if (pgvictoria_compare_string(p->tag, BULLET_POINT))
+   {
+      if (p->cnt == 1)
+      {
+         if (value->type != ValueJSON || ((struct json*)value->data)->type == JSONUnknown)
+         {
+            pgvictoria_value_to_builder(value, FORMAT_TEXT, tag, 0, p->builder);
+         }
+         else
+         {
+            pgvictoria_string_builder_indent(p->builder, tag, 0);
+            pgvictoria_value_to_builder(value, FORMAT_TEXT, NULL, p->indent + INDENT_PER_LEVEL, p->builder);
+         }
+      }
+      else
+      {
+         pgvictoria_value_to_builder(value, FORMAT_TEXT, tag, p->indent + INDENT_PER_LEVEL, p->builder);
+      }
+   }
+   else
+   {
+      pgvictoria_value_to_builder(value, FORMAT_TEXT, tag, p->indent, p->builder);
+   }
+   if (has_next)
+   {
+      pgvictoria_string_builder_append_char(p->builder, '\n');
+   }
+   return 0;
+}
+
+static int
+to_json_string(struct art* t, char* tag, int indent, struct string_builder* builder)
+{
+   pgvictoria_string_builder_indent(builder, tag, indent);
    if (t == NULL || t->size == 0)
    {
-      ret = pgvictoria_append(ret, "");
-      return ret;
+      return pgvictoria_string_builder_append(builder, "{}");
+   }
+   pgvictoria_string_builder_append(builder, "{\n");
+   // the keys are built in one buffer that is reused
+   struct to_string_param param = {
+      .indent = indent + INDENT_PER_LEVEL,
+      .builder = builder,
+      .t = t,
+      .cnt = 0,
+   };
+   pgvictoria_string_builder_init(&param.key);
+   art_iterate(t, art_to_json_string_cb, &param);
+   pgvictoria_string_builder_destroy(&param.key);
+   pgvictoria_string_builder_indent(builder, NULL, indent);
+   return pgvictoria_string_builder_append(builder, "}");
+}
+
+static int
+to_compact_json_string(struct art* t, char* tag, int indent, struct string_builder* builder)
+{
+   pgvictoria_string_builder_indent(builder, tag, indent);
+   if (t == NULL || t->size == 0)
+   {
+      return pgvictoria_string_builder_append(builder, "{}");
+   }
+   pgvictoria_string_builder_append_char(builder, '{');
+   struct to_string_param param = {
+      .indent = indent,
+      .builder = builder,
+      .t = t,
+      .cnt = 0,
+   };
+   pgvictoria_string_builder_init(&param.key);
+   art_iterate(t, art_to_compact_json_string_cb, &param);
+   pgvictoria_string_builder_destroy(&param.key);
+   return pgvictoria_string_builder_append_char(builder, '}');
+}
+
+static int
+to_text_string(struct art* t, char* tag, int indent, struct string_builder* builder)
+{
+   int next_indent = indent;
+   if (tag != NULL && !pgvictoria_compare_string(tag, BULLET_POINT))
+   {
+      pgvictoria_string_builder_indent(builder, tag, indent);
+      next_indent += INDENT_PER_LEVEL;
+   }
+   if (t == NULL || t->size == 0)
+   {
+      return builder->error ? 1 : 0;
    }
    struct to_string_param param = {
       .indent = next_indent,
-      .str = ret,
+      .builder = builder,
       .t = t,
       .cnt = 0,
       .tag = tag};
+   pgvictoria_string_builder_init(&param.key);
    art_iterate(t, art_to_text_string_cb, &param);
-   ret = param.str;
-   return ret;
+   pgvictoria_string_builder_destroy(&param.key);
+   return builder->error ? 1 : 0;
 }
 
 static int
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <collector.h>
+#include <logging.h>
+#include <prometheus.h>
+#include <ring.h>
+
+/* system */
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+static struct ring* ring = NULL;
+static volatile sig_atomic_t collector_stop = 0;
+
+static void collector_shutdown_cb(int signum);
+static void collector_sleep(int seconds, pid_t parent);
+
+int
+pgvictoria_collector_init(int number_of_collectors)
+{
+   if (number_of_collectors <= 0 || number_of_collectors > MAX_NUMBER_OF_COLLECTORS)
+   {
+      return 1;
+   }
+
+   return pgvictoria_ring_create((size_t)number_of_collectors * COLLECTOR_RING_SIZE, &ring);
+}
+
+void
+pgvictoria_collector_run(int collector, int number_of_collectors, int notify_fd)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct sigaction sa;
+   sigset_t mask;
+   pid_t parent;
+   time_t start;
+   int interval;
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = collector_shutdown_cb;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGTERM, &sa, NULL);
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGQUIT, &sa, NULL);
+
+   sa.sa_handler = SIG_DFL;
+   sigaction(SIGCHLD, &sa, NULL);
+
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGTERM);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGQUIT);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+   parent = getppid();
+
+   pgvictoria_log_debug("Collector %d started (%d)", collector, getpid());
+
+   while (!collector_stop && getppid() == parent)
+   {
+      start = time(NULL);
+
+      for (int i = pgvictoria_collector_next(collector, number_of_collectors, config->common.number_of_servers, -1);
+           !collector_stop && i != -1;
+           i = pgvictoria_collector_next(collector, number_of_collectors, config->common.number_of_servers, i))
+      {
+         struct collector_result result;
+         char* drift = NULL;
+
+         pgvictoria_prometheus_collect(i, &result, &drift);
+
+         if (pgvictoria_collector_publish(&result, drift) == 0)
+         {
+            if (write(notify_fd, "c", 1) == -1)
+            {
+               /* A full pipe already has a wake-up pending */
+               errno = 0;
+            }
+         }
+
+         free(drift);
+      }
+
+      interval = pgvictoria_collector_delay(config->collection_interval, start, time(NULL));
+      collector_sleep(interval, parent);
+   }
+
+   pgvictoria_log_debug("Collector %d stopped (%d)", collector, getpid());
+
+   exit(0);
+}
+
+int
+pgvictoria_collector_count(int collectors, int number_of_servers)
+{
+   int n = MIN(collectors, MAX_NUMBER_OF_COLLECTORS);
+
+   /* A collector without a server would only sleep */
+   n = MIN(n, number_of_servers);
+
+   return MAX(n, 1);
+}
+
+int
+pgvictoria_collector_next(int collector, int number_of_collectors, int number_of_servers, int server)
+{
+   int next;
+
+   if (collector < 0 || number_of_collectors <= 0 || collector >= number_of_collectors)
+   {
+      return -1;
+   }
+
+   /* Each collector owns every number_of_collectors'th server */
+   next = server < 0 ? collector : server + number_of_collectors;
+
+   return next < number_of_servers ? next : -1;
+}
+
+int
+pgvictoria_collector_delay(int interval, time_t start, time_t now)
+{
+   time_t elapsed = now - start;
+
+   /* A clock set back must not stretch the interval */
+   if (elapsed < 0)
+   {
+      return interval;
+   }
+   if (elapsed >= interval)
+   {
+      return 0;
+   }
+
+   return interval - (int)elapsed;
+}
+
+int
+pgvictoria_collector_publish(struct collector_result* result, char* drift)
+{
+   struct collector_result r;
+   struct iovec iov[2];
+   size_t max;
+   int ret;
+
+   if (ring == NULL)
+   {
+      return 1;
+   }
+
+   memcpy(&r, result, sizeof(struct collector_result));
+   if (drift == NULL)
+   {
+      r.drift_length = 0;
+   }
+
+   /* Cut an oversized drift at a sample boundary */
+   max = pgvictoria_ring_max_length(ring) - sizeof(struct collector_result);
+   if (r.drift_length > max)
+   {
+      r.drift_length = max;
+      while (r.drift_length > 0 && drift[r.drift_length - 1] != '\n')
+      {
+         r.drift_length--;
+      }
+   }
+
+   iov[0].iov_base = &r;
+   iov[0].iov_len = sizeof(struct collector_result);
+   iov[1].iov_base = drift;
+   iov[1].iov_len = r.drift_length;
+
+   /* main drains on every wake-up, so wait for room rather than drop the result */
+   while ((ret = pgvictoria_ring_pushv(ring, &iov[0], 2)) == RING_FULL)
+   {
+      if (collector_stop)
+      {
+         return 1;
+      }
+
+      SLEEP(1000000L);
+   }
+
+   return ret == RING_OK ? 0 : 1;
+}
+
+int
+pgvictoria_collector_consume(struct collector_result* result, char** drift)
+{
+   char* record = NULL;
+   size_t length;
+
+   *drift = NULL;
+
+   if (ring == NULL || pgvictoria_ring_peek(ring, &length) != RING_OK)
+   {
+      return COLLECTOR_EMPTY;
+   }
+
+   record = (char*)malloc(length + 1);
+   if (record == NULL)
+   {
+      return COLLECTOR_ERROR;
+   }
+
+   if (pgvictoria_ring_pop(ring, record, length, &length) != RING_OK)
+   {
+      free(record);
+      return COLLECTOR_ERROR;
+   }
+
+   if (length < sizeof(struct collector_result))
+   {
+      pgvictoria_log_warn("Collector: dropped a record of %zu bytes", length);
+      free(record);
+      return COLLECTOR_DROPPED;
+   }
+
+   memcpy(result, record, sizeof(struct collector_result));
+
+   /* The drift has to fit in what was popped */
+   if (result->drift_length > length - sizeof(struct collector_result))
+   {
+      pgvictoria_log_warn("Collector: dropped a result with a drift of %zu bytes in a %zu byte record",
+                          result->drift_length, length);
+      free(record);
+      return COLLECTOR_DROPPED;
+   }
+
+   if (result->drift_length > 0)
+   {
+      /* The record buffer is reused for the drift samples */
+      memmove(record, record + sizeof(struct collector_result), result->drift_length);
+      record[result->drift_length] = '\0';
+      *drift = record;
+   }
+   else
+   {
+      free(record);
+   }
+
+   return COLLECTOR_OK;
+}
+
+void
+pgvictoria_collector_destroy(void)
+{
+   pgvictoria_ring_destroy(ring);
+   ring = NULL;
+}
+
+static void
+collector_shutdown_cb(int signum)
+{
+   (void)signum;
+
+   collector_stop = 1;
+}
+
+static void
+collector_sleep(int seconds, pid_t parent)
+{
+   /* Sleep in short steps so a shutdown or an orphaned collector is noticed */
+   for (int i = 0; i < seconds && !collector_stop && getppid() == parent; i++)
+   {
+      sleep(1);
+   }
+}
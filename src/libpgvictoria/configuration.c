@@ -31,6 +31,7 @@
 #include <aes.h>
 #include <configuration.h>
 #include <logging.h>
+#include <registry.h>
 #include <security.h>
 #include <shmem.h>
 #include <utils.h>
@@ -67,7 +68,6 @@ static int as_bytes(char* str, int* bytes, int default_bytes);
 
 static bool transfer_configuration(struct main_configuration* config, struct main_configuration* reload);
 static int copy_server(struct server* dst, struct server* src);
-static void copy_user(struct user* dst, struct user* src);
 static int restart_int(char* name, int e, int n);
 static int restart_string(char* name, char* e, char* n);
 
@@ -92,15 +92,34 @@ pgvictoria_init_main_configuration(void* shm)
    config->backlog = 16;
    config->hugepage = HUGEPAGE_TRY;
 
+   config->metrics = 0;
+   config->collection_interval = 300;
+   config->collectors = 4;
+
    config->update_process_title = UPDATE_PROCESS_TITLE_VERBOSE;
 
    config->common.log_type = PGVICTORIA_LOGGING_TYPE_CONSOLE;
    config->common.log_level = PGVICTORIA_LOGGING_LEVEL_INFO;
    config->common.log_mode = PGVICTORIA_LOGGING_MODE_APPEND;
    atomic_init(&config->common.log_lock, STATE_FREE);
+   atomic_init(&config->common.log_reopen, false);
+   atomic_init(&config->common.log_dropped, 0);
+   atomic_init(&config->common.log_waiting, false);
+
+   for (int i = 0; i < NUMBER_OF_TRACE_SUBSYSTEMS; i++)
+   {
+      config->common.trace[i].sample = 0;
+      config->common.trace[i].rate = 100;
+   }
+   config->common.trace_payload = 64;
 
    free(home_dir);
 
+   if (pgvictoria_registry_create(&config->common, NUMBER_OF_SERVERS, NUMBER_OF_USERS))
+   {
+      return 1;
+   }
+
    return 0;
 }
 
@@ -164,13 +183,10 @@ pgvictoria_read_main_configuration(void* shm, char* filename)
                memcpy(&section, trimmed_line + 1, max);
                if (strcmp(section, "pgvictoria"))
                {
-                  if (idx_server > 0 && idx_server <= NUMBER_OF_SERVERS)
-                  {
-                     memcpy(&(config->common.servers[idx_server - 1]), &srv, sizeof(struct server));
-                  }
-                  else if (idx_server > NUMBER_OF_SERVERS)
+                  if (idx_server > 0 && pgvictoria_registry_add_server(&config->common, &srv, NULL))
                   {
-                     warnx("Maximum number of servers exceeded");
+                     warnx("Unable to add server %s", srv.name);
+                     goto error;
                   }
 
                   memset(&srv, 0, sizeof(struct server));
@@ -429,6 +445,118 @@ pgvictoria_read_main_configuration(void* shm, char* filename)
                      unknown = true;
                   }
                }
+               else if (!strcmp(key, "metrics"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->metrics))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "collection_interval"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_seconds(value, &config->collection_interval, 300))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "collectors"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->collectors))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "trace_protocol_sample"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->common.trace[TRACE_PROTOCOL].sample))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "trace_protocol_rate"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->common.trace[TRACE_PROTOCOL].rate))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "trace_security_sample"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->common.trace[TRACE_SECURITY].sample))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "trace_security_rate"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->common.trace[TRACE_SECURITY].rate))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
+               else if (!strcmp(key, "trace_payload"))
+               {
+                  if (!strcmp(section, "pgvictoria"))
+                  {
+                     if (as_int(value, &config->common.trace_payload))
+                     {
+                        unknown = true;
+                     }
+                  }
+                  else
+                  {
+                     unknown = true;
+                  }
+               }
                else
                {
                   unknown = true;
@@ -459,13 +587,12 @@ pgvictoria_read_main_configuration(void* shm, char* filename)
       trimmed_line = NULL;
    }
 
-   if (strlen(srv.name) > 0)
+   if (strlen(srv.name) > 0 && pgvictoria_registry_add_server(&config->common, &srv, NULL))
    {
-      memcpy(&(config->common.servers[idx_server - 1]), &srv, sizeof(struct server));
+      warnx("Unable to add server %s", srv.name);
+      goto error;
    }
 
-   config->common.number_of_servers = idx_server;
-
    fclose(file);
 
    return 0;
@@ -489,6 +616,7 @@ int
 pgvictoria_validate_main_configuration(void* shm)
 {
    struct stat st;
+   int j;
    struct main_configuration* config;
 
    config = (struct main_configuration*)shm;
@@ -520,6 +648,45 @@ pgvictoria_validate_main_configuration(void* shm)
       config->backlog = 16;
    }
 
+   if (config->metrics < 0 || config->metrics > 65535)
+   {
+      pgvictoria_log_fatal("metrics must be between 0 and 65535 (%d)", config->metrics);
+      return 1;
+   }
+
+   if (config->collection_interval <= 0)
+   {
+      pgvictoria_log_fatal("collection_interval must be positive (%d)", config->collection_interval);
+      return 1;
+   }
+
+   if (config->collectors < 1 || config->collectors > MAX_NUMBER_OF_COLLECTORS)
+   {
+      pgvictoria_log_fatal("collectors must be between 1 and %d (%d)", MAX_NUMBER_OF_COLLECTORS, config->collectors);
+      return 1;
+   }
+
+   for (int i = 0; i < NUMBER_OF_TRACE_SUBSYSTEMS; i++)
+   {
+      if (config->common.trace[i].sample < 0 || config->common.trace[i].sample > 100)
+      {
+         pgvictoria_log_fatal("trace_%s_sample must be between 0 and 100 (%d)", i == TRACE_PROTOCOL ? "protocol" : "security", config->common.trace[i].sample);
+         return 1;
+      }
+
+      if (config->common.trace[i].rate < 0)
+      {
+         pgvictoria_log_fatal("trace_%s_rate must not be negative (%d)", i == TRACE_PROTOCOL ? "protocol" : "security", config->common.trace[i].rate);
+         return 1;
+      }
+   }
+
+   if (config->common.trace_payload < 0 || config->common.trace_payload > MAX_COMMENT)
+   {
+      pgvictoria_log_fatal("trace_payload must be between 0 and %d (%d)", MAX_COMMENT, config->common.trace_payload);
+      return 1;
+   }
+
    if (config->common.number_of_servers <= 0)
    {
       pgvictoria_log_fatal("No servers defined");
@@ -557,6 +724,19 @@ pgvictoria_validate_main_configuration(void* shm)
          pgvictoria_log_fatal("No user defined for %s", config->common.servers[i].name);
          return 1;
       }
+
+      if (pgvictoria_registry_find_server(&config->common, config->common.servers[i].name) != i)
+      {
+         pgvictoria_log_fatal("Duplicate server %s", config->common.servers[i].name);
+         return 1;
+      }
+
+      j = pgvictoria_registry_find_endpoint(&config->common, config->common.servers[i].host, config->common.servers[i].port);
+      if (j != i)
+      {
+         pgvictoria_log_warn("%s and %s use the same host and port (%s:%d)", config->common.servers[j].name,
+                             config->common.servers[i].name, config->common.servers[i].host, config->common.servers[i].port);
+      }
    }
 
    return 0;
@@ -571,7 +751,8 @@ pgvictoria_read_users_configuration(void* shm, char* filename)
    FILE* file;
    char line[LINE_LENGTH];
    char* trimmed_line = NULL;
-   int index;
+   struct user usr;
+   int ret;
    char* master_key = NULL;
    char* username = NULL;
    char* password = NULL;
@@ -591,7 +772,6 @@ pgvictoria_read_users_configuration(void* shm, char* filename)
       goto masterkey;
    }
 
-   index = 0;
    config = (struct main_configuration*)shm;
 
    while (fgets(line, sizeof(line), file))
@@ -636,8 +816,17 @@ pgvictoria_read_users_configuration(void* shm, char* filename)
          if (strlen(username) < MAX_USERNAME_LENGTH &&
              strlen(password) < MAX_PASSWORD_LENGTH)
          {
-            memcpy(&config->common.users[index].username, username, strlen(username));
-            memcpy(&config->common.users[index].password, password, strlen(password));
+            memset(&usr, 0, sizeof(struct user));
+            memcpy(&usr.username, username, strlen(username));
+            memcpy(&usr.password, password, strlen(password));
+
+            ret = pgvictoria_registry_add_user(&config->common, &usr, NULL);
+            pgvictoria_cleanse(&usr.password, sizeof(usr.password));
+
+            if (ret)
+            {
+               goto error;
+            }
          }
          else
          {
@@ -650,20 +839,11 @@ pgvictoria_read_users_configuration(void* shm, char* filename)
 
          password = NULL;
          decoded = NULL;
-
-         index++;
       }
       free(trimmed_line);
       trimmed_line = NULL;
    }
 
-   config->common.number_of_users = index;
-
-   if (config->common.number_of_users > NUMBER_OF_USERS)
-   {
-      goto above;
-   }
-
    free(master_key);
 
    fclose(file);
@@ -697,19 +877,6 @@ masterkey:
    }
 
    return 2;
-
-above:
-
-   free(master_key);
-   free(password);
-   free(decoded);
-
-   if (file)
-   {
-      fclose(file);
-   }
-
-   return 3;
 }
 
 /**
@@ -730,17 +897,7 @@ pgvictoria_validate_users_configuration(void* shm)
 
    for (int i = 0; i < config->common.number_of_servers; i++)
    {
-      bool found = false;
-
-      for (int j = 0; !found && j < config->common.number_of_users; j++)
-      {
-         if (!strcmp(config->common.servers[i].username, config->common.users[j].username))
-         {
-            found = true;
-         }
-      }
-
-      if (!found)
+      if (pgvictoria_registry_find_user(&config->common, config->common.servers[i].username) == -1)
       {
          pgvictoria_log_fatal("Unknown user (\'%s\') defined for %s", config->common.servers[i].username, config->common.servers[i].name);
          return 1;
@@ -771,7 +928,10 @@ pgvictoria_reload_configuration(bool* restart)
       goto error;
    }
 
-   pgvictoria_init_main_configuration((void*)reload);
+   if (pgvictoria_init_main_configuration((void*)reload))
+   {
+      goto error;
+   }
 
    if (pgvictoria_read_main_configuration((void*)reload, config->common.configuration_path))
    {
@@ -795,6 +955,7 @@ pgvictoria_reload_configuration(bool* restart)
 
    *restart = transfer_configuration(config, reload);
 
+   pgvictoria_registry_destroy(&reload->common);
    pgvictoria_destroy_shared_memory((void*)reload, reload_size);
 
    pgvictoria_log_debug("Reload: Success");
@@ -806,6 +967,7 @@ error:
 
    if (reload != NULL)
    {
+      pgvictoria_registry_destroy(&reload->common);
       pgvictoria_destroy_shared_memory((void*)reload, reload_size);
    }
 
@@ -1554,8 +1716,19 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
    {
       changed = true;
    }
+   if (restart_int("metrics", config->metrics, reload->metrics))
+   {
+      changed = true;
+   }
+   config->collection_interval = reload->collection_interval;
+   memcpy(&config->common.trace[0], &reload->common.trace[0], sizeof(config->common.trace));
+   config->common.trace_payload = reload->common.trace_payload;
+   if (restart_int("collectors", config->collectors, reload->collectors))
+   {
+      changed = true;
+   }
 
-   for (int i = 0; i < NUMBER_OF_SERVERS; i++)
+   for (int i = 0; i < MIN(config->common.number_of_servers, reload->common.number_of_servers); i++)
    {
       if (copy_server(&config->common.servers[i], &reload->common.servers[i]))
       {
@@ -1567,11 +1740,20 @@ transfer_configuration(struct main_configuration* config, struct main_configurat
       changed = true;
    }
 
-   for (int i = 0; i < NUMBER_OF_USERS; i++)
+   /* Growing the registry would move it away from the forked processes */
+   if (reload->common.number_of_users > config->common.registry->user_capacity)
    {
-      copy_user(&config->common.users[i], &reload->common.users[i]);
+      restart_int("number_of_users", config->common.number_of_users, reload->common.number_of_users);
+      changed = true;
+   }
+   else
+   {
+      pgvictoria_registry_clear_users(&config->common);
+      for (int i = 0; i < reload->common.number_of_users; i++)
+      {
+         pgvictoria_registry_add_user(&config->common, &reload->common.users[i], NULL);
+      }
    }
-   config->common.number_of_users = reload->common.number_of_users;
 
    return changed;
 }
@@ -1606,13 +1788,6 @@ copy_server(struct server* dst, struct server* src)
    return 0;
 }
 
-static void
-copy_user(struct user* dst, struct user* src)
-{
-   memcpy(&dst->username[0], &src->username[0], MAX_USERNAME_LENGTH);
-   memcpy(&dst->password[0], &src->password[0], MAX_PASSWORD_LENGTH);
-}
-
 static int
 restart_int(char* name, int e, int n)
 {
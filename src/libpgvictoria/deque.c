@@ -29,22 +29,61 @@
 #include <pgvictoria.h>
 #include <deque.h>
 #include <logging.h>
+#include <memory.h>
 #include <utils.h>
 
 #include <stdlib.h>
 #include <string.h>
 
 // tag is copied if not NULL
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config);
 
 // tag is copied if not NULL
-static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node);
+static int
+deque_entry_init(struct deque* deque, struct deque_entry* entry, uintptr_t data, enum value_type type, char* tag, struct value_config* config);
 
 // tag will always be freed
 static void
-deque_node_destroy(struct deque_node* node);
+deque_entry_destroy(struct deque* deque, struct deque_entry* entry);
+
+// release an entry that was never added, the data stays with the caller
+static void
+deque_entry_discard(struct deque* deque, struct deque_entry* entry, enum value_type type, struct value_config* config);
+
+// hand the data and tag of an entry that is being removed over to the caller
+static uintptr_t
+deque_entry_take(struct deque* deque, struct deque_entry* entry, char** tag);
+
+// the free entry at the tail, the caller fills it and counts it
+static struct deque_entry*
+deque_tail(struct deque* deque);
+
+static struct deque_block*
+deque_block_create(struct deque* deque, uint32_t capacity);
+
+// unlink an empty block, the only block of a deque is kept for reuse
+static void
+deque_block_release(struct deque* deque, struct deque_block* block);
+
+// release the data of the values when the arena of the deque is released
+static void
+deque_arena_cleanup(void* data);
+
+// claim the slot for the next add, NULL if the queue is full
+static struct deque_slot*
+deque_ring_claim(struct deque_ring* ring, uint64_t* position);
+
+// move the entry at the head of the queue out, false if the queue is empty
+static bool
+deque_ring_pop(struct deque_ring* ring, struct deque_entry* entry);
+
+static uint32_t
+deque_ring_size(struct deque_ring* ring);
+
+// move the queued entries of a concurrent deque to its blocks
+static void
+deque_settle(struct deque* deque);
 
 static void
 deque_read_lock(struct deque* deque);
@@ -55,62 +94,134 @@ deque_write_lock(struct deque* deque);
 static void
 deque_unlock(struct deque* deque);
 
-static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node);
+// move to the next entry, a NULL block is the position before the first entry
+static bool
+deque_next(struct deque* deque, struct deque_block** block, int32_t* index);
 
-static struct deque_node*
+static struct deque_entry*
 deque_find(struct deque* deque, char* tag);
 
-static char*
-to_json_string(struct deque* deque, char* tag, int indent);
+static int
+to_json_string(struct deque* deque, char* tag, int indent, struct string_builder* builder);
+
+static int
+to_compact_json_string(struct deque* deque, char* tag, int indent, struct string_builder* builder);
+
+static int
+to_text_string(struct deque* deque, char* tag, int indent, struct string_builder* builder);
+
+// stable merge sort of the entries, the result is left in entries
+static void
+deque_sort(struct deque_entry* entries, struct deque_entry* buffer, uint32_t size, deque_compare_cb compare);
 
-static char*
-to_compact_json_string(struct deque* deque, char* tag, int indent);
+// the position a new entry is inserted at to keep the deque sorted
+static void
+deque_sorted_position(struct deque* deque, struct deque_entry* entry, deque_compare_cb compare, struct deque_block** block, uint32_t* position);
 
-static char*
-to_text_string(struct deque* deque, char* tag, int indent);
+// make room for an entry at a position, the block may be split
+static struct deque_entry*
+deque_insert(struct deque* deque, struct deque_block* block, uint32_t position);
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node);
+// forget the entries without destroying them, they have been moved elsewhere
+static void
+deque_forget(struct deque* deque);
 
-static struct deque_node*
-get_middle(struct deque_node* node);
+// point the inline strings of entries copied bytewise at their new place
+static void
+deque_relocate(struct deque_entry* entries, uint32_t number);
 
-static struct deque_node*
-deque_sort(struct deque_node* node);
+// restore the heap of merge sources from a position down
+static void
+deque_merge_sift(struct deque_iterator** sources, int* heap, int size, int position, deque_compare_cb compare);
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2);
+static int
+deque_merge_compare(struct deque_iterator** sources, int a, int b, deque_compare_cb compare);
 
 static int
 tag_compare(char* tag1, char* tag2);
 
+static int
+entry_tag_compare(struct deque_entry* e1, struct deque_entry* e2);
+
 int
 pgvictoria_deque_create(bool thread_safe, struct deque** deque)
+{
+   return pgvictoria_deque_create_arena(NULL, thread_safe, deque);
+}
+
+int
+pgvictoria_deque_create_arena(struct memory_arena* arena, bool thread_safe, struct deque** deque)
 {
    struct deque* q = NULL;
-   q = malloc(sizeof(struct deque));
+   if (arena != NULL)
+   {
+      q = pgvictoria_memory_arena_alloc(arena, sizeof(struct deque));
+   }
+   else
+   {
+      q = malloc(sizeof(struct deque));
+   }
+   if (q == NULL)
+   {
+      return 1;
+   }
    q->size = 0;
    q->thread_safe = thread_safe;
+   q->owns_data = false;
+   q->arena = arena;
+   q->ring = NULL;
    if (thread_safe)
    {
       pthread_rwlock_init(&q->mutex, NULL);
    }
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->start);
-   deque_node_create(0, ValueInt32, NULL, NULL, &q->end);
-   q->start->next = q->end;
-   q->end->prev = q->start;
+   // blocks are created on the first add
+   q->start = NULL;
+   q->end = NULL;
    *deque = q;
    return 0;
 }
 
 int
-pgvictoria_deque_add(struct deque* deque, char* tag, uintptr_t data, enum value_type type)
+pgvictoria_deque_create_concurrent(uint32_t capacity, struct deque** deque)
 {
-   deque_offer(deque, tag, data, type, NULL);
+   struct deque* q = NULL;
+   struct deque_ring* ring = NULL;
+   uint64_t slots = 2;
+
+   while (slots < capacity)
+   {
+      slots *= 2;
+   }
+   ring = aligned_alloc(64, sizeof(struct deque_ring) + slots * sizeof(struct deque_slot));
+   if (ring == NULL)
+   {
+      return 1;
+   }
+   ring->mask = slots - 1;
+   atomic_init(&ring->enqueue, 0);
+   atomic_init(&ring->dequeue, 0);
+   atomic_init(&ring->settled, false);
+   for (uint64_t i = 0; i < slots; i++)
+   {
+      atomic_init(&ring->slots[i].sequence, i);
+   }
+
+   if (pgvictoria_deque_create(true, &q))
+   {
+      free(ring);
+      return 1;
+   }
+   q->ring = ring;
+   *deque = q;
    return 0;
 }
 
+int
+pgvictoria_deque_add(struct deque* deque, char* tag, uintptr_t data, enum value_type type)
+{
+   return deque_offer(deque, tag, data, type, NULL);
+}
+
 int
 pgvictoria_deque_remove(struct deque* deque, char* tag)
 {
@@ -136,94 +247,115 @@ pgvictoria_deque_remove(struct deque* deque, char* tag)
 int
 pgvictoria_deque_clear(struct deque* deque)
 {
-   struct deque_iterator* iter = NULL;
+   struct deque_block* block = NULL;
+   struct deque_block* next = NULL;
    if (deque == NULL)
    {
       return 0;
    }
-   pgvictoria_deque_iterator_create(deque, &iter);
-   while (pgvictoria_deque_iterator_next(iter))
+   deque_settle(deque);
+   deque_write_lock(deque);
+   block = deque->start;
+   while (block != NULL)
+   {
+      next = block->next;
+      for (uint32_t i = block->first; i < block->last; i++)
+      {
+         deque_entry_destroy(deque, &block->entries[i]);
+      }
+      if (deque->arena == NULL)
+      {
+         free(block);
+      }
+      block = next;
+   }
+   deque->start = NULL;
+   deque->end = NULL;
+   deque->size = 0;
+   if (deque->ring != NULL)
    {
-      pgvictoria_deque_iterator_remove(iter);
+      atomic_store(&deque->ring->settled, false);
    }
-   pgvictoria_deque_iterator_destroy(iter);
+   deque_unlock(deque);
    return 0;
 }
 
 int
 pgvictoria_deque_add_with_config(struct deque* deque, char* tag, uintptr_t data, struct value_config* config)
 {
-   deque_offer(deque, tag, data, ValueRef, config);
-   return 0;
+   return deque_offer(deque, tag, data, ValueRef, config);
 }
 
 uintptr_t
 pgvictoria_deque_poll(struct deque* deque, char** tag)
 {
-   struct deque_node* head = NULL;
-   struct value* val = NULL;
+   struct deque_block* head = NULL;
+   struct deque_entry entry;
    uintptr_t data = 0;
-   if (deque == NULL || pgvictoria_deque_size(deque) == 0)
+   if (deque == NULL)
+   {
+      return 0;
+   }
+   if (deque->ring != NULL && !atomic_load(&deque->ring->settled))
+   {
+      // lock-free unless entries have been moved to the blocks
+      goto ring;
+   }
+   if (pgvictoria_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_write_lock(deque);
-   head = deque->start->next;
+   head = deque->start;
    // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   if (head == NULL || head->first == head->last)
    {
+      if (deque->ring != NULL)
+      {
+         atomic_store(&deque->ring->settled, false);
+         deque_unlock(deque);
+         goto ring;
+      }
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->start->next = head->next;
-   head->next->prev = deque->start;
+   data = deque_entry_take(deque, &head->entries[head->first], tag);
+   head->first++;
    deque->size--;
-   val = head->data;
-   if (tag != NULL)
-   {
-      *tag = head->tag;
-   }
-   free(head);
-
-   data = pgvictoria_value_data(val);
-   free(val);
+   deque_block_release(deque, head);
 
    deque_unlock(deque);
    return data;
+
+ring:
+   if (!deque_ring_pop(deque->ring, &entry))
+   {
+      return 0;
+   }
+   return deque_entry_take(deque, &entry, tag);
 }
 
 uintptr_t
 pgvictoria_deque_poll_last(struct deque* deque, char** tag)
 {
-   struct deque_node* tail = NULL;
-   struct value* val = NULL;
+   struct deque_block* tail = NULL;
    uintptr_t data = 0;
+   deque_settle(deque);
    if (deque == NULL || pgvictoria_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_write_lock(deque);
-   tail = deque->end->prev;
-   if (tail == deque->start)
+   tail = deque->end;
+   if (tail == NULL || tail->first == tail->last)
    {
       deque_unlock(deque);
       return 0;
    }
-   // remove node
-   deque->end->prev = tail->prev;
-   tail->prev->next = deque->end;
+   tail->last--;
+   data = deque_entry_take(deque, &tail->entries[tail->last], tag);
    deque->size--;
-
-   val = tail->data;
-   if (tag != NULL)
-   {
-      *tag = tail->tag;
-   }
-   free(tail);
-
-   data = pgvictoria_value_data(val);
-   free(val);
+   deque_block_release(deque, tail);
 
    deque_unlock(deque);
    return data;
@@ -232,72 +364,75 @@ pgvictoria_deque_poll_last(struct deque* deque, char** tag)
 uintptr_t
 pgvictoria_deque_peek(struct deque* deque, char** tag)
 {
-   struct deque_node* head = NULL;
-   struct value* val = NULL;
+   struct deque_block* head = NULL;
+   struct deque_entry* entry = NULL;
+   deque_settle(deque);
    if (deque == NULL || pgvictoria_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_read_lock(deque);
-   head = deque->start->next;
+   head = deque->start;
    // this should not happen when size is not 0, but just in case
-   if (head == deque->end)
+   if (head == NULL || head->first == head->last)
    {
       deque_unlock(deque);
       return 0;
    }
-   val = head->data;
+   entry = &head->entries[head->first];
    if (tag != NULL)
    {
-      *tag = head->tag;
+      *tag = entry->tag;
    }
    deque_unlock(deque);
-   return pgvictoria_value_data(val);
+   return pgvictoria_value_data(&entry->value);
 }
 
 uintptr_t
 pgvictoria_deque_peek_last(struct deque* deque, char** tag)
 {
-   struct deque_node* tail = NULL;
-   struct value* val = NULL;
+   struct deque_block* tail = NULL;
+   struct deque_entry* entry = NULL;
+   deque_settle(deque);
    if (deque == NULL || pgvictoria_deque_size(deque) == 0)
    {
       return 0;
    }
    deque_read_lock(deque);
-   tail = deque->end->prev;
+   tail = deque->end;
    // this should not happen when size is not 0, but just in case
-   if (tail == deque->start)
+   if (tail == NULL || tail->first == tail->last)
    {
       deque_unlock(deque);
       return 0;
    }
-   val = tail->data;
+   entry = &tail->entries[tail->last - 1];
    if (tag != NULL)
    {
-      *tag = tail->tag;
+      *tag = entry->tag;
    }
    deque_unlock(deque);
-   return pgvictoria_value_data(val);
+   return pgvictoria_value_data(&entry->value);
 }
 
 uintptr_t
 pgvictoria_deque_get(struct deque* deque, char* tag)
 {
-   struct deque_node* n = NULL;
+   struct deque_entry* e = NULL;
    uintptr_t ret = 0;
 
 #ifdef CORE_DEBUG
    pgvictoria_log_trace("pgvictoria_deque_get: %s", tag);
 #endif
 
+   deque_settle(deque);
    deque_read_lock(deque);
-   n = deque_find(deque, tag);
-   if (n == NULL)
+   e = deque_find(deque, tag);
+   if (e == NULL)
    {
       goto error;
    }
-   ret = pgvictoria_value_data(n->data);
+   ret = pgvictoria_value_data(&e->value);
    deque_unlock(deque);
    return ret;
 error:
@@ -309,12 +444,13 @@ bool
 pgvictoria_deque_exists(struct deque* deque, char* tag)
 {
    bool ret = false;
-   struct deque_node* n = NULL;
+   struct deque_entry* e = NULL;
 
+   deque_settle(deque);
    deque_read_lock(deque);
 
-   n = deque_find(deque, tag);
-   if (n != NULL)
+   e = deque_find(deque, tag);
+   if (e != NULL)
    {
       ret = true;
    }
@@ -345,52 +481,270 @@ pgvictoria_deque_list(struct deque* deque)
 void
 pgvictoria_deque_sort(struct deque* deque)
 {
+   pgvictoria_deque_sort_by(deque, entry_tag_compare);
+}
+
+void
+pgvictoria_deque_sort_by(struct deque* deque, deque_compare_cb compare)
+{
+   struct deque_entry* entries = NULL;
+   struct deque_entry* buffer = NULL;
+   struct deque_block* block = NULL;
+   struct deque_block* next = NULL;
+   uint32_t n = 0;
+
+   deque_settle(deque);
    deque_write_lock(deque);
-   if (deque == NULL || deque->start == NULL || deque->end == NULL || deque->size <= 1)
+   if (deque == NULL || deque->start == NULL || deque->size <= 1)
    {
       deque_unlock(deque);
       return;
    }
-   // break the connection to start and end node since we are going to move nodes around
-   struct deque_node* first = deque->start->next;
-   struct deque_node* last = deque->end->prev;
-   struct deque_node* node = NULL;
-   first->prev = NULL;
-   last->next = NULL;
-   deque->start->next = NULL;
-   deque->end->prev = NULL;
-   node = deque_sort(first);
-   deque->start->next = node;
-   node->prev = deque->start;
-   while (node->next != NULL)
-   {
-      node = node->next;
-   }
-   deque->end->prev = node;
-   node->next = deque->end;
+   entries = malloc(deque->size * sizeof(struct deque_entry));
+   buffer = malloc(deque->size * sizeof(struct deque_entry));
+   if (entries == NULL || buffer == NULL)
+   {
+      free(entries);
+      free(buffer);
+      deque_unlock(deque);
+      return;
+   }
+   for (block = deque->start; block != NULL; block = block->next)
+   {
+      memcpy(&entries[n], &block->entries[block->first], (block->last - block->first) * sizeof(struct deque_entry));
+      n += block->last - block->first;
+   }
+
+   deque_sort(entries, buffer, n, compare);
+
+   // pack the sorted entries into the blocks from the start, and drop the blocks left empty
+   n = 0;
+   block = deque->start;
+   while (block != NULL)
+   {
+      next = block->next;
+      if (n < deque->size)
+      {
+         block->first = 0;
+         block->last = deque->size - n < block->capacity ? deque->size - n : block->capacity;
+         memcpy(block->entries, &entries[n], block->last * sizeof(struct deque_entry));
+         deque_relocate(block->entries, block->last);
+         n += block->last;
+      }
+      else
+      {
+         block->first = 0;
+         block->last = 0;
+         deque_block_release(deque, block);
+      }
+      block = next;
+   }
+
+   free(entries);
+   free(buffer);
+   deque_unlock(deque);
+}
+
+int
+pgvictoria_deque_add_sorted(struct deque* deque, char* tag, uintptr_t data, enum value_type type, deque_compare_cb compare)
+{
+   struct deque_entry entry;
+   struct deque_entry* slot = NULL;
+   struct deque_block* block = NULL;
+   uint32_t position = 0;
+
+   if (deque == NULL || compare == NULL || type == ValueNone)
+   {
+      return 1;
+   }
+
+   deque_settle(deque);
+   deque_write_lock(deque);
+   if (deque_entry_init(deque, &entry, data, type, tag, NULL))
+   {
+      deque_unlock(deque);
+      return 1;
+   }
+
+   deque_sorted_position(deque, &entry, compare, &block, &position);
+   if (block == NULL)
+   {
+      slot = deque_tail(deque);
+      if (slot != NULL)
+      {
+         deque->end->last++;
+      }
+   }
+   else
+   {
+      slot = deque_insert(deque, block, position);
+   }
+   if (slot == NULL)
+   {
+      deque_entry_destroy(deque, &entry);
+      deque_unlock(deque);
+      return 1;
+   }
+   *slot = entry;
+   deque_relocate(slot, 1);
+   deque->size++;
+   if (deque->ring != NULL)
+   {
+      // poll has to look in the blocks from now on
+      atomic_store(&deque->ring->settled, true);
+   }
    deque_unlock(deque);
+   return 0;
+}
+
+int
+pgvictoria_deque_merge(struct deque** deques, int number, deque_compare_cb compare, struct deque** merged)
+{
+   struct deque* result = NULL;
+   struct deque_iterator** sources = NULL;
+   struct deque_entry* slot = NULL;
+   int* heap = NULL;
+   int size = 0;
+   int top;
+
+   if (deques == NULL || number < 0 || compare == NULL)
+   {
+      return 1;
+   }
+   for (int i = 0; i < number; i++)
+   {
+      if (deques[i] != NULL && deques[i]->arena != NULL)
+      {
+         // the entries would outlive their arena
+         return 1;
+      }
+      for (int j = 0; deques[i] != NULL && j < i; j++)
+      {
+         if (deques[j] == deques[i])
+         {
+            // a deque is locked once per source, so it would wait on itself
+            return 1;
+         }
+      }
+   }
+
+   sources = calloc(number + 1, sizeof(struct deque_iterator*));
+   heap = calloc(number + 1, sizeof(int));
+   if (sources == NULL || heap == NULL || pgvictoria_deque_create(false, &result))
+   {
+      goto error;
+   }
+
+   for (int i = 0; i < number; i++)
+   {
+      if (deques[i] == NULL || pgvictoria_deque_iterator_create(deques[i], &sources[i]))
+      {
+         continue;
+      }
+      deque_write_lock(deques[i]);
+      if (pgvictoria_deque_iterator_next(sources[i]))
+      {
+         heap[size++] = i;
+      }
+   }
+   for (int i = size / 2 - 1; i >= 0; i--)
+   {
+      deque_merge_sift(sources, heap, size, i, compare);
+   }
+
+   while (size > 0)
+   {
+      top = heap[0];
+      slot = deque_tail(result);
+      if (slot == NULL)
+      {
+         goto error;
+      }
+      *slot = sources[top]->block->entries[sources[top]->index];
+      deque_relocate(slot, 1);
+      result->end->last++;
+      result->size++;
+      if (!pgvictoria_deque_iterator_next(sources[top]))
+      {
+         heap[0] = heap[--size];
+      }
+      deque_merge_sift(sources, heap, size, 0, compare);
+   }
+
+   for (int i = 0; i < number; i++)
+   {
+      if (sources[i] != NULL)
+      {
+         deque_forget(deques[i]);
+         deque_unlock(deques[i]);
+         pgvictoria_deque_iterator_destroy(sources[i]);
+      }
+   }
+   free(sources);
+   free(heap);
+
+   *merged = result;
+   return 0;
+
+error:
+   // the deques still hold every entry, so result only lets go of its blocks
+   for (int i = 0; sources != NULL && i < number; i++)
+   {
+      if (sources[i] != NULL)
+      {
+         deque_unlock(deques[i]);
+         pgvictoria_deque_iterator_destroy(sources[i]);
+      }
+   }
+   free(sources);
+   free(heap);
+   if (result != NULL)
+   {
+      deque_forget(result);
+      free(result);
+   }
+   return 1;
 }
 
 void
 pgvictoria_deque_destroy(struct deque* deque)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* next = NULL;
+   struct deque_block* block = NULL;
+   struct deque_block* next = NULL;
    if (deque == NULL)
    {
       return;
    }
-   n = deque->start;
-   while (n != NULL)
-   {
-      next = n->next;
-      deque_node_destroy(n);
-      n = next;
-   }
    if (deque->thread_safe)
    {
       pthread_rwlock_destroy(&deque->mutex);
    }
+   if (deque->ring != NULL)
+   {
+      struct deque_entry entry;
+
+      while (deque_ring_pop(deque->ring, &entry))
+      {
+         deque_entry_destroy(deque, &entry);
+      }
+      free(deque->ring);
+   }
+   if (deque->arena != NULL)
+   {
+      // the blocks and the data go with the arena
+      return;
+   }
+   block = deque->start;
+   while (block != NULL)
+   {
+      next = block->next;
+      for (uint32_t i = block->first; i < block->last; i++)
+      {
+         deque_entry_destroy(deque, &block->entries[i]);
+      }
+      free(block);
+      block = next;
+   }
    free(deque);
 }
 
@@ -408,19 +762,30 @@ pgvictoria_deque_set_thread_safe(struct deque* deque)
 char*
 pgvictoria_deque_to_string(struct deque* deque, int32_t format, char* tag, int indent)
 {
+   struct string_builder builder;
+
+   pgvictoria_string_builder_init(&builder);
+   pgvictoria_deque_to_builder(deque, format, tag, indent, &builder);
+   return pgvictoria_string_builder_finish(&builder);
+}
+
+int
+pgvictoria_deque_to_builder(struct deque* deque, int32_t format, char* tag, int indent, struct string_builder* builder)
+{
+   deque_settle(deque);
    if (format == FORMAT_JSON)
    {
-      return to_json_string(deque, tag, indent);
+      return to_json_string(deque, tag, indent, builder);
    }
    else if (format == FORMAT_TEXT)
    {
-      return to_text_string(deque, tag, indent);
+      return to_text_string(deque, tag, indent, builder);
    }
    else if (format == FORMAT_JSON_COMPACT)
    {
-      return to_compact_json_string(deque, tag, indent);
+      return to_compact_json_string(deque, tag, indent, builder);
    }
-   return NULL;
+   return 0;
 }
 
 uint32_t
@@ -434,6 +799,10 @@ pgvictoria_deque_size(struct deque* deque)
    deque_read_lock(deque);
    size = deque->size;
    deque_unlock(deque);
+   if (deque->ring != NULL)
+   {
+      size += deque_ring_size(deque->ring);
+   }
    return size;
 }
 
@@ -445,9 +814,15 @@ pgvictoria_deque_iterator_create(struct deque* deque, struct deque_iterator** it
    {
       return 1;
    }
+   deque_settle(deque);
    i = malloc(sizeof(struct deque_iterator));
+   if (i == NULL)
+   {
+      return 1;
+   }
    i->deque = deque;
-   i->cur = deque->start;
+   i->block = NULL;
+   i->index = -1;
    i->tag = NULL;
    i->value = NULL;
    *iter = i;
@@ -457,20 +832,49 @@ pgvictoria_deque_iterator_create(struct deque* deque, struct deque_iterator** it
 void
 pgvictoria_deque_iterator_remove(struct deque_iterator* iter)
 {
-   if (iter == NULL || iter->cur == NULL || iter->deque == NULL ||
-       iter->cur == iter->deque->start || iter->cur == iter->deque->end)
+   struct deque* deque = NULL;
+   struct deque_block* block = NULL;
+   struct deque_block* prev = NULL;
+   int32_t i;
+
+   if (iter == NULL || iter->deque == NULL || iter->block == NULL ||
+       iter->index < (int32_t)iter->block->first || iter->index >= (int32_t)iter->block->last)
    {
       return;
    }
-   iter->cur = deque_remove(iter->deque, iter->cur);
-   if (iter->cur == iter->deque->start)
+   deque = iter->deque;
+   block = iter->block;
+   i = iter->index;
+
+   deque_write_lock(deque);
+   deque_entry_destroy(deque, &block->entries[i]);
+   deque->size--;
+   if (i == (int32_t)block->first)
+   {
+      // the previous entry is the last one of the previous block
+      block->first++;
+      prev = block->prev;
+      deque_block_release(deque, block);
+      iter->block = prev;
+      iter->index = prev != NULL ? (int32_t)prev->last - 1 : -1;
+   }
+   else
+   {
+      memmove(&block->entries[i], &block->entries[i + 1], (block->last - i - 1) * sizeof(struct deque_entry));
+      deque_relocate(&block->entries[i], block->last - i - 1);
+      block->last--;
+      iter->index = i - 1;
+   }
+   deque_unlock(deque);
+
+   if (iter->block == NULL)
    {
       iter->value = NULL;
       iter->tag = NULL;
       return;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
+   iter->value = &iter->block->entries[iter->index].value;
+   iter->tag = iter->block->entries[iter->index].tag;
    return;
 }
 
@@ -487,35 +891,46 @@ pgvictoria_deque_iterator_destroy(struct deque_iterator* iter)
 bool
 pgvictoria_deque_iterator_next(struct deque_iterator* iter)
 {
+   struct deque_entry* entry = NULL;
    if (iter == NULL)
    {
       return false;
    }
-   iter->cur = deque_next(iter->deque, iter->cur);
-   if (iter->cur == NULL)
+   // stay within the block without going through deque_next
+   if (iter->block != NULL && iter->index + 1 < (int32_t)iter->block->last)
+   {
+      iter->index++;
+   }
+   else if (!deque_next(iter->deque, &iter->block, &iter->index))
    {
       return false;
    }
-   iter->value = iter->cur->data;
-   iter->tag = iter->cur->tag;
+   entry = &iter->block->entries[iter->index];
+   iter->value = &entry->value;
+   iter->tag = entry->tag;
    return true;
 }
 
 bool
 pgvictoria_deque_iterator_has_next(struct deque_iterator* iter)
 {
+   struct deque_block* block = NULL;
+   int32_t index;
    if (iter == NULL)
    {
       return false;
    }
-   return deque_next(iter->deque, iter->cur) != NULL;
+   block = iter->block;
+   index = iter->index;
+   return deque_next(iter->deque, &block, &index);
 }
 
-static void
+static int
 deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type, struct value_config* config)
 {
-   struct deque_node* n = NULL;
-   struct deque_node* last = NULL;
+   struct deque_entry* entry = NULL;
+   struct deque_slot* slot = NULL;
+   uint64_t position = 0;
 
 #ifdef CORE_DEBUG
    if (deque == NULL)
@@ -523,7 +938,7 @@ deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type
       pgvictoria_log_debug("Deque is NULL");
    }
 
-   if (pgvictoria_deque_exists(deque, tag))
+   if (deque != NULL && deque->ring == NULL && pgvictoria_deque_exists(deque, tag))
    {
       pgvictoria_log_trace("Tag exists: %s", tag);
    }
@@ -538,57 +953,339 @@ deque_offer(struct deque* deque, char* tag, uintptr_t data, enum value_type type
    }
 #endif
 
-   if (type == ValueNone)
+   if (deque == NULL || type == ValueNone)
    {
-      return;
+      return 1;
+   }
+
+   if (deque->ring != NULL)
+   {
+      struct deque_entry e;
+
+      // a claimed slot can not be given back, so fill the entry first
+      if (deque_entry_init(deque, &e, data, type, tag, config))
+      {
+         return 1;
+      }
+      slot = deque_ring_claim(deque->ring, &position);
+      if (slot == NULL)
+      {
+         deque_entry_discard(deque, &e, type, config);
+         return 1;
+      }
+      slot->entry = e;
+      deque_relocate(&slot->entry, 1);
+      atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+      return 0;
    }
 
-   deque_node_create(data, type, tag, config, &n);
    deque_write_lock(deque);
+   entry = deque_tail(deque);
+   if (entry == NULL || deque_entry_init(deque, entry, data, type, tag, config))
+   {
+      deque_unlock(deque);
+      return 1;
+   }
+   deque->end->last++;
    deque->size++;
-   last = deque->end->prev;
-   last->next = n;
-   n->prev = last;
-   n->next = deque->end;
-   deque->end->prev = n;
    deque_unlock(deque);
+   return 0;
 }
 
-static void
-deque_node_create(uintptr_t data, enum value_type type, char* tag, struct value_config* config, struct deque_node** node)
+static int
+deque_entry_init(struct deque* deque, struct deque_entry* entry, uintptr_t data, enum value_type type, char* tag, struct value_config* config)
 {
-   struct deque_node* n = NULL;
-   n = malloc(sizeof(struct deque_node));
-   memset(n, 0, sizeof(struct deque_node));
+   if (pgvictoria_value_init(deque->arena, &entry->value, config != NULL ? ValueRef : type, data))
+   {
+      return 1;
+   }
    if (config != NULL)
    {
-      pgvictoria_value_create_with_config(data, config, &n->data);
+      if (config->destroy_data != NULL)
+      {
+         entry->value.destroy_data = config->destroy_data;
+      }
+      if (config->to_string != NULL)
+      {
+         entry->value.to_string = config->to_string;
+      }
+   }
+   if (tag != NULL)
+   {
+      entry->tag = deque->arena != NULL ? pgvictoria_memory_arena_string(deque->arena, tag) : pgvictoria_append(NULL, tag);
+      if (entry->tag == NULL)
+      {
+         deque_entry_discard(deque, entry, type, config);
+         return 1;
+      }
    }
    else
    {
-      pgvictoria_value_create(type, data, &n->data);
+      entry->tag = NULL;
+   }
+   if (deque->arena != NULL && !deque->owns_data && pgvictoria_value_owns_data(&entry->value))
+   {
+      deque->owns_data = pgvictoria_memory_arena_cleanup(deque->arena, deque_arena_cleanup, deque) == 0;
+   }
+   return 0;
+}
+
+static void
+deque_entry_destroy(struct deque* deque, struct deque_entry* entry)
+{
+   pgvictoria_value_destroy(&entry->value);
+   if (deque->arena == NULL)
+   {
+      free(entry->tag);
+   }
+   entry->tag = NULL;
+}
+
+static void
+deque_entry_discard(struct deque* deque, struct deque_entry* entry, enum value_type type, struct value_config* config)
+{
+   // Only strings are copied, any other data is still the caller's
+   if (config == NULL && (type == ValueString || type == ValueBASE64))
+   {
+      pgvictoria_value_destroy(&entry->value);
    }
+   if (deque->arena == NULL)
+   {
+      free(entry->tag);
+   }
+   entry->tag = NULL;
+}
+
+static uintptr_t
+deque_entry_take(struct deque* deque, struct deque_entry* entry, char** tag)
+{
+   uintptr_t data = pgvictoria_value_data(&entry->value);
+
+   if (deque->arena == NULL)
+   {
+      if (tag != NULL)
+      {
+         *tag = entry->tag;
+      }
+      else
+      {
+         free(entry->tag);
+      }
+      if (entry->value.inlined)
+      {
+         // The entry is reused, so the string has to leave it
+         data = (uintptr_t)pgvictoria_append(NULL, (char*)data);
+      }
+      return data;
+   }
+
+   // The caller owns what is returned, so copy what lives in the arena
    if (tag != NULL)
    {
-      n->tag = pgvictoria_append(NULL, tag);
+      *tag = pgvictoria_append(NULL, entry->tag);
+   }
+   if (entry->value.type == ValueString || entry->value.type == ValueBASE64)
+   {
+      data = (uintptr_t)pgvictoria_append(NULL, (char*)data);
+   }
+   return data;
+}
+
+static struct deque_entry*
+deque_tail(struct deque* deque)
+{
+   struct deque_block* block = deque->end;
+
+   if (block == NULL || block->last == block->capacity)
+   {
+      block = deque_block_create(deque, block == NULL ? DEQUE_FIRST_BLOCK : (block->capacity < DEQUE_MAX_BLOCK ? 2 * block->capacity : DEQUE_MAX_BLOCK));
+      if (block == NULL)
+      {
+         return NULL;
+      }
+      block->prev = deque->end;
+      if (deque->end != NULL)
+      {
+         deque->end->next = block;
+      }
+      else
+      {
+         deque->start = block;
+      }
+      deque->end = block;
+   }
+   return &block->entries[block->last];
+}
+
+static struct deque_block*
+deque_block_create(struct deque* deque, uint32_t capacity)
+{
+   struct deque_block* block = NULL;
+   size_t size = sizeof(struct deque_block) + capacity * sizeof(struct deque_entry);
+
+   if (deque->arena != NULL)
+   {
+      block = pgvictoria_memory_arena_alloc(deque->arena, size);
    }
    else
    {
-      n->tag = NULL;
+      block = malloc(size);
+   }
+   if (block == NULL)
+   {
+      return NULL;
    }
-   *node = n;
+   block->next = NULL;
+   block->prev = NULL;
+   block->first = 0;
+   block->last = 0;
+   block->capacity = capacity;
+   return block;
 }
 
 static void
-deque_node_destroy(struct deque_node* node)
+deque_block_release(struct deque* deque, struct deque_block* block)
 {
-   if (node == NULL)
+   if (block->first != block->last)
+   {
+      return;
+   }
+   if (block->prev == NULL && block->next == NULL)
    {
+      block->first = 0;
+      block->last = 0;
       return;
    }
-   pgvictoria_value_destroy(node->data);
-   free(node->tag);
-   free(node);
+   if (block->prev != NULL)
+   {
+      block->prev->next = block->next;
+   }
+   else
+   {
+      deque->start = block->next;
+   }
+   if (block->next != NULL)
+   {
+      block->next->prev = block->prev;
+   }
+   else
+   {
+      deque->end = block->prev;
+   }
+   if (deque->arena == NULL)
+   {
+      free(block);
+   }
+}
+
+static void
+deque_arena_cleanup(void* data)
+{
+   struct deque* deque = (struct deque*)data;
+
+   for (struct deque_block* block = deque->start; block != NULL; block = block->next)
+   {
+      for (uint32_t i = block->first; i < block->last; i++)
+      {
+         pgvictoria_value_destroy(&block->entries[i].value);
+      }
+   }
+}
+
+static struct deque_slot*
+deque_ring_claim(struct deque_ring* ring, uint64_t* position)
+{
+   struct deque_slot* slot = NULL;
+   uint64_t pos = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+   int64_t diff;
+
+   for (;;)
+   {
+      slot = &ring->slots[pos & ring->mask];
+      diff = (int64_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - pos);
+      if (diff == 0)
+      {
+         if (atomic_compare_exchange_weak_explicit(&ring->enqueue, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+         {
+            *position = pos;
+            return slot;
+         }
+      }
+      else if (diff < 0)
+      {
+         // the consumer of the previous lap has not released the slot
+         return NULL;
+      }
+      else
+      {
+         pos = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+      }
+   }
+}
+
+static bool
+deque_ring_pop(struct deque_ring* ring, struct deque_entry* entry)
+{
+   struct deque_slot* slot = NULL;
+   uint64_t pos = atomic_load_explicit(&ring->dequeue, memory_order_relaxed);
+   int64_t diff;
+
+   for (;;)
+   {
+      slot = &ring->slots[pos & ring->mask];
+      diff = (int64_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - (pos + 1));
+      if (diff == 0)
+      {
+         if (atomic_compare_exchange_weak_explicit(&ring->dequeue, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+         {
+            break;
+         }
+      }
+      else if (diff < 0)
+      {
+         // the producer has not published the slot yet
+         return false;
+      }
+      else
+      {
+         pos = atomic_load_explicit(&ring->dequeue, memory_order_relaxed);
+      }
+   }
+
+   *entry = slot->entry;
+   deque_relocate(entry, 1);
+   // hand the slot to the producer of the next lap
+   atomic_store_explicit(&slot->sequence, pos + ring->mask + 1, memory_order_release);
+   return true;
+}
+
+static uint32_t
+deque_ring_size(struct deque_ring* ring)
+{
+   // load dequeue first, so enqueue is never behind it
+   uint64_t dequeue = atomic_load(&ring->dequeue);
+   uint64_t enqueue = atomic_load(&ring->enqueue);
+
+   return (uint32_t)(enqueue - dequeue);
+}
+
+static void
+deque_settle(struct deque* deque)
+{
+   struct deque_entry* entry = NULL;
+
+   if (deque == NULL || deque->ring == NULL || deque_ring_size(deque->ring) == 0)
+   {
+      return;
+   }
+   deque_write_lock(deque);
+   while ((entry = deque_tail(deque)) != NULL && deque_ring_pop(deque->ring, entry))
+   {
+      deque->end->last++;
+      deque->size++;
+      atomic_store(&deque->ring->settled, true);
+   }
+   deque_unlock(deque);
 }
 
 static void
@@ -621,142 +1318,163 @@ deque_unlock(struct deque* deque)
    pthread_rwlock_unlock(&deque->mutex);
 }
 
-static struct deque_node*
-deque_next(struct deque* deque, struct deque_node* node)
+static bool
+deque_next(struct deque* deque, struct deque_block** block, int32_t* index)
 {
-   struct deque_node* next = NULL;
-   if (deque == NULL || deque->size == 0 || node == NULL)
+   struct deque_block* b = *block;
+   int32_t i = *index;
+   if (deque == NULL || deque->size == 0)
    {
-      return NULL;
+      return false;
    }
-   if (node->next == deque->end)
+   if (b == NULL)
    {
-      return NULL;
+      b = deque->start;
+      i = b != NULL ? (int32_t)b->first : 0;
+   }
+   else
+   {
+      i++;
+   }
+   while (b != NULL && i >= (int32_t)b->last)
+   {
+      b = b->next;
+      i = b != NULL ? (int32_t)b->first : 0;
+   }
+   if (b == NULL)
+   {
+      return false;
    }
-   next = node->next;
-   return next;
+   *block = b;
+   *index = i;
+   return true;
 }
 
-static struct deque_node*
+static struct deque_entry*
 deque_find(struct deque* deque, char* tag)
 {
-   struct deque_node* n = NULL;
+   struct deque_block* block = NULL;
+   int32_t index = -1;
    if (tag == NULL || strlen(tag) == 0 || deque == NULL || deque->size == 0)
    {
       return NULL;
    }
-   n = deque_next(deque, deque->start);
 
-   while (n != NULL)
+   while (deque_next(deque, &block, &index))
    {
-      if (pgvictoria_compare_string(tag, n->tag))
+      if (pgvictoria_compare_string(tag, block->entries[index].tag))
       {
-         return n;
+         return &block->entries[index];
       }
-
-      n = deque_next(deque, n);
    }
    return NULL;
 }
 
-static char*
-to_json_string(struct deque* deque, char* tag, int indent)
+static int
+to_json_string(struct deque* deque, char* tag, int indent, struct string_builder* builder)
 {
-   char* ret = NULL;
-   ret = pgvictoria_indent(ret, tag, indent);
-   struct deque_node* cur = NULL;
+   struct deque_block* block = NULL;
+   int32_t index = -1;
+   struct deque_entry* cur = NULL;
+   struct string_builder t;
+   bool has_next;
+   pgvictoria_string_builder_indent(builder, tag, indent);
    if (deque == NULL || pgvictoria_deque_empty(deque))
    {
-      ret = pgvictoria_append(ret, "[]");
-      return ret;
+      return pgvictoria_string_builder_append(builder, "[]");
    }
+   // the tags are built in one buffer that is reused
+   pgvictoria_string_builder_init(&t);
    deque_read_lock(deque);
-   ret = pgvictoria_append(ret, "[\n");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   pgvictoria_string_builder_append(builder, "[\n");
+   has_next = deque_next(deque, &block, &index);
+   while (has_next)
    {
-      bool has_next = cur->next != deque->end;
-      char* str = NULL;
-      char* t = NULL;
+      cur = &block->entries[index];
+      has_next = deque_next(deque, &block, &index);
+      pgvictoria_string_builder_clear(&t);
       if (cur->tag != NULL)
       {
-         t = pgvictoria_append(t, cur->tag);
-         t = pgvictoria_append(t, ": ");
+         pgvictoria_string_builder_append(&t, cur->tag);
+         pgvictoria_string_builder_append(&t, ": ");
       }
-      str = pgvictoria_value_to_string(cur->data, FORMAT_JSON, t, indent + INDENT_PER_LEVEL);
-      free(t);
-      ret = pgvictoria_append(ret, str);
-      ret = pgvictoria_append(ret, has_next ? ",\n" : "\n");
-      free(str);
-      cur = deque_next(deque, cur);
+      pgvictoria_value_to_builder(&cur->value, FORMAT_JSON, t.length > 0 ? t.str : NULL, indent + INDENT_PER_LEVEL, builder);
+      pgvictoria_string_builder_append(builder, has_next ? ",\n" : "\n");
    }
-   ret = pgvictoria_indent(ret, NULL, indent);
-   ret = pgvictoria_append(ret, "]");
+   pgvictoria_string_builder_indent(builder, NULL, indent);
+   pgvictoria_string_builder_append(builder, "]");
    deque_unlock(deque);
-   return ret;
+   pgvictoria_string_builder_destroy(&t);
+   return builder->error ? 1 : 0;
 }
 
-static char*
-to_compact_json_string(struct deque* deque, char* tag, int indent)
+static int
+to_compact_json_string(struct deque* deque, char* tag, int indent, struct string_builder* builder)
 {
-   char* ret = NULL;
-   ret = pgvictoria_indent(ret, tag, indent);
-   struct deque_node* cur = NULL;
+   struct deque_block* block = NULL;
+   int32_t index = -1;
+   struct deque_entry* cur = NULL;
+   struct string_builder t;
+   bool has_next;
+   pgvictoria_string_builder_indent(builder, tag, indent);
    if (deque == NULL || pgvictoria_deque_empty(deque))
    {
-      ret = pgvictoria_append(ret, "[]");
-      return ret;
+      return pgvictoria_string_builder_append(builder, "[]");
    }
+   pgvictoria_string_builder_init(&t);
    deque_read_lock(deque);
-   ret = pgvictoria_append(ret, "[");
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   pgvictoria_string_builder_append(builder, "[");
+   has_next = deque_next(deque, &block, &index);
+   while (has_next)
    {
-      bool has_next = cur->next != deque->end;
-      char* str = NULL;
-      char* t = NULL;
+      cur = &block->entries[index];
+      has_next = deque_next(deque, &block, &index);
+      pgvictoria_string_builder_clear(&t);
       if (cur->tag != NULL)
       {
-         t = pgvictoria_append(t, cur->tag);
-         t = pgvictoria_append(t, ":");
+         pgvictoria_string_builder_append(&t, cur->tag);
+         pgvictoria_string_builder_append(&t, ":");
+      }
+      pgvictoria_value_to_builder(&cur->value, FORMAT_JSON_COMPACT, t.length > 0 ? t.str : NULL, indent, builder);
+      if (has_next)
+      {
+         pgvictoria_string_builder_append_char(builder, ',');
       }
-      str = pgvictoria_value_to_string(cur->data, FORMAT_JSON_COMPACT, t, indent);
-      free(t);
-      ret = pgvictoria_append(ret, str);
-      ret = pgvictoria_append(ret, has_next ? "," : "");
-      free(str);
-      cur = deque_next(deque, cur);
    }
-   ret = pgvictoria_append(ret, "]");
+   pgvictoria_string_builder_append(builder, "]");
    deque_unlock(deque);
-   return ret;
+   pgvictoria_string_builder_destroy(&t);
+   return builder->error ? 1 : 0;
 }
 
-static char*
-to_text_string(struct deque* deque, char* tag, int indent)
+static int
+to_text_string(struct deque* deque, char* tag, int indent, struct string_builder* builder)
 {
-   char* ret = NULL;
    int cnt = 0;
    int next_indent = pgvictoria_compare_string(tag, BULLET_POINT) ? 0 : indent;
+   int value_indent;
    // we have a tag and it's not the bullet point, so that means another line
    if (tag != NULL && !pgvictoria_compare_string(tag, BULLET_POINT))
    {
-      ret = pgvictoria_indent(ret, tag, indent);
+      pgvictoria_string_builder_indent(builder, tag, indent);
       next_indent += INDENT_PER_LEVEL;
    }
-   struct deque_node* cur = NULL;
+   struct deque_block* block = NULL;
+   int32_t index = -1;
+   struct deque_entry* cur = NULL;
+   bool has_next;
    if (deque == NULL || pgvictoria_deque_empty(deque))
    {
-      ret = pgvictoria_append(ret, "[]");
-      return ret;
+      return pgvictoria_string_builder_append(builder, "[]");
    }
    deque_read_lock(deque);
-   cur = deque_next(deque, deque->start);
-   while (cur != NULL)
+   has_next = deque_next(deque, &block, &index);
+   while (has_next)
    {
-      bool has_next = cur->next != deque->end;
-      char* str = NULL;
-      str = pgvictoria_value_to_string(cur->data, FORMAT_TEXT, BULLET_POINT, next_indent);
+      cur = &block->entries[index];
+      has_next = deque_next(deque, &block, &index);
+      // the first entry is laid out before the indent moves in
+      value_indent = next_indent;
       if (cnt == 0)
       {
          cnt++;
@@ -765,143 +1483,236 @@ to_text_string(struct deque* deque, char* tag, int indent)
             next_indent = indent + INDENT_PER_LEVEL;
          }
       }
-      if (cur->data->type == ValueJSON)
+      if (cur->value.type == ValueJSON)
       {
-         ret = pgvictoria_indent(ret, BULLET_POINT, next_indent);
+         pgvictoria_string_builder_indent(builder, BULLET_POINT, next_indent);
+      }
+      pgvictoria_value_to_builder(&cur->value, FORMAT_TEXT, BULLET_POINT, value_indent, builder);
+      if (has_next)
+      {
+         pgvictoria_string_builder_append_char(builder, '\n');
       }
-      ret = pgvictoria_append(ret, str);
-      ret = pgvictoria_append(ret, has_next ? "\n" : "");
-      free(str);
-      cur = deque_next(deque, cur);
    }
    deque_unlock(deque);
-   return ret;
+   return builder->error ? 1 : 0;
 }
 
-static struct deque_node*
-deque_remove(struct deque* deque, struct deque_node* node)
+static void
+deque_sort(struct deque_entry* entries, struct deque_entry* buffer, uint32_t size, deque_compare_cb compare)
 {
-   if (deque == NULL || node == NULL || node == deque->start || node == deque->end)
-   {
-      return NULL;
-   }
-   struct deque_node* prev = node->prev;
-   struct deque_node* next = node->next;
-   prev->next = next;
-   next->prev = prev;
-   deque_node_destroy(node);
-   deque->size--;
-   return prev;
-}
+   struct deque_entry* from = entries;
+   struct deque_entry* to = buffer;
+   struct deque_entry* swap = NULL;
 
-static struct deque_node*
-get_middle(struct deque_node* node)
-{
-   struct deque_node* slow = node;
-   struct deque_node* fast = node;
-   while (fast != NULL && fast->next != NULL)
+   for (uint32_t width = 1; width < size; width *= 2)
    {
-      slow = slow->next;
-      fast = fast->next->next;
+      for (uint32_t lo = 0; lo < size; lo += 2 * width)
+      {
+         uint32_t mid = lo + width < size ? lo + width : size;
+         uint32_t hi = lo + 2 * width < size ? lo + 2 * width : size;
+         uint32_t left = lo;
+         uint32_t right = mid;
+         uint32_t k = lo;
+
+         while (left < mid && right < hi)
+         {
+            // take from the left on ties to keep equal tags in order
+            if (compare(&from[left], &from[right]) <= 0)
+            {
+               to[k++] = from[left++];
+            }
+            else
+            {
+               to[k++] = from[right++];
+            }
+         }
+         while (left < mid)
+         {
+            to[k++] = from[left++];
+         }
+         while (right < hi)
+         {
+            to[k++] = from[right++];
+         }
+      }
+      swap = from;
+      from = to;
+      to = swap;
    }
-   return slow;
-}
 
-static struct deque_node*
-deque_sort(struct deque_node* node)
-{
-   struct deque_node* mid = NULL;
-   struct deque_node* prevmid = NULL;
-   struct deque_node* node1 = NULL;
-   struct deque_node* node2 = NULL;
-   if (node == NULL || node->next == NULL)
+   if (from != entries)
    {
-      return node;
+      memcpy(entries, from, size * sizeof(struct deque_entry));
    }
-   mid = get_middle(node);
-   prevmid = mid->prev;
-   mid->prev = NULL;
-   prevmid->next = NULL;
-   node1 = deque_sort(node);
-   node2 = deque_sort(mid);
-   return deque_merge(node1, node2);
 }
 
-static struct deque_node*
-deque_merge(struct deque_node* node1, struct deque_node* node2)
+static void
+deque_sorted_position(struct deque* deque, struct deque_entry* entry, deque_compare_cb compare, struct deque_block** block, uint32_t* position)
 {
-   struct deque_node* node = NULL;
-   struct deque_node* left = node1;
-   struct deque_node* right = node2;
-   struct deque_node* next = NULL;
-   struct deque_node* start = NULL;
-   if (node1 == NULL)
-   {
-      return node2;
-   }
-   if (node2 == NULL)
+   uint32_t low;
+   uint32_t high;
+   uint32_t middle;
+
+   *block = NULL;
+   *position = 0;
+
+   if (deque->size == 0)
    {
-      return node1;
+      return;
    }
-   while (left != NULL && right != NULL)
+
+   // Walk back from the tail to the last block that starts with an entry not after this one
+   for (struct deque_block* b = deque->end; b != NULL; b = b->prev)
    {
-      if (tag_compare(left->tag, right->tag) <= 0)
+      if (b->first == b->last || compare(entry, &b->entries[b->first]) < 0)
+      {
+         continue;
+      }
+      if (b == deque->end && compare(entry, &b->entries[b->last - 1]) >= 0)
+      {
+         // append
+         return;
+      }
+      low = b->first;
+      high = b->last;
+      while (low < high)
       {
-         next = left->next;
-         if (node == NULL)
+         middle = low + (high - low) / 2;
+         if (compare(entry, &b->entries[middle]) >= 0)
          {
-            start = left;
-            node = left;
-            node->prev = NULL;
-            node->next = NULL;
+            low = middle + 1;
          }
          else
          {
-            node->next = left;
-            left->prev = node;
-            left->next = NULL;
-            node = node->next;
+            high = middle;
          }
-         left = next;
+      }
+      *block = b;
+      *position = low;
+      return;
+   }
+
+   *block = deque->start;
+   *position = deque->start->first;
+}
+
+static struct deque_entry*
+deque_insert(struct deque* deque, struct deque_block* block, uint32_t position)
+{
+   struct deque_block* split = NULL;
+   uint32_t middle;
+
+   if (block->last == block->capacity && block->first > 0)
+   {
+      memmove(&block->entries[block->first - 1], &block->entries[block->first], (position - block->first) * sizeof(struct deque_entry));
+      deque_relocate(&block->entries[block->first - 1], position - block->first);
+      block->first--;
+      return &block->entries[position - 1];
+   }
+
+   if (block->last == block->capacity)
+   {
+      // move the upper half to a new block after this one
+      split = deque_block_create(deque, block->capacity);
+      if (split == NULL)
+      {
+         return NULL;
+      }
+      middle = block->first + (block->last - block->first) / 2;
+      memcpy(split->entries, &block->entries[middle], (block->last - middle) * sizeof(struct deque_entry));
+      deque_relocate(split->entries, block->last - middle);
+      split->last = block->last - middle;
+      block->last = middle;
+      split->prev = block;
+      split->next = block->next;
+      if (block->next != NULL)
+      {
+         block->next->prev = split;
       }
       else
       {
-         next = right->next;
-         if (node == NULL)
-         {
-            start = right;
-            node = right;
-            node->prev = NULL;
-            node->next = NULL;
-         }
-         else
-         {
-            node->next = right;
-            right->prev = node;
-            right->next = NULL;
-            node = node->next;
-         }
-         right = next;
+         deque->end = split;
+      }
+      block->next = split;
+      if (position > middle)
+      {
+         position -= middle;
+         block = split;
       }
    }
-   while (left != NULL)
+
+   memmove(&block->entries[position + 1], &block->entries[position], (block->last - position) * sizeof(struct deque_entry));
+   deque_relocate(&block->entries[position + 1], block->last - position);
+   block->last++;
+   return &block->entries[position];
+}
+
+static void
+deque_forget(struct deque* deque)
+{
+   struct deque_block* block = deque->start;
+   struct deque_block* next = NULL;
+
+   while (block != NULL)
    {
-      next = left->next;
-      node->next = left;
-      left->prev = node;
-      left = next;
-      node = node->next;
+      next = block->next;
+      free(block);
+      block = next;
    }
-   while (right != NULL)
+   deque->start = NULL;
+   deque->end = NULL;
+   deque->size = 0;
+}
+
+static void
+deque_relocate(struct deque_entry* entries, uint32_t number)
+{
+   for (uint32_t i = 0; i < number; i++)
    {
-      next = right->next;
-      node->next = right;
-      right->prev = node;
-      right = next;
-      node = node->next;
+      pgvictoria_value_relocate(&entries[i].value);
    }
-   return start;
 }
+
+static void
+deque_merge_sift(struct deque_iterator** sources, int* heap, int size, int position, deque_compare_cb compare)
+{
+   int smallest;
+   int child;
+   int swap;
+
+   for (;;)
+   {
+      smallest = position;
+      child = 2 * position + 1;
+      if (child < size && deque_merge_compare(sources, heap[child], heap[smallest], compare) < 0)
+      {
+         smallest = child;
+      }
+      child++;
+      if (child < size && deque_merge_compare(sources, heap[child], heap[smallest], compare) < 0)
+      {
+         smallest = child;
+      }
+      if (smallest == position)
+      {
+         return;
+      }
+      swap = heap[position];
+      heap[position] = heap[smallest];
+      heap[smallest] = swap;
+      position = smallest;
+   }
+}
+
+static int
+deque_merge_compare(struct deque_iterator** sources, int a, int b, deque_compare_cb compare)
+{
+   int ret = compare(&sources[a]->block->entries[sources[a]->index], &sources[b]->block->entries[sources[b]->index]);
+
+   // ties go to the earlier deque
+   return ret != 0 ? ret : a - b;
+}
+
 static int
 tag_compare(char* tag1, char* tag2)
 {
@@ -915,3 +1726,9 @@ tag_compare(char* tag1, char* tag2)
    }
    return strcmp(tag1, tag2);
 }
+
+static int
+entry_tag_compare(struct deque_entry* e1, struct deque_entry* e2)
+{
+   return tag_compare(e1->tag, e2->tag);
+}
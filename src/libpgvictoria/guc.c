@@ -28,7 +28,11 @@
 
 /* pgvictoria */
 #include <pgvictoria.h>
+#include <art.h>
 #include <guc.h>
+#include <json.h>
+#include <memory.h>
+#include <postgresql.h>
 #include <utils.h>
 #include <value.h>
 
@@ -64,9 +68,11 @@ static int compare_lc_numeric(char* baseline, char* current, bool* modified);
 static int compare_lc_time(char* baseline, char* current, bool* modified);
 
 /* Reusable building blocks shared by the comparators above. */
+static int guc_compare_default(enum value_type type, char* baseline, char* current, bool* modified);
 static int compare_locale(char* baseline, char* current, bool* modified);
 static bool guc_equal(char* baseline, char* current, const char* strip, bool fold_case);
 static char* guc_normalize(const char* value, const char* strip, bool fold_case);
+static bool guc_intern_ready(void);
 
 /* The list of GUCs that need special comparison, and the function for each.
  * pgvictoria_check_guc consults this list; anything not here uses the default. */
@@ -77,17 +83,190 @@ static struct guc_comparator special_gucs[] = {
    {"lc_time", compare_lc_time},
    {NULL, NULL}};
 
+/* The interned setting names. The names are kept in one arena and indexed by
+ * id, the tree maps a name to its id, and the comparators of special_gucs are
+ * indexed by id too so a resolved setting is never looked up by name again. */
+static struct memory_arena* guc_arena = NULL;
+static char** guc_names = NULL;
+static int guc_number_of_names = 0;
+static struct art* guc_ids = NULL;
+static guc_compare_fn* guc_comparators = NULL;
+static bool guc_intern_failed = false;
+
+int
+pgvictoria_guc_intern_init(void)
+{
+   struct art* names = NULL;
+   struct art_iterator* iter = NULL;
+   struct art_entry* entries = NULL;
+   struct json* baseline = NULL;
+   struct json_iterator* keys = NULL;
+   int id;
+
+   if (guc_names != NULL)
+   {
+      return 0;
+   }
+
+   /* The tree drops the names shared by baselines, and orders them */
+   if (pgvictoria_art_create_case_insensitive(&names))
+   {
+      goto error;
+   }
+   for (int version = pgvictoria_get_min_supported_version(); version <= pgvictoria_get_max_supported_version(); version++)
+   {
+      if (!pgvictoria_is_version_supported(version))
+      {
+         continue;
+      }
+      baseline = pgvictoria_get_baseline(version);
+      if (baseline == NULL || pgvictoria_json_iterator_create(baseline, &keys))
+      {
+         goto error;
+      }
+      while (pgvictoria_json_iterator_next(keys))
+      {
+         if (pgvictoria_art_insert(names, keys->key, 0, ValueInt32))
+         {
+            goto error;
+         }
+      }
+      pgvictoria_json_iterator_destroy(keys);
+      keys = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+   if (pgvictoria_memory_arena_create(0, &guc_arena))
+   {
+      goto error;
+   }
+   guc_names = pgvictoria_memory_arena_alloc(guc_arena, (names->size + 1) * sizeof(char*));
+   entries = malloc((names->size + 1) * sizeof(struct art_entry));
+   if (guc_names == NULL || entries == NULL || pgvictoria_art_iterator_create(names, &iter))
+   {
+      goto error;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      guc_names[guc_number_of_names] = pgvictoria_memory_arena_string(guc_arena, iter->key);
+      if (guc_names[guc_number_of_names] == NULL)
+      {
+         goto error;
+      }
+      entries[guc_number_of_names].key = guc_names[guc_number_of_names];
+      entries[guc_number_of_names].value = (uintptr_t)guc_number_of_names;
+      entries[guc_number_of_names].type = ValueInt32;
+      guc_number_of_names++;
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   if (pgvictoria_art_create_case_insensitive(&guc_ids) ||
+       pgvictoria_art_bulk_load(guc_ids, entries, guc_number_of_names))
+   {
+      goto error;
+   }
+
+   guc_comparators = pgvictoria_memory_arena_alloc(guc_arena, (guc_number_of_names + 1) * sizeof(guc_compare_fn));
+   if (guc_comparators == NULL)
+   {
+      goto error;
+   }
+   memset(guc_comparators, 0, (guc_number_of_names + 1) * sizeof(guc_compare_fn));
+   for (int i = 0; special_gucs[i].name != NULL; i++)
+   {
+      id = pgvictoria_guc_id((char*)special_gucs[i].name);
+      if (id != GUC_UNKNOWN)
+      {
+         guc_comparators[id] = special_gucs[i].compare;
+      }
+   }
+
+   free(entries);
+   pgvictoria_art_destroy(names);
+   return 0;
+
+error:
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_json_iterator_destroy(keys);
+   pgvictoria_json_destroy(baseline);
+   pgvictoria_art_destroy(names);
+   free(entries);
+   pgvictoria_guc_intern_destroy();
+   guc_intern_failed = true;
+   return 1;
+}
+
+void
+pgvictoria_guc_intern_destroy(void)
+{
+   pgvictoria_art_destroy(guc_ids);
+   pgvictoria_memory_arena_destroy(guc_arena);
+   guc_ids = NULL;
+   guc_arena = NULL;
+   guc_names = NULL;
+   guc_comparators = NULL;
+   guc_number_of_names = 0;
+   guc_intern_failed = false;
+}
+
+int
+pgvictoria_guc_id(char* guc_name)
+{
+   enum value_type type = ValueNone;
+   uintptr_t id;
+
+   if (guc_name == NULL || !guc_intern_ready())
+   {
+      return GUC_UNKNOWN;
+   }
+
+   id = pgvictoria_art_search_typed(guc_ids, guc_name, &type);
+
+   return type == ValueNone ? GUC_UNKNOWN : (int)id;
+}
+
+char*
+pgvictoria_guc_name(int id)
+{
+   if (!guc_intern_ready())
+   {
+      return NULL;
+   }
+
+   return id >= 0 && id < guc_number_of_names ? guc_names[id] : NULL;
+}
+
+int
+pgvictoria_guc_number_of_names(void)
+{
+   if (!guc_intern_ready())
+   {
+      return 0;
+   }
+
+   return guc_number_of_names;
+}
+
 int
 pgvictoria_check_guc(char* guc_name, enum value_type type, char* baseline_val, char* current_val, bool* modified)
 {
    char* baseline = baseline_val ? baseline_val : "";
    char* current = current_val ? current_val : "";
+   int id;
 
    if (modified == NULL)
    {
       return 1;
    }
 
+   id = pgvictoria_guc_id(guc_name);
+   if (id != GUC_UNKNOWN)
+   {
+      return pgvictoria_check_guc_id(id, type, baseline_val, current_val, modified);
+   }
+
    /* Does this GUC need special comparison? If it is in the list, hand it to
     * its own function. */
    if (guc_name != NULL)
@@ -101,6 +280,32 @@ pgvictoria_check_guc(char* guc_name, enum value_type type, char* baseline_val, c
       }
    }
 
+   return guc_compare_default(type, baseline, current, modified);
+}
+
+int
+pgvictoria_check_guc_id(int id, enum value_type type, char* baseline_val, char* current_val, bool* modified)
+{
+   char* baseline = baseline_val ? baseline_val : "";
+   char* current = current_val ? current_val : "";
+
+   if (modified == NULL)
+   {
+      return 1;
+   }
+
+   /* A resolved setting finds its comparator by id */
+   if (id >= 0 && id < pgvictoria_guc_number_of_names() && guc_comparators[id] != NULL)
+   {
+      return guc_comparators[id](baseline, current, modified);
+   }
+
+   return guc_compare_default(type, baseline, current, modified);
+}
+
+static int
+guc_compare_default(enum value_type type, char* baseline, char* current, bool* modified)
+{
    /*
     * Default handling. String values are compared ignoring case and surrounding
     * whitespace; numeric and boolean values are compared exactly so that a value
@@ -183,13 +388,12 @@ guc_equal(char* baseline, char* current, const char* strip, bool fold_case)
  * trimmed, every character in strip removed, and (when fold_case is set)
  * lowercased. Internal whitespace is preserved, so paths and format strings are
  * compared faithfully. Returns NULL for a NULL input or when nothing remains;
- * callers treat NULL as the empty string. Uses the same pgvictoria_append_char
- * building block as pgvictoria_remove_whitespace.
+ * callers treat NULL as the empty string.
  */
 static char*
 guc_normalize(const char* value, const char* strip, bool fold_case)
 {
-   char* result = NULL;
+   struct string_builder result;
    size_t start;
    size_t end;
 
@@ -210,6 +414,7 @@ guc_normalize(const char* value, const char* strip, bool fold_case)
       end--;
    }
 
+   pgvictoria_string_builder_init(&result);
    for (size_t i = start; i < end; i++)
    {
       char c = value[i];
@@ -224,8 +429,29 @@ guc_normalize(const char* value, const char* strip, bool fold_case)
          c = (char)tolower((unsigned char)c);
       }
 
-      result = pgvictoria_append_char(result, c);
+      pgvictoria_string_builder_append_char(&result, c);
+   }
+
+   return pgvictoria_string_builder_finish(&result);
+}
+
+/*
+ * Build the intern table on first use. A failed build is not retried here,
+ * since every attempt parses all the baselines again; only an explicit
+ * pgvictoria_guc_intern_init() tries once more.
+ */
+static bool
+guc_intern_ready(void)
+{
+   if (guc_ids != NULL)
+   {
+      return true;
+   }
+
+   if (guc_intern_failed)
+   {
+      return false;
    }
 
-   return result;
+   return pgvictoria_guc_intern_init() == 0;
 }
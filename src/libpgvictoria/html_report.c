@@ -32,240 +32,985 @@
 #include <utils.h>
 
 /* system */
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include <libxml/HTMLparser.h>
-#include <libxml/HTMLtree.h>
+/* Monochrome Premium CSS Styling */
+static const char* style_content =
+   "body {\n"
+   "  font-family: -apple-system, BlinkMacSystemFont, \"Segoe UI\", Roboto, Helvetica, Arial, sans-serif;\n"
+   "  background-color: #ffffff;\n"
+   "  color: #111111;\n"
+   "  margin: 0;\n"
+   "  padding: 40px 20px;\n"
+   "  line-height: 1.5;\n"
+   "}\n"
+   ".container {\n"
+   "  max-width: 960px;\n"
+   "  margin: 0 auto;\n"
+   "}\n"
+   "h1 {\n"
+   "  font-size: 28px;\n"
+   "  font-weight: 700;\n"
+   "  margin-bottom: 8px;\n"
+   "  border-bottom: 2px solid #111111;\n"
+   "  padding-bottom: 12px;\n"
+   "  text-transform: uppercase;\n"
+   "  letter-spacing: 0.5px;\n"
+   "}\n"
+   "table.metadata {\n"
+   "  width: auto;\n"
+   "  margin: 0 0 30px 0;\n"
+   "  font-size: 14px;\n"
+   "  color: #666666;\n"
+   "}\n"
+   "table.metadata td {\n"
+   "  padding: 4px 16px 4px 0;\n"
+   "  border-bottom: none;\n"
+   "}\n"
+   "table.metadata td:first-child {\n"
+   "  font-weight: 700;\n"
+   "  color: #111111;\n"
+   "}\n"
+   "table {\n"
+   "  width: 100%;\n"
+   "  border-collapse: collapse;\n"
+   "  margin-top: 20px;\n"
+   "  font-size: 14px;\n"
+   "}\n"
+   "th {\n"
+   "  text-align: left;\n"
+   "  padding: 12px 10px;\n"
+   "  border-bottom: 2px solid #111111;\n"
+   "  font-weight: 700;\n"
+   "  text-transform: uppercase;\n"
+   "  font-size: 12px;\n"
+   "  color: #111111;\n"
+   "}\n"
+   "td {\n"
+   "  padding: 12px 10px;\n"
+   "  border-bottom: 1px solid #e5e5e5;\n"
+   "  vertical-align: middle;\n"
+   "  word-break: break-all;\n"
+   "}\n"
+   "tr:nth-child(even) td {\n"
+   "  background-color: #fafafa;\n"
+   "}\n"
+   "tr:hover td {\n"
+   "  background-color: #f0f0f0;\n"
+   "}\n"
+   ".badge {\n"
+   "  display: inline-block;\n"
+   "  font-size: 11px;\n"
+   "  font-weight: 700;\n"
+   "  padding: 4px 8px;\n"
+   "  text-transform: uppercase;\n"
+   "  border: 1px solid #111111;\n"
+   "  border-radius: 0;\n"
+   "  letter-spacing: 0.5px;\n"
+   "}\n"
+   ".badge-default {\n"
+   "  background-color: #f0f0f0;\n"
+   "  color: #333333;\n"
+   "  border-color: #cccccc;\n"
+   "}\n"
+   ".badge-modified {\n"
+   "  background-color: #333333;\n"
+   "  color: #ffffff;\n"
+   "  border-color: #333333;\n"
+   "}\n"
+   ".badge-custom {\n"
+   "  background-color: #ffffff;\n"
+   "  color: #111111;\n"
+   "  border-color: #111111;\n"
+   "  border-style: dashed;\n"
+   "}\n"
+   "@media print {\n"
+   "  body {\n"
+   "    padding: 0;\n"
+   "  }\n"
+   "  table {\n"
+   "    page-break-inside: auto;\n"
+   "  }\n"
+   "  tr {\n"
+   "    page-break-inside: avoid;\n"
+   "    page-break-after: auto;\n"
+   "  }\n"
+   "}\n";
+
+/* The fleet report keeps the columns aligned as rows scroll in and out */
+static const char* fleet_style_content =
+   ".controls {\n"
+   "  display: flex;\n"
+   "  flex-wrap: wrap;\n"
+   "  gap: 8px;\n"
+   "  align-items: center;\n"
+   "  margin-top: 20px;\n"
+   "}\n"
+   ".controls input, .controls select {\n"
+   "  font: inherit;\n"
+   "  font-size: 14px;\n"
+   "  padding: 6px 8px;\n"
+   "  border: 1px solid #111111;\n"
+   "  border-radius: 0;\n"
+   "  background-color: #ffffff;\n"
+   "  color: #111111;\n"
+   "}\n"
+   ".controls input {\n"
+   "  flex: 1 1 240px;\n"
+   "}\n"
+   ".count {\n"
+   "  font-size: 12px;\n"
+   "  color: #666666;\n"
+   "}\n"
+   ".grid {\n"
+   "  display: grid;\n"
+   "  grid-template-columns: 14% 26% 22% 22% 16%;\n"
+   "  align-items: center;\n"
+   "  height: 32px;\n"
+   "  font-size: 14px;\n"
+   "}\n"
+   ".grid > span {\n"
+   "  padding: 0 10px;\n"
+   "  overflow: hidden;\n"
+   "  white-space: nowrap;\n"
+   "  text-overflow: ellipsis;\n"
+   "}\n"
+   ".grid-head {\n"
+   "  margin-top: 20px;\n"
+   "  border-bottom: 2px solid #111111;\n"
+   "  font-weight: 700;\n"
+   "  text-transform: uppercase;\n"
+   "  font-size: 12px;\n"
+   "}\n"
+   ".viewport {\n"
+   "  height: 70vh;\n"
+   "  overflow-y: auto;\n"
+   "}\n"
+   ".rows {\n"
+   "  position: relative;\n"
+   "}\n"
+   ".row, .group {\n"
+   "  position: absolute;\n"
+   "  left: 0;\n"
+   "  right: 0;\n"
+   "  box-sizing: border-box;\n"
+   "}\n"
+   ".row {\n"
+   "  border-bottom: 1px solid #e5e5e5;\n"
+   "}\n"
+   ".row.even {\n"
+   "  background-color: #fafafa;\n"
+   "}\n"
+   ".row:hover {\n"
+   "  background-color: #f0f0f0;\n"
+   "}\n"
+   ".group {\n"
+   "  height: 32px;\n"
+   "  line-height: 30px;\n"
+   "  padding: 0 10px;\n"
+   "  font-weight: 700;\n"
+   "  border-bottom: 2px solid #111111;\n"
+   "  background-color: #ffffff;\n"
+   "}\n";
+
+/*
+ * Renders the rows in view from the data of a fleet report. The filters
+ * only look at the distinct strings once, and grouping sorts the matching
+ * rows under a header per group.
+ */
+static const char* fleet_script_content =
+   "(function () {\n"
+   "  \"use strict\";\n"
+   "  var ROW = 32, EXTRA = 10;\n"
+   "  var data = JSON.parse(document.getElementById(\"pgvictoria-data\").textContent);\n"
+   "  var strings = data.strings, rows = data.rows, servers = data.servers, n = rows.length / 5;\n"
+   "  var byId = function (id) { return document.getElementById(id); };\n"
+   "  var filter = byId(\"filter\"), server = byId(\"server\"), status = byId(\"status\");\n"
+   "  var family = byId(\"family\"), group = byId(\"group\"), count = byId(\"count\");\n"
+   "  var viewport = byId(\"viewport\"), body = byId(\"rows\");\n"
+   "  var families = [], lower = [], matches = [], items = [], labels = [], first = -1, last = -1;\n"
+   "\n"
+   "  function familyOf(k) {\n"
+   "    if (families[k] === undefined) {\n"
+   "      var i = strings[k].search(/[_.]/);\n"
+   "      families[k] = i > 0 ? strings[k].substring(0, i) : strings[k];\n"
+   "    }\n"
+   "    return families[k];\n"
+   "  }\n"
+   "\n"
+   "  function matchOf(k, text) {\n"
+   "    if (matches[k] === undefined) {\n"
+   "      if (lower[k] === undefined) {\n"
+   "        lower[k] = strings[k].toLowerCase();\n"
+   "      }\n"
+   "      matches[k] = lower[k].indexOf(text) >= 0;\n"
+   "    }\n"
+   "    return matches[k];\n"
+   "  }\n"
+   "\n"
+   "  function option(select, value, text) {\n"
+   "    var o = document.createElement(\"option\");\n"
+   "    o.value = value;\n"
+   "    o.textContent = text;\n"
+   "    select.appendChild(o);\n"
+   "  }\n"
+   "\n"
+   "  function groupOf(i) {\n"
+   "    switch (group.value) {\n"
+   "      case \"server\": return servers[rows[5 * i]][0];\n"
+   "      case \"status\": return strings[rows[5 * i + 4]];\n"
+   "      case \"family\": return familyOf(rows[5 * i + 1]);\n"
+   "    }\n"
+   "    return \"\";\n"
+   "  }\n"
+   "\n"
+   "  function cell(line, text) {\n"
+   "    var span = document.createElement(\"span\");\n"
+   "    span.textContent = text;\n"
+   "    span.title = text;\n"
+   "    line.appendChild(span);\n"
+   "    return span;\n"
+   "  }\n"
+   "\n"
+   "  function line(j) {\n"
+   "    var div = document.createElement(\"div\"), i = items[j], r = 5 * i, text, badge;\n"
+   "    div.style.top = j * ROW + \"px\";\n"
+   "    if (i < 0) {\n"
+   "      div.className = \"group\";\n"
+   "      div.textContent = labels[-i - 1];\n"
+   "      return div;\n"
+   "    }\n"
+   "    div.className = \"grid row\" + (j % 2 ? \" even\" : \"\");\n"
+   "    cell(div, servers[rows[r]][0]);\n"
+   "    cell(div, strings[rows[r + 1]]);\n"
+   "    cell(div, strings[rows[r + 2]]);\n"
+   "    cell(div, strings[rows[r + 3]]);\n"
+   "    text = strings[rows[r + 4]];\n"
+   "    badge = document.createElement(\"span\");\n"
+   "    badge.className = \"badge badge-\" + (text === \"Default\" ? \"default\" : text === \"Modified\" ? \"modified\" : \"custom\");\n"
+   "    badge.textContent = text;\n"
+   "    cell(div, \"\").appendChild(badge);\n"
+   "    return div;\n"
+   "  }\n"
+   "\n"
+   "  function render(force) {\n"
+   "    var top = viewport.scrollTop, fragment = document.createDocumentFragment();\n"
+   "    var from = Math.max(0, Math.floor(top / ROW) - EXTRA);\n"
+   "    var to = Math.min(items.length, Math.ceil((top + viewport.clientHeight) / ROW) + EXTRA);\n"
+   "    if (!force && from === first && to === last) {\n"
+   "      return;\n"
+   "    }\n"
+   "    first = from;\n"
+   "    last = to;\n"
+   "    for (var j = from; j < to; j++) {\n"
+   "      fragment.appendChild(line(j));\n"
+   "    }\n"
+   "    body.textContent = \"\";\n"
+   "    body.appendChild(fragment);\n"
+   "  }\n"
+   "\n"
+   "  function update() {\n"
+   "    var text = filter.value.toLowerCase(), s = server.value, t = status.value, f = family.value;\n"
+   "    var matched = [], keys = [], sizes = {}, previous = null, r;\n"
+   "    matches = [];\n"
+   "    for (var i = 0; i < n; i++) {\n"
+   "      r = 5 * i;\n"
+   "      if ((s !== \"\" && rows[r] !== +s) || (t !== \"\" && rows[r + 4] !== +t) ||\n"
+   "          (f !== \"\" && familyOf(rows[r + 1]) !== f) ||\n"
+   "          (text !== \"\" && !matchOf(rows[r + 1], text) && !matchOf(rows[r + 2], text) && !matchOf(rows[r + 3], text))) {\n"
+   "        continue;\n"
+   "      }\n"
+   "      matched.push(i);\n"
+   "    }\n"
+   "    items = matched;\n"
+   "    labels = [];\n"
+   "    if (group.value !== \"\") {\n"
+   "      keys = matched.map(groupOf);\n"
+   "      keys.forEach(function (key) { sizes[key] = (sizes[key] || 0) + 1; });\n"
+   "      items = [];\n"
+   "      matched.map(function (_, j) { return j; }).sort(function (a, b) {\n"
+   "        return keys[a] < keys[b] ? -1 : keys[a] > keys[b] ? 1 : a - b;\n"
+   "      }).forEach(function (j) {\n"
+   "        if (keys[j] !== previous) {\n"
+   "          previous = keys[j];\n"
+   "          labels.push(previous + \" (\" + sizes[previous] + \")\");\n"
+   "          items.push(-labels.length);\n"
+   "        }\n"
+   "        items.push(matched[j]);\n"
+   "      });\n"
+   "    }\n"
+   "    count.textContent = matched.length + \" of \" + n + \" settings on \" + servers.length + \" servers\";\n"
+   "    body.style.height = items.length * ROW + \"px\";\n"
+   "    viewport.scrollTop = 0;\n"
+   "    render(true);\n"
+   "  }\n"
+   "\n"
+   "  var seen = {}, names = [];\n"
+   "  servers.forEach(function (s, i) { option(server, i, s[0] + \" (PostgreSQL \" + s[1] + \")\"); });\n"
+   "  for (var i = 0; i < n; i++) {\n"
+   "    seen[rows[5 * i + 4]] = true;\n"
+   "    if (names.indexOf(familyOf(rows[5 * i + 1])) < 0) {\n"
+   "      names.push(familyOf(rows[5 * i + 1]));\n"
+   "    }\n"
+   "  }\n"
+   "  Object.keys(seen).forEach(function (k) { option(status, k, strings[k]); });\n"
+   "  names.sort().forEach(function (name) { option(family, name, name); });\n"
+   "\n"
+   "  [server, status, family, group].forEach(function (e) { e.addEventListener(\"change\", update); });\n"
+   "  filter.addEventListener(\"input\", update);\n"
+   "  viewport.addEventListener(\"scroll\", function () { render(false); });\n"
+   "  window.addEventListener(\"resize\", function () { render(false); });\n"
+   "  update();\n"
+   "})();\n";
+
+static int html_create(const char* output_html_path, bool fleet, struct html_report** report);
+static int html_head(struct html_report* report);
+static int html_metadata(struct html_report* report, const char* label, const char* value);
+static int html_system(struct html_report* report);
+static int html_flush(struct html_report* report);
+static int html_write(struct html_report* report, const char* s, size_t length);
+static int html_puts(struct html_report* report, const char* s);
+static int html_escaped(struct html_report* report, const char* s);
+static int html_element(struct html_report* report, const char* tag, const char* text);
+static int html_json_string(struct html_report* report, const char* s);
+static int html_string_index(struct html_report* report, const char* s, uint32_t* index);
+static void html_destroy(struct html_report* report);
 
 int
 pgvictoria_generate_html_report(const char* output_html_path, int version, struct deque* items, const char* scope_label, const char* scope_value)
 {
-   pgvictoria_mkdir_parent(output_html_path);
+   struct html_report* report = NULL;
+   struct deque_iterator* it = NULL;
+   int ret = 0;
+
+   if (pgvictoria_html_report_open(output_html_path, version, scope_label, scope_value, &report))
+   {
+      return 1;
+   }
+
+   /* Rows go out as they are read, the report is never held in memory */
+   if (pgvictoria_deque_iterator_create(items, &it))
+   {
+      pgvictoria_html_report_close(report);
+      return 1;
+   }
+   while (pgvictoria_deque_iterator_next(it))
+   {
+      if (pgvictoria_html_report_row(report, (struct pgvictoria_diff_item*)it->value->data))
+      {
+         ret = 1;
+         break;
+      }
+   }
+   pgvictoria_deque_iterator_destroy(it);
+
+   if (pgvictoria_html_report_close(report) || ret)
+   {
+      return 1;
+   }
+
+   printf("Report successfully generated to %s\n", output_html_path);
+   return 0;
+}
+
+int
+pgvictoria_generate_html_fleet_report(const char* output_html_path, int version, struct deque* items, const char* scope_label, const char* scope_value)
+{
+   struct html_report* report = NULL;
+   struct deque_iterator* it = NULL;
+   int ret = 0;
 
-   /* Create HTML Document */
-   htmlDocPtr doc = htmlNewDoc(NULL, NULL);
-   if (!doc)
+   if (pgvictoria_html_fleet_open(output_html_path, scope_label, scope_value, &report))
    {
       return 1;
    }
 
-   /* Create <html> root node */
-   xmlNodePtr html = xmlNewNode(NULL, BAD_CAST "html");
-   xmlDocSetRootElement(doc, html);
-   xmlNewProp(html, BAD_CAST "lang", BAD_CAST "en");
-
-   /* Create <head> and <body> */
-   xmlNodePtr head_node = xmlNewChild(html, NULL, BAD_CAST "head", NULL);
-   xmlNodePtr body = xmlNewChild(html, NULL, BAD_CAST "body", NULL);
-
-   /* Head elements */
-   xmlNodePtr meta_charset = xmlNewChild(head_node, NULL, BAD_CAST "meta", NULL);
-   xmlNewProp(meta_charset, BAD_CAST "charset", BAD_CAST "UTF-8");
-   xmlNodePtr meta_vp = xmlNewChild(head_node, NULL, BAD_CAST "meta", NULL);
-   xmlNewProp(meta_vp, BAD_CAST "name", BAD_CAST "viewport");
-   xmlNewProp(meta_vp, BAD_CAST "content", BAD_CAST "width=device-width, initial-scale=1.0");
-
-   xmlNewChild(head_node, NULL, BAD_CAST "title", BAD_CAST "pgvictoria Configuration Report");
-
-   /* Monochrome Premium CSS Styling */
-   const char* style_content =
-      "body {\n"
-      "  font-family: -apple-system, BlinkMacSystemFont, \"Segoe UI\", Roboto, Helvetica, Arial, sans-serif;\n"
-      "  background-color: #ffffff;\n"
-      "  color: #111111;\n"
-      "  margin: 0;\n"
-      "  padding: 40px 20px;\n"
-      "  line-height: 1.5;\n"
-      "}\n"
-      ".container {\n"
-      "  max-width: 960px;\n"
-      "  margin: 0 auto;\n"
-      "}\n"
-      "h1 {\n"
-      "  font-size: 28px;\n"
-      "  font-weight: 700;\n"
-      "  margin-bottom: 8px;\n"
-      "  border-bottom: 2px solid #111111;\n"
-      "  padding-bottom: 12px;\n"
-      "  text-transform: uppercase;\n"
-      "  letter-spacing: 0.5px;\n"
-      "}\n"
-      "table.metadata {\n"
-      "  width: auto;\n"
-      "  margin: 0 0 30px 0;\n"
-      "  font-size: 14px;\n"
-      "  color: #666666;\n"
-      "}\n"
-      "table.metadata td {\n"
-      "  padding: 4px 16px 4px 0;\n"
-      "  border-bottom: none;\n"
-      "}\n"
-      "table.metadata td:first-child {\n"
-      "  font-weight: 700;\n"
-      "  color: #111111;\n"
-      "}\n"
-      "table {\n"
-      "  width: 100%;\n"
-      "  border-collapse: collapse;\n"
-      "  margin-top: 20px;\n"
-      "  font-size: 14px;\n"
-      "}\n"
-      "th {\n"
-      "  text-align: left;\n"
-      "  padding: 12px 10px;\n"
-      "  border-bottom: 2px solid #111111;\n"
-      "  font-weight: 700;\n"
-      "  text-transform: uppercase;\n"
-      "  font-size: 12px;\n"
-      "  color: #111111;\n"
-      "}\n"
-      "td {\n"
-      "  padding: 12px 10px;\n"
-      "  border-bottom: 1px solid #e5e5e5;\n"
-      "  vertical-align: middle;\n"
-      "  word-break: break-all;\n"
-      "}\n"
-      "tr:nth-child(even) td {\n"
-      "  background-color: #fafafa;\n"
-      "}\n"
-      "tr:hover td {\n"
-      "  background-color: #f0f0f0;\n"
-      "}\n"
-      ".badge {\n"
-      "  display: inline-block;\n"
-      "  font-size: 11px;\n"
-      "  font-weight: 700;\n"
-      "  padding: 4px 8px;\n"
-      "  text-transform: uppercase;\n"
-      "  border: 1px solid #111111;\n"
-      "  border-radius: 0;\n"
-      "  letter-spacing: 0.5px;\n"
-      "}\n"
-      ".badge-default {\n"
-      "  background-color: #f0f0f0;\n"
-      "  color: #333333;\n"
-      "  border-color: #cccccc;\n"
-      "}\n"
-      ".badge-modified {\n"
-      "  background-color: #333333;\n"
-      "  color: #ffffff;\n"
-      "  border-color: #333333;\n"
-      "}\n"
-      ".badge-custom {\n"
-      "  background-color: #ffffff;\n"
-      "  color: #111111;\n"
-      "  border-color: #111111;\n"
-      "  border-style: dashed;\n"
-      "}\n"
-      "@media print {\n"
-      "  body {\n"
-      "    padding: 0;\n"
-      "  }\n"
-      "  table {\n"
-      "    page-break-inside: auto;\n"
-      "  }\n"
-      "  tr {\n"
-      "    page-break-inside: avoid;\n"
-      "    page-break-after: auto;\n"
-      "  }\n"
-      "}\n";
-
-   xmlNewChild(head_node, NULL, BAD_CAST "style", BAD_CAST style_content);
-
-   /* Body elements container */
-   xmlNodePtr container = xmlNewChild(body, NULL, BAD_CAST "div", NULL);
-   xmlNewProp(container, BAD_CAST "class", BAD_CAST "container");
+   /* A single source is a fleet of one */
+   ret = pgvictoria_html_fleet_server(report, scope_value != NULL ? scope_value : "", version);
+
+   if (ret == 0 && pgvictoria_deque_iterator_create(items, &it))
+   {
+      ret = 1;
+   }
+   while (ret == 0 && pgvictoria_deque_iterator_next(it))
+   {
+      ret = pgvictoria_html_fleet_row(report, (struct pgvictoria_diff_item*)it->value->data);
+   }
+   pgvictoria_deque_iterator_destroy(it);
+
+   if (pgvictoria_html_fleet_close(report) || ret)
+   {
+      return 1;
+   }
+
+   printf("Report successfully generated to %s\n", output_html_path);
+   return 0;
+}
+
+int
+pgvictoria_html_report_open(const char* output_html_path, int version, const char* scope_label, const char* scope_value, struct html_report** report)
+{
+   struct html_report* r = NULL;
+   char text[256];
+
+   if (html_create(output_html_path, false, report))
+   {
+      return 1;
+   }
+   r = *report;
+
+   html_head(r);
 
    /* Title */
-   char title_text[256];
-   pgvictoria_snprintf(title_text, sizeof(title_text), "PostgreSQL %d Configuration Difference Report", version);
-   xmlNewChild(container, NULL, BAD_CAST "h1", BAD_CAST title_text);
+   pgvictoria_snprintf(text, sizeof(text), "PostgreSQL %d Configuration Difference Report", version);
+   html_element(r, "h1", text);
 
    /* Metadata block: a label/value table describing what was audited */
-   xmlNodePtr metadata_table = xmlNewChild(container, NULL, BAD_CAST "table", NULL);
-   xmlNewProp(metadata_table, BAD_CAST "class", BAD_CAST "metadata");
-   xmlNodePtr metadata_body = xmlNewChild(metadata_table, NULL, BAD_CAST "tbody", NULL);
+   html_puts(r, "<table class=\"metadata\"><tbody>\n");
 
    if (scope_label && scope_value)
    {
-      xmlNodePtr scope_row = xmlNewChild(metadata_body, NULL, BAD_CAST "tr", NULL);
-      xmlNewChild(scope_row, NULL, BAD_CAST "td", BAD_CAST scope_label);
-      xmlNewChild(scope_row, NULL, BAD_CAST "td", BAD_CAST scope_value);
+      html_metadata(r, scope_label, scope_value);
+   }
+
+   pgvictoria_snprintf(text, sizeof(text), "PostgreSQL %d", version);
+   html_metadata(r, "Version", text);
+   html_system(r);
+
+   html_puts(r, "</tbody></table>\n");
+
+   /* Table structure */
+   html_puts(r, "<table>\n"
+                "<thead><tr>\n"
+                "<th>Configuration Key</th>\n"
+                "<th>Baseline Default</th>\n"
+                "<th>Current Value</th>\n"
+                "<th>Status</th>\n"
+                "</tr></thead>\n"
+                "<tbody>\n");
+
+   if (r->error)
+   {
+      html_destroy(r);
+      *report = NULL;
+      return 1;
+   }
+
+   return 0;
+}
+
+int
+pgvictoria_html_report_row(struct html_report* report, struct pgvictoria_diff_item* item)
+{
+   const char* badge_class = "badge badge-custom";
+
+   if (strcmp(item->status, "Default") == 0)
+   {
+      badge_class = "badge badge-default";
+   }
+   else if (strcmp(item->status, "Modified") == 0)
+   {
+      badge_class = "badge badge-modified";
+   }
+
+   html_puts(report, "<tr>\n");
+   html_element(report, "td", item->key);
+   html_element(report, "td", item->baseline_val);
+   html_element(report, "td", item->current_val);
+   html_puts(report, "<td><span class=\"");
+   html_puts(report, badge_class);
+   html_puts(report, "\">");
+   html_escaped(report, item->status);
+   html_puts(report, "</span></td>\n"
+                     "</tr>\n");
+
+   return report->error ? 1 : 0;
+}
+
+int
+pgvictoria_html_report_close(struct html_report* report)
+{
+   int ret;
+
+   if (report == NULL)
+   {
+      return 1;
+   }
+
+   html_puts(report, "</tbody>\n"
+                     "</table>\n"
+                     "</div></body>\n"
+                     "</html>\n");
+   html_flush(report);
+
+   if (close(report->fd) == -1)
+   {
+      report->error = true;
+   }
+   report->fd = -1;
+
+   ret = report->error ? 1 : 0;
+   html_destroy(report);
+
+   return ret;
+}
+
+int
+pgvictoria_html_fleet_open(const char* output_html_path, const char* scope_label, const char* scope_value, struct html_report** report)
+{
+   struct html_report* r = NULL;
+
+   if (html_create(output_html_path, true, report))
+   {
+      return 1;
+   }
+   r = *report;
+
+   html_head(r);
+   html_element(r, "h1", "PostgreSQL Fleet Configuration Report");
+
+   html_puts(r, "<table class=\"metadata\"><tbody>\n");
+   if (scope_label && scope_value)
+   {
+      html_metadata(r, scope_label, scope_value);
+   }
+   html_system(r);
+   html_puts(r, "</tbody></table>\n");
+
+   /* The options are filled in by the script from the data */
+   html_puts(r, "<div class=\"controls\">\n"
+                "<input id=\"filter\" type=\"search\" placeholder=\"Filter keys and values\">\n"
+                "<select id=\"server\"><option value=\"\">All servers</option></select>\n"
+                "<select id=\"status\"><option value=\"\">All statuses</option></select>\n"
+                "<select id=\"family\"><option value=\"\">All families</option></select>\n"
+                "<select id=\"group\">"
+                "<option value=\"\">No grouping</option>"
+                "<option value=\"server\">Group by server</option>"
+                "<option value=\"status\">Group by status</option>"
+                "<option value=\"family\">Group by family</option>"
+                "</select>\n"
+                "<span id=\"count\" class=\"count\"></span>\n"
+                "</div>\n"
+                "<div class=\"grid grid-head\">"
+                "<span>Server</span>"
+                "<span>Configuration Key</span>"
+                "<span>Baseline Default</span>"
+                "<span>Current Value</span>"
+                "<span>Status</span>"
+                "</div>\n"
+                "<div id=\"viewport\" class=\"viewport\"><div id=\"rows\" class=\"rows\"></div></div>\n"
+                "<script id=\"pgvictoria-data\" type=\"application/json\">{\"rows\":[");
+
+   if (r->error)
+   {
+      html_destroy(r);
+      *report = NULL;
+      return 1;
+   }
+
+   return 0;
+}
+
+int
+pgvictoria_html_fleet_server(struct html_report* report, const char* name, int version)
+{
+   if (report == NULL || !report->fleet || name == NULL)
+   {
+      return 1;
+   }
+
+   return pgvictoria_deque_add(report->servers, (char*)name, (uintptr_t)version, ValueInt32);
+}
+
+int
+pgvictoria_html_fleet_row(struct html_report* report, struct pgvictoria_diff_item* item)
+{
+   uint32_t key = 0;
+   uint32_t baseline = 0;
+   uint32_t current = 0;
+   uint32_t status = 0;
+   uint32_t server;
+   char text[64];
+
+   if (report == NULL || !report->fleet || pgvictoria_deque_size(report->servers) == 0)
+   {
+      return 1;
+   }
+   server = pgvictoria_deque_size(report->servers) - 1;
+
+   if (html_string_index(report, item->key, &key) ||
+       html_string_index(report, item->baseline_val, &baseline) ||
+       html_string_index(report, item->current_val, &current) ||
+       html_string_index(report, item->status, &status))
+   {
+      return 1;
    }
 
-   char baseline_meta[128];
-   pgvictoria_snprintf(baseline_meta, sizeof(baseline_meta), "PostgreSQL %d", version);
-   xmlNodePtr version_row = xmlNewChild(metadata_body, NULL, BAD_CAST "tr", NULL);
-   xmlNewChild(version_row, NULL, BAD_CAST "td", BAD_CAST "Version");
-   xmlNewChild(version_row, NULL, BAD_CAST "td", BAD_CAST baseline_meta);
+   pgvictoria_snprintf(text, sizeof(text), "%s%u,%u,%u,%u,%u", report->number_of_rows > 0 ? "," : "",
+                       server, key, baseline, current, status);
+   html_puts(report, text);
+   report->number_of_rows++;
+
+   return report->error ? 1 : 0;
+}
 
+int
+pgvictoria_html_fleet_close(struct html_report* report)
+{
+   struct art_iterator* ai = NULL;
+   struct deque_iterator* di = NULL;
+   char** strings = NULL;
+   char text[32];
+   int ret;
+
+   if (report == NULL || !report->fleet)
+   {
+      return 1;
+   }
+
+   /* The distinct strings, in the order of their indexes */
+   strings = calloc(report->number_of_strings, sizeof(char*));
+   if (strings == NULL || pgvictoria_art_iterator_create(report->strings, &ai))
+   {
+      report->error = true;
+   }
+   while (ai != NULL && pgvictoria_art_iterator_next(ai))
+   {
+      strings[pgvictoria_value_data(ai->value)] = ai->key;
+   }
+
+   html_puts(report, "],\"strings\":[\"\"");
+   for (uint32_t i = 1; strings != NULL && i < report->number_of_strings; i++)
+   {
+      html_puts(report, ",");
+      html_json_string(report, strings[i]);
+   }
+
+   html_puts(report, "],\"servers\":[");
+   pgvictoria_deque_iterator_create(report->servers, &di);
+   for (int i = 0; pgvictoria_deque_iterator_next(di); i++)
+   {
+      pgvictoria_snprintf(text, sizeof(text), ",%d]", (int)pgvictoria_value_data(di->value));
+      html_puts(report, i > 0 ? ",[" : "[");
+      html_json_string(report, di->tag);
+      html_puts(report, text);
+   }
+   pgvictoria_deque_iterator_destroy(di);
+
+   html_puts(report, "]}</script>\n"
+                     "<script>\n");
+   html_puts(report, fleet_script_content);
+   html_puts(report, "</script>\n"
+                     "</div></body>\n"
+                     "</html>\n");
+   html_flush(report);
+
+   if (close(report->fd) == -1)
+   {
+      report->error = true;
+   }
+   report->fd = -1;
+
+   ret = report->error ? 1 : 0;
+
+   pgvictoria_art_iterator_destroy(ai);
+   free(strings);
+   html_destroy(report);
+
+   return ret;
+}
+
+static int
+html_create(const char* output_html_path, bool fleet, struct html_report** report)
+{
+   struct html_report* r = NULL;
+
+   *report = NULL;
+
+   pgvictoria_mkdir_parent(output_html_path);
+
+   r = calloc(1, sizeof(struct html_report));
+   if (r == NULL)
+   {
+      return 1;
+   }
+   r->fd = -1;
+   r->fleet = fleet;
+
+   if (fleet)
+   {
+      /* String 0 is the empty string, which is not a key of the tree */
+      r->number_of_strings = 1;
+      if (pgvictoria_art_create(&r->strings) || pgvictoria_deque_create(false, &r->servers))
+      {
+         html_destroy(r);
+         return 1;
+      }
+   }
+
+   r->fd = open(output_html_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (r->fd == -1)
+   {
+      html_destroy(r);
+      return 1;
+   }
+
+   *report = r;
+
+   return 0;
+}
+
+static int
+html_head(struct html_report* report)
+{
+   html_puts(report, "<!DOCTYPE html>\n"
+                     "<html lang=\"en\">\n"
+                     "<head>\n"
+                     "<meta charset=\"UTF-8\">\n"
+                     "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
+                     "<title>pgvictoria Configuration Report</title>\n"
+                     "<style>");
+   html_puts(report, style_content);
+   if (report->fleet)
+   {
+      html_puts(report, fleet_style_content);
+   }
+   html_puts(report, "</style>\n"
+                     "</head>\n"
+                     "<body><div class=\"container\">\n");
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_metadata(struct html_report* report, const char* label, const char* value)
+{
+   html_puts(report, "<tr>\n");
+   html_element(report, "td", label);
+   html_element(report, "td", value);
+   html_puts(report, "</tr>\n");
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_system(struct html_report* report)
+{
+   char text[256];
    char* os_name = NULL;
-   int k_major = 0, k_minor = 0, k_patch = 0;
+   int k_major = 0;
+   int k_minor = 0;
+   int k_patch = 0;
+
    if (pgvictoria_os_kernel_version(&os_name, &k_major, &k_minor, &k_patch) == 0)
    {
-      char os_meta[256];
-      pgvictoria_snprintf(os_meta, sizeof(os_meta), "%s %d.%d.%d", os_name, k_major, k_minor, k_patch);
-      xmlNodePtr system_row = xmlNewChild(metadata_body, NULL, BAD_CAST "tr", NULL);
-      xmlNewChild(system_row, NULL, BAD_CAST "td", BAD_CAST "System");
-      xmlNewChild(system_row, NULL, BAD_CAST "td", BAD_CAST os_meta);
+      pgvictoria_snprintf(text, sizeof(text), "%s %d.%d.%d", os_name, k_major, k_minor, k_patch);
+      html_metadata(report, "System", text);
       free(os_name);
    }
 
-   /* Table structure */
-   xmlNodePtr table = xmlNewChild(container, NULL, BAD_CAST "table", NULL);
-   xmlNodePtr thead = xmlNewChild(table, NULL, BAD_CAST "thead", NULL);
-   xmlNodePtr tbody = xmlNewChild(table, NULL, BAD_CAST "tbody", NULL);
+   return report->error ? 1 : 0;
+}
 
-   xmlNodePtr thr = xmlNewChild(thead, NULL, BAD_CAST "tr", NULL);
-   xmlNewChild(thr, NULL, BAD_CAST "th", BAD_CAST "Configuration Key");
-   xmlNewChild(thr, NULL, BAD_CAST "th", BAD_CAST "Baseline Default");
-   xmlNewChild(thr, NULL, BAD_CAST "th", BAD_CAST "Current Value");
-   xmlNewChild(thr, NULL, BAD_CAST "th", BAD_CAST "Status");
+static int
+html_flush(struct html_report* report)
+{
+   size_t written = 0;
+   ssize_t n;
 
-   /* Populate table rows from diff list */
-   struct deque_iterator* it = NULL;
-   pgvictoria_deque_iterator_create(items, &it);
-   while (pgvictoria_deque_iterator_next(it))
+   while (!report->error && written < report->length)
+   {
+      n = write(report->fd, report->buffer + written, report->length - written);
+      if (n == -1)
+      {
+         if (errno != EINTR)
+         {
+            report->error = true;
+         }
+         continue;
+      }
+      written += n;
+   }
+   report->length = 0;
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_write(struct html_report* report, const char* s, size_t length)
+{
+   size_t n;
+
+   while (length > 0 && !report->error)
+   {
+      if (report->length == HTML_BUFFER_SIZE)
+      {
+         html_flush(report);
+      }
+      n = HTML_BUFFER_SIZE - report->length;
+      n = length < n ? length : n;
+      memcpy(report->buffer + report->length, s, n);
+      report->length += n;
+      s += n;
+      length -= n;
+   }
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_puts(struct html_report* report, const char* s)
+{
+   return html_write(report, s, strlen(s));
+}
+
+static int
+html_escaped(struct html_report* report, const char* s)
+{
+   size_t run;
+
+   if (s == NULL)
    {
-      struct pgvictoria_diff_item* curr = (struct pgvictoria_diff_item*)it->value->data;
+      return report->error ? 1 : 0;
+   }
+
+   /* Copy the runs between the characters that need an entity */
+   while (*s != '\0')
+   {
+      run = strcspn(s, "&<>\"'");
+      html_write(report, s, run);
+      s += run;
+
+      switch (*s)
+      {
+         case '&':
+            html_write(report, "&amp;", 5);
+            break;
+         case '<':
+            html_write(report, "&lt;", 4);
+            break;
+         case '>':
+            html_write(report, "&gt;", 4);
+            break;
+         case '"':
+            html_write(report, "&quot;", 6);
+            break;
+         case '\'':
+            html_write(report, "&#39;", 5);
+            break;
+         default:
+            continue;
+      }
+      s++;
+   }
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_element(struct html_report* report, const char* tag, const char* text)
+{
+   html_puts(report, "<");
+   html_puts(report, tag);
+   html_puts(report, ">");
+   html_escaped(report, text);
+   html_puts(report, "</");
+   html_puts(report, tag);
+   html_puts(report, ">\n");
+
+   return report->error ? 1 : 0;
+}
+
+static int
+html_json_string(struct html_report* report, const char* s)
+{
+   char escape[8];
+   size_t run;
+
+   html_write(report, "\"", 1);
 
-      const char* disp_key = curr->key;
-      const char* def_val = curr->baseline_val;
-      const char* value = curr->current_val;
-      const char* status_text = curr->status;
-      const char* badge_class = "badge badge-custom";
+   /* Markup characters are escaped too, so the data can not end its script element */
+   while (*s != '\0')
+   {
+      for (run = 0; s[run] != '\0'; run++)
+      {
+         unsigned char c = (unsigned char)s[run];
+         if (c < 0x20 || c == '"' || c == '\\' || c == '<' || c == '>' || c == '&')
+         {
+            break;
+         }
+      }
+      html_write(report, s, run);
+      s += run;
 
-      if (strcmp(status_text, "Default") == 0)
+      if (*s == '\0')
+      {
+         break;
+      }
+      if (*s == '"' || *s == '\\')
       {
-         badge_class = "badge badge-default";
+         escape[0] = '\\';
+         escape[1] = *s;
+         html_write(report, escape, 2);
       }
-      else if (strcmp(status_text, "Modified") == 0)
+      else
       {
-         badge_class = "badge badge-modified";
+         pgvictoria_snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*s);
+         html_write(report, escape, 6);
       }
+      s++;
+   }
+
+   return html_write(report, "\"", 1);
+}
 
-      /* Append row to table */
-      xmlNodePtr tr = xmlNewChild(tbody, NULL, BAD_CAST "tr", NULL);
-      xmlNewChild(tr, NULL, BAD_CAST "td", BAD_CAST disp_key);
-      xmlNewChild(tr, NULL, BAD_CAST "td", BAD_CAST def_val);
-      xmlNewChild(tr, NULL, BAD_CAST "td", BAD_CAST value);
-      xmlNodePtr td_status = xmlNewChild(tr, NULL, BAD_CAST "td", NULL);
-      xmlNodePtr span_badge = xmlNewChild(td_status, NULL, BAD_CAST "span", BAD_CAST status_text);
-      xmlNewProp(span_badge, BAD_CAST "class", BAD_CAST badge_class);
+static int
+html_string_index(struct html_report* report, const char* s, uint32_t* index)
+{
+   uintptr_t value;
+
+   *index = 0;
+
+   if (s == NULL || *s == '\0')
+   {
+      return 0;
    }
-   pgvictoria_deque_iterator_destroy(it);
 
-   /* Save document to file */
-   int saved_bytes = htmlSaveFileEnc(output_html_path, doc, "UTF-8");
-   xmlFreeDoc(doc);
+   value = pgvictoria_art_search(report->strings, (char*)s);
+   if (value != 0)
+   {
+      *index = (uint32_t)value;
+      return 0;
+   }
 
-   if (saved_bytes < 0)
+   if (pgvictoria_art_insert(report->strings, (char*)s, (uintptr_t)report->number_of_strings, ValueUInt32))
    {
       return 1;
    }
+   *index = report->number_of_strings++;
 
-   printf("Report successfully generated to %s\n", output_html_path);
    return 0;
 }
+
+static void
+html_destroy(struct html_report* report)
+{
+   if (report == NULL)
+   {
+      return;
+   }
+
+   /* A report that was not closed leaves no descriptor behind */
+   if (report->fd != -1)
+   {
+      close(report->fd);
+   }
+   pgvictoria_art_destroy(report->strings);
+   pgvictoria_deque_destroy(report->servers);
+   free(report);
+}
@@ -0,0 +1,1095 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <art.h>
+#include <deque.h>
+#include <image.h>
+#include <json.h>
+#include <logging.h>
+#include <security.h>
+#include <utils.h>
+#include <value.h>
+
+/* system */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * An image starts with a header, followed by the containers and the strings.
+ * A container is a table of fixed size entries, and every reference is an
+ * offset from the start of the image. Containers are 8 byte aligned, strings
+ * are terminated by a zero byte and offset 0 is no string. The checksum covers
+ * everything after the header. Images are in the byte order of the machine
+ * that wrote them.
+ */
+#define IMAGE_HEADER_SIZE 32
+#define IMAGE_ALIGNMENT   8
+#define IMAGE_ORDER       0x01020304U
+
+/* A JSON object that has no type yet */
+#define IMAGE_KIND_EMPTY  0
+#define IMAGE_KIND_OBJECT 1
+#define IMAGE_KIND_ARRAY  2
+#define IMAGE_KIND_ART    3
+#define IMAGE_KIND_DEQUE  4
+
+#define IMAGE_CASE_INSENSITIVE 0x01
+#define IMAGE_THREAD_SAFE      0x02
+
+/* The deepest nesting a load follows, far beyond any configuration */
+#define IMAGE_MAX_DEPTH 64
+
+struct image_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t order;
+   uint64_t size;
+   uint32_t crc;
+   uint32_t root;
+};
+
+/* Objects and trees keep their entries in key order, folded for case-insensitive keys */
+struct image_container
+{
+   uint8_t kind;
+   uint8_t flags;
+   uint16_t reserved;
+   uint32_t count;
+};
+
+struct image_entry
+{
+   uint32_t key;
+   uint32_t key_length;
+   uint8_t type;
+   uint8_t reserved[3];
+   uint32_t length;
+   uint64_t data;
+};
+
+static int image_write(struct string_builder* builder, enum value_type type, uintptr_t data, uint32_t* offset);
+static int image_write_entry(struct string_builder* builder, uint64_t table, uint32_t index, char* key, struct value* value);
+static int image_write_string(struct string_builder* builder, char* s, uint32_t* offset, uint32_t* length);
+static int image_write_zero(struct string_builder* builder, size_t length);
+static int image_align(struct string_builder* builder);
+static enum value_type image_owning_type(enum value_type type);
+static int image_verify(void* data, size_t size);
+static struct image_container* image_container_at(void* data, size_t size, uint64_t offset);
+static struct image_container* image_container_of(struct image* image, struct image_value* value);
+static struct image_entry* image_entries(struct image_container* container);
+static int image_string(struct image* image, uint64_t offset, uint32_t length, char** string);
+static int image_entry_value(struct image* image, struct image_entry* entry, struct image_value* value);
+static int image_compare(char* s1, char* s2, bool fold);
+static int image_load(struct image* image, struct image_container* container, int depth, uintptr_t* data);
+static void image_destroy_data(enum value_type type, uintptr_t data);
+
+int
+pgvictoria_image_create(enum value_type type, uintptr_t data, void** image, size_t* size)
+{
+   struct string_builder builder;
+   struct image_header header;
+   uint32_t root = 0;
+   uint32_t crc = 0;
+
+   *image = NULL;
+   *size = 0;
+
+   pgvictoria_string_builder_init(&builder);
+
+   type = image_owning_type(type);
+   if (data == 0 || (type != ValueJSON && type != ValueART && type != ValueDeque))
+   {
+      goto error;
+   }
+
+   if (image_write_zero(&builder, IMAGE_HEADER_SIZE) ||
+       image_write(&builder, type, data, &root) ||
+       image_align(&builder))
+   {
+      goto error;
+   }
+
+   if (pgvictoria_init_crc32c(&crc) ||
+       pgvictoria_create_crc32c_buffer(builder.str + IMAGE_HEADER_SIZE, builder.length - IMAGE_HEADER_SIZE, &crc) ||
+       pgvictoria_finalize_crc32c(&crc))
+   {
+      goto error;
+   }
+
+   memset(&header, 0, sizeof(struct image_header));
+   memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+   header.version = IMAGE_VERSION;
+   header.order = IMAGE_ORDER;
+   header.size = builder.length;
+   header.crc = crc;
+   header.root = root;
+   memcpy(builder.str, &header, sizeof(struct image_header));
+
+   *size = builder.length;
+   *image = pgvictoria_string_builder_finish(&builder);
+
+   return 0;
+
+error:
+   pgvictoria_string_builder_destroy(&builder);
+   return 1;
+}
+
+int
+pgvictoria_image_write_file(char* path, enum value_type type, uintptr_t data)
+{
+   char tmp[MAX_PATH];
+   void* image = NULL;
+   size_t size = 0;
+   size_t written = 0;
+   ssize_t n;
+   int fd = -1;
+
+   if (path == NULL)
+   {
+      goto error;
+   }
+
+   if (pgvictoria_snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+   {
+      goto error;
+   }
+
+   if (pgvictoria_image_create(type, data, &image, &size))
+   {
+      pgvictoria_log_error("Failed to create image for %s", path);
+      goto error;
+   }
+
+   fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   if (fd == -1)
+   {
+      pgvictoria_log_error("Failed to create image file %s (%s)", tmp, strerror(errno));
+      goto error;
+   }
+
+   while (written < size)
+   {
+      n = write(fd, (char*)image + written, size - written);
+      if (n == -1)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         pgvictoria_log_error("Failed to write image file %s (%s)", tmp, strerror(errno));
+         goto error;
+      }
+      written += n;
+   }
+
+   if (fsync(fd) == -1 || close(fd) == -1)
+   {
+      fd = -1;
+      pgvictoria_log_error("Failed to write image file %s (%s)", tmp, strerror(errno));
+      goto error;
+   }
+   fd = -1;
+
+   // Readers that mapped the old file keep it until they close it
+   if (pgvictoria_move_file(tmp, path))
+   {
+      goto error;
+   }
+
+   free(image);
+
+   return 0;
+
+error:
+   if (fd != -1)
+   {
+      close(fd);
+   }
+   if (image != NULL)
+   {
+      unlink(tmp);
+   }
+   free(image);
+   return 1;
+}
+
+int
+pgvictoria_image_open(char* path, struct image** image)
+{
+   struct image* i = NULL;
+   struct stat st;
+   void* data = MAP_FAILED;
+   int fd = -1;
+
+   *image = NULL;
+
+   if (path == NULL)
+   {
+      goto error;
+   }
+
+   fd = open(path, O_RDONLY);
+   if (fd == -1)
+   {
+      pgvictoria_log_error("Failed to open image file %s (%s)", path, strerror(errno));
+      goto error;
+   }
+
+   if (fstat(fd, &st) == -1 || st.st_size < IMAGE_HEADER_SIZE)
+   {
+      pgvictoria_log_error("Invalid image file %s", path);
+      goto error;
+   }
+
+   data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   if (data == MAP_FAILED)
+   {
+      pgvictoria_log_error("Failed to map image file %s (%s)", path, strerror(errno));
+      goto error;
+   }
+
+   close(fd);
+   fd = -1;
+
+   if (image_verify(data, st.st_size))
+   {
+      pgvictoria_log_error("Invalid image file %s", path);
+      goto error;
+   }
+
+   i = malloc(sizeof(struct image));
+   if (i == NULL)
+   {
+      goto error;
+   }
+
+   i->data = data;
+   i->size = st.st_size;
+   i->mapped = true;
+
+   *image = i;
+
+   return 0;
+
+error:
+   if (data != MAP_FAILED)
+   {
+      munmap(data, st.st_size);
+   }
+   if (fd != -1)
+   {
+      close(fd);
+   }
+   return 1;
+}
+
+int
+pgvictoria_image_attach(void* data, size_t size, struct image** image)
+{
+   struct image* i = NULL;
+
+   *image = NULL;
+
+   if (image_verify(data, size))
+   {
+      return 1;
+   }
+
+   i = malloc(sizeof(struct image));
+   if (i == NULL)
+   {
+      return 1;
+   }
+
+   i->data = data;
+   i->size = size;
+   i->mapped = false;
+
+   *image = i;
+
+   return 0;
+}
+
+int
+pgvictoria_image_root(struct image* image, struct image_value* value)
+{
+   struct image_header* header = NULL;
+   struct image_container* container = NULL;
+
+   if (image == NULL || value == NULL)
+   {
+      return 1;
+   }
+
+   header = (struct image_header*)image->data;
+   container = image_container_at(image->data, image->size, header->root);
+   if (container == NULL)
+   {
+      return 1;
+   }
+
+   value->type = container->kind == IMAGE_KIND_ART ? ValueART : container->kind == IMAGE_KIND_DEQUE ? ValueDeque : ValueJSON;
+   value->data = 0;
+   value->length = container->count;
+   value->offset = header->root;
+
+   return 0;
+}
+
+int
+pgvictoria_image_get(struct image* image, struct image_value* container, char* key, struct image_value* value)
+{
+   struct image_container* c = NULL;
+   struct image_entry* entries = NULL;
+   char* k = NULL;
+   bool fold;
+   uint32_t low = 0;
+   uint32_t high;
+   uint32_t middle;
+   int cmp;
+
+   if (key == NULL || value == NULL)
+   {
+      return 1;
+   }
+
+   c = image_container_of(image, container);
+   if (c == NULL)
+   {
+      return 1;
+   }
+   entries = image_entries(c);
+
+   if (c->kind == IMAGE_KIND_DEQUE)
+   {
+      // Tags are not unique, so the first one wins like pgvictoria_deque_get()
+      for (uint32_t i = 0; i < c->count; i++)
+      {
+         if (image_string(image, entries[i].key, entries[i].key_length, &k))
+         {
+            return 1;
+         }
+         if (k != NULL && !strcmp(key, k))
+         {
+            return image_entry_value(image, &entries[i], value);
+         }
+      }
+      return 1;
+   }
+
+   if (c->kind != IMAGE_KIND_OBJECT && c->kind != IMAGE_KIND_ART)
+   {
+      return 1;
+   }
+
+   fold = (c->flags & IMAGE_CASE_INSENSITIVE) != 0;
+   high = c->count;
+   while (low < high)
+   {
+      middle = low + (high - low) / 2;
+      if (image_string(image, entries[middle].key, entries[middle].key_length, &k) || k == NULL)
+      {
+         return 1;
+      }
+      cmp = image_compare(key, k, fold);
+      if (cmp == 0)
+      {
+         return image_entry_value(image, &entries[middle], value);
+      }
+      if (cmp < 0)
+      {
+         high = middle;
+      }
+      else
+      {
+         low = middle + 1;
+      }
+   }
+
+   return 1;
+}
+
+int
+pgvictoria_image_at(struct image* image, struct image_value* container, uint32_t index, char** key, struct image_value* value)
+{
+   struct image_container* c = NULL;
+   struct image_entry* entry = NULL;
+   char* k = NULL;
+
+   if (value == NULL)
+   {
+      return 1;
+   }
+
+   c = image_container_of(image, container);
+   if (c == NULL || index >= c->count)
+   {
+      return 1;
+   }
+   entry = &image_entries(c)[index];
+
+   if (image_string(image, entry->key, entry->key_length, &k))
+   {
+      return 1;
+   }
+   if (key != NULL)
+   {
+      *key = k;
+   }
+
+   return image_entry_value(image, entry, value);
+}
+
+int
+pgvictoria_image_load(struct image* image, struct image_value* container, uintptr_t* data)
+{
+   struct image_container* c = NULL;
+
+   *data = 0;
+
+   c = image_container_of(image, container);
+   if (c == NULL)
+   {
+      return 1;
+   }
+
+   return image_load(image, c, 0, data);
+}
+
+void
+pgvictoria_image_close(struct image* image)
+{
+   if (image == NULL)
+   {
+      return;
+   }
+
+   if (image->mapped)
+   {
+      munmap(image->data, image->size);
+   }
+
+   free(image);
+}
+
+static int
+image_write(struct string_builder* builder, enum value_type type, uintptr_t data, uint32_t* offset)
+{
+   struct image_container container;
+   struct json* json = NULL;
+   struct art* tree = NULL;
+   struct deque* deque = NULL;
+   struct art_iterator* ai = NULL;
+   struct deque_iterator* di = NULL;
+   uint64_t table;
+   uint32_t index = 0;
+
+   memset(&container, 0, sizeof(struct image_container));
+
+   switch (type)
+   {
+      case ValueJSON:
+         json = (struct json*)data;
+         if (json == NULL)
+         {
+            goto error;
+         }
+         if (json->type == JSONItem)
+         {
+            tree = (struct art*)json->elements;
+            container.kind = IMAGE_KIND_OBJECT;
+         }
+         else if (json->type == JSONArray)
+         {
+            deque = (struct deque*)json->elements;
+            container.kind = IMAGE_KIND_ARRAY;
+         }
+         else
+         {
+            container.kind = IMAGE_KIND_EMPTY;
+         }
+         break;
+      case ValueART:
+         tree = (struct art*)data;
+         container.kind = IMAGE_KIND_ART;
+         break;
+      case ValueDeque:
+         deque = (struct deque*)data;
+         container.kind = IMAGE_KIND_DEQUE;
+         break;
+      default:
+         goto error;
+   }
+
+   if (tree != NULL)
+   {
+      container.count = tree->size;
+      container.flags = tree->case_insensitive ? IMAGE_CASE_INSENSITIVE : 0;
+   }
+   else if (deque != NULL)
+   {
+      container.count = pgvictoria_deque_size(deque);
+      container.flags = deque->thread_safe ? IMAGE_THREAD_SAFE : 0;
+   }
+
+   if (image_align(builder))
+   {
+      goto error;
+   }
+
+   table = builder->length + sizeof(struct image_container);
+   if (table + (uint64_t)container.count * sizeof(struct image_entry) > UINT32_MAX)
+   {
+      goto error;
+   }
+
+   *offset = builder->length;
+   if (pgvictoria_string_builder_append_length(builder, (char*)&container, sizeof(struct image_container)) ||
+       image_write_zero(builder, (size_t)container.count * sizeof(struct image_entry)))
+   {
+      goto error;
+   }
+
+   if (tree != NULL)
+   {
+      if (pgvictoria_art_iterator_create(tree, &ai))
+      {
+         goto error;
+      }
+      while (pgvictoria_art_iterator_next(ai))
+      {
+         if (index >= container.count || image_write_entry(builder, table, index, ai->key, ai->value))
+         {
+            goto error;
+         }
+         index++;
+      }
+   }
+   else if (deque != NULL)
+   {
+      if (pgvictoria_deque_iterator_create(deque, &di))
+      {
+         goto error;
+      }
+      while (pgvictoria_deque_iterator_next(di))
+      {
+         if (index >= container.count || image_write_entry(builder, table, index, di->tag, di->value))
+         {
+            goto error;
+         }
+         index++;
+      }
+   }
+
+   // A concurrent deque may have changed since its size was taken
+   if (index != container.count)
+   {
+      goto error;
+   }
+
+   pgvictoria_art_iterator_destroy(ai);
+   pgvictoria_deque_iterator_destroy(di);
+
+   return 0;
+
+error:
+   pgvictoria_art_iterator_destroy(ai);
+   pgvictoria_deque_iterator_destroy(di);
+   return 1;
+}
+
+static int
+image_write_entry(struct string_builder* builder, uint64_t table, uint32_t index, char* key, struct value* value)
+{
+   struct image_entry entry;
+   enum value_type type;
+   uintptr_t data;
+   uint32_t offset = 0;
+
+   memset(&entry, 0, sizeof(struct image_entry));
+
+   type = image_owning_type(pgvictoria_value_type(value));
+   data = pgvictoria_value_data(value);
+
+   if (key != NULL && image_write_string(builder, key, &entry.key, &entry.key_length))
+   {
+      return 1;
+   }
+
+   entry.type = type;
+
+   switch (type)
+   {
+      case ValueInt8:
+      case ValueUInt8:
+      case ValueInt16:
+      case ValueUInt16:
+      case ValueInt32:
+      case ValueUInt32:
+      case ValueInt64:
+      case ValueUInt64:
+      case ValueChar:
+      case ValueBool:
+      case ValueFloat:
+      case ValueDouble:
+         entry.data = data;
+         break;
+      case ValueString:
+      case ValueBASE64:
+         if (data != 0)
+         {
+            if (image_write_string(builder, (char*)data, &offset, &entry.length))
+            {
+               return 1;
+            }
+            entry.data = offset;
+         }
+         break;
+      case ValueJSON:
+      case ValueART:
+      case ValueDeque:
+         if (image_write(builder, type, data, &offset))
+         {
+            return 1;
+         }
+         entry.data = offset;
+         break;
+      default:
+         // Memory and references to unknown data can not be written
+         return 1;
+   }
+
+   memcpy(builder->str + table + (uint64_t)index * sizeof(struct image_entry), &entry, sizeof(struct image_entry));
+
+   return 0;
+}
+
+static int
+image_write_string(struct string_builder* builder, char* s, uint32_t* offset, uint32_t* length)
+{
+   size_t l = strlen(s);
+
+   if (builder->length + l + 1 > UINT32_MAX)
+   {
+      return 1;
+   }
+
+   *offset = builder->length;
+   *length = l;
+
+   return pgvictoria_string_builder_append_length(builder, s, l + 1);
+}
+
+static int
+image_write_zero(struct string_builder* builder, size_t length)
+{
+   static char zero[64];
+   size_t n;
+
+   while (length > 0)
+   {
+      n = length < sizeof(zero) ? length : sizeof(zero);
+      if (pgvictoria_string_builder_append_length(builder, zero, n))
+      {
+         return 1;
+      }
+      length -= n;
+   }
+
+   return 0;
+}
+
+static int
+image_align(struct string_builder* builder)
+{
+   return image_write_zero(builder, (IMAGE_ALIGNMENT - builder->length % IMAGE_ALIGNMENT) % IMAGE_ALIGNMENT);
+}
+
+static enum value_type
+image_owning_type(enum value_type type)
+{
+   switch (type)
+   {
+      case ValueStringRef:
+         return ValueString;
+      case ValueBASE64Ref:
+         return ValueBASE64;
+      case ValueJSONRef:
+         return ValueJSON;
+      case ValueDequeRef:
+         return ValueDeque;
+      case ValueARTRef:
+         return ValueART;
+      default:
+         return type;
+   }
+}
+
+static int
+image_verify(void* data, size_t size)
+{
+   struct image_header* header = NULL;
+   uint32_t crc = 0;
+
+   if (data == NULL || size < IMAGE_HEADER_SIZE || ((uintptr_t)data % IMAGE_ALIGNMENT) != 0)
+   {
+      return 1;
+   }
+
+   header = (struct image_header*)data;
+   if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) ||
+       header->version != IMAGE_VERSION ||
+       header->order != IMAGE_ORDER ||
+       header->size != size)
+   {
+      return 1;
+   }
+
+   if (image_container_at(data, size, header->root) == NULL)
+   {
+      return 1;
+   }
+
+   if (pgvictoria_init_crc32c(&crc) ||
+       pgvictoria_create_crc32c_buffer((char*)data + IMAGE_HEADER_SIZE, size - IMAGE_HEADER_SIZE, &crc) ||
+       pgvictoria_finalize_crc32c(&crc))
+   {
+      return 1;
+   }
+
+   return pgvictoria_compare_crc32c(crc, header->crc) ? 0 : 1;
+}
+
+static struct image_container*
+image_container_at(void* data, size_t size, uint64_t offset)
+{
+   struct image_container* container = NULL;
+
+   if (offset < IMAGE_HEADER_SIZE || offset % IMAGE_ALIGNMENT != 0 || offset + sizeof(struct image_container) > size)
+   {
+      return NULL;
+   }
+
+   container = (struct image_container*)((char*)data + offset);
+   if (container->kind > IMAGE_KIND_DEQUE ||
+       offset + sizeof(struct image_container) + (uint64_t)container->count * sizeof(struct image_entry) > size)
+   {
+      return NULL;
+   }
+
+   return container;
+}
+
+static struct image_container*
+image_container_of(struct image* image, struct image_value* value)
+{
+   struct image_container* container = NULL;
+
+   if (image == NULL || value == NULL)
+   {
+      return NULL;
+   }
+
+   container = image_container_at(image->data, image->size, value->offset);
+   if (container == NULL)
+   {
+      return NULL;
+   }
+
+   switch (value->type)
+   {
+      case ValueJSON:
+         if (container->kind == IMAGE_KIND_EMPTY || container->kind == IMAGE_KIND_OBJECT || container->kind == IMAGE_KIND_ARRAY)
+         {
+            return container;
+         }
+         break;
+      case ValueART:
+         if (container->kind == IMAGE_KIND_ART)
+         {
+            return container;
+         }
+         break;
+      case ValueDeque:
+         if (container->kind == IMAGE_KIND_DEQUE)
+         {
+            return container;
+         }
+         break;
+      default:
+         break;
+   }
+
+   return NULL;
+}
+
+static struct image_entry*
+image_entries(struct image_container* container)
+{
+   return (struct image_entry*)(container + 1);
+}
+
+static int
+image_string(struct image* image, uint64_t offset, uint32_t length, char** string)
+{
+   *string = NULL;
+
+   if (offset == 0)
+   {
+      return 0;
+   }
+
+   if (offset < IMAGE_HEADER_SIZE || offset + length >= image->size || ((char*)image->data)[offset + length] != '\0')
+   {
+      return 1;
+   }
+
+   *string = (char*)image->data + offset;
+
+   return 0;
+}
+
+static int
+image_entry_value(struct image* image, struct image_entry* entry, struct image_value* value)
+{
+   struct image_container* container = NULL;
+   char* s = NULL;
+
+   value->type = entry->type;
+   value->data = 0;
+   value->length = 0;
+   value->offset = 0;
+
+   switch (entry->type)
+   {
+      case ValueInt8:
+      case ValueUInt8:
+      case ValueInt16:
+      case ValueUInt16:
+      case ValueInt32:
+      case ValueUInt32:
+      case ValueInt64:
+      case ValueUInt64:
+      case ValueChar:
+      case ValueBool:
+      case ValueFloat:
+      case ValueDouble:
+         value->data = (uintptr_t)entry->data;
+         return 0;
+      case ValueString:
+      case ValueBASE64:
+         if (image_string(image, entry->data, entry->length, &s))
+         {
+            return 1;
+         }
+         value->data = (uintptr_t)s;
+         value->length = entry->length;
+         return 0;
+      case ValueJSON:
+      case ValueART:
+      case ValueDeque:
+         value->offset = entry->data;
+         container = image_container_of(image, value);
+         if (container == NULL || value->offset != entry->data)
+         {
+            return 1;
+         }
+         value->length = container->count;
+         return 0;
+      default:
+         return 1;
+   }
+}
+
+static int
+image_compare(char* s1, char* s2, bool fold)
+{
+   unsigned char c1;
+   unsigned char c2;
+
+   do
+   {
+      c1 = (unsigned char)*s1++;
+      c2 = (unsigned char)*s2++;
+      // Folded like the keys of a case-insensitive ART, which orders them
+      if (fold)
+      {
+         c1 = c1 >= 'A' && c1 <= 'Z' ? c1 + ('a' - 'A') : c1;
+         c2 = c2 >= 'A' && c2 <= 'Z' ? c2 + ('a' - 'A') : c2;
+      }
+      if (c1 != c2)
+      {
+         return c1 - c2;
+      }
+   }
+   while (c1 != '\0');
+
+   return 0;
+}
+
+static int
+image_load(struct image* image, struct image_container* container, int depth, uintptr_t* data)
+{
+   struct json* json = NULL;
+   struct art* tree = NULL;
+   struct deque* deque = NULL;
+   struct image_entry* entries = NULL;
+   struct image_value value;
+   uintptr_t child = 0;
+   uint64_t end;
+   char* key = NULL;
+   int ret = 0;
+
+   if (container == NULL || depth >= IMAGE_MAX_DEPTH)
+   {
+      return 1;
+   }
+
+   entries = image_entries(container);
+
+   /* Children are written after the table of their parent, so a reference back is a cycle */
+   end = (uint64_t)((char*)container - (char*)image->data) + sizeof(struct image_container) +
+         (uint64_t)container->count * sizeof(struct image_entry);
+
+   switch (container->kind)
+   {
+      case IMAGE_KIND_EMPTY:
+      case IMAGE_KIND_OBJECT:
+      case IMAGE_KIND_ARRAY:
+         ret = pgvictoria_json_create(&json);
+         break;
+      case IMAGE_KIND_ART:
+         ret = (container->flags & IMAGE_CASE_INSENSITIVE) ? pgvictoria_art_create_case_insensitive(&tree) : pgvictoria_art_create(&tree);
+         break;
+      case IMAGE_KIND_DEQUE:
+         ret = pgvictoria_deque_create((container->flags & IMAGE_THREAD_SAFE) != 0, &deque);
+         break;
+      default:
+         ret = 1;
+         break;
+   }
+   if (ret)
+   {
+      goto error;
+   }
+
+   for (uint32_t i = 0; i < container->count; i++)
+   {
+      child = 0;
+      if (image_string(image, entries[i].key, entries[i].key_length, &key) ||
+          image_entry_value(image, &entries[i], &value))
+      {
+         goto error;
+      }
+
+      if (value.type == ValueJSON || value.type == ValueART || value.type == ValueDeque)
+      {
+         if (value.offset < end ||
+             image_load(image, image_container_at(image->data, image->size, value.offset), depth + 1, &child))
+         {
+            goto error;
+         }
+         value.data = child;
+      }
+
+      switch (container->kind)
+      {
+         case IMAGE_KIND_OBJECT:
+            ret = pgvictoria_json_put(json, key, value.data, value.type);
+            // Once the object has a tree it can fold the keys that follow
+            if (ret == 0 && i == 0 && (container->flags & IMAGE_CASE_INSENSITIVE))
+            {
+               ret = pgvictoria_json_case_insensitive(json);
+            }
+            break;
+         case IMAGE_KIND_ARRAY:
+            ret = pgvictoria_json_append(json, value.data, value.type);
+            break;
+         case IMAGE_KIND_ART:
+            ret = key != NULL ? pgvictoria_art_insert(tree, key, value.data, value.type) : 1;
+            break;
+         case IMAGE_KIND_DEQUE:
+            ret = pgvictoria_deque_add(deque, key, value.data, value.type);
+            break;
+         default:
+            ret = 1;
+            break;
+      }
+      if (ret)
+      {
+         image_destroy_data(value.type, child);
+         goto error;
+      }
+   }
+
+   *data = json != NULL ? (uintptr_t)json : tree != NULL ? (uintptr_t)tree : (uintptr_t)deque;
+
+   return 0;
+
+error:
+   pgvictoria_json_destroy(json);
+   pgvictoria_art_destroy(tree);
+   pgvictoria_deque_destroy(deque);
+   return 1;
+}
+
+static void
+image_destroy_data(enum value_type type, uintptr_t data)
+{
+   if (data == 0)
+   {
+      return;
+   }
+
+   switch (type)
+   {
+      case ValueJSON:
+         pgvictoria_json_destroy((struct json*)data);
+         break;
+      case ValueART:
+         pgvictoria_art_destroy((struct art*)data);
+         break;
+      case ValueDeque:
+         pgvictoria_deque_destroy((struct deque*)data);
+         break;
+      default:
+         break;
+   }
+}
@@ -32,6 +32,7 @@
 #include <art.h>
 #include <json.h>
 #include <logging.h>
+#include <memory.h>
 #include <stream.h>
 #include <utils.h>
 
@@ -43,6 +44,58 @@
 #include <string.h>
 #include <unistd.h>
 
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+/* The number of bytes classified at a time by the structural index */
+#define JSON_BLOCK 64
+
+/**
+ * The characters of interest in a block, one bit per byte
+ */
+struct json_masks
+{
+   uint64_t quote;      /**< The quotes */
+   uint64_t backslash;  /**< The backslashes */
+   uint64_t structural; /**< The braces, brackets, colons and commas */
+   uint64_t whitespace; /**< The spaces, tabs and line breaks */
+};
+
+/**
+ * An object or array that is being parsed
+ */
+struct json_frame
+{
+   struct json* json; /**< The object or array */
+   bool object;       /**< Is it an object */
+   uint64_t base;     /**< The first pending member of the object */
+};
+
+/**
+ * The state of a document parse. The first pass indexes the structural
+ * characters, the quotes and the start of every scalar, the second pass
+ * walks the index to build the document
+ */
+struct json_parser
+{
+   char* str;                    /**< The document */
+   uint64_t length;              /**< The length of the document */
+   uint32_t* positions;          /**< The positions of the tokens */
+   uint64_t count;               /**< The number of tokens */
+   struct memory_arena* arena;   /**< The arena of the document */
+   struct memory_arena* scratch; /**< The arena of the keys and strings until they are copied */
+   struct json* root;            /**< The document */
+   struct json_frame* frames;    /**< The open objects and arrays */
+   uint64_t depth;               /**< The number of open objects and arrays */
+   uint64_t capacity;            /**< The number of frames */
+   struct art_entry* pending;    /**< The members of the open objects */
+   uint64_t pending_count;       /**< The number of pending members */
+   uint64_t pending_capacity;    /**< The number of pending members there is room for */
+};
+
 static int advance_to_first_array_element(struct json_reader* reader);
 static int json_read(struct json_reader* reader);
 static bool json_next_char(struct json_reader* reader, char* next);
@@ -50,13 +103,36 @@ static bool json_peek_next_char(struct json_reader* reader, char* next);
 static int json_fast_forward_value(struct json_reader* reader, char ch);
 static int json_stream_parse_item(struct json_reader* reader, struct json** item);
 static bool type_allowed(enum value_type type);
-static char* item_to_string(struct json* item, int32_t format, char* tag, int indent);
-static char* array_to_string(struct json* array, int32_t format, char* tag, int indent);
-static int parse_string(char* str, uint64_t* index, struct json** obj);
-static int json_add(struct json* obj, char* key, uintptr_t val, enum value_type type);
-static int fill_value(char* str, char* key, uint64_t* index, struct json* o);
-static bool value_start(char ch);
-static int handle_escape_char(char* str, uint64_t* index, uint64_t len, char* ch);
+static int item_to_builder(struct json* item, int32_t format, char* tag, int indent, struct string_builder* builder);
+static int array_to_builder(struct json* array, int32_t format, char* tag, int indent, struct string_builder* builder);
+static int parse_document(char* str, uint64_t length, struct json** obj);
+static int json_index(struct json_parser* parser);
+static void json_classify(unsigned char* in, struct json_masks* masks);
+#if defined(HAVE_NEON)
+static uint64_t json_movemask(uint8x16_t* cmp);
+#endif
+static uint64_t json_escaped(uint64_t backslash, uint64_t* carry);
+static uint64_t json_prefix_xor(uint64_t bits);
+static int json_build(struct json_parser* parser);
+static struct json_frame* json_push(struct json_parser* parser, struct json* json, bool object);
+static int json_pop(struct json_parser* parser);
+static int json_frame_add(struct json_parser* parser, struct json_frame* frame, char* key, uintptr_t data, enum value_type type);
+static int json_string(struct json_parser* parser, uint64_t* index, char** str);
+static int json_hex(char* str, uint32_t length, uint32_t* value);
+static int json_utf8(uint32_t codepoint, char* out);
+static int json_scalar(struct json_parser* parser, uint32_t start, uintptr_t* data, enum value_type* type);
+static int json_literal(char* str, uint32_t length, uintptr_t* data, enum value_type* type);
+static int json_stream_fill(struct json_stream* stream);
+static bool json_stream_peek(struct json_stream* stream, char* c);
+static bool json_stream_take(struct json_stream* stream, char* c);
+static int json_stream_append(struct json_stream* stream, char* data, size_t length);
+static int json_stream_string(struct json_stream* stream, struct json_event* event);
+static int json_stream_escape(struct json_stream* stream);
+static int json_stream_scalar(struct json_stream* stream, struct json_event* event);
+static int json_stream_open(struct json_stream* stream, bool object, struct json_event* event);
+static int json_stream_close(struct json_stream* stream, bool object, struct json_event* event);
+static void json_stream_done(struct json_stream* stream);
+static int json_stream_skip_raw(struct json_stream* stream);
 
 int
 pgvictoria_json_reader_init(char* path, struct json_reader** reader)
@@ -336,13 +412,238 @@ done:
    return false;
 }
 
+int
+pgvictoria_json_stream_init(char* path, struct json_stream** stream)
+{
+   int fd = -1;
+
+   *stream = NULL;
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0)
+   {
+      pgvictoria_log_error("json: could not open %s: %s", path, strerror(errno));
+      goto error;
+   }
+   if (pgvictoria_json_stream_init_fd(fd, stream))
+   {
+      goto error;
+   }
+   (*stream)->owns_fd = true;
+
+   return 0;
+
+error:
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+   return 1;
+}
+
+int
+pgvictoria_json_stream_init_fd(int fd, struct json_stream** stream)
+{
+   struct json_stream* s = NULL;
+
+   *stream = NULL;
+
+   s = calloc(1, sizeof(struct json_stream));
+   if (s == NULL)
+   {
+      goto error;
+   }
+   pgvictoria_stream_buffer_init(&s->buffer);
+   if (s->buffer == NULL || s->buffer->buffer == NULL)
+   {
+      goto error;
+   }
+   s->fd = fd;
+   s->expect = JSONExpectValue;
+   s->last = JSONEventNone;
+
+   *stream = s;
+
+   return 0;
+
+error:
+   if (s != NULL)
+   {
+      pgvictoria_stream_buffer_free(s->buffer);
+      free(s);
+   }
+   return 1;
+}
+
+int
+pgvictoria_json_stream_next(struct json_stream* stream, struct json_event* event)
+{
+   struct stream_buffer* b = stream->buffer;
+   bool object;
+   char c = 0;
+
+   memset(event, 0, sizeof(struct json_event));
+
+   if (stream->error)
+   {
+      return 1;
+   }
+
+   while (true)
+   {
+      // whitespace is skipped straight in the buffer
+      while (true)
+      {
+         if (b->cursor == b->end && json_stream_fill(stream))
+         {
+            goto end;
+         }
+         c = b->buffer[b->cursor];
+         if (c != ' ' && c != '\n' && c != '\t' && c != '\r')
+         {
+            break;
+         }
+         b->cursor++;
+      }
+
+      object = stream->depth > 0 && (stream->objects[(stream->depth - 1) / 64] & (1ULL << ((stream->depth - 1) % 64)));
+      event->depth = stream->depth;
+
+      switch (stream->expect)
+      {
+         case JSONExpectKey:
+            b->cursor++;
+            if (c == '}')
+            {
+               return json_stream_close(stream, true, event);
+            }
+            if (c != '"' || json_stream_string(stream, event))
+            {
+               goto error;
+            }
+            event->type = JSONEventKey;
+            stream->expect = JSONExpectColon;
+            stream->last = JSONEventKey;
+            return 0;
+         case JSONExpectColon:
+            b->cursor++;
+            if (c != ':')
+            {
+               goto error;
+            }
+            stream->expect = JSONExpectValue;
+            break;
+         case JSONExpectNext:
+            b->cursor++;
+            if (c == ',')
+            {
+               stream->expect = object ? JSONExpectKey : JSONExpectValue;
+               break;
+            }
+            if (c == '}' || c == ']')
+            {
+               return json_stream_close(stream, c == '}', event);
+            }
+            goto error;
+         case JSONExpectValue:
+            if (c == '{' || c == '[')
+            {
+               b->cursor++;
+               return json_stream_open(stream, c == '{', event);
+            }
+            // an empty array, or a trailing comma as the document parser allows
+            if (c == ']' && stream->depth > 0 && !object)
+            {
+               b->cursor++;
+               return json_stream_close(stream, false, event);
+            }
+            if (c == '"')
+            {
+               b->cursor++;
+               if (json_stream_string(stream, event))
+               {
+                  goto error;
+               }
+               event->type = JSONEventString;
+            }
+            else if (json_stream_scalar(stream, event))
+            {
+               goto error;
+            }
+            stream->last = event->type;
+            json_stream_done(stream);
+            return 0;
+      }
+   }
+
+end:
+   // the input may only run out between documents
+   if (stream->error || stream->depth > 0 || stream->expect != JSONExpectValue)
+   {
+      goto error;
+   }
+   event->type = JSONEventEnd;
+   stream->last = JSONEventEnd;
+   return 0;
+
+error:
+   stream->error = true;
+   event->type = JSONEventNone;
+   return 1;
+}
+
+int
+pgvictoria_json_stream_skip(struct json_stream* stream)
+{
+   struct json_event event;
+
+   if (stream->error)
+   {
+      return 1;
+   }
+
+   if (stream->last == JSONEventKey)
+   {
+      if (pgvictoria_json_stream_next(stream, &event))
+      {
+         return 1;
+      }
+      if (event.type != JSONEventObjectStart && event.type != JSONEventArrayStart)
+      {
+         return 0;
+      }
+   }
+   else if (stream->last != JSONEventObjectStart && stream->last != JSONEventArrayStart)
+   {
+      return 0;
+   }
+
+   return json_stream_skip_raw(stream);
+}
+
+void
+pgvictoria_json_stream_close(struct json_stream* stream)
+{
+   if (stream == NULL)
+   {
+      return;
+   }
+   if (stream->owns_fd && stream->fd >= 0)
+   {
+      close(stream->fd);
+   }
+   pgvictoria_stream_buffer_free(stream->buffer);
+   free(stream->token);
+   free(stream);
+}
+
 int
 pgvictoria_json_append(struct json* array, uintptr_t entry, enum value_type type)
 {
    if (array != NULL && array->type == JSONUnknown)
    {
       array->type = JSONArray;
-      pgvictoria_deque_create(false, (struct deque**)&array->elements);
+      pgvictoria_deque_create_arena(array->arena, false, (struct deque**)&array->elements);
    }
    if (array == NULL || array->type != JSONArray || !type_allowed(type))
    {
@@ -359,7 +660,7 @@ pgvictoria_json_put(struct json* item, char* key, uintptr_t val, enum value_type
    if (item != NULL && item->type == JSONUnknown)
    {
       item->type = JSONItem;
-      pgvictoria_art_create((struct art**)&item->elements);
+      pgvictoria_art_create_arena(item->arena, (struct art**)&item->elements);
    }
    if (item == NULL || item->type != JSONItem || !type_allowed(type) || key == NULL || strlen(key) == 0)
    {
@@ -432,9 +733,32 @@ pgvictoria_json_clear(struct json* obj)
 int
 pgvictoria_json_create(struct json** object)
 {
-   struct json* o = malloc(sizeof(struct json));
-   memset(o, 0, sizeof(struct json));
+   return pgvictoria_json_create_arena(NULL, object);
+}
+
+int
+pgvictoria_json_create_arena(struct memory_arena* arena, struct json** object)
+{
+   struct json* o = NULL;
+   if (arena != NULL)
+   {
+      o = pgvictoria_memory_arena_alloc(arena, sizeof(struct json));
+   }
+   else
+   {
+      o = malloc(sizeof(struct json));
+      if (o == NULL)
+      {
+         return 1;
+      }
+      memset(o, 0, sizeof(struct json));
+   }
+   if (o == NULL)
+   {
+      return 1;
+   }
    o->type = JSONUnknown;
+   o->arena = arena;
    *object = o;
    return 0;
 }
@@ -446,6 +770,14 @@ pgvictoria_json_destroy(struct json* object)
    {
       return 0;
    }
+   if (object->arena != NULL)
+   {
+      if (object->owner)
+      {
+         pgvictoria_memory_arena_destroy(object->arena);
+      }
+      return 0;
+   }
    if (object->type == JSONArray)
    {
       pgvictoria_deque_destroy(object->elements);
@@ -461,20 +793,28 @@ pgvictoria_json_destroy(struct json* object)
 char*
 pgvictoria_json_to_string(struct json* object, int32_t format, char* tag, int indent)
 {
-   char* str = NULL;
+   struct string_builder builder;
+
+   pgvictoria_string_builder_init(&builder);
+   pgvictoria_json_to_builder(object, format, tag, indent, &builder);
+   return pgvictoria_string_builder_finish(&builder);
+}
+
+int
+pgvictoria_json_to_builder(struct json* object, int32_t format, char* tag, int indent, struct string_builder* builder)
+{
    if (object == NULL || (object->type == JSONUnknown || object->elements == NULL))
    {
-      str = pgvictoria_indent(str, tag, indent);
-      str = pgvictoria_append(str, "{}");
-      return str;
+      pgvictoria_string_builder_indent(builder, tag, indent);
+      return pgvictoria_string_builder_append(builder, "{}");
    }
    if (object->type != JSONArray)
    {
-      return item_to_string(object, format, tag, indent);
+      return item_to_builder(object, format, tag, indent, builder);
    }
    else
    {
-      return array_to_string(object, format, tag, indent);
+      return array_to_builder(object, format, tag, indent, builder);
    }
 }
 
@@ -529,6 +869,16 @@ pgvictoria_json_contains_key(struct json* item, char* key)
    return pgvictoria_art_contains_key(item->elements, key);
 }
 
+int
+pgvictoria_json_case_insensitive(struct json* item)
+{
+   if (item == NULL || item->type != JSONItem)
+   {
+      return 1;
+   }
+   return pgvictoria_art_set_case_insensitive((struct art*)item->elements);
+}
+
 int
 pgvictoria_json_iterator_create(struct json* object, struct json_iterator** iter)
 {
@@ -620,13 +970,13 @@ pgvictoria_json_iterator_has_next(struct json_iterator* iter)
 int
 pgvictoria_json_parse_string(char* str, struct json** obj)
 {
-   uint64_t idx = 0;
-   if (str == NULL || strlen(str) < 2)
+   uint64_t length = 0;
+   if (str == NULL || (length = strlen(str)) < 2)
    {
       return 1;
    }
 
-   return parse_string(str, &idx, obj);
+   return parse_document(str, length, obj);
 }
 
 int
@@ -648,344 +998,712 @@ error:
 }
 
 static int
-parse_string(char* str, uint64_t* index, struct json** obj)
+parse_document(char* str, uint64_t length, struct json** obj)
 {
-   enum json_type type;
-   struct json* o = NULL;
-   uint64_t idx = *index;
-   char ch = str[idx];
-   char* key = NULL;
-   uint64_t len = strlen(str);
+   struct json_parser parser;
+   int ret = 1;
 
-   if (ch == '{')
+   if (length >= UINT32_MAX)
    {
-      type = JSONItem;
+      return 1;
    }
-   else if (ch == '[')
+
+   memset(&parser, 0, sizeof(struct json_parser));
+   parser.str = str;
+   parser.length = length;
+
+   if (json_index(&parser) ||
+       pgvictoria_memory_arena_create(0, &parser.arena) ||
+       pgvictoria_memory_arena_create(0, &parser.scratch))
    {
-      type = JSONArray;
+      goto done;
    }
-   else
+
+   if (json_build(&parser))
    {
-      goto error;
+      pgvictoria_memory_arena_destroy(parser.arena);
+      goto done;
+   }
+
+   parser.root->owner = true;
+   *obj = parser.root;
+   ret = 0;
+
+done:
+   free(parser.positions);
+   free(parser.frames);
+   free(parser.pending);
+   pgvictoria_memory_arena_destroy(parser.scratch);
+   return ret;
+}
+
+static int
+json_index(struct json_parser* parser)
+{
+   unsigned char block[JSON_BLOCK];
+   struct json_masks masks;
+   uint64_t escaped_carry = 0;
+   uint64_t string_carry = 0;
+   uint64_t scalar_carry = 0;
+   uint64_t escaped;
+   uint64_t quotes;
+   uint64_t in_string;
+   uint64_t scalar;
+   uint64_t bits;
+   uint64_t n = 0;
+
+   // every byte could be a token, plus room for a whole block
+   parser->positions = malloc((parser->length + JSON_BLOCK) * sizeof(uint32_t));
+   if (parser->positions == NULL)
+   {
+      return 1;
    }
-   idx++;
-   pgvictoria_json_create(&o);
-   if (type == JSONItem)
+
+   for (uint64_t base = 0; base < parser->length; base += JSON_BLOCK)
    {
-      while (idx < len)
+      if (parser->length - base >= JSON_BLOCK)
       {
-         // pre key
-         while (idx < len && isspace(str[idx]))
-         {
-            idx++;
-         }
-         if (idx == len)
-         {
-            goto error;
-         }
-         if (str[idx] == ',')
-         {
-            idx++;
-         }
-         else if (str[idx] == '}')
-         {
-            idx++;
-            break;
-         }
-         else if (!(str[idx] == '"' && o->type == JSONUnknown))
-         {
-            // if it's first key we won't see comma, otherwise we must see comma
-            goto error;
-         }
-         while (idx < len && str[idx] != '"')
-         {
-            idx++;
-         }
-         if (idx == len)
-         {
-            goto error;
-         }
-         idx++;
-         // The key
-         while (idx < len && str[idx] != '"')
-         {
-            char ec_ch;
-            // handle escape character
-            if (str[idx] == '\\')
-            {
-               if (handle_escape_char(str, &idx, len, &ec_ch))
-               {
-                  goto error;
-               }
-               key = pgvictoria_append_char(key, ec_ch);
-               continue;
-            }
+         json_classify((unsigned char*)parser->str + base, &masks);
+      }
+      else
+      {
+         // pad the last block with spaces
+         memset(block, ' ', JSON_BLOCK);
+         memcpy(block, parser->str + base, parser->length - base);
+         json_classify(block, &masks);
+      }
 
-            key = pgvictoria_append_char(key, str[idx++]);
-         }
-         if (idx == len || key == NULL)
-         {
-            goto error;
-         }
-         // The lands between
-         while (idx < len && (str[idx] == '"' || isspace(str[idx])))
-         {
-            idx++;
-         }
-         if (idx == len || str[idx] != ':')
-         {
-            goto error;
-         }
-         while (idx < len && (str[idx] == ':' || isspace(str[idx])))
-         {
-            idx++;
-         }
-         if (idx == len)
-         {
-            goto error;
-         }
-         // The value
-         if (fill_value(str, key, &idx, o))
-         {
-            goto error;
-         }
-         free(key);
-         key = NULL;
+      escaped = json_escaped(masks.backslash, &escaped_carry);
+      quotes = masks.quote & ~escaped;
+
+      // the opening quote of a string is inside, the closing one is not
+      in_string = json_prefix_xor(quotes) ^ string_carry;
+      string_carry = (uint64_t)((int64_t)in_string >> 63);
+
+      // the first byte of every number and literal
+      scalar = ~(masks.structural | masks.whitespace | quotes | in_string);
+      bits = (masks.structural & ~in_string) | quotes | (scalar & ~((scalar << 1) | scalar_carry));
+      scalar_carry = scalar >> 63;
+
+      while (bits != 0)
+      {
+         parser->positions[n++] = (uint32_t)(base + __builtin_ctzll(bits));
+         bits &= bits - 1;
       }
    }
-   else
+
+   if (string_carry != 0)
    {
-      while (idx < len)
+      // an unterminated string
+      return 1;
+   }
+
+   parser->count = n;
+   return 0;
+}
+
+static void
+json_classify(unsigned char* in, struct json_masks* masks)
+{
+#if defined(HAVE_SSE2)
+   uint64_t quote = 0;
+   uint64_t backslash = 0;
+   uint64_t structural = 0;
+   uint64_t whitespace = 0;
+
+   for (int i = 0; i < JSON_BLOCK; i += 16)
+   {
+      __m128i v = _mm_loadu_si128((__m128i*)(in + i));
+      __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']'))));
+      __m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+      s = _mm_or_si128(s, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+
+      quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+      backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+      structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(s) << i;
+      whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(w) << i;
+   }
+
+   masks->quote = quote;
+   masks->backslash = backslash;
+   masks->structural = structural;
+   masks->whitespace = whitespace;
+#elif defined(HAVE_NEON)
+   uint8x16_t v[4];
+   uint8x16_t q[4];
+   uint8x16_t b[4];
+   uint8x16_t s[4];
+   uint8x16_t w[4];
+
+   for (int i = 0; i < 4; i++)
+   {
+      v[i] = vld1q_u8(in + 16 * i);
+      q[i] = vceqq_u8(v[i], vdupq_n_u8('"'));
+      b[i] = vceqq_u8(v[i], vdupq_n_u8('\\'));
+      s[i] = vorrq_u8(vorrq_u8(vorrq_u8(vceqq_u8(v[i], vdupq_n_u8('{')), vceqq_u8(v[i], vdupq_n_u8('}'))),
+                               vorrq_u8(vceqq_u8(v[i], vdupq_n_u8('[')), vceqq_u8(v[i], vdupq_n_u8(']')))),
+                      vorrq_u8(vceqq_u8(v[i], vdupq_n_u8(':')), vceqq_u8(v[i], vdupq_n_u8(','))));
+      w[i] = vorrq_u8(vorrq_u8(vceqq_u8(v[i], vdupq_n_u8(' ')), vceqq_u8(v[i], vdupq_n_u8('\t'))),
+                      vorrq_u8(vceqq_u8(v[i], vdupq_n_u8('\n')), vceqq_u8(v[i], vdupq_n_u8('\r'))));
+   }
+
+   masks->quote = json_movemask(q);
+   masks->backslash = json_movemask(b);
+   masks->structural = json_movemask(s);
+   masks->whitespace = json_movemask(w);
+#else
+   memset(masks, 0, sizeof(struct json_masks));
+
+   for (int i = 0; i < JSON_BLOCK; i++)
+   {
+      switch (in[i])
       {
-         while (idx < len && isspace(str[idx]))
-         {
-            idx++;
-         }
-         if (idx == len)
-         {
-            goto error;
-         }
-         if (str[idx] == ',')
-         {
-            idx++;
-         }
-         else if (str[idx] == ']')
-         {
-            idx++;
+         case '"':
+            masks->quote |= 1ULL << i;
+            break;
+         case '\\':
+            masks->backslash |= 1ULL << i;
+            break;
+         case '{':
+         case '}':
+         case '[':
+         case ']':
+         case ':':
+         case ',':
+            masks->structural |= 1ULL << i;
+            break;
+         case ' ':
+         case '\t':
+         case '\n':
+         case '\r':
+            masks->whitespace |= 1ULL << i;
+            break;
+         default:
             break;
-         }
-         else if (!(value_start(str[idx]) && o->type == JSONUnknown))
-         {
-            // if it's first key we won't see comma, otherwise we must see comma
-            goto error;
-         }
-         while (idx < len && !value_start(str[idx]))
-         {
-            idx++;
-         }
-         if (idx == len)
-         {
-            goto error;
-         }
-
-         if (fill_value(str, key, &idx, o))
-         {
-            goto error;
-         }
       }
    }
+#endif
+}
 
-   *index = idx;
-   *obj = o;
-   return 0;
-error:
-   pgvictoria_json_destroy(o);
-   free(key);
-   return 1;
+#if defined(HAVE_NEON)
+static uint64_t
+json_movemask(uint8x16_t* cmp)
+{
+   // weigh every byte of a lane with its bit, then add neighbours until a byte holds 8 bits
+   const uint8x16_t weights = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                               0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+   uint8x16_t sum0 = vpaddq_u8(vandq_u8(cmp[0], weights), vandq_u8(cmp[1], weights));
+   uint8x16_t sum1 = vpaddq_u8(vandq_u8(cmp[2], weights), vandq_u8(cmp[3], weights));
+
+   sum0 = vpaddq_u8(sum0, sum1);
+   sum0 = vpaddq_u8(sum0, sum0);
+   return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
 }
+#endif
 
-static int
-json_add(struct json* obj, char* key, uintptr_t val, enum value_type type)
+static uint64_t
+json_escaped(uint64_t backslash, uint64_t* carry)
 {
-   if (obj == NULL)
-   {
-      return 1;
-   }
-   if (key == NULL)
-   {
-      return pgvictoria_json_append(obj, val, type);
-   }
-   return pgvictoria_json_put(obj, key, val, type);
+   const uint64_t even = 0x5555555555555555ULL;
+   uint64_t follows;
+   uint64_t odd_starts;
+   uint64_t even_sequences;
+
+   // a backslash escaped by the previous block does not escape
+   backslash &= ~*carry;
+   follows = (backslash << 1) | *carry;
+
+   // runs of backslashes starting on an odd bit, carried to their end
+   odd_starts = backslash & ~even & ~follows;
+   *carry = __builtin_add_overflow(odd_starts, backslash, &even_sequences) ? 1 : 0;
+
+   // a byte after a run escapes when the run has odd length
+   return (even ^ (even_sequences << 1)) & follows;
 }
 
-static bool
-value_start(char ch)
+static uint64_t
+json_prefix_xor(uint64_t bits)
 {
-   return (isdigit(ch) || ch == '-' || ch == '+') || // number
-          (ch == '[') ||                             // array
-          (ch == '{') ||                             // item
-          (ch == '"' || ch == 'n') ||                // string or null string
-          (ch == 't' || ch == 'f');                  // potential boolean value
+   bits ^= bits << 1;
+   bits ^= bits << 2;
+   bits ^= bits << 4;
+   bits ^= bits << 8;
+   bits ^= bits << 16;
+   bits ^= bits << 32;
+   return bits;
 }
 
 static int
-fill_value(char* str, char* key, uint64_t* index, struct json* o)
+json_build(struct json_parser* parser)
 {
-   uint64_t idx = *index;
-   uint64_t len = strlen(str);
-   if (str[idx] == '"')
+   struct json_frame* frame = NULL;
+   struct json* child = NULL;
+   enum json_expect expect = JSONExpectValue;
+   char* key = NULL;
+   uintptr_t data = 0;
+   enum value_type type = ValueNone;
+   uint64_t i = 0;
+   uint32_t p;
+   char c;
+
+   if (parser->count == 0)
+   {
+      return 1;
+   }
+   c = parser->str[parser->positions[0]];
+   if (c != '{' && c != '[')
    {
-      char* val = NULL;
-      idx++;
-      while (idx < len && str[idx] != '"')
+      return 1;
+   }
+
+   for (i = 0; i < parser->count; i++)
+   {
+      p = parser->positions[i];
+      c = parser->str[p];
+
+      switch (expect)
       {
-         char ec_ch;
-         if (str[idx] == '\\')
-         {
-            if (handle_escape_char(str, &idx, len, &ec_ch))
+         case JSONExpectKey:
+            // an empty object, or a trailing comma
+            if (c == '}')
             {
-               goto error;
+               goto close;
+            }
+            if (c != '"' || json_string(parser, &i, &key) || key == NULL)
+            {
+               return 1;
             }
-            val = pgvictoria_append_char(val, ec_ch);
+            expect = JSONExpectColon;
             continue;
-         }
+         case JSONExpectColon:
+            if (c != ':')
+            {
+               return 1;
+            }
+            expect = JSONExpectValue;
+            continue;
+         case JSONExpectNext:
+            if (c == ',')
+            {
+               expect = frame->object ? JSONExpectKey : JSONExpectValue;
+               continue;
+            }
+            if (c == (frame->object ? '}' : ']'))
+            {
+               goto close;
+            }
+            return 1;
+         case JSONExpectValue:
+            if (c == ']' && frame != NULL && !frame->object)
+            {
+               goto close;
+            }
+            break;
+      }
 
-         val = pgvictoria_append_char(val, str[idx++]);
+      // a value
+      if (c == '{' || c == '[')
+      {
+         if (pgvictoria_json_create_arena(parser->arena, &child))
+         {
+            return 1;
+         }
+         data = (uintptr_t)child;
+         type = ValueJSON;
       }
-      if (idx == len)
+      else if (c == '"')
       {
-         goto error;
+         if (json_string(parser, &i, (char**)&data))
+         {
+            return 1;
+         }
+         type = ValueString;
       }
-      if (val == NULL)
+      else if (json_scalar(parser, p, &data, &type))
       {
-         json_add(o, key, (uintptr_t)"", ValueString);
+         return 1;
       }
-      else
+
+      if (frame != NULL && json_frame_add(parser, frame, key, data, type))
       {
-         json_add(o, key, (uintptr_t)val, ValueString);
+         return 1;
       }
-      idx++;
-      free(val);
-   }
-   else if (str[idx] == '-' || str[idx] == '+' || isdigit(str[idx]))
-   {
-      bool has_digit = false;
-      char* val_str = NULL;
-      while (idx < len && (isdigit(str[idx]) || str[idx] == '.' || str[idx] == '-' || str[idx] == '+'))
+      key = NULL;
+
+      if (type == ValueJSON)
       {
-         if (str[idx] == '.')
+         frame = json_push(parser, child, c == '{');
+         if (frame == NULL)
          {
-            has_digit = true;
+            return 1;
          }
-         val_str = pgvictoria_append_char(val_str, str[idx++]);
-      }
-      if (has_digit)
-      {
-         double val = 0.;
-         if (sscanf(val_str, "%lf", &val) != 1)
+         if (parser->root == NULL)
          {
-            free(val_str);
-            goto error;
+            parser->root = child;
          }
-         json_add(o, key, pgvictoria_value_from_double(val), ValueDouble);
-         free(val_str);
+         expect = c == '{' ? JSONExpectKey : JSONExpectValue;
       }
       else
       {
-         int64_t val = 0;
-         if (sscanf(val_str, "%" PRId64, &val) != 1)
-         {
-            free(val_str);
-            goto error;
-         }
-         json_add(o, key, (uintptr_t)val, ValueInt64);
-         free(val_str);
+         expect = JSONExpectNext;
+      }
+      continue;
+
+close:
+      if (json_pop(parser))
+      {
+         return 1;
+      }
+      if (parser->depth == 0)
+      {
+         // what follows the document is ignored
+         return 0;
       }
+      frame = &parser->frames[parser->depth - 1];
+      expect = JSONExpectNext;
    }
-   else if (str[idx] == '{')
+
+   // the document is not closed
+   return 1;
+}
+
+static struct json_frame*
+json_push(struct json_parser* parser, struct json* json, bool object)
+{
+   struct json_frame* frames = NULL;
+   struct json_frame* frame = NULL;
+
+   if (parser->depth == parser->capacity)
    {
-      struct json* val = NULL;
-      if (parse_string(str, &idx, &val))
+      parser->capacity = parser->capacity == 0 ? 16 : parser->capacity * 2;
+      frames = realloc(parser->frames, parser->capacity * sizeof(struct json_frame));
+      if (frames == NULL)
       {
-         goto error;
+         return NULL;
       }
-      json_add(o, key, (uintptr_t)val, ValueJSON);
+      parser->frames = frames;
    }
-   else if (str[idx] == '[')
+
+   frame = &parser->frames[parser->depth++];
+   frame->json = json;
+   frame->object = object;
+   frame->base = parser->pending_count;
+   return frame;
+}
+
+static int
+json_pop(struct json_parser* parser)
+{
+   struct json_frame* frame = &parser->frames[--parser->depth];
+   uint64_t number = parser->pending_count - frame->base;
+
+   if (frame->object && number > 0)
    {
-      struct json* val = NULL;
-      if (parse_string(str, &idx, &val))
+      // the members of an object go into its tree in one bulk load
+      frame->json->type = JSONItem;
+      if (pgvictoria_art_create_arena(parser->arena, (struct art**)&frame->json->elements) ||
+          pgvictoria_art_bulk_load((struct art*)frame->json->elements, &parser->pending[frame->base], number))
       {
-         goto error;
+         return 1;
       }
-      json_add(o, key, (uintptr_t)val, ValueJSON);
    }
-   else if (str[idx] == 'n' || str[idx] == 't' || str[idx] == 'f')
+   parser->pending_count = frame->base;
+   return 0;
+}
+
+static int
+json_frame_add(struct json_parser* parser, struct json_frame* frame, char* key, uintptr_t data, enum value_type type)
+{
+   struct art_entry* pending = NULL;
+
+   if (!frame->object)
    {
-      char* val = NULL;
-      while (idx < len && str[idx] >= 'a' && str[idx] <= 'z')
+      return pgvictoria_json_append(frame->json, data, type);
+   }
+
+   if (parser->pending_count == parser->pending_capacity)
+   {
+      parser->pending_capacity = parser->pending_capacity == 0 ? 64 : parser->pending_capacity * 2;
+      pending = realloc(parser->pending, parser->pending_capacity * sizeof(struct art_entry));
+      if (pending == NULL)
       {
-         val = pgvictoria_append_char(val, str[idx++]);
+         return 1;
       }
-      if (pgvictoria_compare_string(val, "null"))
+      parser->pending = pending;
+   }
+   parser->pending[parser->pending_count].key = key;
+   parser->pending[parser->pending_count].value = data;
+   parser->pending[parser->pending_count].type = type;
+   parser->pending_count++;
+   return 0;
+}
+
+static int
+json_string(struct json_parser* parser, uint64_t* index, char** str)
+{
+   uint32_t start;
+   uint32_t end;
+   uint32_t codepoint;
+   uint32_t low;
+   char* out = NULL;
+   char* s = NULL;
+
+   // the closing quote is the next token
+   if (*index + 1 >= parser->count)
+   {
+      return 1;
+   }
+   start = parser->positions[*index] + 1;
+   end = parser->positions[*index + 1];
+   *index += 1;
+
+   if (start == end)
+   {
+      *str = NULL;
+      return 0;
+   }
+
+   out = pgvictoria_memory_arena_alloc(parser->scratch, end - start + 1);
+   if (out == NULL)
+   {
+      return 1;
+   }
+   s = memchr(parser->str + start, '\\', end - start);
+   if (s == NULL)
+   {
+      memcpy(out, parser->str + start, end - start);
+      out[end - start] = '\0';
+      *str = out;
+      return 0;
+   }
+
+   // copy up to the first escape, then decode
+   memcpy(out, parser->str + start, s - (parser->str + start));
+   *str = out;
+   out += s - (parser->str + start);
+   for (uint32_t i = s - parser->str; i < end; i++)
+   {
+      if (parser->str[i] != '\\')
+      {
+         *out++ = parser->str[i];
+         continue;
+      }
+      if (++i == end)
+      {
+         return 1;
+      }
+      switch (parser->str[i])
+      {
+         case '"':
+         case '\\':
+         case '/':
+            *out++ = parser->str[i];
+            break;
+         case 'b':
+            *out++ = '\b';
+            break;
+         case 'f':
+            *out++ = '\f';
+            break;
+         case 'n':
+            *out++ = '\n';
+            break;
+         case 'r':
+            *out++ = '\r';
+            break;
+         case 't':
+            *out++ = '\t';
+            break;
+         case 'u':
+            if (json_hex(parser->str + i + 1, end - i - 1, &codepoint))
+            {
+               return 1;
+            }
+            i += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+               // a surrogate pair
+               if (end - i - 1 < 6 || parser->str[i + 1] != '\\' || parser->str[i + 2] != 'u' ||
+                   json_hex(parser->str + i + 3, end - i - 3, &low) || low < 0xDC00 || low > 0xDFFF)
+               {
+                  return 1;
+               }
+               codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+               i += 6;
+            }
+            // at most 4 bytes, never more than the 6 or 12 the escape takes
+            out += json_utf8(codepoint, out);
+            break;
+         default:
+            return 1;
+      }
+   }
+   *out = '\0';
+   return 0;
+}
+
+static int
+json_hex(char* str, uint32_t length, uint32_t* value)
+{
+   uint32_t v = 0;
+   char c;
+
+   if (length < 4)
+   {
+      return 1;
+   }
+   for (int i = 0; i < 4; i++)
+   {
+      c = str[i];
+      v <<= 4;
+      if (c >= '0' && c <= '9')
       {
-         json_add(o, key, 0, ValueString);
+         v |= c - '0';
       }
-      else if (pgvictoria_compare_string(val, "true"))
+      else if (c >= 'a' && c <= 'f')
       {
-         json_add(o, key, true, ValueBool);
+         v |= c - 'a' + 10;
       }
-      else if (pgvictoria_compare_string(val, "false"))
+      else if (c >= 'A' && c <= 'F')
       {
-         json_add(o, key, false, ValueBool);
+         v |= c - 'A' + 10;
       }
       else
       {
-         free(val);
-         goto error;
+         return 1;
       }
-      free(val);
    }
-   else
-   {
-      goto error;
-   }
-   *index = idx;
+   *value = v;
    return 0;
-error:
-   return 1;
 }
 
 static int
-handle_escape_char(char* str, uint64_t* index, uint64_t len, char* ch)
+json_utf8(uint32_t codepoint, char* out)
 {
-   uint64_t idx = *index;
-   idx++;
-   if (idx == len) // security check
+   if (codepoint < 0x80)
    {
+      out[0] = (char)codepoint;
       return 1;
    }
-   // Check the next character after checking '\' character
-   switch (str[idx])
+   if (codepoint < 0x800)
    {
-      case '\"':
-      case '\\':
-         *ch = str[idx];
-         break;
-      case 'n':
-         *ch = '\n';
-         break;
-      case 't':
-         *ch = '\t';
+      out[0] = (char)(0xC0 | (codepoint >> 6));
+      out[1] = (char)(0x80 | (codepoint & 0x3F));
+      return 2;
+   }
+   if (codepoint < 0x10000)
+   {
+      out[0] = (char)(0xE0 | (codepoint >> 12));
+      out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      out[2] = (char)(0x80 | (codepoint & 0x3F));
+      return 3;
+   }
+   out[0] = (char)(0xF0 | (codepoint >> 18));
+   out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+   out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+   out[3] = (char)(0x80 | (codepoint & 0x3F));
+   return 4;
+}
+
+static int
+json_scalar(struct json_parser* parser, uint32_t start, uintptr_t* data, enum value_type* type)
+{
+   uint32_t length = 0;
+   char c;
+
+   // a scalar runs up to whitespace or the next structural character
+   while (start + length < parser->length)
+   {
+      c = parser->str[start + length];
+      if (c == ',' || c == '}' || c == ']' || c == ':' || c == '{' || c == '[' ||
+          c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '"')
+      {
          break;
-      case 'r':
-         *ch = '\r';
+      }
+      length++;
+   }
+
+   return json_literal(parser->str + start, length, data, type);
+}
+
+static int
+json_literal(char* str, uint32_t length, uintptr_t* data, enum value_type* type)
+{
+   char buffer[64];
+   char* end = NULL;
+   bool fraction = false;
+   int64_t i = 0;
+   double d = 0.0;
+   char c;
+
+   if (length == 4 && !strncmp(str, "null", 4))
+   {
+      *data = 0;
+      *type = ValueString;
+      return 0;
+   }
+   if (length == 4 && !strncmp(str, "true", 4))
+   {
+      *data = true;
+      *type = ValueBool;
+      return 0;
+   }
+   if (length == 5 && !strncmp(str, "false", 5))
+   {
+      *data = false;
+      *type = ValueBool;
+      return 0;
+   }
+
+   if (length == 0 || length >= sizeof(buffer))
+   {
+      return 1;
+   }
+   c = str[0];
+   if (c != '-' && c != '+' && !isdigit((unsigned char)c))
+   {
+      return 1;
+   }
+   memcpy(buffer, str, length);
+   buffer[length] = '\0';
+   for (uint32_t j = 1; j < length; j++)
+   {
+      c = buffer[j];
+      if (c == '.' || c == 'e' || c == 'E')
+      {
+         fraction = true;
          break;
-      default:
+      }
+   }
+
+   errno = 0;
+   if (!fraction)
+   {
+      i = strtoll(buffer, &end, 10);
+      if (*end == '\0' && errno == 0)
+      {
+         *data = (uintptr_t)i;
+         *type = ValueInt64;
+         return 0;
+      }
+      if (*end != '\0')
+      {
          return 1;
+      }
+      // too large for an integer
+      errno = 0;
+   }
+
+   d = strtod(buffer, &end);
+   if (*end != '\0' || errno != 0)
+   {
+      return 1;
    }
-   *index = idx + 1;
+   *data = pgvictoria_value_from_double(d);
+   *type = ValueDouble;
    return 0;
 }
 
@@ -1386,15 +2104,394 @@ error:
    return 1;
 }
 
+static int
+json_stream_fill(struct json_stream* stream)
+{
+   struct stream_buffer* b = stream->buffer;
+   ssize_t numbytes = 0;
+
+   b->start = b->cursor = b->end = 0;
+
+   do
+   {
+      numbytes = read(stream->fd, b->buffer, b->size);
+   }
+   while (numbytes < 0 && errno == EINTR);
+
+   if (numbytes < 0)
+   {
+      pgvictoria_log_error("json: could not read the stream: %s", strerror(errno));
+      stream->error = true;
+      return 1;
+   }
+   if (numbytes == 0)
+   {
+      return 1;
+   }
+   b->end = numbytes;
+   return 0;
+}
+
+static bool
+json_stream_peek(struct json_stream* stream, char* c)
+{
+   if (stream->buffer->cursor == stream->buffer->end && json_stream_fill(stream))
+   {
+      return false;
+   }
+   *c = stream->buffer->buffer[stream->buffer->cursor];
+   return true;
+}
+
+static bool
+json_stream_take(struct json_stream* stream, char* c)
+{
+   if (!json_stream_peek(stream, c))
+   {
+      return false;
+   }
+   stream->buffer->cursor++;
+   return true;
+}
+
+static int
+json_stream_append(struct json_stream* stream, char* data, size_t length)
+{
+   size_t size = stream->token_size;
+   char* token = NULL;
+
+   // room for the terminator too
+   if (stream->token_length + length + 1 > size)
+   {
+      size = size == 0 ? 256 : size;
+      while (stream->token_length + length + 1 > size)
+      {
+         size *= 2;
+      }
+      token = realloc(stream->token, size);
+      if (token == NULL)
+      {
+         return 1;
+      }
+      stream->token = token;
+      stream->token_size = size;
+   }
+   memcpy(stream->token + stream->token_length, data, length);
+   stream->token_length += length;
+   return 0;
+}
+
+static int
+json_stream_string(struct json_stream* stream, struct json_event* event)
+{
+   struct stream_buffer* b = stream->buffer;
+   char* start = NULL;
+   char* quote = NULL;
+   char* escape = NULL;
+   size_t length;
+
+   stream->token_length = 0;
+
+   while (true)
+   {
+      if (b->cursor == b->end && json_stream_fill(stream))
+      {
+         return 1;
+      }
+      start = b->buffer + b->cursor;
+      length = b->end - b->cursor;
+      quote = memchr(start, '"', length);
+      escape = memchr(start, '\\', quote != NULL ? (size_t)(quote - start) : length);
+
+      if (escape != NULL)
+      {
+         if (json_stream_append(stream, start, escape - start))
+         {
+            return 1;
+         }
+         b->cursor += escape - start + 1;
+         if (json_stream_escape(stream))
+         {
+            return 1;
+         }
+         continue;
+      }
+
+      if (quote == NULL)
+      {
+         // the string goes on in the next read
+         if (json_stream_append(stream, start, length))
+         {
+            return 1;
+         }
+         b->cursor = b->end;
+         continue;
+      }
+
+      b->cursor += quote - start + 1;
+      if (stream->token_length == 0)
+      {
+         // the whole string is in the buffer, so it is handed out in place
+         *quote = '\0';
+         event->string = start;
+         event->length = quote - start;
+         return 0;
+      }
+      if (json_stream_append(stream, start, quote - start))
+      {
+         return 1;
+      }
+      stream->token[stream->token_length] = '\0';
+      event->string = stream->token;
+      event->length = stream->token_length;
+      return 0;
+   }
+}
+
+static int
+json_stream_escape(struct json_stream* stream)
+{
+   char hex[4];
+   char out[4];
+   uint32_t codepoint;
+   uint32_t low;
+   char c;
+
+   if (!json_stream_take(stream, &c))
+   {
+      return 1;
+   }
+   switch (c)
+   {
+      case '"':
+      case '\\':
+      case '/':
+         break;
+      case 'b':
+         c = '\b';
+         break;
+      case 'f':
+         c = '\f';
+         break;
+      case 'n':
+         c = '\n';
+         break;
+      case 'r':
+         c = '\r';
+         break;
+      case 't':
+         c = '\t';
+         break;
+      case 'u':
+         for (int i = 0; i < 4; i++)
+         {
+            if (!json_stream_take(stream, &hex[i]))
+            {
+               return 1;
+            }
+         }
+         if (json_hex(hex, 4, &codepoint))
+         {
+            return 1;
+         }
+         if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+         {
+            // a surrogate pair
+            if (!json_stream_take(stream, &c) || c != '\\' || !json_stream_take(stream, &c) || c != 'u')
+            {
+               return 1;
+            }
+            for (int i = 0; i < 4; i++)
+            {
+               if (!json_stream_take(stream, &hex[i]))
+               {
+                  return 1;
+               }
+            }
+            if (json_hex(hex, 4, &low) || low < 0xDC00 || low > 0xDFFF)
+            {
+               return 1;
+            }
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+         }
+         return json_stream_append(stream, out, json_utf8(codepoint, out));
+      default:
+         return 1;
+   }
+   return json_stream_append(stream, &c, 1);
+}
+
+static int
+json_stream_scalar(struct json_stream* stream, struct json_event* event)
+{
+   char buffer[64];
+   uint32_t length = 0;
+   uintptr_t data = 0;
+   enum value_type type;
+   char c;
+
+   // a scalar runs up to whitespace, the next structural character or the end
+   while (json_stream_peek(stream, &c))
+   {
+      if (c == ',' || c == '}' || c == ']' || c == ':' || c == '{' || c == '[' ||
+          c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '"')
+      {
+         break;
+      }
+      if (length == sizeof(buffer))
+      {
+         return 1;
+      }
+      buffer[length++] = c;
+      stream->buffer->cursor++;
+   }
+   if (stream->error || json_literal(buffer, length, &data, &type))
+   {
+      return 1;
+   }
+
+   switch (type)
+   {
+      case ValueString:
+         event->type = JSONEventNull;
+         break;
+      case ValueBool:
+         event->type = JSONEventBool;
+         event->boolean = (bool)data;
+         break;
+      case ValueInt64:
+         event->type = JSONEventInteger;
+         event->integer = (int64_t)data;
+         break;
+      default:
+         event->type = JSONEventFloat;
+         event->number = pgvictoria_value_to_double(data);
+         break;
+   }
+   return 0;
+}
+
+static int
+json_stream_open(struct json_stream* stream, bool object, struct json_event* event)
+{
+   int depth = stream->depth;
+
+   if (depth == JSON_STREAM_MAX_DEPTH)
+   {
+      pgvictoria_log_error("json: more than %d nested objects and arrays", JSON_STREAM_MAX_DEPTH);
+      stream->error = true;
+      event->type = JSONEventNone;
+      return 1;
+   }
+   if (object)
+   {
+      stream->objects[depth / 64] |= 1ULL << (depth % 64);
+   }
+   else
+   {
+      stream->objects[depth / 64] &= ~(1ULL << (depth % 64));
+   }
+   stream->depth++;
+   stream->expect = object ? JSONExpectKey : JSONExpectValue;
+
+   event->type = object ? JSONEventObjectStart : JSONEventArrayStart;
+   event->depth = depth;
+   stream->last = event->type;
+   return 0;
+}
+
+static int
+json_stream_close(struct json_stream* stream, bool object, struct json_event* event)
+{
+   int depth = stream->depth - 1;
+
+   if (depth < 0 || (bool)(stream->objects[depth / 64] & (1ULL << (depth % 64))) != object)
+   {
+      stream->error = true;
+      event->type = JSONEventNone;
+      return 1;
+   }
+   stream->depth = depth;
+   json_stream_done(stream);
+
+   event->type = object ? JSONEventObjectEnd : JSONEventArrayEnd;
+   event->depth = depth;
+   stream->last = event->type;
+   return 0;
+}
+
+static void
+json_stream_done(struct json_stream* stream)
+{
+   // a document at the top is followed by the next one, if any
+   stream->expect = stream->depth == 0 ? JSONExpectValue : JSONExpectNext;
+}
+
+static int
+json_stream_skip_raw(struct json_stream* stream)
+{
+   struct stream_buffer* b = stream->buffer;
+   int depth = 1;
+   bool string = false;
+   bool escape = false;
+   char c;
+
+   // the object or array has just been opened
+   while (depth > 0)
+   {
+      if (b->cursor == b->end && json_stream_fill(stream))
+      {
+         stream->error = true;
+         return 1;
+      }
+      c = b->buffer[b->cursor++];
+      if (string)
+      {
+         if (escape)
+         {
+            escape = false;
+         }
+         else if (c == '\\')
+         {
+            escape = true;
+         }
+         else if (c == '"')
+         {
+            string = false;
+         }
+      }
+      else if (c == '"')
+      {
+         string = true;
+      }
+      else if (c == '{' || c == '[')
+      {
+         depth++;
+      }
+      else if (c == '}' || c == ']')
+      {
+         depth--;
+      }
+   }
+
+   stream->depth--;
+   json_stream_done(stream);
+   stream->last = JSONEventNone;
+   return 0;
+}
+
 int
 pgvictoria_json_read_file(char* path, struct json** obj)
 {
    FILE* file = NULL;
    char buf[DEFAULT_BUFFER_SIZE];
    char* str = NULL;
+   size_t n;
+   struct string_builder builder;
    struct json* j = NULL;
 
    *obj = NULL;
+   pgvictoria_string_builder_init(&builder);
 
    if (path == NULL)
    {
@@ -1409,14 +2506,14 @@ pgvictoria_json_read_file(char* path, struct json** obj)
       goto error;
    }
 
-   memset(buf, 0, sizeof(buf));
-
-   // save the last one for ending so that we get to use append
-   while (fread(buf, 1, DEFAULT_BUFFER_SIZE - 1, file) > 0)
+   while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
    {
-      str = pgvictoria_append(str, buf);
-      memset(buf, 0, sizeof(buf));
+      if (pgvictoria_string_builder_append_length(&builder, buf, n))
+      {
+         goto error;
+      }
    }
+   str = pgvictoria_string_builder_finish(&builder);
 
    if (pgvictoria_json_parse_string(str, &j))
    {
@@ -1441,6 +2538,7 @@ error:
       fclose(file);
    }
 
+   pgvictoria_string_builder_destroy(&builder);
    free(str);
 
    return 1;
@@ -1514,14 +2612,14 @@ type_allowed(enum value_type type)
    }
 }
 
-static char*
-item_to_string(struct json* item, int32_t format, char* tag, int indent)
+static int
+item_to_builder(struct json* item, int32_t format, char* tag, int indent, struct string_builder* builder)
 {
-   return pgvictoria_art_to_string(item->elements, format, tag, indent);
+   return pgvictoria_art_to_builder(item->elements, format, tag, indent, builder);
 }
 
-static char*
-array_to_string(struct json* array, int32_t format, char* tag, int indent)
+static int
+array_to_builder(struct json* array, int32_t format, char* tag, int indent, struct string_builder* builder)
 {
-   return pgvictoria_deque_to_string(array->elements, format, tag, indent);
+   return pgvictoria_deque_to_builder(array->elements, format, tag, indent, builder);
 }
@@ -29,10 +29,16 @@
 /* pgvictoria */
 #include <pgvictoria.h>
 #include <logging.h>
+#include <network.h>
+#include <ring.h>
 #include <utils.h>
 
 /* system */
 #include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,15 +47,39 @@
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #define LINE_LENGTH 32
 
+#define LOG_MESSAGE_LENGTH 4096
+#define LOG_WRITER_BATCH   1024
+#define LOG_WRITER_SLEEP   8000000L
+#define LOG_WRITER_WAIT    1000
+#define LOG_WRITER_STALL   5
+
+/** @struct log_record
+ * Defines the header of a log line in the ring. It is followed by the name
+ * of the source file and the message. A level of 0 is a line written as is
+ */
+struct log_record
+{
+   int64_t time;         /**< The time of the line */
+   int32_t level;        /**< The level */
+   int32_t line;         /**< The line number */
+   uint32_t file_length; /**< The length of the file name */
+};
+
 FILE* log_file;
 
 time_t next_log_rotation_age; /* number of seconds at which the next location will happen */
 
 char current_log_path[MAX_PATH]; /* the current log file */
 
+static struct ring* log_ring = NULL;
+static bool log_writer = false;
+static volatile sig_atomic_t log_writer_stop = 0;
+static int log_wakeup[2] = {-1, -1};
+
 static bool log_rotation_enabled(void);
 static void log_rotation_disable(void);
 static bool log_rotation_required(void);
@@ -57,6 +87,13 @@ static bool log_rotation_set_next_rotation_age(void);
 static int log_file_open(void);
 static void log_file_rotate(void);
 static void output_log_line(char* l);
+static bool log_ring_active(void);
+static int log_push(int level, char* filename, int line, char* fmt, va_list vl);
+static int log_push_line(char* l);
+static int log_ring_pushv(struct iovec* iov, int iovcnt);
+static void log_writer_wait(void);
+static void log_writer_output(FILE* output, char* record, size_t length, time_t* cached, char* prefix, size_t size);
+static void log_writer_shutdown_cb(int signum);
 
 static char* levels[] =
    {
@@ -86,7 +123,12 @@ pgvictoria_start_logging(void)
 
    config = (struct main_configuration*)shmem;
 
-   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE && !log_file)
+   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE && log_ring_active())
+   {
+      /* The log belongs to the writer, which reopens it with the new settings */
+      atomic_store(&config->common.log_reopen, true);
+   }
+   else if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE && !log_file)
    {
       log_file_open();
 
@@ -118,9 +160,16 @@ pgvictoria_stop_logging(void)
 
    if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE)
    {
-      if (log_file != NULL)
+      if (log_ring_active())
+      {
+         return 0;
+      }
+      else if (log_file != NULL)
       {
-         return fclose(log_file);
+         int ret = fclose(log_file);
+
+         log_file = NULL;
+         return ret;
       }
       else
       {
@@ -166,6 +215,47 @@ pgvictoria_log_line(int level, char* file, int line, char* fmt, ...)
 
    if (level >= config->common.log_level)
    {
+      if (log_ring_active())
+      {
+         va_list vl;
+         bool pushed = true;
+
+#ifdef DEBUG
+         if (level > 4)
+         {
+            char* bt = NULL;
+            pgvictoria_backtrace_string(&bt);
+            if (bt != NULL)
+            {
+               pushed = log_push_line(bt) == 0;
+            }
+            free(bt);
+         }
+#endif
+
+         if (pushed)
+         {
+            va_start(vl, fmt);
+            pushed = log_push(level, file, line, fmt, vl) == 0;
+            va_end(vl);
+         }
+
+         if (pushed)
+         {
+            return;
+         }
+
+         /*
+          * Never wait for the writer. An error is not dropped but written
+          * directly, ahead of the lines still in the ring
+          */
+         if (level < PGVICTORIA_LOGGING_LEVEL_ERROR)
+         {
+            atomic_fetch_add(&config->common.log_dropped, 1);
+            return;
+         }
+      }
+
       if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_CONSOLE)
       {
          output = stdout;
@@ -244,7 +334,8 @@ retry:
                fprintf(output, "\n");
                fflush(output);
 
-               if (log_rotation_required())
+               /* The log writer rotates the file it writes */
+               if (!log_ring_active() && log_rotation_required())
                {
                   log_file_rotate();
                }
@@ -503,7 +594,14 @@ output_log_line(char* l)
 
    config = (struct main_configuration*)shmem;
 
-   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_CONSOLE)
+   if (log_ring_active())
+   {
+      if (log_push_line(l))
+      {
+         atomic_fetch_add(&config->common.log_dropped, 1);
+      }
+   }
+   else if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_CONSOLE)
    {
       fprintf(stdout, "%s", l);
       fprintf(stdout, "\n");
@@ -517,6 +615,248 @@ output_log_line(char* l)
    }
 }
 
+int
+pgvictoria_log_writer_init(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   if (log_ring != NULL || config->common.log_type == PGVICTORIA_LOGGING_TYPE_SYSLOG)
+   {
+      return 1;
+   }
+
+   if (strlen(config->common.log_line_prefix) == 0)
+   {
+      memcpy(config->common.log_line_prefix, PGVICTORIA_LOGGING_DEFAULT_LOG_LINE_PREFIX, strlen(PGVICTORIA_LOGGING_DEFAULT_LOG_LINE_PREFIX));
+   }
+
+   atomic_store(&config->common.log_reopen, false);
+   atomic_store(&config->common.log_dropped, 0);
+   atomic_store(&config->common.log_waiting, false);
+
+   /* Producers wake a waiting writer through the pipe */
+   if (pipe(log_wakeup) == -1)
+   {
+      log_wakeup[0] = -1;
+      log_wakeup[1] = -1;
+      errno = 0;
+      return 1;
+   }
+
+   pgvictoria_socket_nonblocking(log_wakeup[0], true);
+   pgvictoria_socket_nonblocking(log_wakeup[1], true);
+
+   if (pgvictoria_ring_create(PGVICTORIA_LOGGING_RING_SIZE, &log_ring))
+   {
+      close(log_wakeup[0]);
+      close(log_wakeup[1]);
+      log_wakeup[0] = -1;
+      log_wakeup[1] = -1;
+      return 1;
+   }
+
+   return 0;
+}
+
+void
+pgvictoria_log_writer_run(void)
+{
+   struct main_configuration* config;
+   struct sigaction sa;
+   sigset_t mask;
+   FILE* output = NULL;
+   char* record = NULL;
+   char prefix[MISC_LENGTH];
+   time_t cached = -1;
+   size_t size;
+   size_t length;
+   unsigned long long dropped;
+   uint64_t skipped = 0;
+   time_t stalled = 0;
+   bool warned = false;
+   long backoff = 1000000L;
+   pid_t parent;
+   int count;
+
+   config = (struct main_configuration*)shmem;
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = log_writer_shutdown_cb;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGTERM, &sa, NULL);
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGQUIT, &sa, NULL);
+
+   sa.sa_handler = SIG_DFL;
+   sigaction(SIGCHLD, &sa, NULL);
+
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGTERM);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGQUIT);
+   sigaddset(&mask, SIGCHLD);
+   sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+   /* The lines of the writer itself are written directly */
+   log_writer = true;
+   parent = getppid();
+
+   size = pgvictoria_ring_max_length(log_ring);
+   record = (char*)malloc(size + 1);
+   if (record == NULL)
+   {
+      _exit(1);
+   }
+
+   while (true)
+   {
+      output = config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE ? log_file : stdout;
+      count = 0;
+
+      /* Drain a batch, and write it with a single flush */
+      while (count < LOG_WRITER_BATCH && pgvictoria_ring_pop(log_ring, record, size, &length) == RING_OK)
+      {
+         if (output != NULL)
+         {
+            log_writer_output(output, record, length, &cached, &prefix[0], sizeof(prefix));
+         }
+         count++;
+      }
+
+      if (count > 0 && output != NULL)
+      {
+         fflush(output);
+      }
+
+      dropped = atomic_exchange(&config->common.log_dropped, 0);
+      if (dropped > 0)
+      {
+         pgvictoria_log_warn("%llu log lines were dropped by a full log ring", dropped);
+      }
+
+      if (log_ring->skipped != skipped)
+      {
+         pgvictoria_log_warn("%" PRIu64 " log lines were lost by processes that died while logging", log_ring->skipped - skipped);
+         skipped = log_ring->skipped;
+      }
+
+      if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE)
+      {
+         if (atomic_exchange(&config->common.log_reopen, false))
+         {
+            if (log_file != NULL)
+            {
+               fclose(log_file);
+               log_file = NULL;
+            }
+            log_file_open();
+         }
+         else if (count > 0 && log_file != NULL && log_rotation_required())
+         {
+            log_file_rotate();
+         }
+      }
+
+      if (count > 0)
+      {
+         backoff = 1000000L;
+         stalled = 0;
+         warned = false;
+         continue;
+      }
+
+      /*
+       * Lines behind a record that is claimed but never published cannot be
+       * written. A dead producer is skipped by the ring itself, so this is a
+       * process stuck in the middle of logging, or one killed before it could
+       * stamp its claim
+       */
+      if (!pgvictoria_ring_empty(log_ring))
+      {
+         if (stalled == 0)
+         {
+            stalled = time(NULL);
+         }
+         else if (!warned && time(NULL) - stalled >= LOG_WRITER_STALL)
+         {
+            pgvictoria_log_warn("The log ring has had an unpublished record at its head for %d seconds", LOG_WRITER_STALL);
+            warned = true;
+         }
+      }
+      else
+      {
+         stalled = 0;
+         warned = false;
+      }
+
+      /* On shutdown a stalled head is not waited for any longer than a second */
+      if ((log_writer_stop && (pgvictoria_ring_empty(log_ring) || (stalled != 0 && time(NULL) > stalled))) ||
+          getppid() != parent)
+      {
+         break;
+      }
+
+      if (stalled != 0)
+      {
+         /* The head is published without a wake-up, so poll it with a back off */
+         SLEEP(backoff);
+         backoff = MIN(backoff * 2, LOG_WRITER_SLEEP);
+      }
+      else
+      {
+         log_writer_wait();
+      }
+   }
+
+   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE && log_file != NULL)
+   {
+      fclose(log_file);
+   }
+   fflush(stdout);
+
+   free(record);
+
+   _exit(0);
+}
+
+void
+pgvictoria_log_writer_destroy(void)
+{
+   struct main_configuration* config;
+   FILE* previous = NULL;
+
+   config = (struct main_configuration*)shmem;
+
+   if (log_ring == NULL)
+   {
+      return;
+   }
+
+   pgvictoria_ring_destroy(log_ring);
+   log_ring = NULL;
+
+   close(log_wakeup[0]);
+   close(log_wakeup[1]);
+   log_wakeup[0] = -1;
+   log_wakeup[1] = -1;
+
+   /* Append to the log the writer left, which may have been rotated or reopened */
+   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_FILE && log_file != NULL)
+   {
+      previous = log_file;
+      if (log_file_open())
+      {
+         log_file = previous;
+      }
+      else
+      {
+         fclose(previous);
+      }
+   }
+}
+
 void
 pgvictoria_print_bytes_binary(void* ptr, size_t n)
 {
@@ -532,6 +872,197 @@ pgvictoria_print_bytes_binary(void* ptr, size_t n)
    putchar('\n');
 }
 
+static bool
+log_ring_active(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   return log_ring != NULL && !log_writer && config->common.log_type != PGVICTORIA_LOGGING_TYPE_SYSLOG;
+}
+
+static int
+log_push(int level, char* filename, int line, char* fmt, va_list vl)
+{
+   struct log_record record;
+   struct iovec iov[3];
+   char message[LOG_MESSAGE_LENGTH];
+   char* name;
+   int length;
+
+   name = strrchr(filename, '/');
+   name = name != NULL ? name + 1 : filename;
+
+   length = vsnprintf(&message[0], sizeof(message), fmt, vl);
+   if (length < 0)
+   {
+      length = 0;
+   }
+   else if (length >= (int)sizeof(message))
+   {
+      length = sizeof(message) - 1;
+   }
+
+   record.time = (int64_t)time(NULL);
+   record.level = level;
+   record.line = line;
+   record.file_length = strlen(name);
+
+   iov[0].iov_base = &record;
+   iov[0].iov_len = sizeof(struct log_record);
+   iov[1].iov_base = name;
+   iov[1].iov_len = record.file_length;
+   iov[2].iov_base = &message[0];
+   iov[2].iov_len = length;
+
+   return log_ring_pushv(&iov[0], 3);
+}
+
+static int
+log_push_line(char* l)
+{
+   struct log_record record;
+   struct iovec iov[2];
+   size_t length;
+
+   memset(&record, 0, sizeof(struct log_record));
+
+   length = MIN(strlen(l), pgvictoria_ring_max_length(log_ring) - sizeof(struct log_record));
+
+   iov[0].iov_base = &record;
+   iov[0].iov_len = sizeof(struct log_record);
+   iov[1].iov_base = l;
+   iov[1].iov_len = length;
+
+   return log_ring_pushv(&iov[0], 2);
+}
+
+static int
+log_ring_pushv(struct iovec* iov, int iovcnt)
+{
+   struct main_configuration* config;
+   int saved_errno = errno;
+
+   config = (struct main_configuration*)shmem;
+
+   if (pgvictoria_ring_pushv(log_ring, iov, iovcnt) != RING_OK)
+   {
+      return 1;
+   }
+
+   /*
+    * Pairs with the fence in log_writer_wait: either the writer sees the line
+    * before it blocks, or this sees it waiting. Only the producer that clears
+    * the flag writes, a full pipe already holds a wake-up
+    */
+   atomic_thread_fence(memory_order_seq_cst);
+   if (atomic_load(&config->common.log_waiting) && atomic_exchange(&config->common.log_waiting, false))
+   {
+      if (write(log_wakeup[1], "", 1) == -1)
+      {
+         errno = saved_errno;
+      }
+   }
+
+   return 0;
+}
+
+static void
+log_writer_wait(void)
+{
+   struct main_configuration* config;
+   struct pollfd fds;
+   char buffer[64];
+
+   config = (struct main_configuration*)shmem;
+
+   atomic_store(&config->common.log_waiting, true);
+   atomic_thread_fence(memory_order_seq_cst);
+
+   /* The timeout bounds the shutdown and parent checks, lines wake the writer at once */
+   if (pgvictoria_ring_empty(log_ring) && !log_writer_stop)
+   {
+      fds.fd = log_wakeup[0];
+      fds.events = POLLIN;
+      fds.revents = 0;
+      poll(&fds, 1, LOG_WRITER_WAIT);
+   }
+
+   atomic_store(&config->common.log_waiting, false);
+
+   while (read(log_wakeup[0], &buffer[0], sizeof(buffer)) > 0)
+   {
+   }
+   errno = 0;
+}
+
+static void
+log_writer_output(FILE* output, char* record, size_t length, time_t* cached, char* prefix, size_t size)
+{
+   struct main_configuration* config;
+   struct log_record r;
+   struct tm tm;
+   char* filename;
+   char* message;
+   int level;
+
+   config = (struct main_configuration*)shmem;
+
+   if (length < sizeof(struct log_record))
+   {
+      return;
+   }
+
+   memcpy(&r, record, sizeof(struct log_record));
+   if (r.file_length > length - sizeof(struct log_record))
+   {
+      return;
+   }
+
+   filename = record + sizeof(struct log_record);
+   message = filename + r.file_length;
+   record[length] = '\0';
+
+   if (r.level == 0)
+   {
+      fprintf(output, "%s\n", message);
+      return;
+   }
+
+   /* The prefix only changes once a second */
+   if ((time_t)r.time != *cached)
+   {
+      time_t t = (time_t)r.time;
+
+      localtime_r(&t, &tm);
+      prefix[strftime(prefix, size, config->common.log_line_prefix, &tm)] = '\0';
+      *cached = t;
+   }
+
+   level = MAX(1, MIN(r.level, 6));
+
+   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_CONSOLE)
+   {
+      fprintf(output, "%s %s%-5s\x1b[0m \x1b[90m%.*s:%d\x1b[0m %s\n",
+              prefix, colors[level - 1], levels[level - 1],
+              (int)r.file_length, filename, r.line, message);
+   }
+   else
+   {
+      fprintf(output, "%s %-5s %.*s:%d %s\n",
+              prefix, levels[level - 1], (int)r.file_length, filename, r.line, message);
+   }
+}
+
+static void
+log_writer_shutdown_cb(int signum)
+{
+   (void)signum;
+
+   log_writer_stop = 1;
+}
+
 static bool
 log_rotation_enabled(void)
 {
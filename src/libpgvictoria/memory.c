@@ -41,6 +41,9 @@
 static struct message* message = NULL;
 static void* data = NULL;
 
+static struct memory_arena_block* arena_block_create(struct memory_arena_block* next, size_t size);
+static void arena_run_cleanup(struct memory_arena* arena);
+
 void
 pgvictoria_memory_init(void)
 {
@@ -137,3 +140,205 @@ pgvictoria_memory_dynamic_append(void* orig, size_t orig_size, void* append, siz
 
    return d;
 }
+
+int
+pgvictoria_memory_arena_create(size_t block_size, struct memory_arena** arena)
+{
+   struct memory_arena* a = NULL;
+
+   *arena = NULL;
+
+   a = (struct memory_arena*)malloc(sizeof(struct memory_arena));
+   if (a == NULL)
+   {
+      return 1;
+   }
+
+   a->block_size = block_size > 0 ? block_size : MEMORY_ARENA_BLOCK;
+   a->cleanup = NULL;
+   a->allocated = 0;
+   a->block = arena_block_create(NULL, a->block_size);
+   if (a->block == NULL)
+   {
+      free(a);
+      return 1;
+   }
+   a->first = a->block;
+
+   *arena = a;
+
+   return 0;
+}
+
+void*
+pgvictoria_memory_arena_alloc(struct memory_arena* arena, size_t size)
+{
+   struct memory_arena_block* block = NULL;
+   void* p = NULL;
+
+   if (arena == NULL)
+   {
+      return NULL;
+   }
+
+   size = (size + 15) & ~(size_t)15;
+   block = arena->block;
+
+   if (block->used + size > block->size)
+   {
+      // Oversized requests get a block of their own behind the current one
+      if (size > arena->block_size / 4)
+      {
+         block = arena_block_create(block->next, size);
+         if (block == NULL)
+         {
+            return NULL;
+         }
+         arena->block->next = block;
+      }
+      else
+      {
+         block = arena_block_create(arena->block, arena->block_size);
+         if (block == NULL)
+         {
+            return NULL;
+         }
+         arena->block = block;
+      }
+   }
+
+   p = block->data + block->used;
+   block->used += size;
+   arena->allocated += size;
+
+   return p;
+}
+
+char*
+pgvictoria_memory_arena_string(struct memory_arena* arena, char* s)
+{
+   char* c = NULL;
+   size_t length;
+
+   if (s == NULL)
+   {
+      return NULL;
+   }
+
+   length = strlen(s) + 1;
+   c = pgvictoria_memory_arena_alloc(arena, length);
+   if (c != NULL)
+   {
+      memcpy(c, s, length);
+   }
+
+   return c;
+}
+
+int
+pgvictoria_memory_arena_cleanup(struct memory_arena* arena, void (*cleanup)(void* data), void* data)
+{
+   struct memory_arena_cleanup* c = NULL;
+
+   c = pgvictoria_memory_arena_alloc(arena, sizeof(struct memory_arena_cleanup));
+   if (c == NULL)
+   {
+      return 1;
+   }
+
+   c->cleanup = cleanup;
+   c->data = data;
+   c->next = arena->cleanup;
+   arena->cleanup = c;
+
+   return 0;
+}
+
+void
+pgvictoria_memory_arena_reset(struct memory_arena* arena)
+{
+   struct memory_arena_block* block = NULL;
+   struct memory_arena_block* next = NULL;
+
+   if (arena == NULL)
+   {
+      return;
+   }
+
+   arena_run_cleanup(arena);
+
+   /* The oldest block may be an oversized one, so keep the first by identity */
+   block = arena->block;
+   while (block != NULL)
+   {
+      next = block->next;
+      if (block != arena->first)
+      {
+         free(block);
+      }
+      block = next;
+   }
+
+   block = arena->first;
+   memset(block->data, 0, block->used);
+   block->used = 0;
+   block->next = NULL;
+   arena->block = block;
+   arena->allocated = 0;
+}
+
+void
+pgvictoria_memory_arena_destroy(struct memory_arena* arena)
+{
+   struct memory_arena_block* block = NULL;
+   struct memory_arena_block* next = NULL;
+
+   if (arena == NULL)
+   {
+      return;
+   }
+
+   arena_run_cleanup(arena);
+
+   block = arena->block;
+   while (block != NULL)
+   {
+      next = block->next;
+      free(block);
+      block = next;
+   }
+
+   free(arena);
+}
+
+static struct memory_arena_block*
+arena_block_create(struct memory_arena_block* next, size_t size)
+{
+   struct memory_arena_block* block = NULL;
+
+   block = (struct memory_arena_block*)calloc(1, sizeof(struct memory_arena_block) + size);
+   if (block == NULL)
+   {
+      return NULL;
+   }
+
+   block->next = next;
+   block->size = size;
+   block->used = 0;
+
+   return block;
+}
+
+static void
+arena_run_cleanup(struct memory_arena* arena)
+{
+   struct memory_arena_cleanup* c = arena->cleanup;
+
+   // Detach the list first, so the arena starts over without callbacks
+   arena->cleanup = NULL;
+   while (c != NULL)
+   {
+      c->cleanup(c->data);
+      c = c->next;
+   }
+}
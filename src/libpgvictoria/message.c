@@ -34,6 +34,7 @@
 #include <network.h>
 #include <security.h>
 #include <stream.h>
+#include <trace.h>
 #include <utils.h>
 
 #include <assert.h>
@@ -44,6 +45,7 @@
 #include <openssl/evp.h>
 #include <openssl/ssl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 
 static struct message* allocate_message(size_t size);
@@ -850,20 +852,27 @@ pgvictoria_query_execute(SSL* ssl, int socket, struct message* msg, struct query
    size_t data_size;
    void* data = pgvictoria_memory_dynamic_create(&data_size);
    size_t offset = 0;
+   bool trace = pgvictoria_trace_sample(TRACE_PROTOCOL);
+   struct timespec start;
+   struct timespec now;
+   long first_read = -1;
 
    *response = NULL;
 
+   if (trace)
+   {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+   }
+
    status = pgvictoria_write_message(ssl, socket, msg);
    if (status != MESSAGE_STATUS_OK)
    {
       goto error;
    }
 
-   if (pgvictoria_log_is_enabled(PGVICTORIA_LOGGING_LEVEL_DEBUG5))
+   if (trace)
    {
-      pgvictoria_log_trace("Query request -- BEGIN");
-      pgvictoria_log_message(msg);
-      pgvictoria_log_trace("Query request -- END");
+      pgvictoria_trace_message(TRACE_PROTOCOL, '>', msg);
    }
 
    cont = true;
@@ -873,6 +882,12 @@ pgvictoria_query_execute(SSL* ssl, int socket, struct message* msg, struct query
 
       if (status == MESSAGE_STATUS_OK)
       {
+         if (trace && first_read < 0)
+         {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            first_read = (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000L;
+         }
+
          data = pgvictoria_memory_dynamic_append(data, data_size, reply->data, reply->length, &data_size);
 
          if (pgvictoria_has_message('Z', data, data_size))
@@ -893,18 +908,11 @@ pgvictoria_query_execute(SSL* ssl, int socket, struct message* msg, struct query
       reply = NULL;
    }
 
-   if (pgvictoria_log_is_enabled(PGVICTORIA_LOGGING_LEVEL_DEBUG5))
+   if (trace)
    {
-      if (data == NULL)
-      {
-         pgvictoria_log_debug("Data is NULL");
-      }
-      else
-      {
-         pgvictoria_log_trace("Query response -- BEGIN");
-         pgvictoria_log_mem(data, data_size);
-         pgvictoria_log_trace("Query response -- END");
-      }
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      pgvictoria_trace_response(TRACE_PROTOCOL, data, data_size, first_read,
+                                (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000L);
    }
 
    r = (struct query_response*)malloc(sizeof(struct query_response));
@@ -267,6 +267,8 @@ check_baseline_in_dirs(int version)
 /**
  * Get the PostgreSQL baseline configuration for a specific version.
  * 
+ * Setting names are matched regardless of case, as PostgreSQL does.
+ *
  * @param version The PostgreSQL version (e.g. 14, 15, 16, 17, 18, 19)
  * @return The JSON baseline object, or NULL if the version is not supported or parsing fails.
  */
@@ -281,6 +283,12 @@ pgvictoria_get_baseline(int version)
       if (pgvictoria_json_parse_string(json_str, &baseline) == 0)
       {
          free(json_str);
+         /* A case-sensitive baseline would silently miss mixed-case names */
+         if (pgvictoria_json_case_insensitive(baseline))
+         {
+            pgvictoria_json_destroy(baseline);
+            return NULL;
+         }
          return baseline;
       }
       free(json_str);
@@ -300,6 +308,11 @@ pgvictoria_get_baseline(int version)
          struct json* baseline = NULL;
          if (pgvictoria_json_parse_string((char*)static_json_str, &baseline) == 0)
          {
+            if (pgvictoria_json_case_insensitive(baseline))
+            {
+               pgvictoria_json_destroy(baseline);
+               return NULL;
+            }
             return baseline;
          }
          break;
@@ -0,0 +1,720 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <collector.h>
+#include <deque.h>
+#include <guc.h>
+#include <logging.h>
+#include <network.h>
+#include <prometheus.h>
+#include <report.h>
+#include <utils.h>
+#include <value.h>
+
+/* system */
+#include <errno.h>
+#include <ev.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROMETHEUS_CACHE_INITIAL_SIZE 16384
+
+#define PROMETHEUS_HEADER_OK                                    \
+   "HTTP/1.1 200 OK\r\n"                                        \
+   "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" \
+   "Content-Length: %zu\r\n"                                    \
+   "Connection: close\r\n"                                      \
+   "\r\n"
+
+#define PROMETHEUS_RESPONSE_NOT_FOUND \
+   "HTTP/1.1 404 Not Found\r\n"       \
+   "Content-Length: 0\r\n"            \
+   "Connection: close\r\n"            \
+   "\r\n"
+
+#define PROMETHEUS_RESPONSE_NOT_ALLOWED \
+   "HTTP/1.1 405 Method Not Allowed\r\n" \
+   "Allow: GET\r\n"                      \
+   "Content-Length: 0\r\n"               \
+   "Connection: close\r\n"               \
+   "\r\n"
+
+#define PROMETHEUS_RESPONSE_BAD_REQUEST \
+   "HTTP/1.1 400 Bad Request\r\n"       \
+   "Content-Length: 0\r\n"              \
+   "Connection: close\r\n"              \
+   "\r\n"
+
+/** @struct prometheus_client
+ * Defines a metrics client being served on the event loop
+ */
+struct prometheus_client
+{
+   struct ev_io io;                         /**< The libev base type, must be first */
+   struct ev_timer timer;                   /**< The timeout of the client */
+   int fd;                                  /**< The client descriptor */
+   char request[PROMETHEUS_REQUEST_SIZE];   /**< The request */
+   size_t request_length;                   /**< The length of the request */
+   char* response;                          /**< The response */
+   size_t response_length;                  /**< The length of the response */
+   size_t written;                          /**< The number of bytes written */
+};
+
+static struct prometheus_server* servers = NULL;
+static int number_of_servers = 0;
+static char* cache = NULL;
+static size_t cache_size = 0;
+static size_t cache_length = 0;
+static char* render = NULL;
+static size_t render_size = 0;
+static size_t render_length = 0;
+static bool render_failed = false;
+static char** setting_labels = NULL;
+static int number_of_setting_labels = 0;
+
+static int render_append(char* format, ...);
+static void escape_label(char* label, char* dst, size_t size);
+static char* setting_label(struct pgvictoria_diff_item* item, char* buffer, size_t size);
+static void client_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static void client_timeout_cb(struct ev_loop* loop, struct ev_timer* watcher, int revents);
+static int client_respond(struct ev_loop* loop, struct prometheus_client* client);
+static void client_close(struct ev_loop* loop, struct prometheus_client* client);
+
+int
+pgvictoria_prometheus_init(void)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+
+   number_of_servers = config->common.number_of_servers;
+   servers = (struct prometheus_server*)calloc(MAX(number_of_servers, 1), sizeof(struct prometheus_server));
+   if (servers == NULL)
+   {
+      return 1;
+   }
+
+   /* Labels are escaped once since the server list only changes on restart */
+   for (int i = 0; i < number_of_servers; i++)
+   {
+      escape_label(config->common.servers[i].name, servers[i].label, sizeof(servers[i].label));
+   }
+
+   /* Setting labels are escaped on first use, and kept by setting id */
+   number_of_setting_labels = pgvictoria_guc_number_of_names();
+   setting_labels = (char**)calloc(number_of_setting_labels + 1, sizeof(char*));
+   if (setting_labels == NULL)
+   {
+      return 1;
+   }
+
+   cache = (char*)malloc(PROMETHEUS_CACHE_INITIAL_SIZE);
+   render = (char*)malloc(PROMETHEUS_CACHE_INITIAL_SIZE);
+   if (cache == NULL || render == NULL)
+   {
+      return 1;
+   }
+   cache_size = PROMETHEUS_CACHE_INITIAL_SIZE;
+   cache_length = 0;
+   render_size = PROMETHEUS_CACHE_INITIAL_SIZE;
+   render_length = 0;
+
+   return pgvictoria_prometheus_render();
+}
+
+int
+pgvictoria_prometheus_collect(int server, struct collector_result* result, char** drift)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct deque* items = NULL;
+   struct timespec start_time;
+   struct timespec end_time;
+   int version = 0;
+   int ret = 1;
+
+   *drift = NULL;
+   memset(result, 0, sizeof(struct collector_result));
+   result->server = server;
+
+   if (server < 0 || server >= config->common.number_of_servers)
+   {
+      return 1;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start_time);
+   ret = pgvictoria_report_collect(server, PGVICTORIA_REPORT_FULL, &version, &items);
+   clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+   result->duration = (double)(end_time.tv_sec - start_time.tv_sec) + (double)(end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+   result->timestamp = time(NULL);
+
+   if (ret)
+   {
+      pgvictoria_log_warn("Collection from %s failed", config->common.servers[server].name);
+      goto done;
+   }
+
+   result->up = true;
+   result->version = version;
+
+   ret = pgvictoria_prometheus_drift(server, items, result, drift);
+
+done:
+
+   pgvictoria_deque_destroy(items);
+
+   return ret;
+}
+
+int
+pgvictoria_prometheus_drift(int server, struct deque* items, struct collector_result* result, char** drift)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct deque_iterator* iter = NULL;
+   struct string_builder d;
+   char name[MISC_LENGTH * 2];
+   char setting[256];
+
+   *drift = NULL;
+   result->drift_length = 0;
+
+   if (server < 0 || server >= config->common.number_of_servers)
+   {
+      return 1;
+   }
+
+   escape_label(config->common.servers[server].name, name, sizeof(name));
+
+   pgvictoria_string_builder_init(&d);
+
+   /* The drift samples are rendered once here so a scrape never walks the settings */
+   if (pgvictoria_deque_iterator_create(items, &iter))
+   {
+      return 1;
+   }
+
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      struct pgvictoria_diff_item* item = (struct pgvictoria_diff_item*)iter->value->data;
+      char* status = NULL;
+
+      if (!strcmp(item->status, "Default"))
+      {
+         result->number_of_default++;
+         continue;
+      }
+      else if (!strcmp(item->status, "Modified"))
+      {
+         result->number_of_modified++;
+         status = "modified";
+      }
+      else
+      {
+         result->number_of_custom++;
+         status = "custom";
+      }
+
+      pgvictoria_string_builder_append_format(&d, "pgvictoria_setting_drift{name=\"%s\",setting=\"%s\",status=\"%s\"} 1\n",
+                                              name, setting_label(item, setting, sizeof(setting)), status);
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+
+   if (d.error)
+   {
+      pgvictoria_string_builder_destroy(&d);
+      return 1;
+   }
+
+   result->drift_length = d.length;
+   *drift = pgvictoria_string_builder_finish(&d);
+
+   return 0;
+}
+
+int
+pgvictoria_prometheus_update(struct collector_result* result, char* drift)
+{
+   struct prometheus_server* s = NULL;
+
+   if (result->server < 0 || result->server >= number_of_servers)
+   {
+      free(drift);
+      return 1;
+   }
+
+   s = &servers[result->server];
+
+   s->collections++;
+   s->duration = result->duration;
+   s->up = result->up;
+
+   if (!result->up)
+   {
+      /* What drifted on an unreachable server is no longer known */
+      s->errors++;
+      free(drift);
+      free(s->drift);
+      s->drift = NULL;
+      return 0;
+   }
+
+   s->version = result->version;
+   s->number_of_default = result->number_of_default;
+   s->number_of_modified = result->number_of_modified;
+   s->number_of_custom = result->number_of_custom;
+   s->last_collection = result->timestamp;
+
+   free(s->drift);
+   s->drift = drift;
+
+   return 0;
+}
+
+int
+pgvictoria_prometheus_render(void)
+{
+   int n = number_of_servers;
+   char* buffer = NULL;
+   size_t size;
+
+   render_length = 0;
+   render_failed = false;
+
+   render_append("# HELP pgvictoria_state The state of pgvictoria\n"
+                 "# TYPE pgvictoria_state gauge\n"
+                 "pgvictoria_state 1\n\n");
+
+   render_append("# HELP pgvictoria_server_up Is the server reachable by the last collection\n"
+                 "# TYPE pgvictoria_server_up gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_server_up{name=\"%s\"} %d\n", servers[i].label, servers[i].up ? 1 : 0);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_server_version The major version of the server\n"
+                 "# TYPE pgvictoria_server_version gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_server_version{name=\"%s\"} %d\n", servers[i].label, servers[i].version);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_settings The number of settings by baseline status\n"
+                 "# TYPE pgvictoria_settings gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_settings{name=\"%s\",status=\"default\"} %d\n", servers[i].label, servers[i].number_of_default);
+      render_append("pgvictoria_settings{name=\"%s\",status=\"modified\"} %d\n", servers[i].label, servers[i].number_of_modified);
+      render_append("pgvictoria_settings{name=\"%s\",status=\"custom\"} %d\n", servers[i].label, servers[i].number_of_custom);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_setting_drift The settings that differ from the baseline\n"
+                 "# TYPE pgvictoria_setting_drift gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      if (servers[i].drift != NULL)
+      {
+         render_append("%s", servers[i].drift);
+      }
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_collection_duration_seconds The duration of the last collection\n"
+                 "# TYPE pgvictoria_collection_duration_seconds gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_collection_duration_seconds{name=\"%s\"} %.6f\n", servers[i].label, servers[i].duration);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_collection_timestamp_seconds The time of the last successful collection\n"
+                 "# TYPE pgvictoria_collection_timestamp_seconds gauge\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_collection_timestamp_seconds{name=\"%s\"} %lld\n", servers[i].label, (long long)servers[i].last_collection);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_collections_total The number of collections\n"
+                 "# TYPE pgvictoria_collections_total counter\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_collections_total{name=\"%s\"} %" PRIu64 "\n", servers[i].label, servers[i].collections);
+   }
+   render_append("\n");
+
+   render_append("# HELP pgvictoria_collection_errors_total The number of failed collections\n"
+                 "# TYPE pgvictoria_collection_errors_total counter\n");
+   for (int i = 0; i < n; i++)
+   {
+      render_append("pgvictoria_collection_errors_total{name=\"%s\"} %" PRIu64 "\n", servers[i].label, servers[i].errors);
+   }
+
+   /* A render that lost a chunk is dropped, the cache keeps the last complete one */
+   if (render_failed)
+   {
+      pgvictoria_log_warn("Prometheus: could not render the metrics");
+      return 1;
+   }
+
+   buffer = cache;
+   size = cache_size;
+   cache = render;
+   cache_size = render_size;
+   cache_length = render_length;
+   render = buffer;
+   render_size = size;
+   render_length = 0;
+
+   return 0;
+}
+
+int
+pgvictoria_prometheus_client(struct ev_loop* loop, int client_fd)
+{
+   struct prometheus_client* client = NULL;
+   struct ev_io* io = NULL;
+   struct ev_timer* timer = NULL;
+
+   client = (struct prometheus_client*)malloc(sizeof(struct prometheus_client));
+   if (client == NULL)
+   {
+      pgvictoria_disconnect(client_fd);
+      return 1;
+   }
+
+   memset(client, 0, sizeof(struct prometheus_client));
+   client->fd = client_fd;
+
+   pgvictoria_socket_nonblocking(client_fd, true);
+
+   io = &client->io;
+   ev_io_init(io, client_cb, client_fd, EV_READ);
+   ev_io_start(loop, io);
+
+   timer = &client->timer;
+   ev_timer_init(timer, client_timeout_cb, PROMETHEUS_TIMEOUT, 0.0);
+   ev_timer_start(loop, timer);
+
+   return 0;
+}
+
+char*
+pgvictoria_prometheus_metrics(size_t* length)
+{
+   *length = cache_length;
+   return cache;
+}
+
+void
+pgvictoria_prometheus_destroy(void)
+{
+   for (int i = 0; servers != NULL && i < number_of_servers; i++)
+   {
+      free(servers[i].drift);
+   }
+   free(servers);
+   servers = NULL;
+   number_of_servers = 0;
+
+   for (int i = 0; setting_labels != NULL && i < number_of_setting_labels; i++)
+   {
+      free(setting_labels[i]);
+   }
+   free(setting_labels);
+   setting_labels = NULL;
+   number_of_setting_labels = 0;
+
+   free(cache);
+   cache = NULL;
+   cache_size = 0;
+   cache_length = 0;
+   free(render);
+   render = NULL;
+   render_size = 0;
+   render_length = 0;
+}
+
+/*
+ * Append to the render buffer. Both buffers are kept between renders and only
+ * ever grow, so once they have reached their working size a render allocates
+ * nothing. A failed append fails the whole render.
+ */
+static int
+render_append(char* format, ...)
+{
+   va_list args;
+   int length;
+
+   if (render_failed)
+   {
+      return 1;
+   }
+
+   va_start(args, format);
+   length = vsnprintf(render + render_length, render_size - render_length, format, args);
+   va_end(args);
+
+   if (length < 0)
+   {
+      render_failed = true;
+      return 1;
+   }
+
+   if (render_length + length >= render_size)
+   {
+      size_t size = render_size;
+      char* c = NULL;
+
+      while (render_length + length >= size)
+      {
+         size *= 2;
+      }
+
+      c = (char*)realloc(render, size);
+      if (c == NULL)
+      {
+         render[render_length] = '\0';
+         render_failed = true;
+         return 1;
+      }
+      render = c;
+      render_size = size;
+
+      va_start(args, format);
+      vsnprintf(render + render_length, render_size - render_length, format, args);
+      va_end(args);
+   }
+
+   render_length += length;
+
+   return 0;
+}
+
+static void
+escape_label(char* label, char* dst, size_t size)
+{
+   size_t j = 0;
+
+   for (size_t i = 0; label[i] != '\0' && j + 2 < size; i++)
+   {
+      if (label[i] == '\\' || label[i] == '"')
+      {
+         dst[j++] = '\\';
+         dst[j++] = label[i];
+      }
+      else if (label[i] == '\n')
+      {
+         dst[j++] = '\\';
+         dst[j++] = 'n';
+      }
+      else
+      {
+         dst[j++] = label[i];
+      }
+   }
+
+   dst[j] = '\0';
+}
+
+/*
+ * The escaped label of a setting. Known settings are escaped once per process,
+ * anything else into the buffer every time.
+ */
+static char*
+setting_label(struct pgvictoria_diff_item* item, char* buffer, size_t size)
+{
+   if (setting_labels == NULL || item->id < 0 || item->id >= number_of_setting_labels)
+   {
+      escape_label(item->key, buffer, size);
+      return buffer;
+   }
+
+   if (setting_labels[item->id] == NULL)
+   {
+      escape_label(pgvictoria_guc_name(item->id), buffer, size);
+      setting_labels[item->id] = pgvictoria_append(NULL, buffer);
+      if (setting_labels[item->id] == NULL)
+      {
+         return buffer;
+      }
+   }
+
+   return setting_labels[item->id];
+}
+
+static void
+client_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
+{
+   struct prometheus_client* client = (struct prometheus_client*)watcher;
+   ssize_t n;
+
+   if (revents & EV_READ)
+   {
+      n = read(client->fd, client->request + client->request_length, sizeof(client->request) - 1 - client->request_length);
+
+      if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      {
+         return;
+      }
+
+      if (n <= 0)
+      {
+         client_close(loop, client);
+         return;
+      }
+
+      client->request_length += n;
+      client->request[client->request_length] = '\0';
+
+      if (strstr(client->request, "\r\n\r\n") == NULL && client->request_length < sizeof(client->request) - 1)
+      {
+         return;
+      }
+
+      if (client_respond(loop, client))
+      {
+         client_close(loop, client);
+      }
+   }
+   else if (revents & EV_WRITE)
+   {
+      n = write(client->fd, client->response + client->written, client->response_length - client->written);
+
+      if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      {
+         return;
+      }
+
+      if (n <= 0)
+      {
+         client_close(loop, client);
+         return;
+      }
+
+      client->written += n;
+
+      if (client->written == client->response_length)
+      {
+         client_close(loop, client);
+      }
+   }
+}
+
+static void
+client_timeout_cb(struct ev_loop* loop, struct ev_timer* watcher, int revents)
+{
+   struct prometheus_client* client = (struct prometheus_client*)((char*)watcher - offsetof(struct prometheus_client, timer));
+
+   (void)revents;
+
+   pgvictoria_log_debug("Metrics client timed out");
+
+   client_close(loop, client);
+}
+
+static int
+client_respond(struct ev_loop* loop, struct prometheus_client* client)
+{
+   char header[256];
+   char* path = NULL;
+   char* end = NULL;
+   int header_length;
+
+   if (strstr(client->request, "\r\n\r\n") == NULL)
+   {
+      client->response = strdup(PROMETHEUS_RESPONSE_BAD_REQUEST);
+   }
+   else if (!pgvictoria_starts_with(client->request, "GET "))
+   {
+      client->response = strdup(PROMETHEUS_RESPONSE_NOT_ALLOWED);
+   }
+   else
+   {
+      path = client->request + 4;
+      end = strchr(path, ' ');
+      if (end != NULL)
+      {
+         *end = '\0';
+      }
+
+      if (!strcmp(path, "/metrics") || !strncmp(path, "/metrics?", 9))
+      {
+         header_length = snprintf(header, sizeof(header), PROMETHEUS_HEADER_OK, cache_length);
+
+         client->response = (char*)malloc(header_length + cache_length);
+         if (client->response != NULL)
+         {
+            memcpy(client->response, header, header_length);
+            memcpy(client->response + header_length, cache, cache_length);
+            client->response_length = header_length + cache_length;
+         }
+      }
+      else
+      {
+         client->response = strdup(PROMETHEUS_RESPONSE_NOT_FOUND);
+      }
+   }
+
+   if (client->response == NULL)
+   {
+      return 1;
+   }
+
+   if (client->response_length == 0)
+   {
+      client->response_length = strlen(client->response);
+   }
+
+   ev_io_stop(loop, &client->io);
+   ev_io_set(&client->io, client->fd, EV_WRITE);
+   ev_io_start(loop, &client->io);
+
+   return 0;
+}
+
+static void
+client_close(struct ev_loop* loop, struct prometheus_client* client)
+{
+   ev_io_stop(loop, &client->io);
+   ev_timer_stop(loop, &client->timer);
+
+   pgvictoria_disconnect(client->fd);
+
+   free(client->response);
+   free(client);
+}
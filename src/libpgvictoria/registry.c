@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <registry.h>
+#include <shmem.h>
+#include <utils.h>
+
+/* system */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REGISTRY_EMPTY     -1
+#define REGISTRY_ALIGNMENT 64
+
+#define FNV_OFFSET_BASIS   2166136261U
+#define FNV_PRIME          16777619U
+
+typedef bool (*registry_match)(struct common_configuration* config, int32_t entry, void* key);
+
+/** @struct endpoint
+ * Defines the key of the host:port index
+ */
+struct endpoint
+{
+   char* host; /**< The host */
+   int port;   /**< The port */
+};
+
+static void registry_layout(int servers, int users, struct registry* layout);
+static int registry_allocate(struct common_configuration* config, int servers, int users);
+static int registry_grow(struct common_configuration* config, int servers, int users);
+static void registry_index_server(struct common_configuration* config, int index);
+static void registry_index_user(struct common_configuration* config, int index);
+static int32_t* index_slots(struct registry* registry, size_t offset);
+static void index_insert(struct common_configuration* config, size_t offset, uint32_t slots, uint32_t hash, int32_t entry, registry_match match, void* key);
+static int index_find(struct common_configuration* config, size_t offset, uint32_t slots, uint32_t hash, registry_match match, void* key);
+static uint32_t hash_string(char* s, uint32_t hash);
+static uint32_t hash_endpoint(char* host, int port);
+static bool match_server_name(struct common_configuration* config, int32_t entry, void* key);
+static bool match_server_endpoint(struct common_configuration* config, int32_t entry, void* key);
+static bool match_user_name(struct common_configuration* config, int32_t entry, void* key);
+static size_t align(size_t size);
+static uint32_t slots_for(int capacity);
+
+int
+pgvictoria_registry_create(struct common_configuration* config, int servers, int users)
+{
+   config->registry = NULL;
+   config->servers = NULL;
+   config->users = NULL;
+   config->number_of_servers = 0;
+   config->number_of_users = 0;
+
+   return registry_allocate(config, MAX(servers, 1), MAX(users, 1));
+}
+
+int
+pgvictoria_registry_add_server(struct common_configuration* config, struct server* server, int* index)
+{
+   int i;
+
+   if (config->registry == NULL)
+   {
+      return 1;
+   }
+
+   if (config->number_of_servers == config->registry->server_capacity)
+   {
+      if (registry_grow(config, config->registry->server_capacity * 2, config->registry->user_capacity))
+      {
+         return 1;
+      }
+   }
+
+   i = config->number_of_servers;
+   memcpy(&config->servers[i], server, sizeof(struct server));
+   registry_index_server(config, i);
+   config->number_of_servers++;
+
+   if (index != NULL)
+   {
+      *index = i;
+   }
+
+   return 0;
+}
+
+int
+pgvictoria_registry_add_user(struct common_configuration* config, struct user* user, int* index)
+{
+   int i;
+
+   if (config->registry == NULL)
+   {
+      return 1;
+   }
+
+   if (config->number_of_users == config->registry->user_capacity)
+   {
+      if (registry_grow(config, config->registry->server_capacity, config->registry->user_capacity * 2))
+      {
+         return 1;
+      }
+   }
+
+   i = config->number_of_users;
+   memcpy(&config->users[i], user, sizeof(struct user));
+   registry_index_user(config, i);
+   config->number_of_users++;
+
+   if (index != NULL)
+   {
+      *index = i;
+   }
+
+   return 0;
+}
+
+int
+pgvictoria_registry_find_server(struct common_configuration* config, char* name)
+{
+   if (config->registry == NULL || name == NULL)
+   {
+      return -1;
+   }
+
+   return index_find(config, config->registry->server_names_offset, config->registry->server_slots,
+                     hash_string(name, FNV_OFFSET_BASIS), match_server_name, name);
+}
+
+int
+pgvictoria_registry_find_endpoint(struct common_configuration* config, char* host, int port)
+{
+   struct endpoint key;
+
+   if (config->registry == NULL || host == NULL)
+   {
+      return -1;
+   }
+
+   key.host = host;
+   key.port = port;
+
+   return index_find(config, config->registry->server_endpoints_offset, config->registry->server_slots,
+                     hash_endpoint(host, port), match_server_endpoint, &key);
+}
+
+int
+pgvictoria_registry_find_user(struct common_configuration* config, char* username)
+{
+   if (config->registry == NULL || username == NULL)
+   {
+      return -1;
+   }
+
+   return index_find(config, config->registry->user_names_offset, config->registry->user_slots,
+                     hash_string(username, FNV_OFFSET_BASIS), match_user_name, username);
+}
+
+void
+pgvictoria_registry_clear_servers(struct common_configuration* config)
+{
+   struct registry* r = config->registry;
+
+   if (r == NULL)
+   {
+      return;
+   }
+
+   memset(config->servers, 0, (size_t)r->server_capacity * sizeof(struct server));
+   memset(index_slots(r, r->server_names_offset), 0xff, r->server_slots * sizeof(int32_t));
+   memset(index_slots(r, r->server_endpoints_offset), 0xff, r->server_slots * sizeof(int32_t));
+   config->number_of_servers = 0;
+}
+
+void
+pgvictoria_registry_clear_users(struct common_configuration* config)
+{
+   struct registry* r = config->registry;
+
+   if (r == NULL)
+   {
+      return;
+   }
+
+   pgvictoria_cleanse(config->users, (size_t)r->user_capacity * sizeof(struct user));
+   memset(index_slots(r, r->user_names_offset), 0xff, r->user_slots * sizeof(int32_t));
+   config->number_of_users = 0;
+}
+
+void
+pgvictoria_registry_destroy(struct common_configuration* config)
+{
+   if (config->registry != NULL)
+   {
+      pgvictoria_destroy_shared_memory(config->registry, config->registry->size);
+   }
+
+   config->registry = NULL;
+   config->servers = NULL;
+   config->users = NULL;
+   config->number_of_servers = 0;
+   config->number_of_users = 0;
+}
+
+static void
+registry_layout(int servers, int users, struct registry* layout)
+{
+   size_t offset;
+
+   memset(layout, 0, sizeof(struct registry));
+
+   layout->server_capacity = servers;
+   layout->user_capacity = users;
+   layout->server_slots = slots_for(servers);
+   layout->user_slots = slots_for(users);
+
+   offset = align(sizeof(struct registry));
+
+   layout->servers_offset = offset;
+   offset = align(offset + (size_t)servers * sizeof(struct server));
+
+   layout->users_offset = offset;
+   offset = align(offset + (size_t)users * sizeof(struct user));
+
+   layout->server_names_offset = offset;
+   offset = align(offset + layout->server_slots * sizeof(int32_t));
+
+   layout->server_endpoints_offset = offset;
+   offset = align(offset + layout->server_slots * sizeof(int32_t));
+
+   layout->user_names_offset = offset;
+   offset = align(offset + layout->user_slots * sizeof(int32_t));
+
+   layout->size = offset;
+}
+
+static int
+registry_allocate(struct common_configuration* config, int servers, int users)
+{
+   struct registry layout;
+   struct registry* r = NULL;
+
+   registry_layout(servers, users, &layout);
+
+   if (pgvictoria_create_shared_memory(layout.size, HUGEPAGE_OFF, (void**)&r))
+   {
+      return 1;
+   }
+
+   memcpy(r, &layout, sizeof(struct registry));
+
+   memset(index_slots(r, r->server_names_offset), 0xff, r->server_slots * sizeof(int32_t));
+   memset(index_slots(r, r->server_endpoints_offset), 0xff, r->server_slots * sizeof(int32_t));
+   memset(index_slots(r, r->user_names_offset), 0xff, r->user_slots * sizeof(int32_t));
+
+   config->registry = r;
+   config->servers = (struct server*)((char*)r + r->servers_offset);
+   config->users = (struct user*)((char*)r + r->users_offset);
+
+   return 0;
+}
+
+static int
+registry_grow(struct common_configuration* config, int servers, int users)
+{
+   struct registry* old = config->registry;
+   struct server* old_servers = config->servers;
+   struct user* old_users = config->users;
+
+   if (registry_allocate(config, servers, users))
+   {
+      config->registry = old;
+      config->servers = old_servers;
+      config->users = old_users;
+      return 1;
+   }
+
+   /* Indexes are rebuilt since the slot counts change with the capacity */
+   memcpy(config->servers, old_servers, (size_t)config->number_of_servers * sizeof(struct server));
+   for (int i = 0; i < config->number_of_servers; i++)
+   {
+      registry_index_server(config, i);
+   }
+
+   memcpy(config->users, old_users, (size_t)config->number_of_users * sizeof(struct user));
+   for (int i = 0; i < config->number_of_users; i++)
+   {
+      registry_index_user(config, i);
+   }
+
+   pgvictoria_cleanse(old_users, (size_t)old->user_capacity * sizeof(struct user));
+   pgvictoria_destroy_shared_memory(old, old->size);
+
+   return 0;
+}
+
+static void
+registry_index_server(struct common_configuration* config, int index)
+{
+   struct registry* r = config->registry;
+   struct server* srv = &config->servers[index];
+   struct endpoint key;
+
+   index_insert(config, r->server_names_offset, r->server_slots, hash_string(srv->name, FNV_OFFSET_BASIS),
+                index, match_server_name, srv->name);
+
+   key.host = srv->host;
+   key.port = srv->port;
+
+   index_insert(config, r->server_endpoints_offset, r->server_slots, hash_endpoint(srv->host, srv->port),
+                index, match_server_endpoint, &key);
+}
+
+static void
+registry_index_user(struct common_configuration* config, int index)
+{
+   struct registry* r = config->registry;
+   struct user* usr = &config->users[index];
+
+   index_insert(config, r->user_names_offset, r->user_slots, hash_string(usr->username, FNV_OFFSET_BASIS),
+                index, match_user_name, usr->username);
+}
+
+static int32_t*
+index_slots(struct registry* registry, size_t offset)
+{
+   return (int32_t*)((char*)registry + offset);
+}
+
+static void
+index_insert(struct common_configuration* config, size_t offset, uint32_t slots, uint32_t hash, int32_t entry, registry_match match, void* key)
+{
+   int32_t* s = index_slots(config->registry, offset);
+   uint32_t mask = slots - 1;
+
+   /* Linear probing; a key that is already indexed keeps its first entry */
+   for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+   {
+      if (s[i] == REGISTRY_EMPTY)
+      {
+         s[i] = entry;
+         return;
+      }
+
+      if (match(config, s[i], key))
+      {
+         return;
+      }
+   }
+}
+
+static int
+index_find(struct common_configuration* config, size_t offset, uint32_t slots, uint32_t hash, registry_match match, void* key)
+{
+   int32_t* s = index_slots(config->registry, offset);
+   uint32_t mask = slots - 1;
+
+   for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+   {
+      if (s[i] == REGISTRY_EMPTY)
+      {
+         return -1;
+      }
+
+      if (match(config, s[i], key))
+      {
+         return s[i];
+      }
+   }
+}
+
+static uint32_t
+hash_string(char* s, uint32_t hash)
+{
+   for (unsigned char* p = (unsigned char*)s; *p != '\0'; p++)
+   {
+      hash ^= *p;
+      hash *= FNV_PRIME;
+   }
+
+   return hash;
+}
+
+static uint32_t
+hash_endpoint(char* host, int port)
+{
+   uint32_t hash = hash_string(host, FNV_OFFSET_BASIS);
+   uint32_t p = (uint32_t)port;
+
+   for (int i = 0; i < 4; i++)
+   {
+      hash ^= (p >> (i * 8)) & 0xff;
+      hash *= FNV_PRIME;
+   }
+
+   return hash;
+}
+
+static bool
+match_server_name(struct common_configuration* config, int32_t entry, void* key)
+{
+   return !strcmp(config->servers[entry].name, (char*)key);
+}
+
+static bool
+match_server_endpoint(struct common_configuration* config, int32_t entry, void* key)
+{
+   struct endpoint* e = (struct endpoint*)key;
+
+   return config->servers[entry].port == e->port && !strcmp(config->servers[entry].host, e->host);
+}
+
+static bool
+match_user_name(struct common_configuration* config, int32_t entry, void* key)
+{
+   return !strcmp(config->users[entry].username, (char*)key);
+}
+
+static size_t
+align(size_t size)
+{
+   return (size + REGISTRY_ALIGNMENT - 1) & ~((size_t)REGISTRY_ALIGNMENT - 1);
+}
+
+static uint32_t
+slots_for(int capacity)
+{
+   uint32_t slots = 16;
+
+   /* Keep the load factor at or below one half */
+   while (slots < (uint32_t)capacity * 2)
+   {
+      slots <<= 1;
+   }
+
+   return slots;
+}
@@ -34,6 +34,7 @@
 #include <security.h>
 #include <message.h>
 #include <postgresql.h>
+#include <registry.h>
 #include <logging.h>
 #include <network.h>
 #include <json.h>
@@ -45,51 +46,6 @@
 #include <string.h>
 #include <strings.h>
 #include <err.h>
-#include <ctype.h>
-
-/* libxml2 */
-#include <libxml/HTMLtree.h>
-#include <libxml/tree.h>
-
-static uintptr_t
-pgvictoria_json_get_typed_case_insensitive(struct json* baseline, char* key, enum value_type* type, char** matched_key)
-{
-   uintptr_t val = pgvictoria_json_get_typed(baseline, key, type);
-   if (val)
-   {
-      if (matched_key)
-      {
-         *matched_key = key;
-      }
-      return val;
-   }
-
-   /* Try lowercase lookup to avoid iterator scan */
-   char lower_key[128];
-   size_t key_len = strlen(key);
-   if (key_len < sizeof(lower_key))
-   {
-      for (size_t i = 0; i < key_len; i++)
-      {
-         lower_key[i] = tolower((unsigned char)key[i]);
-      }
-      lower_key[key_len] = '\0';
-
-      if (strcmp(lower_key, key) != 0)
-      {
-         val = pgvictoria_json_get_typed(baseline, lower_key, type);
-         if (val)
-         {
-            if (matched_key)
-            {
-               *matched_key = NULL;
-            }
-            return val;
-         }
-      }
-   }
-   return 0;
-}
 
 static int
 detect_pg_version(void)
@@ -121,8 +77,8 @@ detect_pg_version(void)
    return ver;
 }
 
-static int
-trim_and_extract_key_value(char* line, char* key, char* value)
+int
+pgvictoria_report_extract_key_value(char* line, char* key, char* value)
 {
    char* p = line;
    char* start_key;
@@ -214,15 +170,8 @@ trim_and_extract_key_value(char* line, char* key, char* value)
    return 0;
 }
 
-/*
- * Classify a single key/value against the baseline (Default / Modified / Custom)
- * and append it as a diff item to the report deque. Shared by both the file and
- * online datasources so the report is built identically regardless of source.
- * When skip_defaults is set, rows whose value matches the baseline default are not
- * added, so every renderer simply outputs whatever the deque contains.
- */
-static void
-report_add_diff_item(struct deque* items, struct json* baseline, char* key, char* val, int skip_defaults)
+int
+pgvictoria_report_classify(struct json* baseline, char* key, char* val, struct pgvictoria_diff_item* item)
 {
    /*
     * SHOW ALL returns an empty GUC setting as a zero-length column, which the
@@ -233,10 +182,19 @@ report_add_diff_item(struct deque* items, struct json* baseline, char* key, char
    const char* cur_val = val ? val : "";
 
    enum value_type type;
-   char* matched_key = NULL;
-   uintptr_t baseline_val_ptr = pgvictoria_json_get_typed_case_insensitive(baseline, key, &type, &matched_key);
+   uintptr_t baseline_val_ptr = 0;
+
+   if (baseline == NULL || key == NULL || item == NULL)
+   {
+      return 1;
+   }
+
+   /* The name is resolved once, everything downstream goes by the id */
+   item->id = pgvictoria_guc_id(key);
+
+   /* The baseline matches setting names regardless of case */
+   baseline_val_ptr = pgvictoria_json_get_typed(baseline, key, &type);
 
-   const char* disp_key = matched_key ? matched_key : key;
    const char* def_val = "-";
    const char* status_text = "Custom";
    char* default_val_str = NULL;
@@ -254,7 +212,7 @@ report_add_diff_item(struct deque* items, struct json* baseline, char* key, char
                bool modified = false;
 
                def_val = default_val_str;
-               pgvictoria_check_guc((char*)disp_key, type, default_val_str, (char*)cur_val, &modified);
+               pgvictoria_check_guc_id(item->id, type, default_val_str, (char*)cur_val, &modified);
                status_text = modified ? "Modified" : "Default";
             }
             pgvictoria_value_destroy(v);
@@ -273,28 +231,47 @@ report_add_diff_item(struct deque* items, struct json* baseline, char* key, char
       status_text = (cur_val[0] == '\0') ? "Default" : "Modified";
    }
 
-   /* In "changed" mode, drop settings whose value matches the baseline default. */
-   if (skip_defaults && strcmp(status_text, "Default") == 0)
+   snprintf(item->key, sizeof(item->key), "%s", key);
+   snprintf(item->baseline_val, sizeof(item->baseline_val), "%s", def_val);
+   snprintf(item->current_val, sizeof(item->current_val), "%s", cur_val);
+   snprintf(item->status, sizeof(item->status), "%s", status_text);
+
+   free(default_val_str);
+
+   return 0;
+}
+
+/*
+ * Classify a single key/value against the baseline (Default / Modified / Custom)
+ * and append it as a diff item to the report deque. Shared by both the file and
+ * online datasources so the report is built identically regardless of source.
+ * When skip_defaults is set, rows whose value matches the baseline default are not
+ * added, so every renderer simply outputs whatever the deque contains.
+ */
+static void
+report_add_diff_item(struct deque* items, struct json* baseline, char* key, char* val, int skip_defaults)
+{
+   struct pgvictoria_diff_item* item = malloc(sizeof(struct pgvictoria_diff_item));
+
+   if (item == NULL)
    {
-      free(default_val_str);
       return;
    }
 
-   struct pgvictoria_diff_item* item = malloc(sizeof(struct pgvictoria_diff_item));
-   if (item)
+   if (pgvictoria_report_classify(baseline, key, val, item))
    {
-      snprintf(item->key, sizeof(item->key), "%s", disp_key);
-      snprintf(item->baseline_val, sizeof(item->baseline_val), "%s", def_val);
-      snprintf(item->current_val, sizeof(item->current_val), "%s", cur_val);
-      snprintf(item->status, sizeof(item->status), "%s", status_text);
-
-      pgvictoria_deque_add(items, NULL, (uintptr_t)item, ValueMem);
+      free(item);
+      return;
    }
 
-   if (default_val_str)
+   /* In "changed" mode, drop settings whose value matches the baseline default. */
+   if (skip_defaults && strcmp(item->status, "Default") == 0)
    {
-      free(default_val_str);
+      free(item);
+      return;
    }
+
+   pgvictoria_deque_add(items, NULL, (uintptr_t)item, ValueMem);
 }
 
 /*
@@ -368,6 +345,10 @@ report_render(struct deque* items, int version, enum pgvictoria_output_format fo
    {
       ret = pgvictoria_generate_html_report(resolved_output, version, items, scope_label, scope_value);
    }
+   else if (format == PGVICTORIA_OUTPUT_FLEET)
+   {
+      ret = pgvictoria_generate_html_fleet_report(resolved_output, version, items, scope_label, scope_value);
+   }
    else
    {
       /* Text to a file: create the parent directory like the renderers do. */
@@ -396,7 +377,7 @@ report_render(struct deque* items, int version, enum pgvictoria_output_format fo
 }
 
 int
-pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum pgvictoria_report_type type, char* output_file)
+pgvictoria_report_collect(int server, enum pgvictoria_report_type type, int* version, struct deque** items)
 {
    struct main_configuration* config = (struct main_configuration*)shmem;
    struct server* srv;
@@ -405,10 +386,13 @@ pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum
    struct message* msg = NULL;
    struct query_response* version_response = NULL;
    struct query_response* all_response = NULL;
-   int version = 0;
    struct json* baseline = NULL;
+   struct deque* result = NULL;
    int ret = 1;
 
+   *version = 0;
+   *items = NULL;
+
    if (server < 0 || server >= config->common.number_of_servers)
    {
       warnx("Invalid server index");
@@ -418,13 +402,10 @@ pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum
    srv = &config->common.servers[server];
 
    char* password_str = "";
-   for (int i = 0; i < config->common.number_of_users; i++)
+   int user = pgvictoria_registry_find_user(&config->common, srv->username);
+   if (user != -1)
    {
-      if (strcmp(config->common.users[i].username, srv->username) == 0)
-      {
-         password_str = config->common.users[i].password;
-         break;
-      }
+      password_str = config->common.users[user].password;
    }
    if (password_str == NULL || *password_str == '\0')
    {
@@ -458,14 +439,14 @@ pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum
       char* ver_str = version_response->tuples->data[0];
       if (pgvictoria_is_number(ver_str, 10))
       {
-         version = pgvictoria_atoi(ver_str) / 10000;
+         *version = pgvictoria_atoi(ver_str) / 10000;
       }
    }
 
-   baseline = pgvictoria_get_baseline(version);
+   baseline = pgvictoria_get_baseline(*version);
    if (!baseline)
    {
-      warnx("No baseline available for PostgreSQL version %d", version);
+      warnx("No baseline available for PostgreSQL version %d", *version);
       goto error;
    }
 
@@ -480,25 +461,22 @@ pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum
    }
 
    /* Build the source-agnostic diff deque from the live configuration */
-   struct deque* items = NULL;
-   pgvictoria_deque_create(false, &items);
+   if (pgvictoria_deque_create(false, &result))
+   {
+      goto error;
+   }
 
    int skip_defaults = (type == PGVICTORIA_REPORT_CHANGED);
 
    struct tuple* curr = all_response->tuples;
    while (curr)
    {
-      report_add_diff_item(items, baseline, curr->data[0], curr->data[1], skip_defaults);
+      report_add_diff_item(result, baseline, curr->data[0], curr->data[1], skip_defaults);
       curr = curr->next;
    }
 
-   /* Render the deque in the requested format */
-   char endpoint[MISC_LENGTH + 8];
-   pgvictoria_snprintf(endpoint, sizeof(endpoint), "%s:%d", srv->host, srv->port);
-
-   ret = report_render(items, version, format, output_file, "Online", endpoint);
-
-   pgvictoria_deque_destroy(items);
+   *items = result;
+   ret = 0;
 
 error:
    if (msg)
@@ -531,6 +509,116 @@ error:
    return ret;
 }
 
+int
+pgvictoria_report_online(int server, enum pgvictoria_output_format format, enum pgvictoria_report_type type, char* output_file)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct server* srv;
+   struct deque* items = NULL;
+   int version = 0;
+   int ret = 1;
+
+   if (pgvictoria_report_collect(server, type, &version, &items))
+   {
+      return 1;
+   }
+
+   srv = &config->common.servers[server];
+
+   /* Render the deque in the requested format */
+   char endpoint[MISC_LENGTH + 8];
+   pgvictoria_snprintf(endpoint, sizeof(endpoint), "%s:%d", srv->host, srv->port);
+
+   ret = report_render(items, version, format, output_file, "Online", endpoint);
+
+   pgvictoria_deque_destroy(items);
+
+   return ret;
+}
+
+int
+pgvictoria_report_fleet(enum pgvictoria_report_type type, char* output_file)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct html_report* report = NULL;
+   struct deque* items = NULL;
+   struct deque_iterator* it = NULL;
+   char* resolved_output = NULL;
+   char scope[32];
+   int version = 0;
+   int reported = 0;
+   int ret = 1;
+
+   if (output_file == NULL || output_file[0] == '\0')
+   {
+      warnx("pgvictoria-cli: -o/--output is required");
+      return 1;
+   }
+
+   if (pgvictoria_resolve_path(output_file, &resolved_output) != 0 || resolved_output == NULL)
+   {
+      resolved_output = strdup(output_file);
+   }
+
+   pgvictoria_snprintf(scope, sizeof(scope), "%d servers", config->common.number_of_servers);
+
+   if (pgvictoria_html_fleet_open(resolved_output, "Online", scope, &report))
+   {
+      warn("pgvictoria-cli: Cannot open output file %s", resolved_output);
+      goto done;
+   }
+
+   /* One server at a time, so only its settings are held in memory */
+   for (int i = 0; i < config->common.number_of_servers; i++)
+   {
+      if (pgvictoria_report_collect(i, type, &version, &items))
+      {
+         warnx("pgvictoria-cli: Skipping server %s", config->common.servers[i].name);
+         continue;
+      }
+
+      if (pgvictoria_html_fleet_server(report, config->common.servers[i].name, version))
+      {
+         pgvictoria_deque_destroy(items);
+         goto close;
+      }
+
+      pgvictoria_deque_iterator_create(items, &it);
+      while (pgvictoria_deque_iterator_next(it))
+      {
+         if (pgvictoria_html_fleet_row(report, (struct pgvictoria_diff_item*)it->value->data))
+         {
+            pgvictoria_deque_iterator_destroy(it);
+            pgvictoria_deque_destroy(items);
+            goto close;
+         }
+      }
+      pgvictoria_deque_iterator_destroy(it);
+      pgvictoria_deque_destroy(items);
+      items = NULL;
+
+      reported++;
+   }
+
+   ret = reported > 0 ? 0 : 1;
+
+close:
+   if (pgvictoria_html_fleet_close(report))
+   {
+      ret = 1;
+   }
+
+   if (ret == 0)
+   {
+      printf("Report successfully generated to %s\n", resolved_output);
+   }
+
+done:
+   free(resolved_output);
+
+   return ret;
+}
+
 static int
 detect_pg_version_from_file(const char* filename)
 {
@@ -571,6 +659,31 @@ detect_pg_version_from_file(const char* filename)
    return version;
 }
 
+int
+pgvictoria_report_detect_version(char* filename, int override_version)
+{
+   int version = 0;
+
+   if (pgvictoria_is_version_supported(override_version))
+   {
+      return override_version;
+   }
+
+   /* Fallback to file comment detection */
+   if (filename != NULL)
+   {
+      version = detect_pg_version_from_file(filename);
+   }
+
+   /* Fallback to local system check if file comment check failed */
+   if (!pgvictoria_is_version_supported(version))
+   {
+      version = detect_pg_version();
+   }
+
+   return version;
+}
+
 int
 pgvictoria_report_file(char* filename, enum pgvictoria_output_format format, enum pgvictoria_report_type type, char* output_file, int override_version)
 {
@@ -612,21 +725,7 @@ pgvictoria_report_file(char* filename, enum pgvictoria_output_format format, enu
       return 1;
    }
 
-   if (pgvictoria_is_version_supported(override_version))
-   {
-      version = override_version;
-   }
-   else
-   {
-      /* Fallback to file comment detection */
-      version = detect_pg_version_from_file(resolved_filename);
-
-      /* Fallback to local system check if file comment check failed */
-      if (!pgvictoria_is_version_supported(version))
-      {
-         version = detect_pg_version();
-      }
-   }
+   version = pgvictoria_report_detect_version(resolved_filename, override_version);
 
    baseline = pgvictoria_get_baseline(version);
    if (!baseline)
@@ -661,7 +760,7 @@ pgvictoria_report_file(char* filename, enum pgvictoria_output_format format, enu
       line_number++;
       memset(key, 0, sizeof(key));
       memset(value, 0, sizeof(value));
-      int status = trim_and_extract_key_value(line, key, value);
+      int status = pgvictoria_report_extract_key_value(line, key, value);
 
       if (status == 0)
       {
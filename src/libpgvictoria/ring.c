@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <ring.h>
+#include <shmem.h>
+
+/* system */
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Every record starts with an 8 byte header. The low word holds the length and
+ * the published bit, the high word the pid of the producer that claimed the
+ * record. Records are padded to 8 bytes so a header never wraps.
+ */
+#define RING_HEADER_SIZE 8
+#define RING_ALIGNMENT   8
+#define RING_MIN_SIZE    64
+#define RING_PUBLISHED   0x80000000U
+#define RING_OWNER_SHIFT 32
+
+static uint64_t ring_capacity(size_t capacity);
+static uint64_t record_size(size_t length);
+static atomic_ullong* record_header(struct ring* ring, uint64_t offset);
+static bool record_abandoned(uint64_t header);
+static void ring_write(struct ring* ring, uint64_t offset, void* src, size_t length);
+static void ring_read(struct ring* ring, uint64_t offset, void* dst, size_t length);
+static void ring_clear(struct ring* ring, uint64_t offset, size_t length);
+
+size_t
+pgvictoria_ring_size(size_t capacity)
+{
+   return sizeof(struct ring) + ring_capacity(capacity);
+}
+
+int
+pgvictoria_ring_init(void* memory, size_t capacity, struct ring** ring)
+{
+   struct ring* r = NULL;
+   uint64_t c;
+
+   *ring = NULL;
+
+   if (memory == NULL || ((uintptr_t)memory & 63) != 0)
+   {
+      return 1;
+   }
+
+   c = ring_capacity(capacity);
+   if (c == 0)
+   {
+      return 1;
+   }
+
+   r = (struct ring*)memory;
+   memset(r, 0, sizeof(struct ring) + c);
+
+   r->capacity = c;
+   r->shared = false;
+   r->skipped = 0;
+   atomic_init(&r->head, 0);
+   atomic_init(&r->tail, 0);
+
+   *ring = r;
+
+   return 0;
+}
+
+int
+pgvictoria_ring_create(size_t capacity, struct ring** ring)
+{
+   void* s = NULL;
+   size_t size;
+
+   *ring = NULL;
+
+   size = pgvictoria_ring_size(capacity);
+
+   if (pgvictoria_create_shared_memory(size, HUGEPAGE_OFF, &s))
+   {
+      return 1;
+   }
+
+   if (pgvictoria_ring_init(s, capacity, ring))
+   {
+      pgvictoria_destroy_shared_memory(s, size);
+      return 1;
+   }
+
+   (*ring)->shared = true;
+
+   return 0;
+}
+
+size_t
+pgvictoria_ring_max_length(struct ring* ring)
+{
+   return ring->capacity / 2 - RING_HEADER_SIZE;
+}
+
+int
+pgvictoria_ring_push(struct ring* ring, void* data, size_t length)
+{
+   struct iovec iov;
+
+   iov.iov_base = data;
+   iov.iov_len = length;
+
+   return pgvictoria_ring_pushv(ring, &iov, 1);
+}
+
+int
+pgvictoria_ring_pushv(struct ring* ring, struct iovec* iov, int iovcnt)
+{
+   uint64_t head;
+   uint64_t tail;
+   uint64_t size;
+   uint64_t offset;
+   uint64_t owner;
+   size_t length = 0;
+
+   for (int i = 0; i < iovcnt; i++)
+   {
+      length += iov[i].iov_len;
+   }
+
+   if (length > pgvictoria_ring_max_length(ring))
+   {
+      return RING_TOO_BIG;
+   }
+
+   size = record_size(length);
+   owner = (uint64_t)(uint32_t)getpid() << RING_OWNER_SHIFT;
+
+   /* Claim the space; a failed exchange reloads head so only tail is reread */
+   head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   do
+   {
+      tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+      if (ring->capacity - (head - tail) < size)
+      {
+         return RING_FULL;
+      }
+   }
+   while (!atomic_compare_exchange_weak_explicit(&ring->head, &head, head + size,
+                                                 memory_order_relaxed, memory_order_relaxed));
+
+   /*
+    * Record the owner right away, so the consumer can skip the record should
+    * this process die before it is published
+    */
+   atomic_store_explicit(record_header(ring, head), owner | length, memory_order_relaxed);
+
+   offset = head + RING_HEADER_SIZE;
+   for (int i = 0; i < iovcnt; i++)
+   {
+      if (iov[i].iov_len > 0)
+      {
+         ring_write(ring, offset, iov[i].iov_base, iov[i].iov_len);
+         offset += iov[i].iov_len;
+      }
+   }
+
+   atomic_store_explicit(record_header(ring, head), owner | length | RING_PUBLISHED, memory_order_release);
+
+   return RING_OK;
+}
+
+int
+pgvictoria_ring_peek(struct ring* ring, size_t* length)
+{
+   uint64_t tail;
+   uint64_t header;
+   uint64_t record;
+
+   *length = 0;
+
+   for (;;)
+   {
+      tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      header = atomic_load_explicit(record_header(ring, tail), memory_order_acquire);
+
+      if (header & RING_PUBLISHED)
+      {
+         break;
+      }
+
+      if (!record_abandoned(header))
+      {
+         return RING_EMPTY;
+      }
+
+      /* The producer died between claiming and publishing the record, drop it */
+      record = record_size((uint32_t)header);
+      ring_clear(ring, tail, record);
+      atomic_store_explicit(&ring->tail, tail + record, memory_order_release);
+      ring->skipped++;
+   }
+
+   *length = (uint32_t)header & ~RING_PUBLISHED;
+
+   return RING_OK;
+}
+
+int
+pgvictoria_ring_pop(struct ring* ring, void* buffer, size_t size, size_t* length)
+{
+   uint64_t tail;
+   uint64_t record;
+
+   if (pgvictoria_ring_peek(ring, length) != RING_OK)
+   {
+      return RING_EMPTY;
+   }
+
+   if (*length > size)
+   {
+      return RING_TOO_SMALL;
+   }
+
+   tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+   record = record_size(*length);
+
+   ring_read(ring, tail + RING_HEADER_SIZE, buffer, *length);
+
+   /* Producers see the cleared record before they can claim it again */
+   ring_clear(ring, tail, record);
+   atomic_store_explicit(&ring->tail, tail + record, memory_order_release);
+
+   return RING_OK;
+}
+
+bool
+pgvictoria_ring_empty(struct ring* ring)
+{
+   return atomic_load_explicit(&ring->head, memory_order_acquire) ==
+          atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+void
+pgvictoria_ring_destroy(struct ring* ring)
+{
+   if (ring != NULL && ring->shared)
+   {
+      pgvictoria_destroy_shared_memory(ring, pgvictoria_ring_size(ring->capacity));
+   }
+}
+
+static uint64_t
+ring_capacity(size_t capacity)
+{
+   uint64_t c = RING_MIN_SIZE;
+
+   if (capacity > (size_t)(RING_PUBLISHED))
+   {
+      return 0;
+   }
+
+   while (c < capacity)
+   {
+      c <<= 1;
+   }
+
+   return c;
+}
+
+static uint64_t
+record_size(size_t length)
+{
+   return (RING_HEADER_SIZE + length + RING_ALIGNMENT - 1) & ~((uint64_t)RING_ALIGNMENT - 1);
+}
+
+static atomic_ullong*
+record_header(struct ring* ring, uint64_t offset)
+{
+   return (atomic_ullong*)(ring->data + (offset & (ring->capacity - 1)));
+}
+
+/*
+ * A claimed record whose owner no longer exists will never be published. A
+ * record claimed by a producer that died before it could even write its pid
+ * reads as free and cannot be told apart from one still being claimed.
+ */
+static bool
+record_abandoned(uint64_t header)
+{
+   pid_t owner = (pid_t)(header >> RING_OWNER_SHIFT);
+
+   if (owner <= 0 || owner == getpid())
+   {
+      return false;
+   }
+
+   return kill(owner, 0) == -1 && errno == ESRCH;
+}
+
+static void
+ring_write(struct ring* ring, uint64_t offset, void* src, size_t length)
+{
+   uint64_t position = offset & (ring->capacity - 1);
+   size_t first = MIN(length, ring->capacity - position);
+
+   memcpy(ring->data + position, src, first);
+   if (first < length)
+   {
+      memcpy(ring->data, (char*)src + first, length - first);
+   }
+}
+
+static void
+ring_read(struct ring* ring, uint64_t offset, void* dst, size_t length)
+{
+   uint64_t position = offset & (ring->capacity - 1);
+   size_t first = MIN(length, ring->capacity - position);
+
+   memcpy(dst, ring->data + position, first);
+   if (first < length)
+   {
+      memcpy((char*)dst + first, ring->data, length - first);
+   }
+}
+
+static void
+ring_clear(struct ring* ring, uint64_t offset, size_t length)
+{
+   uint64_t position = offset & (ring->capacity - 1);
+   size_t first = MIN(length, ring->capacity - position);
+
+   atomic_store_explicit(record_header(ring, offset), 0, memory_order_relaxed);
+
+   memset(ring->data + position + RING_HEADER_SIZE, 0, first - RING_HEADER_SIZE);
+   if (first < length)
+   {
+      memset(ring->data, 0, length - first);
+   }
+}
@@ -31,6 +31,7 @@
 #include <logging.h>
 #include <network.h>
 #include <security.h>
+#include <trace.h>
 #include <stddef.h>
 #include <utils.h>
 
@@ -84,9 +85,9 @@ static int generate_md5(char* str, int length, char** md5);
 static int client_scram256(SSL* c_ssl, int client_fd, char* password, int slot);
 
 static int server_trust(void);
-static int server_password(char* username, char* password, SSL* ssl, int server_fd);
-static int server_md5(char* username, char* password, SSL* ssl, int server_fd);
-static int server_scram256(char* username, char* password, SSL* ssl, int server_fd);
+static int server_password(char* username, char* password, SSL* ssl, int server_fd, bool trace);
+static int server_md5(char* username, char* password, SSL* ssl, int server_fd, bool trace);
+static int server_scram256(char* username, char* password, SSL* ssl, int server_fd, bool trace);
 
 static int sasl_prep(char* password, char** password_prep);
 static int generate_nounce(char** nounce);
@@ -873,6 +874,7 @@ pgvictoria_server_authenticate(int server, char* database, char* username, char*
    int auth_type;
    int ret;
    int status = AUTH_ERROR;
+   bool trace;
    SSL* c_ssl = NULL;
    struct message* ssl_msg = NULL;
    struct message* startup_msg = NULL;
@@ -886,6 +888,9 @@ pgvictoria_server_authenticate(int server, char* database, char* username, char*
    server_fd = -1;
    config = (struct main_configuration*)shmem;
 
+   /* The messages of a sampled authentication are traced together */
+   trace = pgvictoria_trace_sample(TRACE_SECURITY);
+
    for (int i = 0; i < NUMBER_OF_SECURITY_MESSAGES; i++)
    {
       memset(&security_messages[i], 0, SECURITY_BUFFER_SIZE);
@@ -916,6 +921,10 @@ pgvictoria_server_authenticate(int server, char* database, char* username, char*
    }
 
    ret = pgvictoria_write_message(c_ssl, server_fd, startup_msg);
+   if (trace && ret == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '>', startup_msg);
+   }
    if (ret != MESSAGE_STATUS_OK)
    {
       pgvictoria_log_info("pgvictoria_create_startup_message: %d", ret);
@@ -923,6 +932,10 @@ pgvictoria_server_authenticate(int server, char* database, char* username, char*
    }
 
    ret = pgvictoria_read_block_message(c_ssl, server_fd, &msg);
+   if (trace && ret == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '<', msg);
+   }
    if (ret != MESSAGE_STATUS_OK)
    {
       pgvictoria_log_info("pgvictoria_read_block_message (STARTUP): %d", ret);
@@ -949,15 +962,15 @@ pgvictoria_server_authenticate(int server, char* database, char* username, char*
    }
    else if (auth_type == SECURITY_PASSWORD)
    {
-      status = server_password(username, password, c_ssl, server_fd);
+      status = server_password(username, password, c_ssl, server_fd, trace);
    }
    else if (auth_type == SECURITY_MD5)
    {
-      status = server_md5(username, password, c_ssl, server_fd);
+      status = server_md5(username, password, c_ssl, server_fd, trace);
    }
    else if (auth_type == SECURITY_SCRAM256)
    {
-      status = server_scram256(username, password, c_ssl, server_fd);
+      status = server_scram256(username, password, c_ssl, server_fd, trace);
    }
 
    if (status == AUTH_BAD_PASSWORD)
@@ -1018,7 +1031,7 @@ server_trust(void)
 }
 
 static int
-server_password(char* username, char* password, SSL* ssl, int server_fd)
+server_password(char* username, char* password, SSL* ssl, int server_fd, bool trace)
 {
    int status = MESSAGE_STATUS_ERROR;
    int auth_index = 1;
@@ -1035,6 +1048,10 @@ server_password(char* username, char* password, SSL* ssl, int server_fd)
    }
 
    status = pgvictoria_write_message(ssl, server_fd, password_msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '>', password_msg);
+   }
    if (status != MESSAGE_STATUS_OK)
    {
       goto error;
@@ -1045,9 +1062,12 @@ server_password(char* username, char* password, SSL* ssl, int server_fd)
    auth_index++;
 
    status = pgvictoria_read_block_message(ssl, server_fd, &auth_msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '<', auth_msg);
+   }
    if (auth_msg->length > SECURITY_BUFFER_SIZE)
    {
-      pgvictoria_log_message(auth_msg);
       pgvictoria_log_error("Security message too large: %ld", auth_msg->length);
       goto error;
    }
@@ -1059,7 +1079,6 @@ server_password(char* username, char* password, SSL* ssl, int server_fd)
    {
       if (auth_msg->length > SECURITY_BUFFER_SIZE)
       {
-         pgvictoria_log_message(auth_msg);
          pgvictoria_log_error("Security message too large: %ld", auth_msg->length);
          goto error;
       }
@@ -1097,7 +1116,7 @@ error:
 }
 
 static int
-server_md5(char* username, char* password, SSL* ssl, int server_fd)
+server_md5(char* username, char* password, SSL* ssl, int server_fd, bool trace)
 {
    int status = MESSAGE_STATUS_ERROR;
    int auth_index = 1;
@@ -1150,6 +1169,10 @@ server_md5(char* username, char* password, SSL* ssl, int server_fd)
    }
 
    status = pgvictoria_write_message(ssl, server_fd, md5_msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '>', md5_msg);
+   }
    if (status != MESSAGE_STATUS_OK)
    {
       goto error;
@@ -1160,9 +1183,12 @@ server_md5(char* username, char* password, SSL* ssl, int server_fd)
    auth_index++;
 
    status = pgvictoria_read_block_message(ssl, server_fd, &auth_msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '<', auth_msg);
+   }
    if (auth_msg->length > SECURITY_BUFFER_SIZE)
    {
-      pgvictoria_log_message(auth_msg);
       pgvictoria_log_error("Security message too large: %ld", auth_msg->length);
       goto error;
    }
@@ -1174,7 +1200,6 @@ server_md5(char* username, char* password, SSL* ssl, int server_fd)
    {
       if (auth_msg->length > SECURITY_BUFFER_SIZE)
       {
-         pgvictoria_log_message(auth_msg);
          pgvictoria_log_error("Security message too large: %ld", auth_msg->length);
          goto error;
       }
@@ -1230,7 +1255,7 @@ error:
 }
 
 static int
-server_scram256(char* username, char* password, SSL* ssl, int server_fd)
+server_scram256(char* username, char* password, SSL* ssl, int server_fd, bool trace)
 {
    int status = MESSAGE_STATUS_ERROR;
    int auth_index = 1;
@@ -1282,15 +1307,22 @@ server_scram256(char* username, char* password, SSL* ssl, int server_fd)
    auth_index++;
 
    status = pgvictoria_write_message(ssl, server_fd, sasl_response);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '>', sasl_response);
+   }
    if (status != MESSAGE_STATUS_OK)
    {
       goto error;
    }
 
    status = pgvictoria_read_block_message(ssl, server_fd, &msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '<', msg);
+   }
    if (msg->length > SECURITY_BUFFER_SIZE)
    {
-      pgvictoria_log_message(msg);
       pgvictoria_log_error("Security message too large: %ld", msg->length);
       goto error;
    }
@@ -1351,15 +1383,22 @@ server_scram256(char* username, char* password, SSL* ssl, int server_fd)
    auth_index++;
 
    status = pgvictoria_write_message(ssl, server_fd, sasl_continue_response);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '>', sasl_continue_response);
+   }
    if (status != MESSAGE_STATUS_OK)
    {
       goto error;
    }
 
    status = pgvictoria_read_block_message(ssl, server_fd, &msg);
+   if (trace && status == MESSAGE_STATUS_OK)
+   {
+      pgvictoria_trace_message(TRACE_SECURITY, '<', msg);
+   }
    if (msg->length > SECURITY_BUFFER_SIZE)
    {
-      pgvictoria_log_message(msg);
       pgvictoria_log_error("Security message too large: %ld", msg->length);
       goto error;
    }
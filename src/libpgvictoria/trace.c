@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <logging.h>
+#include <trace.h>
+#include <utils.h>
+
+/* system */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @struct trace_bucket
+ * Defines the token bucket of a subsystem in this process
+ */
+struct trace_bucket
+{
+   double tokens;            /**< The number of trace lines that may be written */
+   int rate;                 /**< The rate the bucket was filled for */
+   struct timespec last;     /**< The time of the last refill */
+   unsigned long suppressed; /**< The number of lines suppressed since the last one written */
+};
+
+/** @struct trace_type
+ * Defines the messages of one type in a response
+ */
+struct trace_type
+{
+   long count;   /**< The number of messages */
+   long bytes;   /**< The number of bytes */
+   size_t first; /**< The offset of the first message */
+};
+
+static char* names[] = {"protocol", "security"};
+
+/* Security messages carry password hashes and proofs */
+static bool payloads[] = {true, false};
+
+static struct trace_bucket buckets[NUMBER_OF_TRACE_SUBSYSTEMS];
+static uint64_t random_state = 0;
+static pid_t random_pid = 0;
+
+static uint64_t trace_random(void);
+static void trace_payload(char* data, size_t length, char* out, size_t size);
+
+bool
+pgvictoria_trace_sample(int subsystem)
+{
+   struct main_configuration* config;
+   int sample;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || subsystem < 0 || subsystem >= NUMBER_OF_TRACE_SUBSYSTEMS)
+   {
+      return false;
+   }
+
+   sample = config->common.trace[subsystem].sample;
+
+   if (sample <= 0)
+   {
+      return false;
+   }
+   else if (sample >= 100)
+   {
+      return true;
+   }
+
+   return trace_random() % 100 < (uint64_t)sample;
+}
+
+bool
+pgvictoria_trace_allow(int subsystem)
+{
+   struct main_configuration* config;
+   struct trace_bucket* bucket;
+   struct timespec now;
+   unsigned long suppressed;
+   double elapsed;
+   int rate;
+
+   config = (struct main_configuration*)shmem;
+
+   if (config == NULL || subsystem < 0 || subsystem >= NUMBER_OF_TRACE_SUBSYSTEMS)
+   {
+      return false;
+   }
+
+   rate = config->common.trace[subsystem].rate;
+   if (rate <= 0)
+   {
+      return true;
+   }
+
+   bucket = &buckets[subsystem];
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   if (bucket->rate != rate)
+   {
+      /* A new rate starts with a full bucket */
+      bucket->rate = rate;
+      bucket->tokens = rate;
+   }
+   else
+   {
+      elapsed = (double)(now.tv_sec - bucket->last.tv_sec) + (double)(now.tv_nsec - bucket->last.tv_nsec) / 1000000000.0;
+      bucket->tokens = MIN((double)rate, bucket->tokens + elapsed * rate);
+   }
+   bucket->last = now;
+
+   if (bucket->tokens < 1.0)
+   {
+      bucket->suppressed++;
+      return false;
+   }
+
+   bucket->tokens -= 1.0;
+
+   if (bucket->suppressed > 0)
+   {
+      suppressed = bucket->suppressed;
+      bucket->suppressed = 0;
+      pgvictoria_log_info("trace %s: %lu lines suppressed", names[subsystem], suppressed);
+   }
+
+   return true;
+}
+
+void
+pgvictoria_trace_message(int subsystem, char direction, struct message* msg)
+{
+   struct main_configuration* config;
+   char payload[MAX_COMMENT + 8];
+   size_t offset;
+
+   config = (struct main_configuration*)shmem;
+
+   if (msg == NULL || msg->data == NULL || !pgvictoria_trace_allow(subsystem))
+   {
+      return;
+   }
+
+   /* A startup message has no type, only a length */
+   offset = msg->kind != 0 ? 5 : 8;
+
+   payload[0] = '\0';
+   if (payloads[subsystem] && config->common.trace_payload > 0 && (size_t)msg->length > offset)
+   {
+      trace_payload((char*)msg->data + offset, msg->length - offset, &payload[0], MIN((size_t)config->common.trace_payload + 1, sizeof(payload) - 4));
+   }
+
+   pgvictoria_log_info("trace %s %c %c %zd bytes \"%s\"", names[subsystem], direction,
+                       msg->kind >= 32 ? msg->kind : '?', msg->length, &payload[0]);
+}
+
+void
+pgvictoria_trace_response(int subsystem, void* data, size_t size, long first_read, long total)
+{
+   struct main_configuration* config;
+   struct trace_type types[256];
+   unsigned char order[256];
+   char payload[MAX_COMMENT + 8];
+   char* d = (char*)data;
+   size_t offset = 0;
+   size_t length;
+   int number_of_types = 0;
+   unsigned char kind;
+
+   config = (struct main_configuration*)shmem;
+
+   if (data == NULL || subsystem < 0 || subsystem >= NUMBER_OF_TRACE_SUBSYSTEMS)
+   {
+      return;
+   }
+
+   memset(&types[0], 0, sizeof(types));
+
+   /* One pass over the messages, counting each type in the order it first appears */
+   while (offset + 5 <= size)
+   {
+      kind = (unsigned char)d[offset];
+      length = 1 + (size_t)(uint32_t)pgvictoria_read_int32(d + offset + 1);
+      if (length < 5 || offset + length > size)
+      {
+         length = size - offset;
+      }
+
+      if (types[kind].count == 0)
+      {
+         types[kind].first = offset;
+         order[number_of_types++] = kind;
+      }
+      types[kind].count++;
+      types[kind].bytes += length;
+
+      offset += length;
+   }
+
+   for (int i = 0; i < number_of_types && pgvictoria_trace_allow(subsystem); i++)
+   {
+      struct trace_type* t = &types[order[i]];
+
+      length = 1 + (size_t)(uint32_t)pgvictoria_read_int32(d + t->first + 1);
+      length = MIN(length, size - t->first);
+
+      payload[0] = '\0';
+      if (payloads[subsystem] && config->common.trace_payload > 0 && length > 5)
+      {
+         trace_payload(d + t->first + 5, length - 5, &payload[0], MIN((size_t)config->common.trace_payload + 1, sizeof(payload) - 4));
+      }
+
+      pgvictoria_log_info("trace %s < %c %ld %s %ld bytes \"%s\"", names[subsystem],
+                          order[i] >= 32 && order[i] < 127 ? order[i] : '?', t->count,
+                          t->count == 1 ? "message" : "messages", t->bytes, &payload[0]);
+   }
+
+   if (pgvictoria_trace_allow(subsystem))
+   {
+      pgvictoria_log_info("trace %s < %zu bytes in %ld.%03ld ms, first read after %ld.%03ld ms", names[subsystem],
+                          size, total / 1000, total % 1000, first_read / 1000, first_read % 1000);
+   }
+}
+
+static uint64_t
+trace_random(void)
+{
+   pid_t pid = getpid();
+
+   /* Forked processes do not share a sequence */
+   if (random_pid != pid || random_state == 0)
+   {
+      random_pid = pid;
+      random_state = ((uint64_t)pid << 32) ^ (uint64_t)time(NULL) ^ 0x9E3779B97F4A7C15ULL;
+   }
+
+   random_state ^= random_state << 13;
+   random_state ^= random_state >> 7;
+   random_state ^= random_state << 17;
+
+   return random_state;
+}
+
+static void
+trace_payload(char* data, size_t length, char* out, size_t size)
+{
+   size_t n = 0;
+
+   if (size == 0)
+   {
+      return;
+   }
+
+   /* Keep printable characters, and mark a cut payload */
+   while (n < length && n + 1 < size)
+   {
+      unsigned char c = (unsigned char)data[n];
+
+      out[n] = (c >= 32 && c < 127 && c != '"') ? (char)c : '.';
+      n++;
+   }
+   out[n] = '\0';
+
+   if (n < length)
+   {
+      memcpy(out + n, "...", 4);
+   }
+}
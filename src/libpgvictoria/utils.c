@@ -42,6 +42,7 @@
 #include <inttypes.h>
 #include <libgen.h>
 #include <pwd.h>
+#include <stdarg.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -79,6 +80,7 @@ static int max_process_title_size = 0;
 #endif
 
 static int string_compare(const void* a, const void* b);
+static int string_builder_reserve(struct string_builder* builder, size_t length);
 
 static int get_permissions(char* from, int* permissions);
 
@@ -997,6 +999,162 @@ pgvictoria_append_bool(char* orig, bool b)
    return orig;
 }
 
+void
+pgvictoria_string_builder_init(struct string_builder* builder)
+{
+   builder->str = NULL;
+   builder->length = 0;
+   builder->capacity = 0;
+   builder->error = false;
+}
+
+int
+pgvictoria_string_builder_append(struct string_builder* builder, char* s)
+{
+   if (s == NULL)
+   {
+      return builder->error ? 1 : 0;
+   }
+   return pgvictoria_string_builder_append_length(builder, s, strlen(s));
+}
+
+int
+pgvictoria_string_builder_append_length(struct string_builder* builder, char* s, size_t length)
+{
+   if (string_builder_reserve(builder, length))
+   {
+      return 1;
+   }
+   memcpy(builder->str + builder->length, s, length);
+   builder->length += length;
+   builder->str[builder->length] = '\0';
+   return 0;
+}
+
+int
+pgvictoria_string_builder_append_char(struct string_builder* builder, char c)
+{
+   if (string_builder_reserve(builder, 1))
+   {
+      return 1;
+   }
+   builder->str[builder->length++] = c;
+   builder->str[builder->length] = '\0';
+   return 0;
+}
+
+int
+pgvictoria_string_builder_append_format(struct string_builder* builder, char* format, ...)
+{
+   va_list args;
+   size_t room;
+   int n;
+
+   // most formatted values are short, so try the room there is first
+   if (string_builder_reserve(builder, MISC_LENGTH - 1))
+   {
+      return 1;
+   }
+   room = builder->capacity - builder->length;
+   va_start(args, format);
+   n = vsnprintf(builder->str + builder->length, room, format, args);
+   va_end(args);
+   if (n < 0)
+   {
+      builder->error = true;
+      return 1;
+   }
+   if ((size_t)n >= room)
+   {
+      if (string_builder_reserve(builder, n))
+      {
+         return 1;
+      }
+      va_start(args, format);
+      vsnprintf(builder->str + builder->length, builder->capacity - builder->length, format, args);
+      va_end(args);
+   }
+   builder->length += n;
+   return 0;
+}
+
+int
+pgvictoria_string_builder_append_escaped(struct string_builder* builder, char* s)
+{
+   size_t start = 0;
+   char c;
+
+   if (s == NULL)
+   {
+      return builder->error ? 1 : 0;
+   }
+   for (size_t i = 0; s[i] != '\0'; i++)
+   {
+      c = s[i];
+      if (c != '\"' && c != '\\' && c != '\n' && c != '\t' && c != '\r')
+      {
+         continue;
+      }
+      // copy the run before the escape in one go
+      if (pgvictoria_string_builder_append_length(builder, s + start, i - start) ||
+          pgvictoria_string_builder_append_char(builder, '\\') ||
+          pgvictoria_string_builder_append_char(builder, c == '\n' ? 'n' : c == '\t' ? 't' : c == '\r' ? 'r' : c))
+      {
+         return 1;
+      }
+      start = i + 1;
+   }
+   return pgvictoria_string_builder_append(builder, s + start);
+}
+
+int
+pgvictoria_string_builder_indent(struct string_builder* builder, char* tag, int indent)
+{
+   if (indent > 0)
+   {
+      if (string_builder_reserve(builder, indent))
+      {
+         return 1;
+      }
+      memset(builder->str + builder->length, ' ', indent);
+      builder->length += indent;
+      builder->str[builder->length] = '\0';
+   }
+   return pgvictoria_string_builder_append(builder, tag);
+}
+
+void
+pgvictoria_string_builder_clear(struct string_builder* builder)
+{
+   builder->length = 0;
+   if (builder->str != NULL)
+   {
+      builder->str[0] = '\0';
+   }
+}
+
+char*
+pgvictoria_string_builder_finish(struct string_builder* builder)
+{
+   char* str = builder->str;
+
+   // an empty string is NULL, like pgvictoria_append() leaves it
+   if (builder->error || builder->length == 0)
+   {
+      free(str);
+      str = NULL;
+   }
+   pgvictoria_string_builder_init(builder);
+   return str;
+}
+
+void
+pgvictoria_string_builder_destroy(struct string_builder* builder)
+{
+   free(builder->str);
+   pgvictoria_string_builder_init(builder);
+}
+
 char*
 pgvictoria_remove_whitespace(char* orig)
 {
@@ -2205,6 +2363,37 @@ string_compare(const void* a, const void* b)
    return strcmp(*(char**)a, *(char**)b);
 }
 
+static int
+string_builder_reserve(struct string_builder* builder, size_t length)
+{
+   size_t capacity;
+   char* str = NULL;
+
+   if (builder->error)
+   {
+      return 1;
+   }
+   // room for the terminator too
+   if (builder->length + length < builder->capacity)
+   {
+      return 0;
+   }
+   capacity = builder->capacity == 0 ? MISC_LENGTH : builder->capacity;
+   while (builder->length + length >= capacity)
+   {
+      capacity *= 2;
+   }
+   str = realloc(builder->str, capacity);
+   if (str == NULL)
+   {
+      builder->error = true;
+      return 1;
+   }
+   builder->str = str;
+   builder->capacity = capacity;
+   return 0;
+}
+
 int
 pgvictoria_permission_recursive(char* d)
 {
@@ -28,6 +28,7 @@
 /* pgvictoria */
 #include <art.h>
 #include <json.h>
+#include <memory.h>
 #include <utils.h>
 
 /* System */
@@ -41,6 +42,9 @@ static void free_destroy_cb(uintptr_t data);
 static void art_destroy_cb(uintptr_t data);
 static void deque_destroy_cb(uintptr_t data);
 static void json_destroy_cb(uintptr_t data);
+static void value_init(struct memory_arena* arena, struct value* val, enum value_type type, uintptr_t data);
+static void value_arena_cleanup(void* data);
+static bool value_in_arena(struct memory_arena* arena, enum value_type type, uintptr_t data);
 static char* noop_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
 static char* int8_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
 static char* uint8_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
@@ -59,120 +63,44 @@ static char* deque_to_string_cb(uintptr_t data, int32_t format, char* tag, int i
 static char* art_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
 static char* json_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
 static char* mem_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent);
+static data_to_string_cb value_to_string_cb(enum value_type type);
+static char* value_data_to_string(enum value_type type, uintptr_t data, int32_t format, char* tag, int indent);
+static int value_data_to_builder(enum value_type type, uintptr_t data, int32_t format, char* tag, int indent, struct string_builder* builder);
 
 int
 pgvictoria_value_create(enum value_type type, uintptr_t data, struct value** value)
+{
+   return pgvictoria_value_create_arena(NULL, type, data, value);
+}
+
+int
+pgvictoria_value_create_arena(struct memory_arena* arena, enum value_type type, uintptr_t data, struct value** value)
 {
    struct value* val = NULL;
    if (type == ValueNone)
    {
       goto error;
    }
-   val = (struct value*)malloc(sizeof(struct value));
-   if (val == NULL)
+   if (arena != NULL)
    {
-      goto error;
+      val = (struct value*)pgvictoria_memory_arena_alloc(arena, sizeof(struct value));
    }
-   val->data = 0;
-   val->type = type;
-   switch (type)
+   else
    {
-      case ValueInt8:
-         val->to_string = int8_to_string_cb;
-         break;
-      case ValueUInt8:
-         val->to_string = uint8_to_string_cb;
-         break;
-      case ValueInt16:
-         val->to_string = int16_to_string_cb;
-         break;
-      case ValueUInt16:
-         val->to_string = uint16_to_string_cb;
-         break;
-      case ValueInt32:
-         val->to_string = int32_to_string_cb;
-         break;
-      case ValueUInt32:
-         val->to_string = uint32_to_string_cb;
-         break;
-      case ValueInt64:
-         val->to_string = int64_to_string_cb;
-         break;
-      case ValueUInt64:
-         val->to_string = uint64_to_string_cb;
-         break;
-      case ValueFloat:
-         val->to_string = float_to_string_cb;
-         break;
-      case ValueDouble:
-         val->to_string = double_to_string_cb;
-         break;
-      case ValueBool:
-         val->to_string = bool_to_string_cb;
-         break;
-      case ValueChar:
-         val->to_string = char_to_string_cb;
-         break;
-      case ValueString:
-      case ValueBASE64:
-      case ValueStringRef:
-      case ValueBASE64Ref:
-         val->to_string = string_to_string_cb;
-         break;
-      case ValueJSON:
-      case ValueJSONRef:
-         val->to_string = json_to_string_cb;
-         break;
-      case ValueDeque:
-      case ValueDequeRef:
-         val->to_string = deque_to_string_cb;
-         break;
-      case ValueART:
-      case ValueARTRef:
-         val->to_string = art_to_string_cb;
-         break;
-      case ValueMem:
-      case ValueRef:
-         val->to_string = mem_to_string_cb;
-         break;
-      default:
-         val->to_string = noop_to_string_cb;
-         break;
+      val = (struct value*)malloc(sizeof(struct value));
    }
-   switch (type)
+   if (val == NULL)
    {
-      case ValueString:
-      {
-         val->data = (uintptr_t)pgvictoria_append(NULL, (char*)data);
-         val->destroy_data = free_destroy_cb;
-         break;
-      }
-      case ValueBASE64:
+      goto error;
+   }
+   value_init(arena, val, type, data);
+   val->arena = arena != NULL;
+   if (arena != NULL && val->destroy_data != noop_destroy_cb)
+   {
+      if (pgvictoria_memory_arena_cleanup(arena, value_arena_cleanup, val))
       {
-         val->data = (uintptr_t)pgvictoria_append(NULL, (char*)data);
-         val->destroy_data = free_destroy_cb;
-         break;
+         goto error;
       }
-      case ValueMem:
-         val->data = data;
-         val->destroy_data = free_destroy_cb;
-         break;
-      case ValueJSON:
-         val->data = data;
-         val->destroy_data = json_destroy_cb;
-         break;
-      case ValueDeque:
-         val->data = data;
-         val->destroy_data = deque_destroy_cb;
-         break;
-      case ValueART:
-         val->data = data;
-         val->destroy_data = art_destroy_cb;
-         break;
-      default:
-         val->data = data;
-         val->destroy_data = noop_destroy_cb;
-         break;
    }
    *value = val;
    return 0;
@@ -181,10 +109,43 @@ error:
    return 1;
 }
 
+int
+pgvictoria_value_init(struct memory_arena* arena, struct value* value, enum value_type type, uintptr_t data)
+{
+   if (value == NULL || type == ValueNone)
+   {
+      return 1;
+   }
+   value_init(arena, value, type, data);
+   value->arena = true;
+   return 0;
+}
+
+void
+pgvictoria_value_relocate(struct value* value)
+{
+   if (value != NULL && value->inlined)
+   {
+      value->data = (uintptr_t)value->buffer;
+   }
+}
+
+bool
+pgvictoria_value_owns_data(struct value* value)
+{
+   return value != NULL && value->destroy_data != noop_destroy_cb;
+}
+
 int
 pgvictoria_value_create_with_config(uintptr_t data, struct value_config* config, struct value** value)
 {
-   if (pgvictoria_value_create(ValueRef, data, value))
+   return pgvictoria_value_create_arena_with_config(NULL, data, config, value);
+}
+
+int
+pgvictoria_value_create_arena_with_config(struct memory_arena* arena, uintptr_t data, struct value_config* config, struct value** value)
+{
+   if (pgvictoria_value_create_arena(arena, ValueRef, data, value))
    {
       return 1;
    }
@@ -193,6 +154,10 @@ pgvictoria_value_create_with_config(uintptr_t data, struct value_config* config,
       if (config->destroy_data != NULL)
       {
          (*value)->destroy_data = config->destroy_data;
+         if (arena != NULL && pgvictoria_memory_arena_cleanup(arena, value_arena_cleanup, *value))
+         {
+            return 1;
+         }
       }
       if (config->to_string != NULL)
       {
@@ -210,6 +175,13 @@ pgvictoria_value_destroy(struct value* value)
       return 0;
    }
    value->destroy_data(value->data);
+   if (value->arena)
+   {
+      // The arena may still run the cleanup of the value, so disarm it
+      value->destroy_data = noop_destroy_cb;
+      value->data = 0;
+      return 0;
+   }
    free(value);
    return 0;
 }
@@ -240,6 +212,23 @@ pgvictoria_value_to_string(struct value* value, int32_t format, char* tag, int i
    return value->to_string(value->data, format, tag, indent);
 }
 
+int
+pgvictoria_value_to_builder(struct value* value, int32_t format, char* tag, int indent, struct string_builder* builder)
+{
+   char* str = NULL;
+   int ret;
+
+   // a custom callback can only hand back a string
+   if (value->to_string != value_to_string_cb(value->type))
+   {
+      str = value->to_string(value->data, format, tag, indent);
+      ret = pgvictoria_string_builder_append(builder, str);
+      free(str);
+      return ret;
+   }
+   return value_data_to_builder(value->type, value->data, format, tag, indent, builder);
+}
+
 uintptr_t
 pgvictoria_value_from_double(double val)
 {
@@ -374,6 +363,121 @@ pgvictoria_value_type_to_string(enum value_type type)
    }
 }
 
+static data_to_string_cb
+value_to_string_cb(enum value_type type)
+{
+   switch (type)
+   {
+      case ValueInt8:
+         return int8_to_string_cb;
+      case ValueUInt8:
+         return uint8_to_string_cb;
+      case ValueInt16:
+         return int16_to_string_cb;
+      case ValueUInt16:
+         return uint16_to_string_cb;
+      case ValueInt32:
+         return int32_to_string_cb;
+      case ValueUInt32:
+         return uint32_to_string_cb;
+      case ValueInt64:
+         return int64_to_string_cb;
+      case ValueUInt64:
+         return uint64_to_string_cb;
+      case ValueFloat:
+         return float_to_string_cb;
+      case ValueDouble:
+         return double_to_string_cb;
+      case ValueBool:
+         return bool_to_string_cb;
+      case ValueChar:
+         return char_to_string_cb;
+      case ValueString:
+      case ValueBASE64:
+      case ValueStringRef:
+      case ValueBASE64Ref:
+         return string_to_string_cb;
+      case ValueJSON:
+      case ValueJSONRef:
+         return json_to_string_cb;
+      case ValueDeque:
+      case ValueDequeRef:
+         return deque_to_string_cb;
+      case ValueART:
+      case ValueARTRef:
+         return art_to_string_cb;
+      case ValueMem:
+      case ValueRef:
+         return mem_to_string_cb;
+      default:
+         return noop_to_string_cb;
+   }
+}
+
+static void
+value_init(struct memory_arena* arena, struct value* val, enum value_type type, uintptr_t data)
+{
+   val->data = 0;
+   val->type = type;
+   val->inlined = false;
+   val->to_string = value_to_string_cb(type);
+   switch (type)
+   {
+      case ValueString:
+      case ValueBASE64:
+      {
+         size_t length = data != 0 ? strlen((char*)data) : 0;
+
+         if (length > 0 && length < VALUE_INLINE_SIZE)
+         {
+            memcpy(val->buffer, (char*)data, length + 1);
+            val->data = (uintptr_t)val->buffer;
+            val->inlined = true;
+            val->destroy_data = noop_destroy_cb;
+         }
+         else if (arena != NULL)
+         {
+            // An empty string is stored as NULL, like pgvictoria_append() does
+            if (length > 0)
+            {
+               val->data = (uintptr_t)pgvictoria_memory_arena_string(arena, (char*)data);
+            }
+            val->destroy_data = noop_destroy_cb;
+         }
+         else
+         {
+            val->data = (uintptr_t)pgvictoria_append(NULL, (char*)data);
+            val->destroy_data = free_destroy_cb;
+         }
+         break;
+      }
+      case ValueMem:
+         val->data = data;
+         val->destroy_data = free_destroy_cb;
+         break;
+      case ValueJSON:
+         val->data = data;
+         val->destroy_data = json_destroy_cb;
+         break;
+      case ValueDeque:
+         val->data = data;
+         val->destroy_data = deque_destroy_cb;
+         break;
+      case ValueART:
+         val->data = data;
+         val->destroy_data = art_destroy_cb;
+         break;
+      default:
+         val->data = data;
+         val->destroy_data = noop_destroy_cb;
+         break;
+   }
+   if (arena != NULL && val->destroy_data != noop_destroy_cb && value_in_arena(arena, type, data))
+   {
+      val->destroy_data = noop_destroy_cb;
+   }
+}
+
 static void
 noop_destroy_cb(uintptr_t data)
 {
@@ -404,213 +508,118 @@ json_destroy_cb(uintptr_t data)
    pgvictoria_json_destroy((struct json*)data);
 }
 
+static void
+value_arena_cleanup(void* data)
+{
+   struct value* value = (struct value*)data;
+
+   value->destroy_data(value->data);
+   value->destroy_data = noop_destroy_cb;
+}
+
+static bool
+value_in_arena(struct memory_arena* arena, enum value_type type, uintptr_t data)
+{
+   if (data == 0)
+   {
+      return true;
+   }
+   switch (type)
+   {
+      case ValueJSON:
+         // The root of a parsed document owns its arena and is released as a whole
+         return ((struct json*)data)->arena == arena && !((struct json*)data)->owner;
+      case ValueDeque:
+         return ((struct deque*)data)->arena == arena;
+      case ValueART:
+         return ((struct art*)data)->arena == arena;
+      default:
+         return false;
+   }
+}
+
 static char*
 noop_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   ret = pgvictoria_indent(ret, tag, indent);
-   (void)data;
-   (void)format;
-   return ret;
+   return value_data_to_string(ValueNone, data, format, tag, indent);
 }
 
 static char*
-int8_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+int8_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRId8, (int8_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueInt8, data, format, tag, indent);
 }
 
 static char*
-uint8_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+uint8_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRIu8, (uint8_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueUInt8, data, format, tag, indent);
 }
 
 static char*
-int16_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+int16_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRId16, (int16_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueInt16, data, format, tag, indent);
 }
 
 static char*
-uint16_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+uint16_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRIu16, (uint16_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueUInt16, data, format, tag, indent);
 }
 
 static char*
-int32_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+int32_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRId32, (int32_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueInt32, data, format, tag, indent);
 }
 
 static char*
-uint32_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+uint32_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRIu32, (uint32_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueUInt32, data, format, tag, indent);
 }
 
 static char*
-int64_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+int64_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRId64, (int64_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueInt64, data, format, tag, indent);
 }
 
 static char*
-uint64_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+uint64_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%" PRIu64, (uint64_t)data);
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueUInt64, data, format, tag, indent);
 }
 
 static char*
-float_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+float_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%f", pgvictoria_value_to_float(data));
-   ret = pgvictoria_append(ret, buf);
-   return ret;
+   return value_data_to_string(ValueFloat, data, format, tag, indent);
 }
 
 static char*
-double_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+double_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%f", pgvictoria_value_to_double(data));
-   ret = pgvictoria_append(ret, buf);
-
-   return ret;
+   return value_data_to_string(ValueDouble, data, format, tag, indent);
 }
 
 static char*
 string_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char* str = (char*)data;
-   char* translated_string = NULL;
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   if (str == NULL)
-   {
-      if (format == FORMAT_JSON || format == FORMAT_JSON_COMPACT)
-      {
-         ret = pgvictoria_append(ret, "null");
-      }
-   }
-   else if (strlen(str) == 0)
-   {
-      if (format == FORMAT_JSON || format == FORMAT_JSON_COMPACT)
-      {
-         ret = pgvictoria_append(ret, "\"\"");
-      }
-      else if (format == FORMAT_TEXT)
-      {
-         ret = pgvictoria_append(ret, "''");
-      }
-   }
-   else
-   {
-      if (format == FORMAT_JSON || format == FORMAT_JSON_COMPACT)
-      {
-         translated_string = pgvictoria_escape_string(str);
-         ret = pgvictoria_append_char(ret, '"');
-         ret = pgvictoria_append(ret, translated_string);
-         ret = pgvictoria_append_char(ret, '"');
-         free(translated_string);
-      }
-      else if (format == FORMAT_TEXT)
-      {
-         ret = pgvictoria_append(ret, str);
-      }
-   }
-
-   return ret;
+   return value_data_to_string(ValueString, data, format, tag, indent);
 }
 
 static char*
-bool_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+bool_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   bool val = (bool)data;
-   ret = pgvictoria_indent(ret, tag, indent);
-   ret = pgvictoria_append(ret, val ? "true" : "false");
-   return ret;
+   return value_data_to_string(ValueBool, data, format, tag, indent);
 }
 
 static char*
-char_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+char_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
-
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "'%c'", (char)data);
-   ret = pgvictoria_append(ret, buf);
-
-   return ret;
+   return value_data_to_string(ValueChar, data, format, tag, indent);
 }
 
 static char*
@@ -632,15 +641,92 @@ json_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 }
 
 static char*
-mem_to_string_cb(uintptr_t data, int32_t format __attribute__((unused)), char* tag, int indent)
+mem_to_string_cb(uintptr_t data, int32_t format, char* tag, int indent)
 {
-   char* ret = NULL;
-   char buf[MISC_LENGTH];
+   return value_data_to_string(ValueMem, data, format, tag, indent);
+}
+
+static char*
+value_data_to_string(enum value_type type, uintptr_t data, int32_t format, char* tag, int indent)
+{
+   struct string_builder builder;
 
-   ret = pgvictoria_indent(ret, tag, indent);
-   memset(buf, 0, MISC_LENGTH);
-   pgvictoria_snprintf(buf, MISC_LENGTH, "%p", (void*)data);
-   ret = pgvictoria_append(ret, buf);
+   pgvictoria_string_builder_init(&builder);
+   value_data_to_builder(type, data, format, tag, indent, &builder);
+   return pgvictoria_string_builder_finish(&builder);
+}
+
+static int
+value_data_to_builder(enum value_type type, uintptr_t data, int32_t format, char* tag, int indent, struct string_builder* builder)
+{
+   char* str = (char*)data;
+   bool json = format == FORMAT_JSON || format == FORMAT_JSON_COMPACT;
 
-   return ret;
+   switch (type)
+   {
+      case ValueJSON:
+      case ValueJSONRef:
+         return pgvictoria_json_to_builder((struct json*)data, format, tag, indent, builder);
+      case ValueDeque:
+      case ValueDequeRef:
+         return pgvictoria_deque_to_builder((struct deque*)data, format, tag, indent, builder);
+      case ValueART:
+      case ValueARTRef:
+         return pgvictoria_art_to_builder((struct art*)data, format, tag, indent, builder);
+      default:
+         break;
+   }
+
+   pgvictoria_string_builder_indent(builder, tag, indent);
+   switch (type)
+   {
+      case ValueInt8:
+         return pgvictoria_string_builder_append_format(builder, "%" PRId8, (int8_t)data);
+      case ValueUInt8:
+         return pgvictoria_string_builder_append_format(builder, "%" PRIu8, (uint8_t)data);
+      case ValueInt16:
+         return pgvictoria_string_builder_append_format(builder, "%" PRId16, (int16_t)data);
+      case ValueUInt16:
+         return pgvictoria_string_builder_append_format(builder, "%" PRIu16, (uint16_t)data);
+      case ValueInt32:
+         return pgvictoria_string_builder_append_format(builder, "%" PRId32, (int32_t)data);
+      case ValueUInt32:
+         return pgvictoria_string_builder_append_format(builder, "%" PRIu32, (uint32_t)data);
+      case ValueInt64:
+         return pgvictoria_string_builder_append_format(builder, "%" PRId64, (int64_t)data);
+      case ValueUInt64:
+         return pgvictoria_string_builder_append_format(builder, "%" PRIu64, (uint64_t)data);
+      case ValueFloat:
+         return pgvictoria_string_builder_append_format(builder, "%f", pgvictoria_value_to_float(data));
+      case ValueDouble:
+         return pgvictoria_string_builder_append_format(builder, "%f", pgvictoria_value_to_double(data));
+      case ValueBool:
+         return pgvictoria_string_builder_append(builder, (bool)data ? "true" : "false");
+      case ValueChar:
+         return pgvictoria_string_builder_append_format(builder, "'%c'", (char)data);
+      case ValueString:
+      case ValueBASE64:
+      case ValueStringRef:
+      case ValueBASE64Ref:
+         if (str == NULL)
+         {
+            return pgvictoria_string_builder_append(builder, json ? "null" : NULL);
+         }
+         if (*str == '\0')
+         {
+            return pgvictoria_string_builder_append(builder, json ? "\"\"" : format == FORMAT_TEXT ? "''" : NULL);
+         }
+         if (json)
+         {
+            pgvictoria_string_builder_append_char(builder, '"');
+            pgvictoria_string_builder_append_escaped(builder, str);
+            return pgvictoria_string_builder_append_char(builder, '"');
+         }
+         return pgvictoria_string_builder_append(builder, format == FORMAT_TEXT ? str : NULL);
+      case ValueMem:
+      case ValueRef:
+         return pgvictoria_string_builder_append_format(builder, "%p", (void*)data);
+      default:
+         return builder->error ? 1 : 0;
+   }
 }
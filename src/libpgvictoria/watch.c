@@ -0,0 +1,1399 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/* pgvictoria */
+#include <pgvictoria.h>
+#include <art.h>
+#include <deque.h>
+#include <json.h>
+#include <postgresql.h>
+#include <report.h>
+#include <utils.h>
+#include <value.h>
+#include <watch.h>
+
+/* system */
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(HAVE_LINUX)
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#endif
+
+#define WATCH_SETTING           0
+#define WATCH_INCLUDE           1
+#define WATCH_INCLUDE_IF_EXISTS 2
+#define WATCH_INCLUDE_DIR       3
+
+/* PostgreSQL refuses to nest configuration files deeper than this */
+#define WATCH_MAX_DEPTH 10
+
+#if defined(HAVE_LINUX)
+
+#define WATCH_DIRECTORY_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_MOVE_SELF)
+#define WATCH_EVENT_BUFFER   (64 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+
+/** @struct watch_entry
+ * Defines a line of a configuration file, either a setting or an include directive
+ */
+struct watch_entry
+{
+   int kind;             /**< WATCH_SETTING or one of the include kinds */
+   char key[128];        /**< The lower case setting name */
+   char value[MAX_PATH]; /**< The value of the setting, or the resolved include target */
+};
+
+/** @struct watch_file
+ * Defines a watched configuration file
+ */
+struct watch_file
+{
+   char path[MAX_PATH];   /**< The path of the file */
+   bool dirty;            /**< Has the file changed since it was parsed */
+   struct deque* entries; /**< The settings and include directives of the file, in file order */
+};
+
+/** @struct watch_directory
+ * Defines a watched directory
+ */
+struct watch_directory
+{
+   char path[MAX_PATH]; /**< The path of the directory */
+   int wd;              /**< The inotify watch descriptor, or -1 while the directory does not exist */
+   bool include_dir;    /**< Is the directory the target of an include_dir */
+};
+
+/** @struct watch_setting
+ * Defines the effective value of a setting
+ */
+struct watch_setting
+{
+   char value[MAX_PATH];      /**< The value */
+   struct watch_file* source; /**< The file the value comes from */
+};
+
+/** @struct watch_root
+ * Defines a configuration file given on the command line, and the configuration it makes up
+ */
+struct watch_root
+{
+   struct watch_file* file; /**< The file */
+   int version;             /**< The detected PostgreSQL version */
+   struct json* baseline;   /**< The cached version baseline */
+   struct art* effective;   /**< The effective configuration, key to struct watch_setting */
+   int number_of_files;     /**< The number of files applied for the configuration */
+   bool header;             /**< Has the current batch been announced */
+};
+
+/** @struct watch_state
+ * Defines the state of a watch
+ */
+struct watch_state
+{
+   int fd;                   /**< The inotify descriptor */
+   struct watch_root* roots; /**< The files given on the command line */
+   int number_of_roots;      /**< The number of roots */
+   struct art* files;        /**< All known files, path to struct watch_file */
+   struct art* directories;  /**< All known directories, path to struct watch_directory */
+   struct art* descriptors;  /**< All watched directories, watch descriptor to struct watch_directory */
+   struct deque* dirty;      /**< The files to re-parse */
+   char* buffer;             /**< The inotify event buffer */
+   FILE* out;                /**< The output stream */
+};
+
+static void watch_file_destroy(uintptr_t data);
+static int watch_join(char* file, char* target, char* path);
+static int watch_parent(char* path, char* parent);
+static void watch_canonical(char* path);
+static int watch_parse(char* path, struct deque** entries);
+static void watch_mark_dirty(struct watch_state* state, struct watch_file* file);
+static struct watch_directory* watch_add_directory(struct watch_state* state, char* path, bool include_dir);
+static int watch_attach(struct watch_state* state, struct watch_directory* directory, bool rescan);
+static int watch_detach(struct watch_state* state, struct watch_directory* directory, int wd);
+static int watch_rescan(struct watch_state* state);
+static struct watch_file* watch_add_file(struct watch_state* state, char* path);
+static int watch_walk(struct watch_state* state, struct watch_root* root, struct watch_file* file, int depth, struct art* effective);
+static void watch_emit(struct watch_state* state, struct watch_root* root, char* key, char* old_value, char* new_value, struct watch_file* source);
+static int watch_rebuild(struct watch_state* state, bool emit);
+static int watch_process(struct watch_state* state, char* buffer, ssize_t length, bool* changed);
+static int watch_read(struct watch_state* state);
+
+int
+pgvictoria_watch_create(char** files, int number_of_files, int override_version, FILE* out, struct watch_state** watch)
+{
+   struct watch_state* state = NULL;
+   struct watch_root* root = NULL;
+   char path[MAX_PATH];
+
+   *watch = NULL;
+
+   if (files == NULL || number_of_files <= 0)
+   {
+      warnx("pgvictoria-cli: No configuration files to watch");
+      return 1;
+   }
+
+   state = (struct watch_state*)malloc(sizeof(struct watch_state));
+   if (state == NULL)
+   {
+      return 1;
+   }
+   memset(state, 0, sizeof(struct watch_state));
+   state->fd = -1;
+   state->out = out != NULL ? out : stdout;
+
+   state->roots = (struct watch_root*)calloc(number_of_files, sizeof(struct watch_root));
+   state->buffer = (char*)aligned_alloc(__alignof__(struct inotify_event), WATCH_EVENT_BUFFER);
+   if (state->roots == NULL || state->buffer == NULL)
+   {
+      goto error;
+   }
+
+   if (pgvictoria_art_create(&state->files) ||
+       pgvictoria_art_create(&state->directories) ||
+       pgvictoria_art_create(&state->descriptors) ||
+       pgvictoria_deque_create(false, &state->dirty))
+   {
+      goto error;
+   }
+
+   state->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+   if (state->fd == -1)
+   {
+      warn("pgvictoria-cli: Cannot initialize inotify");
+      goto error;
+   }
+
+   for (int i = 0; i < number_of_files; i++)
+   {
+      bool duplicate = false;
+
+      if (files[i] == NULL || strlen(files[i]) == 0 || strlen(files[i]) >= MAX_PATH)
+      {
+         warnx("pgvictoria-cli: Invalid or excessively long configuration filename");
+         goto error;
+      }
+
+      if (realpath(files[i], path) == NULL)
+      {
+         warn("pgvictoria-cli: Cannot resolve configuration file %s", files[i]);
+         goto error;
+      }
+
+      if (!pgvictoria_is_file(path))
+      {
+         warnx("pgvictoria-cli: %s is not a regular file", path);
+         goto error;
+      }
+
+      if (pgvictoria_is_binary_file(path))
+      {
+         warnx("pgvictoria-cli: Configuration file %s appears to be a binary file, rejecting", path);
+         goto error;
+      }
+
+      for (int j = 0; j < state->number_of_roots; j++)
+      {
+         if (!strcmp(state->roots[j].file->path, path))
+         {
+            duplicate = true;
+         }
+      }
+
+      if (duplicate)
+      {
+         continue;
+      }
+
+      /* Counted right away so that a failure below is cleaned up by pgvictoria_watch_destroy */
+      root = &state->roots[state->number_of_roots++];
+
+      root->file = watch_add_file(state, path);
+      if (root->file == NULL)
+      {
+         goto error;
+      }
+
+      /* Every cluster is compared against its own baseline */
+      root->version = pgvictoria_report_detect_version(path, override_version);
+      root->baseline = pgvictoria_get_baseline(root->version);
+      if (root->baseline == NULL)
+      {
+         warnx("No baseline available for PostgreSQL version %d", root->version);
+         goto error;
+      }
+
+      if (pgvictoria_art_create(&root->effective))
+      {
+         goto error;
+      }
+   }
+
+   if (watch_rebuild(state, false))
+   {
+      goto error;
+   }
+
+   *watch = state;
+
+   return 0;
+
+error:
+
+   pgvictoria_watch_destroy(state);
+
+   return 1;
+}
+
+int
+pgvictoria_watch_process(struct watch_state* watch, int timeout)
+{
+   struct pollfd fds;
+
+   if (watch == NULL)
+   {
+      return 1;
+   }
+
+   fds.fd = watch->fd;
+   fds.events = POLLIN;
+   fds.revents = 0;
+
+   if (poll(&fds, 1, timeout) == -1)
+   {
+      return errno == EINTR ? 0 : 1;
+   }
+
+   if (!(fds.revents & POLLIN))
+   {
+      return 0;
+   }
+
+   return watch_read(watch);
+}
+
+char*
+pgvictoria_watch_value(struct watch_state* watch, int root, char* key)
+{
+   struct watch_setting* setting = NULL;
+
+   if (watch == NULL || root < 0 || root >= watch->number_of_roots || key == NULL)
+   {
+      return NULL;
+   }
+
+   setting = (struct watch_setting*)pgvictoria_art_search(watch->roots[root].effective, key);
+
+   return setting != NULL ? setting->value : NULL;
+}
+
+void
+pgvictoria_watch_destroy(struct watch_state* watch)
+{
+   if (watch == NULL)
+   {
+      return;
+   }
+
+   if (watch->fd != -1)
+   {
+      close(watch->fd);
+   }
+
+   if (watch->roots != NULL)
+   {
+      for (int i = 0; i < watch->number_of_roots; i++)
+      {
+         pgvictoria_json_destroy(watch->roots[i].baseline);
+         pgvictoria_art_destroy(watch->roots[i].effective);
+      }
+   }
+
+   pgvictoria_deque_destroy(watch->dirty);
+   pgvictoria_art_destroy(watch->descriptors);
+   pgvictoria_art_destroy(watch->directories);
+   pgvictoria_art_destroy(watch->files);
+   free(watch->buffer);
+   free(watch->roots);
+   free(watch);
+}
+
+int
+pgvictoria_watch(char** files, int number_of_files, int override_version, char* output_file)
+{
+   struct watch_state* state = NULL;
+   struct signalfd_siginfo info;
+   struct pollfd fds[2];
+   sigset_t mask;
+   sigset_t old_mask;
+   FILE* out = stdout;
+   int sfd = -1;
+   bool running = true;
+   int ret = 1;
+
+   if (output_file != NULL)
+   {
+      out = fopen(output_file, "a");
+      if (out == NULL)
+      {
+         warn("pgvictoria-cli: Cannot open output file %s", output_file);
+         return 1;
+      }
+   }
+
+   /*
+    * SIGINT and SIGTERM are taken through a signalfd that is polled together
+    * with the inotify descriptor, so a signal arriving between two reads can
+    * never be lost the way it could be when relying on EINTR.
+    */
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGINT);
+   sigaddset(&mask, SIGTERM);
+   if (sigprocmask(SIG_BLOCK, &mask, &old_mask) == -1)
+   {
+      warn("pgvictoria-cli: Cannot block signals");
+      goto error;
+   }
+
+   sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+   if (sfd == -1)
+   {
+      warn("pgvictoria-cli: Cannot create signal descriptor");
+      goto restore;
+   }
+
+   if (pgvictoria_watch_create(files, number_of_files, override_version, out, &state))
+   {
+      goto restore;
+   }
+
+   for (int i = 0; i < state->number_of_roots; i++)
+   {
+      fprintf(out, "Watching %s (%d files) against the PostgreSQL %d baseline (%" PRIu64 " settings)\n",
+              state->roots[i].file->path, state->roots[i].number_of_files, state->roots[i].version,
+              state->roots[i].effective->size);
+   }
+   fflush(out);
+
+   ret = 0;
+
+   while (running)
+   {
+      fds[0].fd = sfd;
+      fds[0].events = POLLIN;
+      fds[0].revents = 0;
+      fds[1].fd = state->fd;
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+
+      if (poll(fds, 2, -1) == -1)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         warn("pgvictoria-cli: Cannot wait for inotify events");
+         ret = 1;
+         break;
+      }
+
+      if (fds[0].revents & POLLIN)
+      {
+         if (read(sfd, &info, sizeof(info)) > 0)
+         {
+            running = false;
+         }
+      }
+      else if (fds[1].revents & POLLIN)
+      {
+         if (watch_read(state))
+         {
+            ret = 1;
+            break;
+         }
+      }
+   }
+
+restore:
+
+   sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+error:
+
+   pgvictoria_watch_destroy(state);
+
+   if (sfd != -1)
+   {
+      close(sfd);
+   }
+
+   if (out != stdout)
+   {
+      fclose(out);
+   }
+
+   return ret;
+}
+
+static void
+watch_file_destroy(uintptr_t data)
+{
+   struct watch_file* file = (struct watch_file*)data;
+
+   if (file == NULL)
+   {
+      return;
+   }
+
+   pgvictoria_deque_destroy(file->entries);
+   free(file);
+}
+
+/*
+ * Resolve an include target the way PostgreSQL does: relative paths are
+ * relative to the directory of the file that contains the directive.
+ */
+static int
+watch_join(char* file, char* target, char* path)
+{
+   char* slash = NULL;
+   int length = 0;
+
+   if (target[0] == '/')
+   {
+      length = snprintf(path, MAX_PATH, "%s", target);
+   }
+   else
+   {
+      slash = strrchr(file, '/');
+      length = snprintf(path, MAX_PATH, "%.*s/%s", slash != NULL ? (int)(slash - file) : 1, slash != NULL ? file : ".", target);
+   }
+
+   if (length < 0 || length >= MAX_PATH)
+   {
+      return 1;
+   }
+
+   /* conf.d/.., ./conf.d or a symlink would otherwise get the wd of the directory it aliases */
+   watch_canonical(path);
+
+   return 0;
+}
+
+static int
+watch_parent(char* path, char* parent)
+{
+   char* slash = NULL;
+
+   snprintf(parent, MAX_PATH, "%s", path);
+
+   slash = strrchr(parent, '/');
+   if (slash == NULL || !strcmp(parent, "/"))
+   {
+      return 1;
+   }
+
+   if (slash == parent)
+   {
+      slash++;
+   }
+   *slash = '\0';
+
+   return 0;
+}
+
+/*
+ * Resolve symbolic links and dot segments in a path. A target that does not
+ * exist yet is resolved through its parent, and is kept as is if that does
+ * not exist either.
+ */
+static void
+watch_canonical(char* path)
+{
+   char resolved[PATH_MAX];
+   char parent[MAX_PATH];
+   char name[MAX_PATH];
+   int length = 0;
+
+   if (realpath(path, resolved) == NULL)
+   {
+      if (watch_parent(path, parent) || realpath(parent, resolved) == NULL)
+      {
+         errno = 0;
+         return;
+      }
+      errno = 0;
+
+      snprintf(name, sizeof(name), "%s", strrchr(path, '/') + 1);
+      length = strlen(resolved);
+      if (length + 1 + strlen(name) >= sizeof(resolved))
+      {
+         return;
+      }
+      snprintf(resolved + length, sizeof(resolved) - length, "%s%s", strcmp(resolved, "/") ? "/" : "", name);
+   }
+
+   if (strlen(resolved) < MAX_PATH)
+   {
+      snprintf(path, MAX_PATH, "%s", resolved);
+   }
+}
+
+static int
+watch_parse(char* path, struct deque** entries)
+{
+   struct deque* e = NULL;
+   struct watch_entry* entry = NULL;
+   FILE* file = NULL;
+   char line[1024];
+   char key[128];
+   char value[1024];
+
+   *entries = NULL;
+
+   if (pgvictoria_deque_create(false, &e))
+   {
+      goto error;
+   }
+
+   /* A file that is missing right now (removed, or mid-rename) simply contributes nothing */
+   file = fopen(path, "r");
+   if (file != NULL)
+   {
+      while (fgets(line, sizeof(line), file))
+      {
+         if (pgvictoria_report_extract_key_value(line, key, value) != 0)
+         {
+            continue;
+         }
+
+         entry = (struct watch_entry*)malloc(sizeof(struct watch_entry));
+         if (entry == NULL)
+         {
+            goto error;
+         }
+         memset(entry, 0, sizeof(struct watch_entry));
+
+         for (char* p = key; *p; p++)
+         {
+            *p = tolower((unsigned char)*p);
+         }
+         snprintf(entry->key, sizeof(entry->key), "%s", key);
+
+         if (!strcmp(key, "include") || !strcmp(key, "include_if_exists") || !strcmp(key, "include_dir"))
+         {
+            entry->kind = WATCH_INCLUDE;
+
+            if (!strcmp(key, "include_if_exists"))
+            {
+               entry->kind = WATCH_INCLUDE_IF_EXISTS;
+            }
+            else if (!strcmp(key, "include_dir"))
+            {
+               entry->kind = WATCH_INCLUDE_DIR;
+            }
+
+            if (watch_join(path, value, entry->value))
+            {
+               warnx("pgvictoria-cli: Include path %s in %s is too long, skipping", value, path);
+               free(entry);
+               continue;
+            }
+         }
+         else
+         {
+            entry->kind = WATCH_SETTING;
+            snprintf(entry->value, sizeof(entry->value), "%s", value);
+         }
+
+         if (pgvictoria_deque_add(e, NULL, (uintptr_t)entry, ValueMem))
+         {
+            free(entry);
+            goto error;
+         }
+      }
+
+      fclose(file);
+      file = NULL;
+   }
+
+   *entries = e;
+
+   return 0;
+
+error:
+
+   if (file != NULL)
+   {
+      fclose(file);
+   }
+
+   pgvictoria_deque_destroy(e);
+
+   return 1;
+}
+
+static void
+watch_mark_dirty(struct watch_state* state, struct watch_file* file)
+{
+   if (file != NULL && !file->dirty)
+   {
+      file->dirty = true;
+      pgvictoria_deque_add(state->dirty, NULL, (uintptr_t)file, ValueRef);
+   }
+}
+
+static struct watch_directory*
+watch_add_directory(struct watch_state* state, char* path, bool include_dir)
+{
+   struct watch_directory* directory = NULL;
+
+   directory = (struct watch_directory*)pgvictoria_art_search(state->directories, path);
+   if (directory == NULL)
+   {
+      directory = (struct watch_directory*)malloc(sizeof(struct watch_directory));
+      if (directory == NULL)
+      {
+         return NULL;
+      }
+      memset(directory, 0, sizeof(struct watch_directory));
+      snprintf(directory->path, sizeof(directory->path), "%s", path);
+      directory->wd = -1;
+
+      if (pgvictoria_art_insert(state->directories, path, (uintptr_t)directory, ValueMem))
+      {
+         free(directory);
+         return NULL;
+      }
+
+      if (watch_attach(state, directory, false))
+      {
+         return NULL;
+      }
+   }
+
+   directory->include_dir |= include_dir;
+
+   return directory;
+}
+
+/*
+ * Start watching a directory. A directory that does not exist is kept as
+ * pending and its parent is watched instead, so that its creation is seen
+ * and the watch can be attached then.
+ */
+static int
+watch_attach(struct watch_state* state, struct watch_directory* directory, bool rescan)
+{
+   struct art_iterator* iter = NULL;
+   struct deque* pending = NULL;
+   char wd[MISC_LENGTH];
+   char parent[MAX_PATH];
+   int ret = 1;
+
+   if (directory->wd != -1)
+   {
+      return 0;
+   }
+
+   directory->wd = inotify_add_watch(state->fd, directory->path, WATCH_DIRECTORY_MASK | IN_ONLYDIR);
+   if (directory->wd == -1)
+   {
+      if (errno != ENOENT && errno != ENOTDIR)
+      {
+         warn("pgvictoria-cli: Cannot watch directory %s", directory->path);
+         return 1;
+      }
+
+      if (!watch_parent(directory->path, parent) && watch_add_directory(state, parent, false) == NULL)
+      {
+         return 1;
+      }
+
+      return 0;
+   }
+
+   snprintf(wd, sizeof(wd), "%d", directory->wd);
+   if (pgvictoria_art_insert(state->descriptors, wd, (uintptr_t)directory, ValueRef))
+   {
+      return 1;
+   }
+
+   if (!rescan)
+   {
+      return 0;
+   }
+
+   /*
+    * The directory came back: its files have to be read again, and pending
+    * directories below it may have been created before the watch existed.
+    */
+   if (pgvictoria_deque_create(false, &pending) || pgvictoria_art_iterator_create(state->files, &iter))
+   {
+      goto error;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      if (!watch_parent(iter->key, parent) && !strcmp(parent, directory->path))
+      {
+         watch_mark_dirty(state, (struct watch_file*)iter->value->data);
+      }
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   if (pgvictoria_art_iterator_create(state->directories, &iter))
+   {
+      goto error;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      if (((struct watch_directory*)iter->value->data)->wd == -1 &&
+          !watch_parent(iter->key, parent) && !strcmp(parent, directory->path))
+      {
+         pgvictoria_deque_add(pending, NULL, iter->value->data, ValueRef);
+      }
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   while (!pgvictoria_deque_empty(pending))
+   {
+      if (watch_attach(state, (struct watch_directory*)pgvictoria_deque_poll(pending, NULL), true))
+      {
+         goto error;
+      }
+   }
+
+   ret = 0;
+
+error:
+
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_deque_destroy(pending);
+
+   return ret;
+}
+
+/*
+ * A watched directory was removed or moved away. The files in it no longer
+ * contribute anything, and the directory goes back to pending until it is
+ * created again.
+ */
+static int
+watch_detach(struct watch_state* state, struct watch_directory* directory, int wd)
+{
+   struct art_iterator* iter = NULL;
+   struct watch_file* file = NULL;
+   struct deque* entries = NULL;
+   char key[MISC_LENGTH];
+   char parent[MAX_PATH];
+
+   snprintf(key, sizeof(key), "%d", wd);
+   pgvictoria_art_delete(state->descriptors, key);
+   directory->wd = -1;
+
+   if (pgvictoria_art_iterator_create(state->files, &iter))
+   {
+      return 1;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      if (!watch_parent(iter->key, parent) && !strcmp(parent, directory->path))
+      {
+         file = (struct watch_file*)iter->value->data;
+
+         if (pgvictoria_deque_create(false, &entries))
+         {
+            pgvictoria_art_iterator_destroy(iter);
+            return 1;
+         }
+
+         pgvictoria_deque_destroy(file->entries);
+         file->entries = entries;
+      }
+   }
+   pgvictoria_art_iterator_destroy(iter);
+
+   /* It may already be back, otherwise this watches the parent for it */
+   return watch_attach(state, directory, true);
+}
+
+static struct watch_file*
+watch_add_file(struct watch_state* state, char* path)
+{
+   struct watch_file* file = NULL;
+   struct value_config file_config = {.destroy_data = watch_file_destroy, .to_string = NULL};
+   char directory[MAX_PATH];
+
+   file = (struct watch_file*)pgvictoria_art_search(state->files, path);
+   if (file != NULL)
+   {
+      return file;
+   }
+
+   file = (struct watch_file*)malloc(sizeof(struct watch_file));
+   if (file == NULL)
+   {
+      return NULL;
+   }
+   memset(file, 0, sizeof(struct watch_file));
+   snprintf(file->path, sizeof(file->path), "%s", path);
+
+   if (watch_parse(file->path, &file->entries))
+   {
+      free(file);
+      return NULL;
+   }
+
+   if (pgvictoria_art_insert_with_config(state->files, path, (uintptr_t)file, &file_config))
+   {
+      watch_file_destroy((uintptr_t)file);
+      return NULL;
+   }
+
+   /*
+    * Watch the parent directory rather than the file itself: editors save by
+    * writing a new file and renaming it over the old one, which would silently
+    * orphan a watch on the original inode.
+    */
+   if (!watch_parent(path, directory) && watch_add_directory(state, directory, false) == NULL)
+   {
+      /* An unwatched file must not be found by the next lookup */
+      pgvictoria_art_delete(state->files, path);
+      return NULL;
+   }
+
+   return file;
+}
+
+/*
+ * Apply a file the way the server does: settings and include directives are
+ * taken in file order, and an included file is applied at the position of
+ * its directive. The last assignment of a setting in this walk order is its
+ * effective value.
+ */
+static int
+watch_walk(struct watch_state* state, struct watch_root* root, struct watch_file* file, int depth, struct art* effective)
+{
+   struct deque_iterator* iter = NULL;
+   struct watch_entry* entry = NULL;
+   struct watch_setting* setting = NULL;
+   struct watch_file* child = NULL;
+   char path[MAX_PATH];
+   int ret = 1;
+
+   if (depth > WATCH_MAX_DEPTH)
+   {
+      warnx("pgvictoria-cli: Configuration files nested too deeply at %s, skipping", file->path);
+      return 0;
+   }
+
+   root->number_of_files++;
+
+   if (pgvictoria_deque_iterator_create(file->entries, &iter))
+   {
+      return 1;
+   }
+
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      entry = (struct watch_entry*)iter->value->data;
+
+      if (entry->kind == WATCH_SETTING)
+      {
+         setting = (struct watch_setting*)pgvictoria_art_search(effective, entry->key);
+         if (setting == NULL)
+         {
+            setting = (struct watch_setting*)malloc(sizeof(struct watch_setting));
+            if (setting == NULL)
+            {
+               goto error;
+            }
+            memset(setting, 0, sizeof(struct watch_setting));
+
+            if (pgvictoria_art_insert(effective, entry->key, (uintptr_t)setting, ValueMem))
+            {
+               free(setting);
+               goto error;
+            }
+         }
+
+         /* A later assignment overwrites an earlier one */
+         snprintf(setting->value, sizeof(setting->value), "%s", entry->value);
+         setting->source = file;
+      }
+      else if (entry->kind == WATCH_INCLUDE_DIR)
+      {
+         int number_of_files = 0;
+         char** names = NULL;
+
+         if (watch_add_directory(state, entry->value, true) == NULL)
+         {
+            continue;
+         }
+
+         /* pgvictoria_get_files returns the names sorted, which is the order PostgreSQL applies them in */
+         if (pgvictoria_get_files(entry->value, &number_of_files, &names) == 0)
+         {
+            for (int i = 0; i < number_of_files; i++)
+            {
+               if (names[i][0] != '.' && pgvictoria_ends_with(names[i], ".conf") &&
+                   snprintf(path, sizeof(path), "%s/%s", entry->value, names[i]) < (int)sizeof(path))
+               {
+                  child = watch_add_file(state, path);
+                  if (child != NULL && watch_walk(state, root, child, depth + 1, effective))
+                  {
+                     for (int j = i; j < number_of_files; j++)
+                     {
+                        free(names[j]);
+                     }
+                     free(names);
+                     goto error;
+                  }
+               }
+               free(names[i]);
+            }
+            free(names);
+         }
+      }
+      else
+      {
+         if (entry->kind == WATCH_INCLUDE && !pgvictoria_exists(entry->value))
+         {
+            warnx("pgvictoria-cli: Included file %s does not exist", entry->value);
+         }
+
+         child = watch_add_file(state, entry->value);
+         if (child != NULL && watch_walk(state, root, child, depth + 1, effective))
+         {
+            goto error;
+         }
+      }
+   }
+
+   ret = 0;
+
+error:
+
+   pgvictoria_deque_iterator_destroy(iter);
+
+   return ret;
+}
+
+static void
+watch_emit(struct watch_state* state, struct watch_root* root, char* key, char* old_value, char* new_value, struct watch_file* source)
+{
+   struct pgvictoria_diff_item item;
+   char timestamp[64];
+   time_t now;
+   struct tm tm;
+
+   if (pgvictoria_report_classify(root->baseline, key, new_value != NULL ? new_value : old_value, &item))
+   {
+      return;
+   }
+
+   if (!root->header)
+   {
+      now = time(NULL);
+      localtime_r(&now, &tm);
+      strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+      fprintf(state->out, "\n%s Configuration drift in %s\n", timestamp, root->file->path);
+      root->header = true;
+   }
+
+   fprintf(state->out, "%-40s | %-20s | %-20s -> %-20s | %-10s | %s\n",
+           item.key, item.baseline_val,
+           old_value != NULL ? old_value : "-",
+           new_value != NULL ? new_value : "-",
+           new_value != NULL ? item.status : "Removed",
+           source != NULL ? source->path : "-");
+}
+
+/*
+ * Re-apply the cached files of every root and report each setting whose
+ * effective value moved. Only files marked dirty have been re-parsed, the
+ * rest of the configuration comes from the cache.
+ */
+static int
+watch_rebuild(struct watch_state* state, bool emit)
+{
+   struct watch_root* root = NULL;
+   struct art* effective = NULL;
+   struct art_iterator* iter = NULL;
+   struct watch_setting* old_setting = NULL;
+   struct watch_setting* new_setting = NULL;
+   for (int i = 0; i < state->number_of_roots; i++)
+   {
+      root = &state->roots[i];
+      root->number_of_files = 0;
+      root->header = false;
+
+      if (pgvictoria_art_create(&effective))
+      {
+         goto error;
+      }
+
+      if (watch_walk(state, root, root->file, 0, effective))
+      {
+         goto error;
+      }
+
+      if (emit)
+      {
+         if (pgvictoria_art_iterator_create(root->effective, &iter))
+         {
+            goto error;
+         }
+         while (pgvictoria_art_iterator_next(iter))
+         {
+            old_setting = (struct watch_setting*)iter->value->data;
+            new_setting = (struct watch_setting*)pgvictoria_art_search(effective, iter->key);
+
+            if (new_setting == NULL)
+            {
+               watch_emit(state, root, iter->key, old_setting->value, NULL, old_setting->source);
+            }
+            else if (strcmp(old_setting->value, new_setting->value))
+            {
+               watch_emit(state, root, iter->key, old_setting->value, new_setting->value, new_setting->source);
+            }
+         }
+         pgvictoria_art_iterator_destroy(iter);
+         iter = NULL;
+
+         if (pgvictoria_art_iterator_create(effective, &iter))
+         {
+            goto error;
+         }
+         while (pgvictoria_art_iterator_next(iter))
+         {
+            if (!pgvictoria_art_contains_key(root->effective, iter->key))
+            {
+               new_setting = (struct watch_setting*)iter->value->data;
+               watch_emit(state, root, iter->key, NULL, new_setting->value, new_setting->source);
+            }
+         }
+         pgvictoria_art_iterator_destroy(iter);
+         iter = NULL;
+      }
+
+      pgvictoria_art_destroy(root->effective);
+      root->effective = effective;
+      effective = NULL;
+   }
+
+   return 0;
+
+error:
+
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_art_destroy(effective);
+
+   return 1;
+}
+
+static int
+watch_process(struct watch_state* state, char* buffer, ssize_t length, bool* changed)
+{
+   struct watch_directory* directory = NULL;
+   struct watch_directory* child = NULL;
+   struct watch_file* file = NULL;
+   char wd[MISC_LENGTH];
+   char path[MAX_PATH];
+
+   for (char* p = buffer; p < buffer + length;)
+   {
+      struct inotify_event* event = (struct inotify_event*)p;
+
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+         warnx("pgvictoria-cli: The inotify queue overflowed, reading every file again");
+         if (watch_rescan(state))
+         {
+            return 1;
+         }
+         *changed = true;
+         continue;
+      }
+
+      snprintf(wd, sizeof(wd), "%d", event->wd);
+      directory = (struct watch_directory*)pgvictoria_art_search(state->descriptors, wd);
+
+      if (directory == NULL)
+      {
+         continue;
+      }
+
+      if (event->mask & IN_MOVE_SELF)
+      {
+         /* The watch follows the inode to its new name; drop it, IN_IGNORED does the rest */
+         inotify_rm_watch(state->fd, event->wd);
+         continue;
+      }
+
+      if (event->mask & IN_IGNORED)
+      {
+         if (watch_detach(state, directory, event->wd))
+         {
+            return 1;
+         }
+         *changed = true;
+         continue;
+      }
+
+      if (event->len == 0)
+      {
+         continue;
+      }
+
+      if (snprintf(path, sizeof(path), "%s/%s", directory->path, event->name) >= (int)sizeof(path))
+      {
+         continue;
+      }
+
+      if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+      {
+         child = (struct watch_directory*)pgvictoria_art_search(state->directories, path);
+         if (child != NULL && child->wd == -1)
+         {
+            if (watch_attach(state, child, true))
+            {
+               return 1;
+            }
+            *changed = true;
+         }
+         continue;
+      }
+
+      if (directory->include_dir && event->name[0] != '.' && pgvictoria_ends_with(event->name, ".conf") &&
+          (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM)))
+      {
+         *changed = true;
+      }
+
+      file = (struct watch_file*)pgvictoria_art_search(state->files, path);
+      if (file != NULL)
+      {
+         watch_mark_dirty(state, file);
+         *changed = true;
+      }
+   }
+
+   return 0;
+}
+
+/*
+ * Events were lost, so nothing is known about what changed. Every file is
+ * read again, and pending directories may have been created in the meantime.
+ */
+static int
+watch_rescan(struct watch_state* state)
+{
+   struct art_iterator* iter = NULL;
+   struct deque* pending = NULL;
+   int ret = 1;
+
+   if (pgvictoria_deque_create(false, &pending) || pgvictoria_art_iterator_create(state->files, &iter))
+   {
+      goto error;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      watch_mark_dirty(state, (struct watch_file*)iter->value->data);
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   if (pgvictoria_art_iterator_create(state->directories, &iter))
+   {
+      goto error;
+   }
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      if (((struct watch_directory*)iter->value->data)->wd == -1)
+      {
+         pgvictoria_deque_add(pending, NULL, iter->value->data, ValueRef);
+      }
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   while (!pgvictoria_deque_empty(pending))
+   {
+      if (watch_attach(state, (struct watch_directory*)pgvictoria_deque_poll(pending, NULL), true))
+      {
+         goto error;
+      }
+   }
+
+   ret = 0;
+
+error:
+
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_deque_destroy(pending);
+
+   return ret;
+}
+
+/*
+ * Drain the inotify queue, re-parse the files that changed and report the
+ * drift of the whole batch at once.
+ */
+static int
+watch_read(struct watch_state* state)
+{
+   struct watch_file* file = NULL;
+   struct deque* entries = NULL;
+   bool changed = false;
+   ssize_t length;
+
+   for (;;)
+   {
+      length = read(state->fd, state->buffer, WATCH_EVENT_BUFFER);
+
+      if (length == -1)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         if (errno == EAGAIN || errno == EWOULDBLOCK)
+         {
+            break;
+         }
+
+         warn("pgvictoria-cli: Cannot read inotify events");
+         return 1;
+      }
+
+      if (watch_process(state, state->buffer, length, &changed))
+      {
+         return 1;
+      }
+   }
+
+   while (!pgvictoria_deque_empty(state->dirty))
+   {
+      file = (struct watch_file*)pgvictoria_deque_poll(state->dirty, NULL);
+      file->dirty = false;
+
+      if (watch_parse(file->path, &entries))
+      {
+         return 1;
+      }
+
+      pgvictoria_deque_destroy(file->entries);
+      file->entries = entries;
+   }
+
+   if (changed && watch_rebuild(state, true))
+   {
+      return 1;
+   }
+
+   fflush(state->out);
+
+   return 0;
+}
+
+#else
+
+int
+pgvictoria_watch_create(char** files, int number_of_files, int override_version, FILE* out, struct watch_state** watch)
+{
+   (void)files;
+   (void)number_of_files;
+   (void)override_version;
+   (void)out;
+
+   *watch = NULL;
+
+   warnx("pgvictoria-cli: watch is only supported on Linux");
+
+   return 1;
+}
+
+int
+pgvictoria_watch_process(struct watch_state* watch, int timeout)
+{
+   (void)watch;
+   (void)timeout;
+
+   return 1;
+}
+
+char*
+pgvictoria_watch_value(struct watch_state* watch, int root, char* key)
+{
+   (void)watch;
+   (void)root;
+   (void)key;
+
+   return NULL;
+}
+
+void
+pgvictoria_watch_destroy(struct watch_state* watch)
+{
+   (void)watch;
+}
+
+int
+pgvictoria_watch(char** files, int number_of_files, int override_version, char* output_file)
+{
+   (void)files;
+   (void)number_of_files;
+   (void)override_version;
+   (void)output_file;
+
+   warnx("pgvictoria-cli: watch is only supported on Linux");
+
+   return 1;
+}
+
+#endif
@@ -30,8 +30,13 @@
 #include <pgvictoria.h>
 #include <configuration.h>
 #include <cmd.h>
+#include <collector.h>
+#include <guc.h>
 #include <logging.h>
 #include <memory.h>
+#include <network.h>
+#include <prometheus.h>
+#include <registry.h>
 #include <shmem.h>
 #include <utils.h>
 
@@ -53,15 +58,54 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #include <openssl/crypto.h>
+#ifdef HAVE_SYSTEMD
+#include <systemd/sd-daemon.h>
+#endif
 
 #define NAME           "main"
 #define MAX_FDS        64
-#define SIGNALS_NUMBER 6
+#define SIGNALS_NUMBER 3
+
+#define RESTART_MIN 1.0
+#define RESTART_MAX 60.0
+
+#define METRICS_RENDER_DELAY 0.1
+
+/** @struct process_restart
+ * Defines the restart state of a child process. A process that keeps dying
+ * right after it started is restarted with a growing delay
+ */
+struct process_restart
+{
+   struct ev_timer timer;   /**< The timer of a delayed restart, must be first */
+   ev_tstamp since;         /**< The time the process was last started */
+   double delay;            /**< The delay of the last restart, 0 for none */
+   int id;                  /**< The identifier passed to respawn */
+   void (*respawn)(int id); /**< Start the process again */
+};
 
 static int create_pidfile(void);
 static void remove_pidfile(void);
+static void start_metrics(void);
+static void shutdown_metrics(void);
+static void accept_metrics_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static int start_collectors(void);
+static int start_collector(int collector);
+static void shutdown_collectors(void);
+static void collector_cb(struct ev_loop* loop, struct ev_io* watcher, int revents);
+static void render_cb(struct ev_loop* loop, struct ev_timer* w, int revents);
+static void collector_exit_cb(struct ev_loop* loop, struct ev_child* w, int revents);
+static void respawn_collector(int collector);
+static int start_log_writer(void);
+static void shutdown_log_writer(void);
+static void log_writer_exit_cb(struct ev_loop* loop, struct ev_child* w, int revents);
+static void respawn_log_writer(int id);
+static void restart_process(struct ev_loop* loop, struct ev_child* w, char* name, struct process_restart* restart);
+static void restart_cb(struct ev_loop* loop, struct ev_timer* w, int revents);
+static void shutdown_cb(struct ev_loop* loop, struct ev_signal* w, int revents);
 
 struct accept_io
 {
@@ -70,9 +114,22 @@ struct accept_io
    char** argv;
 };
 
+static volatile int keep_running = 1;
 static volatile int stop = 0;
 static char** argv_ptr;
 static struct ev_loop* main_loop = NULL;
+static struct accept_io io_metrics[MAX_FDS];
+static int* metrics_fds = NULL;
+static int metrics_fds_length = -1;
+static struct ev_child collectors[MAX_NUMBER_OF_COLLECTORS];
+static struct process_restart collector_restart[MAX_NUMBER_OF_COLLECTORS];
+static int number_of_collectors = 0;
+static int collector_fds[2] = {-1, -1};
+static struct ev_io io_collector;
+static struct ev_timer render_timer;
+static struct ev_child log_writer;
+static struct process_restart log_writer_restart = {.respawn = respawn_log_writer};
+static bool log_writer_started = false;
 
 static void
 version(void)
@@ -123,6 +180,9 @@ main(int argc, char** argv)
    char users_path_buffer[MAX_PATH];
    struct stat path_stat = {0};
    char* adjusted_dir_path = NULL;
+   struct signal_info signal_watcher[SIGNALS_NUMBER];
+   int signals[SIGNALS_NUMBER] = {SIGTERM, SIGINT, SIGQUIT};
+   struct ev_io* io = NULL;
 
    cli_option options[] = {
       {"c", "config", true},
@@ -191,8 +251,12 @@ main(int argc, char** argv)
       goto error;
    }
 
-   pgvictoria_init_main_configuration(shmem);
    config = (struct main_configuration*)shmem;
+   if (pgvictoria_init_main_configuration(shmem))
+   {
+      warnx("pgvictoria: Error in creating the server registry");
+      goto error;
+   }
 
    if (directory_path == NULL)
    {
@@ -293,11 +357,6 @@ main(int argc, char** argv)
          warnx("pgvictoria: Invalid master key file");
          goto error;
       }
-      else if (ret == 3)
-      {
-         warnx("pgvictoria: USERS: Too many users defined %d (max %d)", config->common.number_of_users, NUMBER_OF_USERS);
-         goto error;
-      }
    }
    else
    {
@@ -313,11 +372,6 @@ main(int argc, char** argv)
          warnx("pgvictoria: Invalid master key file");
          goto error;
       }
-      else if (ret == 3)
-      {
-         warnx("pgvictoria: USERS: Too many users defined %d (max %d)", config->common.number_of_users, NUMBER_OF_USERS);
-         goto error;
-      }
    }
 
    memcpy(&config->common.users_path[0], users_path, MIN(strlen(users_path), (size_t)MAX_PATH - 1));
@@ -369,13 +423,130 @@ main(int argc, char** argv)
 
    free(os);
 
+   signal(SIGPIPE, SIG_IGN);
+
+   for (int i = 0; i < SIGNALS_NUMBER; i++)
+   {
+      struct ev_signal* sig = &signal_watcher[i].signal;
+
+      ev_signal_init(sig, shutdown_cb, signals[i]);
+      signal_watcher[i].slot = -1;
+      ev_signal_start(main_loop, sig);
+   }
+
+   /* Started before the other processes are forked, so they log to the ring */
+   if (start_log_writer())
+   {
+      pgvictoria_log_fatal("Could not start the log writer");
+#ifdef HAVE_SYSTEMD
+      sd_notify(0, "STATUS=Could not start the log writer");
+#endif
+      goto error;
+   }
+
+   pgvictoria_memory_init();
+
+   /* Interned before the collectors are forked, so they share the table */
+   if (pgvictoria_guc_intern_init())
+   {
+      pgvictoria_log_warn("Could not intern the setting names");
+   }
+
+   if (pgvictoria_prometheus_init())
+   {
+      pgvictoria_log_fatal("Could not initialize metrics");
+      goto error;
+   }
+
+   if (config->metrics > 0)
+   {
+      /* Bind metrics socket */
+      if (pgvictoria_bind(config->host, config->metrics, &metrics_fds, &metrics_fds_length))
+      {
+         pgvictoria_log_fatal("Could not bind to %s:%d", config->host, config->metrics);
+#ifdef HAVE_SYSTEMD
+         sd_notifyf(0, "STATUS=Could not bind to %s:%d", config->host, config->metrics);
+#endif
+         goto error;
+      }
+
+      if (metrics_fds_length > MAX_FDS)
+      {
+         pgvictoria_log_fatal("Too many descriptors %d", metrics_fds_length);
+#ifdef HAVE_SYSTEMD
+         sd_notifyf(0, "STATUS=Too many descriptors %d", metrics_fds_length);
+#endif
+         goto error;
+      }
+
+      start_metrics();
+
+      for (int i = 0; i < metrics_fds_length; i++)
+      {
+         pgvictoria_log_debug("Metrics: %d", *(metrics_fds + i));
+      }
+   }
+
+   if (start_collectors())
+   {
+      pgvictoria_log_fatal("Could not start the collectors");
+#ifdef HAVE_SYSTEMD
+      sd_notify(0, "STATUS=Could not start the collectors");
+#endif
+      goto error;
+   }
+
+   io = &io_collector;
+   ev_io_init(io, collector_cb, collector_fds[0], EV_READ);
+   ev_io_start(main_loop, io);
+
+   ev_timer_init(&render_timer, render_cb, METRICS_RENDER_DELAY, 0.0);
+
+#ifdef HAVE_SYSTEMD
+   sd_notifyf(0,
+              "READY=1\n"
+              "STATUS=Running\n"
+              "MAINPID=%lu",
+              (unsigned long)getpid());
+#endif
+
+   while (keep_running)
+   {
+      ev_run(main_loop, 0);
+   }
+
    pgvictoria_log_info("Shutdown");
+#ifdef HAVE_SYSTEMD
+   sd_notify(0, "STOPPING=1");
+#endif
+
+   ev_io_stop(main_loop, &io_collector);
+   ev_timer_stop(main_loop, &render_timer);
+
+   shutdown_collectors();
+
+   shutdown_metrics();
+   free(metrics_fds);
+   metrics_fds = NULL;
+
+   for (int i = 0; i < SIGNALS_NUMBER; i++)
+   {
+      ev_signal_stop(main_loop, (struct ev_signal*)&signal_watcher[i]);
+   }
+
+   pgvictoria_prometheus_destroy();
+   pgvictoria_collector_destroy();
+   pgvictoria_guc_intern_destroy();
+   pgvictoria_memory_destroy();
+
+   shutdown_log_writer();
 
    ev_loop_destroy(main_loop);
 
    remove_pidfile();
 
    pgvictoria_stop_logging();
+   pgvictoria_registry_destroy(&config->common);
    pgvictoria_destroy_shared_memory(shmem, shmem_size);
 
    if (stop)
@@ -387,6 +558,13 @@ main(int argc, char** argv)
 
 error:
 
+   shutdown_collectors();
+
+   pgvictoria_prometheus_destroy();
+   pgvictoria_collector_destroy();
+   pgvictoria_guc_intern_destroy();
+   pgvictoria_memory_destroy();
+
    if (pid_file_created)
    {
       remove_pidfile();
@@ -395,7 +573,10 @@ error:
 
    config->running = false;
 
+   shutdown_log_writer();
+
    pgvictoria_stop_logging();
+   pgvictoria_registry_destroy(&config->common);
    pgvictoria_destroy_shared_memory(shmem, shmem_size);
 
    if (stop)
@@ -488,3 +669,462 @@ remove_pidfile(void)
       unlink(config->pidfile);
    }
 }
+
+static void
+start_metrics(void)
+{
+   for (int i = 0; i < metrics_fds_length; i++)
+   {
+      int sockfd = *(metrics_fds + i);
+      struct ev_io* io = &io_metrics[i].io;
+
+      memset(&io_metrics[i], 0, sizeof(struct accept_io));
+      ev_io_init(io, accept_metrics_cb, sockfd, EV_READ);
+      io_metrics[i].socket = sockfd;
+      io_metrics[i].argv = argv_ptr;
+      ev_io_start(main_loop, io);
+   }
+}
+
+static void
+shutdown_metrics(void)
+{
+   for (int i = 0; i < metrics_fds_length; i++)
+   {
+      ev_io_stop(main_loop, (struct ev_io*)&io_metrics[i]);
+      pgvictoria_disconnect(io_metrics[i].socket);
+      errno = 0;
+   }
+}
+
+static void
+accept_metrics_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
+{
+   struct sockaddr_in6 client_addr;
+   socklen_t client_addr_length;
+   int client_fd;
+
+   if (EV_ERROR & revents)
+   {
+      pgvictoria_log_debug("accept_metrics_cb: invalid event: %s", strerror(errno));
+      errno = 0;
+      return;
+   }
+
+   client_addr_length = sizeof(client_addr);
+   client_fd = accept(watcher->fd, (struct sockaddr*)&client_addr, &client_addr_length);
+   if (client_fd == -1)
+   {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+         pgvictoria_log_debug("accept_metrics_cb: accept: %s", strerror(errno));
+      }
+      errno = 0;
+      return;
+   }
+
+   pgvictoria_prometheus_client(loop, client_fd);
+}
+
+static void
+shutdown_cb(struct ev_loop* loop, struct ev_signal* w, int revents)
+{
+   (void)revents;
+
+   pgvictoria_log_debug("shutdown requested (%d)", w->signum);
+   keep_running = 0;
+   ev_break(loop, EVBREAK_ALL);
+}
+
+static int
+start_collectors(void)
+{
+   struct main_configuration* config;
+
+   config = (struct main_configuration*)shmem;
+
+   number_of_collectors = pgvictoria_collector_count(config->collectors, config->common.number_of_servers);
+
+   if (pgvictoria_collector_init(number_of_collectors))
+   {
+      return 1;
+   }
+
+   if (pipe(collector_fds) == -1)
+   {
+      pgvictoria_log_error("pipe: %s", strerror(errno));
+      errno = 0;
+      return 1;
+   }
+
+   pgvictoria_socket_nonblocking(collector_fds[0], true);
+   pgvictoria_socket_nonblocking(collector_fds[1], true);
+
+   memset(&collectors, 0, sizeof(collectors));
+   memset(&collector_restart, 0, sizeof(collector_restart));
+
+   for (int i = 0; i < number_of_collectors; i++)
+   {
+      collector_restart[i].id = i;
+      collector_restart[i].respawn = respawn_collector;
+
+      if (start_collector(i))
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+static int
+start_collector(int collector)
+{
+   struct ev_child* child = NULL;
+   pid_t pid;
+   char title[MISC_LENGTH];
+
+   pid = fork();
+   if (pid == -1)
+   {
+      pgvictoria_log_error("Cannot create collector %d: %s", collector, strerror(errno));
+      errno = 0;
+      return 1;
+   }
+   else if (pid == 0)
+   {
+      /* The loop and the listeners belong to main */
+      for (int i = 0; i < metrics_fds_length; i++)
+      {
+         close(*(metrics_fds + i));
+      }
+      close(collector_fds[0]);
+
+      pgvictoria_snprintf(&title[0], sizeof(title), "%d", collector);
+      pgvictoria_set_proc_title(1, argv_ptr, "collector", &title[0]);
+
+      pgvictoria_collector_run(collector, number_of_collectors, collector_fds[1]);
+   }
+
+   child = &collectors[collector];
+   ev_child_init(child, collector_exit_cb, pid, 0);
+   ev_child_start(main_loop, child);
+
+   collector_restart[collector].since = ev_now(main_loop);
+
+   return 0;
+}
+
+static int
+start_log_writer(void)
+{
+   struct main_configuration* config;
+   struct ev_child* child = NULL;
+   pid_t pid;
+
+   config = (struct main_configuration*)shmem;
+
+   /* syslog does its own buffering */
+   if (config->common.log_type == PGVICTORIA_LOGGING_TYPE_SYSLOG)
+   {
+      return 0;
+   }
+
+   if (!log_writer_started)
+   {
+      if (pgvictoria_log_writer_init())
+      {
+         return 1;
+      }
+      log_writer_started = true;
+   }
+
+   pid = fork();
+   if (pid == -1)
+   {
+      pgvictoria_log_writer_destroy();
+      log_writer_started = false;
+      pgvictoria_log_error("Cannot create the log writer: %s", strerror(errno));
+      errno = 0;
+      return 1;
+   }
+   else if (pid == 0)
+   {
+      for (int i = 0; i < metrics_fds_length; i++)
+      {
+         close(*(metrics_fds + i));
+      }
+      if (collector_fds[0] != -1)
+      {
+         close(collector_fds[0]);
+      }
+
+      pgvictoria_set_proc_title(1, argv_ptr, "log writer", NULL);
+
+      pgvictoria_log_writer_run();
+   }
+
+   child = &log_writer;
+   ev_child_init(child, log_writer_exit_cb, pid, 0);
+   ev_child_start(main_loop, child);
+
+   log_writer_restart.since = ev_now(main_loop);
+
+   return 0;
+}
+
+static void
+shutdown_log_writer(void)
+{
+   int status;
+
+   if (!log_writer_started)
+   {
+      return;
+   }
+
+   ev_timer_stop(main_loop, &log_writer_restart.timer);
+
+   if (log_writer.pid > 0)
+   {
+      ev_child_stop(main_loop, &log_writer);
+      kill(log_writer.pid, SIGTERM);
+
+      /* The writer exits once the ring is written out */
+      for (int attempt = 0; attempt < 50 && log_writer.pid > 0; attempt++)
+      {
+         if (waitpid(log_writer.pid, &status, WNOHANG) != 0)
+         {
+            log_writer.pid = 0;
+         }
+         else
+         {
+            SLEEP(100000000L);
+         }
+      }
+
+      if (log_writer.pid > 0)
+      {
+         kill(log_writer.pid, SIGKILL);
+         waitpid(log_writer.pid, &status, 0);
+         log_writer.pid = 0;
+      }
+   }
+
+   pgvictoria_log_writer_destroy();
+   log_writer_started = false;
+}
+
+static void
+shutdown_collectors(void)
+{
+   int status;
+   bool running;
+
+   for (int i = 0; i < number_of_collectors; i++)
+   {
+      ev_timer_stop(main_loop, &collector_restart[i].timer);
+
+      if (collectors[i].pid > 0)
+      {
+         ev_child_stop(main_loop, &collectors[i]);
+         kill(collectors[i].pid, SIGTERM);
+      }
+   }
+
+   /* Give collectors in the middle of a collection a moment before forcing them */
+   for (int attempt = 0; attempt < 50; attempt++)
+   {
+      running = false;
+
+      for (int i = 0; i < number_of_collectors; i++)
+      {
+         if (collectors[i].pid > 0)
+         {
+            if (waitpid(collectors[i].pid, &status, WNOHANG) == 0)
+            {
+               running = true;
+            }
+            else
+            {
+               collectors[i].pid = 0;
+            }
+         }
+      }
+
+      if (!running)
+      {
+         break;
+      }
+
+      SLEEP(100000000L);
+   }
+
+   for (int i = 0; i < number_of_collectors; i++)
+   {
+      if (collectors[i].pid > 0)
+      {
+         pgvictoria_log_warn("Collector %d did not stop, killing it", i);
+         kill(collectors[i].pid, SIGKILL);
+         waitpid(collectors[i].pid, &status, 0);
+         collectors[i].pid = 0;
+      }
+   }
+
+   number_of_collectors = 0;
+
+   if (collector_fds[0] != -1)
+   {
+      close(collector_fds[0]);
+      collector_fds[0] = -1;
+   }
+   if (collector_fds[1] != -1)
+   {
+      close(collector_fds[1]);
+      collector_fds[1] = -1;
+   }
+}
+
+static void
+collector_cb(struct ev_loop* loop, struct ev_io* watcher, int revents)
+{
+   char buffer[256];
+   struct collector_result result;
+   char* drift = NULL;
+   int ret;
+   bool updated = false;
+
+   if (EV_ERROR & revents)
+   {
+      pgvictoria_log_trace("collector_cb: got invalid event: %s", strerror(errno));
+      return;
+   }
+
+   while (read(watcher->fd, &buffer[0], sizeof(buffer)) > 0)
+   {
+   }
+   errno = 0;
+
+   /* A dropped record does not hold back the results behind it */
+   while ((ret = pgvictoria_collector_consume(&result, &drift)) == COLLECTOR_OK || ret == COLLECTOR_DROPPED)
+   {
+      if (ret == COLLECTOR_OK)
+      {
+         pgvictoria_prometheus_update(&result, drift);
+         updated = true;
+      }
+   }
+
+   /*
+    * Every published result wakes main, so a collection round over the fleet
+    * arrives as many small batches. Render once the round has settled
+    */
+   if (updated && !ev_is_active(&render_timer))
+   {
+      ev_timer_set(&render_timer, METRICS_RENDER_DELAY, 0.0);
+      ev_timer_start(loop, &render_timer);
+   }
+}
+
+static void
+render_cb(struct ev_loop* loop, struct ev_timer* w, int revents)
+{
+   (void)revents;
+
+   ev_timer_stop(loop, w);
+
+   pgvictoria_prometheus_render();
+}
+
+static void
+log_writer_exit_cb(struct ev_loop* loop, struct ev_child* w, int revents)
+{
+   (void)revents;
+
+   ev_child_stop(loop, w);
+   w->pid = 0;
+
+   if (keep_running)
+   {
+      /* The ring outlives the writer, so the pending lines are not lost */
+      restart_process(loop, w, "Log writer", &log_writer_restart);
+   }
+}
+
+static void
+respawn_log_writer(int id)
+{
+   (void)id;
+
+   if (log_writer_started && log_writer.pid == 0)
+   {
+      start_log_writer();
+   }
+}
+
+static void
+collector_exit_cb(struct ev_loop* loop, struct ev_child* w, int revents)
+{
+   int collector = (int)(w - &collectors[0]);
+   char name[MISC_LENGTH];
+
+   (void)revents;
+
+   ev_child_stop(loop, w);
+   w->pid = 0;
+
+   if (keep_running)
+   {
+      pgvictoria_snprintf(&name[0], sizeof(name), "Collector %d", collector);
+      restart_process(loop, w, &name[0], &collector_restart[collector]);
+   }
+}
+
+static void
+respawn_collector(int collector)
+{
+   if (collectors[collector].pid == 0)
+   {
+      start_collector(collector);
+   }
+}
+
+static void
+restart_process(struct ev_loop* loop, struct ev_child* w, char* name, struct process_restart* restart)
+{
+   if (ev_now(loop) - restart->since >= RESTART_MAX)
+   {
+      restart->delay = 0.0;
+   }
+   else
+   {
+      restart->delay = restart->delay == 0.0 ? RESTART_MIN : MIN(restart->delay * 2, RESTART_MAX);
+   }
+
+   if (restart->delay == 0.0)
+   {
+      pgvictoria_log_warn("%s (%d) exited with status %d, restarting", name, w->rpid, w->rstatus);
+      restart->respawn(restart->id);
+   }
+   else
+   {
+      pgvictoria_log_warn("%s (%d) exited with status %d, restarting in %.0f seconds", name, w->rpid, w->rstatus, restart->delay);
+      ev_timer_init(&restart->timer, restart_cb, restart->delay, 0.0);
+      ev_timer_start(loop, &restart->timer);
+   }
+}
+
+static void
+restart_cb(struct ev_loop* loop, struct ev_timer* w, int revents)
+{
+   struct process_restart* restart = (struct process_restart*)w;
+
+   (void)revents;
+
+   ev_timer_stop(loop, w);
+
+   if (keep_running)
+   {
+      restart->respawn(restart->id);
+   }
+}
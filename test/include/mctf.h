@@ -66,6 +66,7 @@ typedef struct mctf_test
    mctf_test_func_t func;        /**< Test function pointer */
    bool is_negative;             /**< True if this is a negative test */
    bool is_integration;          /**< True if opt-in (runs only via --integration or an explicit -t/-m) */
+   bool is_benchmark;            /**< True if a benchmark (runs only via --benchmark) */
    unsigned int max_elapsed_sec; /**< Max allowed runtime in seconds; 0 = no limit */
    struct mctf_test* next;       /**< Next test in linked list */
 } mctf_test_t;
@@ -161,6 +162,26 @@ mctf_register_test(const char* name, const char* module, const char* file, mctf_
 void
 mctf_register_integration_test(const char* name, const char* module, const char* file, mctf_test_func_t func);
 
+/**
+ * Register a benchmark (excluded from the unit test runs; selected with
+ * --benchmark, optionally narrowed with -t/-m).
+ *
+ * @param name The test name
+ * @param module The module name
+ * @param file The source file name
+ * @param func The test function
+ * @param max_seconds Maximum allowed runtime in seconds
+ */
+void
+mctf_register_benchmark(const char* name, const char* module, const char* file, mctf_test_func_t func, unsigned int max_seconds);
+
+/**
+ * Run the benchmarks instead of the tests
+ * @param benchmark Whether to run the benchmarks
+ */
+void
+mctf_set_benchmark(bool benchmark);
+
 /**
  * Register a test function with additional flags.
  * @param name The test name
@@ -502,6 +523,23 @@ mctf_get_results(size_t* count);
    }                                                                                         \
    static int name(void)
 
+/**
+ * Register a benchmark with a max runtime. Benchmarks measure and log
+ * throughput; they are not part of the unit test runs.
+ * Usage: MCTF_BENCHMARK(my_benchmark, 60) { ... }
+ * Module name is derived from the source file name (same as MCTF_TEST).
+ */
+#define MCTF_BENCHMARK(name, max_seconds)                                             \
+   static int name(void);                                                             \
+   static void __attribute__((constructor)) mctf_register_benchmark_##name(void)      \
+   {                                                                                  \
+      const char* file_path = __FILE__;                                               \
+      const char* filename = mctf_extract_filename(file_path);                        \
+      mctf_register_benchmark(#name, mctf_extract_module_name(file_path), filename,   \
+                              name, (unsigned int)(max_seconds));                     \
+   }                                                                                  \
+   static int name(void)
+
 /**
  * Register a test that is both negative (allows ERROR in log) and has a max runtime.
  * Usage: MCTF_TEST_MAX_NEGATIVE(name, max_seconds) { ... }
@@ -36,6 +36,9 @@ extern "C" {
 
 #include <pgvictoria.h>
 
+#include <time.h>
+#include <sys/types.h>
+
 #define ENV_VAR_BASE_DIR "PGVICTORIA_TEST_BASE_DIR"
 
 extern char TEST_BASE_DIR[MAX_PATH];
@@ -64,6 +67,29 @@ pgvictoria_test_setup(void);
 void
 pgvictoria_test_teardown(void);
 
+/**
+ * The number of seconds since a point in time
+ * @param start The point in time, from CLOCK_MONOTONIC
+ * @return The seconds
+ */
+double
+pgvictoria_test_elapsed(struct timespec* start);
+
+/**
+ * The size of the log file, where the next log lines will start
+ * @return The offset
+ */
+off_t
+pgvictoria_test_log_offset(void);
+
+/**
+ * Read the log file from an offset
+ * @param offset The offset
+ * @return The log lines, which the caller frees, or NULL upon failure
+ */
+char*
+pgvictoria_test_log_read(off_t offset);
+
 #ifdef __cplusplus
 }
 #endif
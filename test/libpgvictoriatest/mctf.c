@@ -46,6 +46,7 @@ char* mctf_errmsg = NULL;
 /* Global test runner */
 static mctf_runner_t g_runner = {0};
 static bool g_initialized = false;
+static bool g_benchmark = false;
 
 /* Optional log file for test runner output */
 static FILE* mctf_log_file = NULL;
@@ -301,6 +302,23 @@ mctf_register_integration_test(const char* name, const char* module, const char*
    }
 }
 
+void
+mctf_register_benchmark(const char* name, const char* module, const char* file, mctf_test_func_t func, unsigned int max_seconds)
+{
+   mctf_register_test_with_options(name, module, file, func, false, max_seconds);
+   /* Mark the just-appended test as a benchmark (test runs skip it). */
+   if (g_runner.tests_tail != NULL)
+   {
+      g_runner.tests_tail->is_benchmark = true;
+   }
+}
+
+void
+mctf_set_benchmark(bool benchmark)
+{
+   g_benchmark = benchmark;
+}
+
 void
 mctf_register_test_with_max_time(const char* name, const char* module, const char* file, mctf_test_func_t func, unsigned int max_seconds)
 {
@@ -458,6 +476,12 @@ mctf_extract_module_name(const char* file_path)
 static bool
 matches_filter(mctf_filter_type_t filter_type, const mctf_test_t* test, const char* filter)
 {
+   /* Benchmarks and tests never run together */
+   if (test->is_benchmark != g_benchmark)
+   {
+      return false;
+   }
+
    /* Integration mode runs exactly the opt-in integration tests. */
    if (filter_type == MCTF_FILTER_INTEGRATION)
    {
@@ -510,7 +534,7 @@ mctf_run_tests(mctf_filter_type_t filter_type, const char* filter)
       switch (filter_type)
       {
          case MCTF_FILTER_NONE:
-            mctf_log_errorf("MCTF: No tests registered (total registered: %zu)\n", g_runner.test_count);
+            mctf_log_errorf("MCTF: No %s registered (total registered: %zu)\n", g_benchmark ? "benchmarks" : "tests", g_runner.test_count);
             break;
          case MCTF_FILTER_MODULE:
             mctf_log_errorf("MCTF: No tests found in module '%s'\n", filter);
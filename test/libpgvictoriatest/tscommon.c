@@ -31,9 +31,11 @@
 #include <shmem.h>
 #include <logging.h>
 #include <memory.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 char TEST_BASE_DIR[MAX_PATH];
 
@@ -97,3 +99,57 @@ pgvictoria_test_teardown(void)
 {
    pgvictoria_memory_destroy();
 }
+
+double
+pgvictoria_test_elapsed(struct timespec* start)
+{
+   struct timespec end;
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+off_t
+pgvictoria_test_log_offset(void)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct stat st;
+
+   return stat(config->common.log_path, &st) == 0 ? st.st_size : 0;
+}
+
+char*
+pgvictoria_test_log_read(off_t offset)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   FILE* file = NULL;
+   char* data = NULL;
+   long size;
+
+   file = fopen(config->common.log_path, "r");
+   if (file == NULL)
+   {
+      return NULL;
+   }
+
+   fseek(file, 0, SEEK_END);
+   size = ftell(file) - offset;
+   if (size < 0)
+   {
+      size = 0;
+      offset = 0;
+   }
+
+   data = (char*)calloc(1, size + 1);
+   if (data != NULL)
+   {
+      fseek(file, offset, SEEK_SET);
+      size = fread(data, 1, size, file);
+      data[size] = '\0';
+   }
+
+   fclose(file);
+
+   return data;
+}
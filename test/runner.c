@@ -62,12 +62,14 @@ usage(const char* progname)
    printf("Options:\n");
    printf("  -t, --test NAME    Run only tests matching NAME (test name pattern)\n");
    printf("  -m, --module NAME Run all tests in module NAME\n");
+   printf("  -b, --benchmark    Run the benchmarks instead of the tests\n");
    printf("  -h, --help         Show this help message\n");
    printf("\n");
    printf("Examples:\n");
    printf("  %s                 Run full test suite\n", progname);
    printf("  %s -m registry     Run all tests in 'registry' module\n", progname);
    printf("  %s -t check_point  Run test matching 'check_point'\n", progname);
+   printf("  %s -b -m art       Run the benchmarks of the 'art' module\n", progname);
    printf("\n");
 }
 
@@ -309,10 +311,11 @@ main(int argc, char* argv[])
    static struct option long_options[] = {
       {"test", required_argument, 0, 't'},
       {"module", required_argument, 0, 'm'},
+      {"benchmark", no_argument, 0, 'b'},
       {"help", no_argument, 0, 'h'},
       {0, 0, 0, 0}};
 
-   while ((c = getopt_long(argc, argv, "t:m:h", long_options, NULL)) != -1)
+   while ((c = getopt_long(argc, argv, "t:m:bh", long_options, NULL)) != -1)
    {
       switch (c)
       {
@@ -327,6 +330,9 @@ main(int argc, char* argv[])
             filter = optarg;
             filter_type = (c == 't') ? MCTF_FILTER_TEST : MCTF_FILTER_MODULE;
             break;
+         case 'b':
+            mctf_set_benchmark(true);
+            break;
          case 'h':
             usage(argv[0]);
             return EXIT_SUCCESS;
@@ -0,0 +1,1023 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <mctf.h>
+#include <tscommon.h>
+#include <art.h>
+#include <json.h>
+#include <logging.h>
+#include <memory.h>
+#include <postgresql.h>
+#include <utils.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define ART_TEST_ALPHABET "0123456789abcdef"
+#define ART_TEST_ROUNDS   2000
+#define ART_TEST_SNAPSHOT 100000
+#define ART_TEST_LOADS    20
+
+struct art_test_scan
+{
+   int count;
+   int limit;
+   bool unordered;
+   char last[128];
+};
+
+static int art_test_scan_cb(void* data, char* key, struct value* value);
+static int art_test_entry_compare(const void* a, const void* b);
+static int art_test_baseline_keys(int version, struct json** baseline, char*** keys, int* number_of_keys);
+static void art_test_free_keys(char** keys, int number_of_keys);
+
+MCTF_TEST_SETUP(art)
+{
+   pgvictoria_test_setup();
+}
+
+MCTF_TEST_TEARDOWN(art)
+{
+   pgvictoria_test_teardown();
+}
+
+MCTF_TEST(test_art_insert_search)
+{
+   struct art* t = NULL;
+   char key[64];
+
+   pgvictoria_art_create(&t);
+
+   /* Two levels of 16 way fan-out, then a level wide enough to need node48 and node256 */
+   for (int i = 0; i < 16; i++)
+   {
+      for (int j = 0; j < 16; j++)
+      {
+         snprintf(key, sizeof(key), "shared_prefix_%c%c", ART_TEST_ALPHABET[i], ART_TEST_ALPHABET[j]);
+         MCTF_ASSERT_INT_EQ(pgvictoria_art_insert(t, key, (uintptr_t)(i * 16 + j), ValueInt32), 0, cleanup);
+      }
+   }
+   for (int i = 1; i < 256; i++)
+   {
+      snprintf(key, sizeof(key), "wide_%c", (char)i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32), 0, cleanup);
+   }
+
+   MCTF_ASSERT_INT_EQ((int)t->size, 256 + 255, cleanup);
+
+   for (int i = 0; i < 16; i++)
+   {
+      for (int j = 0; j < 16; j++)
+      {
+         snprintf(key, sizeof(key), "shared_prefix_%c%c", ART_TEST_ALPHABET[i], ART_TEST_ALPHABET[j]);
+         MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), i * 16 + j, cleanup, "lookup of %s", key);
+      }
+   }
+   for (int i = 1; i < 256; i++)
+   {
+      snprintf(key, sizeof(key), "wide_%c", (char)i);
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), i, cleanup);
+   }
+
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "shared_prefix_"), cleanup, "a prefix is not a key");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "shared_prefix_0g"), cleanup, "missing child");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "shared_prefix_000"), cleanup, "longer key");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "shared_prefiy_00"), cleanup, "prefix mismatch");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "a_key_that_is_longer_than_sixteen_bytes"), cleanup, "long missing key");
+
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "shared_prefix_%c0", ART_TEST_ALPHABET[i]);
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, key), 0, cleanup);
+      MCTF_ASSERT(!pgvictoria_art_contains_key(t, key), cleanup, "deleted key %s", key);
+   }
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "shared_prefix_%cf", ART_TEST_ALPHABET[i]);
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), i * 16 + 15, cleanup);
+   }
+
+cleanup:
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_long_keys)
+{
+   struct art* t = NULL;
+   char key[128];
+
+   pgvictoria_art_create(&t);
+
+   /* Keys longer than a vector share more than MAX_PREFIX_LEN bytes */
+   for (int i = 0; i < 40; i++)
+   {
+      snprintf(key, sizeof(key), "autovacuum_vacuum_insert_scale_factor_for_table_%d", i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32), 0, cleanup);
+   }
+
+   for (int i = 0; i < 40; i++)
+   {
+      snprintf(key, sizeof(key), "autovacuum_vacuum_insert_scale_factor_for_table_%d", i);
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), i, cleanup);
+   }
+
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "autovacuum_vacuum_insert_scale_factor_for_tablf_1"), cleanup, "mismatch inside the compressed path");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "autovacuum_vacuum_insert_scale_factor_for_table_40"), cleanup, "missing key");
+
+   /* A prefix longer than MAX_PREFIX_LEN is split past the stored bytes and verified at the leaf */
+   for (int i = 0; i < 3; i++)
+   {
+      snprintf(key, sizeof(key), "%070d_%d", 0, i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_insert(t, key, (uintptr_t)(100 + i), ValueInt32), 0, cleanup);
+   }
+   snprintf(key, sizeof(key), "%064d1", 0);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_insert(t, key, (uintptr_t)200, ValueInt32), 0, cleanup);
+
+   snprintf(key, sizeof(key), "%064d1", 0);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), 200, cleanup);
+   snprintf(key, sizeof(key), "%064d2%05d_1", 0, 0);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, key), cleanup, "mismatch past the stored prefix");
+
+   snprintf(key, sizeof(key), "%070d_%d", 0, 1);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, key), 0, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, key), cleanup, "deleted key");
+
+   for (int i = 0; i < 3; i += 2)
+   {
+      snprintf(key, sizeof(key), "%070d_%d", 0, i);
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, key), 100 + i, cleanup);
+   }
+
+cleanup:
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_case_insensitive)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   struct json* baseline = NULL;
+   enum value_type type;
+   char key[200];
+   char upper[200];
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_create_case_insensitive(&t), 0, cleanup);
+
+   pgvictoria_art_insert(t, "DateStyle", (uintptr_t)1, ValueInt32);
+   pgvictoria_art_insert(t, "IntervalStyle", (uintptr_t)2, ValueInt32);
+   pgvictoria_art_insert(t, "TimeZone", (uintptr_t)3, ValueInt32);
+   pgvictoria_art_insert(t, "timezone_abbreviations", (uintptr_t)4, ValueInt32);
+
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "datestyle"), 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "DATESTYLE"), 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "intervalstyle"), 2, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "TIMEZONE"), 3, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "TimeZone_Abbreviations"), 4, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "timezon"), cleanup, "a prefix is not a key");
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "datestyles"), cleanup, "longer key");
+
+   /* Replacing a value keeps the first spelling */
+   pgvictoria_art_insert(t, "timezone", (uintptr_t)5, ValueInt32);
+   MCTF_ASSERT_INT_EQ((int)t->size, 4, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "TimeZone"), 5, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "TIME"), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "seek TIME");
+   MCTF_ASSERT_STR_EQ(iter->key, "TimeZone", cleanup);
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, "DATESTYLE"), 0, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "DateStyle"), cleanup, "deleted key");
+   MCTF_ASSERT_INT_EQ((int)t->size, 3, cleanup);
+
+   /* Folding a tree in place, with keys too long for the stack buffer */
+   pgvictoria_art_destroy(t);
+   pgvictoria_art_create(&t);
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "Long_%0150d_Key_%c", 0, ART_TEST_ALPHABET[i]);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_set_case_insensitive(t), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)t->size, 16, cleanup);
+   for (int i = 0; i < 16; i++)
+   {
+      snprintf(key, sizeof(key), "Long_%0150d_Key_%c", 0, ART_TEST_ALPHABET[i]);
+      for (int j = 0; key[j] != '\0'; j++)
+      {
+         upper[j] = key[j] >= 'a' && key[j] <= 'z' ? key[j] - ('a' - 'A') : key[j];
+         upper[j + 1] = '\0';
+      }
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, upper), i, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "first key");
+   MCTF_ASSERT(strncmp(iter->key, "Long_", 5) == 0, cleanup, "spelling of %s", iter->key);
+   snprintf(key, sizeof(key), "LONG_%0150d_KEY_0", 0);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, key), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)t->size, 15, cleanup);
+
+   /* Baselines match setting names the way PostgreSQL does */
+   baseline = pgvictoria_get_baseline(18);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+   MCTF_ASSERT(pgvictoria_json_get_typed(baseline, "datestyle", &type) != 0, cleanup, "datestyle");
+   MCTF_ASSERT(pgvictoria_json_get_typed(baseline, "DateStyle", &type) != 0, cleanup, "DateStyle");
+   MCTF_ASSERT(pgvictoria_json_get_typed(baseline, "TIMEZONE", &type) != 0, cleanup, "TIMEZONE");
+   MCTF_ASSERT(pgvictoria_json_get_typed(baseline, "WORK_MEM", &type) != 0, cleanup, "WORK_MEM");
+
+cleanup:
+   pgvictoria_json_destroy(baseline);
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_scan)
+{
+   struct art* t = NULL;
+   struct json* baseline = NULL;
+   struct art_test_scan scan;
+   char** keys = NULL;
+   char** matches = NULL;
+   int number_of_keys = 0;
+   int number_of_matches = 0;
+   int expected;
+   char* families[] = {"autovacuum", "log_", "enable_", "max_", "wal_", "lc_", "nosuchfamily"};
+
+   MCTF_ASSERT_INT_EQ(art_test_baseline_keys(18, &baseline, &keys, &number_of_keys), 0, cleanup);
+   t = (struct art*)baseline->elements;
+
+   /* One subtree walk per family, in key order */
+   for (size_t f = 0; f < sizeof(families) / sizeof(families[0]); f++)
+   {
+      expected = 0;
+      for (int i = 0; i < number_of_keys; i++)
+      {
+         if (strncasecmp(keys[i], families[f], strlen(families[f])) == 0)
+         {
+            expected++;
+         }
+      }
+
+      memset(&scan, 0, sizeof(scan));
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_prefix_scan(t, families[f], art_test_scan_cb, &scan), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(scan.count, expected, cleanup, "family %s", families[f]);
+      MCTF_ASSERT(!scan.unordered, cleanup, "family %s out of order", families[f]);
+   }
+
+   /* The baseline is case-insensitive, and keys keep their spelling */
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_prefix_scan(t, "DATESTYLE", art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, 1, cleanup);
+   MCTF_ASSERT_STR_EQ(scan.last, "DateStyle", cleanup);
+
+   /* A prefix past the stored prefix bytes of a node */
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_prefix_scan(t, "autovacuum_vacuum_insert_scale", art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, 1, cleanup);
+
+   /* Every key */
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_prefix_scan(t, NULL, art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, number_of_keys, cleanup);
+
+   /* A range is [start, end) */
+   expected = 0;
+   for (int i = 0; i < number_of_keys; i++)
+   {
+      if (strcasecmp(keys[i], "log_") >= 0 && strcasecmp(keys[i], "max_") < 0)
+      {
+         expected++;
+      }
+   }
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_range_scan(t, "log_", "max_", art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, expected, cleanup);
+   MCTF_ASSERT(!scan.unordered, cleanup, "range out of order");
+
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_range_scan(t, "work_mem", "work_mem_", art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, 1, cleanup);
+   MCTF_ASSERT_STR_EQ(scan.last, "work_mem", cleanup);
+
+   memset(&scan, 0, sizeof(scan));
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_range_scan(t, NULL, NULL, art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, number_of_keys, cleanup);
+
+   /* The callback ends the scan */
+   memset(&scan, 0, sizeof(scan));
+   scan.limit = 3;
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_range_scan(t, "a", NULL, art_test_scan_cb, &scan), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(scan.count, 3, cleanup);
+
+   /* The copying prefix search is built on the scan */
+   number_of_matches = pgvictoria_art_prefix_search(t, "autovacuum_vacuum", &matches, 4);
+   MCTF_ASSERT_INT_EQ(number_of_matches, 4, cleanup);
+   MCTF_ASSERT(strncmp(matches[0], "autovacuum_vacuum", 17) == 0, cleanup, "match %s", matches[0]);
+
+cleanup:
+   if (matches != NULL)
+   {
+      for (int i = 0; i < number_of_matches; i++)
+      {
+         free(matches[i]);
+      }
+      free(matches);
+   }
+   art_test_free_keys(keys, number_of_keys);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_bulk_load)
+{
+   struct art* t = NULL;
+   struct art* reference = NULL;
+   struct art_iterator* iter = NULL;
+   struct art_entry entries[600];
+   struct art_statistics stats;
+   struct art_statistics expected;
+   char keys[600][32];
+   int n = 0;
+
+   /* Fan-out wide enough for every node size */
+   for (int i = 1; i < 256; i++)
+   {
+      snprintf(keys[n], sizeof(keys[n]), "wide_%c", (char)i);
+      n++;
+   }
+   for (int i = 0; i < 16 * 16; i++)
+   {
+      snprintf(keys[n], sizeof(keys[n]), "x%c%c_setting", ART_TEST_ALPHABET[i >> 4], ART_TEST_ALPHABET[i & 15]);
+      n++;
+   }
+   for (int i = 0; i < 30; i++)
+   {
+      snprintf(keys[n], sizeof(keys[n]), "xz%02d", i);
+      n++;
+   }
+   snprintf(keys[n++], sizeof(keys[n]), "y");
+   snprintf(keys[n++], sizeof(keys[n]), "yy");
+
+   for (int i = 0; i < n; i++)
+   {
+      entries[i].key = keys[i];
+      entries[i].value = (uintptr_t)i;
+      entries[i].type = ValueInt32;
+   }
+
+   /* Sorted input */
+   pgvictoria_art_create(&t);
+   pgvictoria_art_create(&reference);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_bulk_load(t, entries, n), 0, cleanup);
+   for (int i = 0; i < n; i++)
+   {
+      pgvictoria_art_insert(reference, keys[i], (uintptr_t)i, ValueInt32);
+   }
+   MCTF_ASSERT_INT_EQ((int)t->size, n, cleanup);
+   for (int i = 0; i < n; i++)
+   {
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, keys[i]), i, cleanup, "lookup of %s", keys[i]);
+   }
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(t, &stats), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(reference, &expected), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.node4, (int)expected.node4, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.node16, (int)expected.node16, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.node48, (int)expected.node48, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.node256, (int)expected.node256, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.visits, (int)expected.visits, cleanup);
+
+   /* A loaded tree takes inserts and deletes like any other */
+   for (int i = 0; i < 16 * 16; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, keys[255 + i]), 0, cleanup);
+   }
+   for (int i = 1; i < 200; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, keys[i]), 0, cleanup);
+   }
+   pgvictoria_art_insert(t, "wide_extra", (uintptr_t)1000, ValueInt32);
+   pgvictoria_art_insert(t, "y", (uintptr_t)1001, ValueInt32);
+   MCTF_ASSERT_INT_EQ((int)t->size, n - 16 * 16 - 199 + 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "wide_extra"), 1000, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "y"), 1001, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, keys[0]), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_bulk_load(t, entries, n) != 0, cleanup, "loading into a tree that has keys");
+   pgvictoria_art_destroy(t);
+   t = NULL;
+
+   /* Unsorted input with a duplicate, the last one wins */
+   entries[0] = entries[n - 1];
+   entries[0].value = (uintptr_t)5000;
+   entries[n - 1].value = (uintptr_t)6000;
+   entries[1].key = keys[n - 1];
+   entries[1].value = (uintptr_t)7000;
+   pgvictoria_art_create(&t);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_bulk_load(t, entries, n), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)t->size, n - 2, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "yy"), 6000, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, keys[0]), cleanup, "replaced key");
+   pgvictoria_art_destroy(t);
+   t = NULL;
+
+   /* A case-insensitive tree */
+   entries[0].key = "DateStyle";
+   entries[1].key = "IntervalStyle";
+   entries[2].key = "TimeZone";
+   pgvictoria_art_create_case_insensitive(&t);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_bulk_load(t, entries, 3), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "timezone"), (int)entries[2].value, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "first key");
+   MCTF_ASSERT_STR_EQ(iter->key, "DateStyle", cleanup);
+
+cleanup:
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_art_destroy(reference);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_art_bulk_load_throughput, 60)
+{
+   struct art* t = NULL;
+   struct json* baseline = NULL;
+   struct art_entry* entries = NULL;
+   struct timespec start;
+   char** keys = NULL;
+   int number_of_keys = 0;
+   double insert;
+   double load;
+
+   for (int version = 14; version <= 20; version++)
+   {
+      if (version <= 19)
+      {
+         MCTF_ASSERT_INT_EQ(art_test_baseline_keys(version, &baseline, &keys, &number_of_keys), 0, cleanup);
+      }
+      else
+      {
+         /* A snapshot of 100 servers */
+         number_of_keys = ART_TEST_SNAPSHOT;
+         keys = calloc(number_of_keys, sizeof(char*));
+         MCTF_ASSERT_PTR_NONNULL(keys, cleanup);
+         for (int i = 0; i < number_of_keys; i++)
+         {
+            keys[i] = malloc(32);
+            snprintf(keys[i], 32, "server_%03d.setting_%04d", i / 1000, i % 1000);
+         }
+      }
+
+      entries = calloc(number_of_keys, sizeof(struct art_entry));
+      MCTF_ASSERT_PTR_NONNULL(entries, cleanup);
+      for (int i = 0; i < number_of_keys; i++)
+      {
+         entries[i].key = keys[i];
+         entries[i].value = (uintptr_t)i;
+         entries[i].type = ValueInt32;
+      }
+      qsort(entries, number_of_keys, sizeof(struct art_entry), art_test_entry_compare);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int r = 0; r < ART_TEST_LOADS; r++)
+      {
+         pgvictoria_art_create(&t);
+         for (int i = 0; i < number_of_keys; i++)
+         {
+            pgvictoria_art_insert(t, entries[i].key, entries[i].value, entries[i].type);
+         }
+         pgvictoria_art_destroy(t);
+         t = NULL;
+      }
+      insert = pgvictoria_test_elapsed(&start);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int r = 0; r < ART_TEST_LOADS; r++)
+      {
+         pgvictoria_art_create(&t);
+         MCTF_ASSERT_INT_EQ(pgvictoria_art_bulk_load(t, entries, number_of_keys), 0, cleanup);
+         pgvictoria_art_destroy(t);
+         t = NULL;
+      }
+      load = pgvictoria_test_elapsed(&start);
+
+      pgvictoria_log_info("art: %s%d, %d keys: insert %.3fms, bulk load %.3fms per tree",
+                          version <= 19 ? "pg" : "snapshot ", version <= 19 ? version : 100, number_of_keys,
+                          insert * 1000.0 / ART_TEST_LOADS, load * 1000.0 / ART_TEST_LOADS);
+
+      free(entries);
+      entries = NULL;
+      art_test_free_keys(keys, number_of_keys);
+      keys = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+cleanup:
+   free(entries);
+   art_test_free_keys(keys, number_of_keys);
+   pgvictoria_json_destroy(baseline);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_delete_shrink)
+{
+   struct art* t = NULL;
+   struct art_statistics stats;
+   char key[64];
+
+   pgvictoria_art_create(&t);
+
+   for (int i = 1; i < 256; i++)
+   {
+      snprintf(key, sizeof(key), "max_parallel_workers_%c", (char)i);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(t, &stats), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.node256, 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.leaves, 255, cleanup);
+
+   /* Every delete shrinks the node as soon as it falls below the next size */
+   for (int i = 1; i < 255; i++)
+   {
+      snprintf(key, sizeof(key), "max_parallel_workers_%c", (char)i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, key), 0, cleanup);
+
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(t, &stats), 0, cleanup);
+      if (stats.leaves <= 37)
+      {
+         MCTF_ASSERT_INT_EQ((int)stats.node256, 0, cleanup, "node256 with %d children", (int)stats.leaves);
+      }
+      if (stats.leaves <= 12)
+      {
+         MCTF_ASSERT_INT_EQ((int)stats.node48, 0, cleanup, "node48 with %d children", (int)stats.leaves);
+      }
+      if (stats.leaves <= 3)
+      {
+         MCTF_ASSERT_INT_EQ((int)stats.node16, 0, cleanup, "node16 with %d children", (int)stats.leaves);
+      }
+   }
+
+   /* A single key collapses back into one leaf */
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(t, &stats), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)stats.leaves, 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)(stats.node4 + stats.node16 + stats.node48 + stats.node256), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, "max_parallel_workers_\xff"), 255, cleanup);
+
+cleanup:
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_baseline_shape)
+{
+   struct art* t = NULL;
+   struct art_statistics stats;
+   struct json* baseline = NULL;
+   char** keys = NULL;
+   int number_of_keys = 0;
+
+   for (int version = 14; version <= 19; version++)
+   {
+      MCTF_ASSERT_INT_EQ(art_test_baseline_keys(version, &baseline, &keys, &number_of_keys), 0, cleanup);
+
+      pgvictoria_art_create(&t);
+      for (int i = 0; i < number_of_keys; i++)
+      {
+         pgvictoria_art_insert(t, keys[i], (uintptr_t)i, ValueInt32);
+      }
+
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_statistics(t, &stats), 0, cleanup);
+      MCTF_ASSERT_INT_EQ((int)stats.leaves, number_of_keys, cleanup);
+
+      for (int i = 0; i < number_of_keys; i++)
+      {
+         MCTF_ASSERT_INT_EQ((int)pgvictoria_art_search(t, keys[i]), i, cleanup);
+      }
+
+      pgvictoria_log_info("art: pg%d baseline, %d keys: %" PRIu64 " nodes (%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 "), "
+                          "%" PRIu64 " bytes, %.2f node visits per lookup, %" PRIu64 " nodes verified at the leaf",
+                          version, number_of_keys, stats.node4 + stats.node16 + stats.node48 + stats.node256,
+                          stats.node4, stats.node16, stats.node48, stats.node256, stats.memory,
+                          (double)stats.visits / stats.leaves, stats.optimistic);
+
+      pgvictoria_art_destroy(t);
+      t = NULL;
+      art_test_free_keys(keys, number_of_keys);
+      keys = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+cleanup:
+   pgvictoria_art_destroy(t);
+   art_test_free_keys(keys, number_of_keys);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_inline_values)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   struct json_iterator* values = NULL;
+   struct memory_arena* arena = NULL;
+   struct json* baseline = NULL;
+   char key[32];
+   char str[64];
+   int strings;
+   int inlined;
+
+   /* Short strings are kept in the leaf, longer ones on their own */
+   pgvictoria_art_create(&t);
+   pgvictoria_art_insert(t, "fsync", (uintptr_t)"on", ValueString);
+   pgvictoria_art_insert(t, "log_line_prefix", (uintptr_t)"%m [%p] %q%u@%d ", ValueString);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      MCTF_ASSERT(iter->value->inlined == !strcmp(iter->key, "fsync"), cleanup, "inline value of %s", iter->key);
+   }
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   /* Replacing a value swaps between the two */
+   pgvictoria_art_insert(t, "fsync", (uintptr_t)"a value too long to inline", ValueString);
+   pgvictoria_art_insert(t, "log_line_prefix", (uintptr_t)"%m ", ValueString);
+   MCTF_ASSERT_STR_EQ((char*)pgvictoria_art_search(t, "fsync"), "a value too long to inline", cleanup);
+   MCTF_ASSERT_STR_EQ((char*)pgvictoria_art_search(t, "log_line_prefix"), "%m ", cleanup);
+   MCTF_ASSERT_INT_EQ((int)t->size, 2, cleanup);
+
+   /* Folding a tree moves the values into new leaves */
+   for (int i = 0; i < 200; i++)
+   {
+      snprintf(key, sizeof(key), "Setting_%d", i);
+      snprintf(str, sizeof(str), i % 4 == 0 ? "a value too long to inline %d" : "v%d", i);
+      pgvictoria_art_insert(t, key, (uintptr_t)str, ValueString);
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_set_case_insensitive(t), 0, cleanup);
+   for (int i = 0; i < 200; i++)
+   {
+      snprintf(key, sizeof(key), "SETTING_%d", i);
+      snprintf(str, sizeof(str), i % 4 == 0 ? "a value too long to inline %d" : "v%d", i);
+      MCTF_ASSERT_STR_EQ((char*)pgvictoria_art_search(t, key), str, cleanup);
+   }
+   pgvictoria_art_destroy(t);
+   t = NULL;
+
+   /* A tree in an arena releases the data its values own along with the arena */
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(0, &arena), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_create_arena(arena, &t), 0, cleanup);
+   pgvictoria_art_insert(t, "a", (uintptr_t)malloc(32), ValueMem);
+   pgvictoria_art_insert(t, "b", (uintptr_t)"short", ValueString);
+   pgvictoria_art_insert(t, "a", (uintptr_t)malloc(64), ValueMem);
+   pgvictoria_art_insert(t, "c", (uintptr_t)malloc(16), ValueMem);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_delete(t, "c"), 0, cleanup);
+   MCTF_ASSERT_STR_EQ((char*)pgvictoria_art_search(t, "b"), "short", cleanup);
+   pgvictoria_memory_arena_destroy(arena);
+   arena = NULL;
+   t = NULL;
+
+   /* Most baseline settings have values short enough to be inlined */
+   for (int version = 14; version <= 19; version++)
+   {
+      baseline = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_iterator_create(baseline, &values), 0, cleanup);
+      strings = 0;
+      inlined = 0;
+      while (pgvictoria_json_iterator_next(values))
+      {
+         if (values->value->type == ValueString)
+         {
+            strings++;
+            inlined += values->value->inlined;
+         }
+      }
+      pgvictoria_json_iterator_destroy(values);
+      values = NULL;
+
+      pgvictoria_log_info("art: pg%d baseline, %d of %d string values inline", version, inlined, strings);
+      MCTF_ASSERT(inlined * 2 > strings, cleanup, "pg%d: %d of %d strings inline", version, inlined, strings);
+
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+cleanup:
+   pgvictoria_json_iterator_destroy(values);
+   pgvictoria_json_destroy(baseline);
+   pgvictoria_art_iterator_destroy(iter);
+   if (arena == NULL)
+   {
+      pgvictoria_art_destroy(t);
+   }
+   pgvictoria_memory_arena_destroy(arena);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_art_lookup_throughput, 60)
+{
+   struct art* t = NULL;
+   struct json* baseline = NULL;
+   char** keys = NULL;
+   int number_of_keys = 0;
+   struct timespec start;
+   double seconds;
+   long lookups;
+   long found;
+   char key[64];
+
+   for (int version = 14; version <= 19; version++)
+   {
+      MCTF_ASSERT_INT_EQ(art_test_baseline_keys(version, &baseline, &keys, &number_of_keys), 0, cleanup);
+
+      found = 0;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int r = 0; r < ART_TEST_ROUNDS; r++)
+      {
+         for (int i = 0; i < number_of_keys; i++)
+         {
+            enum value_type type;
+
+            pgvictoria_json_get_typed(baseline, keys[i], &type);
+            found += type != ValueNone ? 1 : 0;
+         }
+      }
+      seconds = pgvictoria_test_elapsed(&start);
+      lookups = (long)ART_TEST_ROUNDS * number_of_keys;
+
+      MCTF_ASSERT(found == lookups, cleanup, "every baseline key should be found");
+
+      pgvictoria_log_info("art: pg%d baseline, %d keys: %ld lookups in %.3fs, %.0f lookups/s",
+                          version, number_of_keys, lookups, seconds, seconds > 0.0 ? lookups / seconds : 0.0);
+
+      art_test_free_keys(keys, number_of_keys);
+      keys = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+   /* Every inner node is a full node16 */
+   pgvictoria_art_create(&t);
+   for (int i = 0; i < 16 * 16 * 16; i++)
+   {
+      snprintf(key, sizeof(key), "%c%c%c", ART_TEST_ALPHABET[i >> 8], ART_TEST_ALPHABET[(i >> 4) & 15], ART_TEST_ALPHABET[i & 15]);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+
+   found = 0;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int r = 0; r < ART_TEST_ROUNDS; r++)
+   {
+      for (int i = 0; i < 16 * 16 * 16; i++)
+      {
+         key[0] = ART_TEST_ALPHABET[i >> 8];
+         key[1] = ART_TEST_ALPHABET[(i >> 4) & 15];
+         key[2] = ART_TEST_ALPHABET[i & 15];
+         found += (long)pgvictoria_art_search(t, key) == i ? 1 : 0;
+      }
+   }
+   seconds = pgvictoria_test_elapsed(&start);
+   lookups = (long)ART_TEST_ROUNDS * 16 * 16 * 16;
+
+   MCTF_ASSERT(found == lookups, cleanup, "every node16 key should be found");
+
+   pgvictoria_log_info("art: node16, %d keys: %ld lookups in %.3fs, %.0f lookups/s",
+                       16 * 16 * 16, lookups, seconds, seconds > 0.0 ? lookups / seconds : 0.0);
+
+cleanup:
+   art_test_free_keys(keys, number_of_keys);
+   pgvictoria_json_destroy(baseline);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_art_iterator_order)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   char key[160];
+   char previous[160];
+   int count = 0;
+
+   pgvictoria_art_create(&t);
+
+   for (int i = 0; i < 16 * 16; i++)
+   {
+      snprintf(key, sizeof(key), "%c%c_setting", ART_TEST_ALPHABET[i & 15], ART_TEST_ALPHABET[i >> 4]);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+   for (int i = 1; i < 256; i++)
+   {
+      snprintf(key, sizeof(key), "wide_%c", (char)i);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+
+   /* A full scan returns every key in order */
+   previous[0] = '\0';
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      MCTF_ASSERT(strcmp(previous, iter->key) < 0, cleanup, "%s before %s", previous, iter->key);
+      snprintf(previous, sizeof(previous), "%s", iter->key);
+      count++;
+   }
+   MCTF_ASSERT_INT_EQ(count, 256 + 255, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_iterator_has_next(iter), cleanup, "exhausted iterator");
+
+   /* A prefix scan */
+   count = 0;
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "a"), 0, cleanup);
+   while (pgvictoria_art_iterator_next(iter) && strncmp(iter->key, "a", 1) == 0)
+   {
+      count++;
+   }
+   MCTF_ASSERT_INT_EQ(count, 16, cleanup);
+   MCTF_ASSERT_STR_EQ(iter->key, "b0_setting", cleanup);
+
+   /* Seeking between keys, past a key and past the end */
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "3f_settinga"), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "key after 3f_settinga");
+   MCTF_ASSERT_STR_EQ(iter->key, "40_setting", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "4"), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "key after 4");
+   MCTF_ASSERT_STR_EQ(iter->key, "40_setting", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "wide_\xff"), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_art_iterator_next(iter), cleanup, "last key");
+   MCTF_ASSERT(!pgvictoria_art_iterator_next(iter), cleanup, "past the last key");
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "x"), 0, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_iterator_has_next(iter), cleanup, "past the end");
+
+   /* Removing while iterating shrinks the nodes under the iterator */
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_seek(iter, "wide_"), 0, cleanup);
+   count = 0;
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      pgvictoria_art_iterator_remove(iter);
+      count++;
+   }
+   MCTF_ASSERT_INT_EQ(count, 255, cleanup);
+   MCTF_ASSERT_INT_EQ((int)t->size, 256, cleanup);
+   MCTF_ASSERT(!pgvictoria_art_contains_key(t, "wide_a"), cleanup, "removed key");
+   pgvictoria_art_iterator_destroy(iter);
+   iter = NULL;
+
+   /* A path deeper than the inline stack */
+   pgvictoria_art_clear(t);
+   for (int i = 1; i < 150; i++)
+   {
+      memset(key, 'a', i);
+      key[i] = '\0';
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+   count = 0;
+   MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+   while (pgvictoria_art_iterator_next(iter))
+   {
+      count++;
+      MCTF_ASSERT_INT_EQ((int)strlen(iter->key), count, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(count, 149, cleanup);
+
+cleanup:
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_art_iterator_throughput, 60)
+{
+   struct art* t = NULL;
+   struct art_iterator* iter = NULL;
+   struct timespec start;
+   char key[64];
+   long steps = 0;
+   double seconds;
+
+   /* A snapshot sized tree */
+   pgvictoria_art_create(&t);
+   for (int i = 0; i < ART_TEST_SNAPSHOT; i++)
+   {
+      snprintf(key, sizeof(key), "server_%03d.setting_%04d", i % 1000, i / 1000);
+      pgvictoria_art_insert(t, key, (uintptr_t)i, ValueInt32);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int r = 0; r < 20; r++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_art_iterator_create(t, &iter), 0, cleanup);
+      while (pgvictoria_art_iterator_next(iter))
+      {
+         steps++;
+      }
+      pgvictoria_art_iterator_destroy(iter);
+      iter = NULL;
+   }
+   seconds = pgvictoria_test_elapsed(&start);
+
+   MCTF_ASSERT(steps == 20L * ART_TEST_SNAPSHOT, cleanup, "every key should be visited");
+
+   pgvictoria_log_info("art: iterator, %d keys: %ld steps in %.3fs, %.0f steps/s",
+                       ART_TEST_SNAPSHOT, steps, seconds, seconds > 0.0 ? steps / seconds : 0.0);
+
+cleanup:
+   pgvictoria_art_iterator_destroy(iter);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+static int
+art_test_entry_compare(const void* a, const void* b)
+{
+   return strcmp(((struct art_entry*)a)->key, ((struct art_entry*)b)->key);
+}
+
+static int
+art_test_scan_cb(void* data, char* key, struct value* value)
+{
+   struct art_test_scan* scan = (struct art_test_scan*)data;
+
+   (void)value;
+
+   if (scan->count > 0 && strcasecmp(scan->last, key) >= 0)
+   {
+      scan->unordered = true;
+   }
+   snprintf(scan->last, sizeof(scan->last), "%s", key);
+   scan->count++;
+
+   return scan->limit > 0 && scan->count >= scan->limit;
+}
+
+static int
+art_test_baseline_keys(int version, struct json** baseline, char*** keys, int* number_of_keys)
+{
+   struct json_iterator* iter = NULL;
+   int n = 0;
+
+   *keys = NULL;
+   *number_of_keys = 0;
+
+   *baseline = pgvictoria_get_baseline(version);
+   if (*baseline == NULL || pgvictoria_json_iterator_create(*baseline, &iter))
+   {
+      return 1;
+   }
+
+   while (pgvictoria_json_iterator_next(iter))
+   {
+      *keys = realloc(*keys, (n + 1) * sizeof(char*));
+      (*keys)[n++] = pgvictoria_append(NULL, iter->key);
+   }
+   pgvictoria_json_iterator_destroy(iter);
+
+   *number_of_keys = n;
+
+   return n > 0 ? 0 : 1;
+}
+
+static void
+art_test_free_keys(char** keys, int number_of_keys)
+{
+   for (int i = 0; keys != NULL && i < number_of_keys; i++)
+   {
+      free(keys[i]);
+   }
+   free(keys);
+}
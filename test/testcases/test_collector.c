@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <collector.h>
+#include <mctf.h>
+#include <tscommon.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define COLLECTOR_TEST_SAMPLE "pgvictoria_setting_drift{name=\"primary\",setting=\"work_mem\",status=\"modified\"} 1\n"
+
+static void collector_test_result(int server, struct collector_result* result);
+
+MCTF_TEST_SETUP(collector)
+{
+   pgvictoria_test_setup();
+}
+
+MCTF_TEST_TEARDOWN(collector)
+{
+   pgvictoria_collector_destroy();
+   pgvictoria_test_teardown();
+}
+
+MCTF_TEST(test_collector_count)
+{
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_count(4, 10), 4, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_count(4, 2), 2, cleanup, "no more collectors than servers");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_count(4, 0), 1, cleanup, "one collector without servers");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_count(MAX_NUMBER_OF_COLLECTORS + 8, 1000), MAX_NUMBER_OF_COLLECTORS, cleanup);
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_collector_schedule)
+{
+   int owners[7] = {0};
+   int n = 0;
+
+   /* Every server is owned by exactly one collector, in order */
+   for (int c = 0; c < 3; c++)
+   {
+      int previous = -1;
+
+      for (int i = pgvictoria_collector_next(c, 3, 7, -1); i != -1; i = pgvictoria_collector_next(c, 3, 7, i))
+      {
+         MCTF_ASSERT(i >= 0 && i < 7, cleanup, "server %d out of range", i);
+         MCTF_ASSERT(i > previous, cleanup, "collector %d went back to server %d", c, i);
+         MCTF_ASSERT_INT_EQ(i % 3, c, cleanup, "server %d should belong to collector %d", i, i % 3);
+         owners[i]++;
+         previous = i;
+         n++;
+      }
+   }
+
+   MCTF_ASSERT_INT_EQ(n, 7, cleanup);
+   for (int i = 0; i < 7; i++)
+   {
+      MCTF_ASSERT_INT_EQ(owners[i], 1, cleanup, "server %d", i);
+   }
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_next(0, 1, 0, -1), -1, cleanup, "no servers, nothing to collect");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_next(2, 4, 2, -1), -1, cleanup, "a collector past the servers has none");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_next(3, 3, 7, -1), -1, cleanup, "an unknown collector has none");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_next(0, 0, 7, -1), -1, cleanup, "no collectors, nothing to collect");
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_collector_delay)
+{
+   time_t start = time(NULL);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_delay(60, start, start), 60, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_delay(60, start, start + 15), 45, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_delay(60, start, start + 60), 0, cleanup, "a round of a whole interval starts the next at once");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_delay(60, start, start + 600), 0, cleanup, "an overrun does not sleep");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_delay(60, start, start - 3600), 60, cleanup, "a clock set back does not stretch the interval");
+
+cleanup:
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_collector_dispatch)
+{
+   struct collector_result result;
+   char* drift = NULL;
+   char* samples = COLLECTOR_TEST_SAMPLE COLLECTOR_TEST_SAMPLE;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_publish(&result, NULL), 1, cleanup, "no ring, nothing to publish on");
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_init(0), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_init(MAX_NUMBER_OF_COLLECTORS + 1), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_init(2), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_EMPTY, cleanup, "the ring should be empty");
+
+   collector_test_result(0, &result);
+   result.drift_length = strlen(samples);
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_publish(&result, samples), 0, cleanup);
+
+   /* The drift length of a result without samples is ignored */
+   collector_test_result(1, &result);
+   result.up = false;
+   result.drift_length = 42;
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_publish(&result, NULL), 0, cleanup);
+
+   memset(&result, 0, sizeof(result));
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(result.server, 0, cleanup);
+   MCTF_ASSERT(result.up, cleanup, "the first result should be up");
+   MCTF_ASSERT_INT_EQ(result.version, 17, cleanup);
+   MCTF_ASSERT_INT_EQ(result.number_of_modified, 2, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(drift, cleanup);
+   MCTF_ASSERT_STR_EQ(drift, samples, cleanup);
+   free(drift);
+   drift = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(result.server, 1, cleanup);
+   MCTF_ASSERT(!result.up, cleanup, "the second result should be down");
+   MCTF_ASSERT_INT_EQ((int)result.drift_length, 0, cleanup);
+   MCTF_ASSERT_PTR_NULL(drift, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_EMPTY, cleanup, "the ring should be drained");
+
+cleanup:
+   free(drift);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_collector_oversized)
+{
+   struct collector_result result;
+   char* samples = NULL;
+   char* drift = NULL;
+   size_t sample_length = strlen(COLLECTOR_TEST_SAMPLE);
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_init(1), 0, cleanup);
+
+   /* More samples than a single ring record can hold */
+   samples = (char*)malloc(COLLECTOR_RING_SIZE + sample_length + 1);
+   MCTF_ASSERT_PTR_NONNULL(samples, cleanup);
+   while (length + sample_length <= COLLECTOR_RING_SIZE)
+   {
+      memcpy(samples + length, COLLECTOR_TEST_SAMPLE, sample_length);
+      length += sample_length;
+   }
+   samples[length] = '\0';
+
+   collector_test_result(0, &result);
+   result.drift_length = length;
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_publish(&result, samples), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_OK, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(drift, cleanup);
+   MCTF_ASSERT(result.drift_length > 0 && result.drift_length < length, cleanup, "the drift should be cut, got %zu", result.drift_length);
+   MCTF_ASSERT_INT_EQ((int)(result.drift_length % sample_length), 0, cleanup, "the drift should be cut at a sample boundary");
+   MCTF_ASSERT_INT_EQ((int)strlen(drift), (int)result.drift_length, cleanup);
+   MCTF_ASSERT(!strncmp(drift, samples, result.drift_length), cleanup, "the drift should be a prefix of the samples");
+
+cleanup:
+   free(drift);
+   free(samples);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_collector_process)
+{
+   struct collector_result result;
+   char* drift = NULL;
+   int seen[3] = {0};
+   int status = 0;
+   pid_t pid;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_collector_init(1), 0, cleanup);
+
+   /* Results are published by the collector processes and consumed by main */
+   pid = fork();
+   MCTF_ASSERT(pid != -1, cleanup, "fork failed");
+   if (pid == 0)
+   {
+      for (int i = 0; i < 3; i++)
+      {
+         collector_test_result(i, &result);
+         result.drift_length = strlen(COLLECTOR_TEST_SAMPLE);
+         if (pgvictoria_collector_publish(&result, COLLECTOR_TEST_SAMPLE))
+         {
+            _exit(1);
+         }
+      }
+      _exit(0);
+   }
+
+   MCTF_ASSERT(waitpid(pid, &status, 0) == pid, cleanup, "waitpid failed");
+   MCTF_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, cleanup, "the collector should publish its results");
+
+   for (int i = 0; i < 3; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_collector_consume(&result, &drift), COLLECTOR_OK, cleanup);
+      MCTF_ASSERT(result.server >= 0 && result.server < 3, cleanup, "unknown server %d", result.server);
+      MCTF_ASSERT_STR_EQ(drift, COLLECTOR_TEST_SAMPLE, cleanup);
+      seen[result.server]++;
+      free(drift);
+      drift = NULL;
+   }
+
+   for (int i = 0; i < 3; i++)
+   {
+      MCTF_ASSERT_INT_EQ(seen[i], 1, cleanup, "server %d", i);
+   }
+
+cleanup:
+   free(drift);
+   MCTF_FINISH();
+}
+
+static void
+collector_test_result(int server, struct collector_result* result)
+{
+   memset(result, 0, sizeof(struct collector_result));
+   result->server = server;
+   result->up = true;
+   result->version = 17;
+   result->number_of_default = 300;
+   result->number_of_modified = 2;
+   result->timestamp = time(NULL);
+}
@@ -0,0 +1,845 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <deque.h>
+#include <logging.h>
+#include <memory.h>
+#include <mctf.h>
+#include <tscommon.h>
+#include <utils.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEQUE_TEST_ENTRIES 100000
+#define DEQUE_TEST_ROUNDS  20
+#define DEQUE_TEST_ITEMS   64000
+
+struct deque_test_worker
+{
+   struct deque* deque;
+   int first;
+   int count;
+   atomic_int* polled;
+   atomic_llong* sum;
+   int total;
+};
+
+static int deque_test_contention(struct deque* deque, int threads, double* seconds);
+static int deque_test_compare_key(struct deque_entry* e1, struct deque_entry* e2);
+static int deque_test_compare_tag(struct deque_entry* e1, struct deque_entry* e2);
+static int deque_test_compare_length(struct deque_entry* e1, struct deque_entry* e2);
+static int deque_test_check_sorted(struct deque* deque, int expected);
+static void deque_test_string(int key, char* str, size_t size);
+static int deque_test_check_strings(struct deque* deque, int expected);
+static void* deque_test_produce(void* arg);
+static void* deque_test_consume(void* arg);
+
+MCTF_TEST(test_deque_blocks)
+{
+   struct deque* deque = NULL;
+   struct deque_iterator* iter = NULL;
+   char* tag = NULL;
+   char* data = NULL;
+   int64_t expected = 0;
+   int64_t v = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_deque_empty(deque), cleanup, "new deque should be empty");
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_poll(deque, NULL), 0, cleanup);
+
+   // Enough entries to span several blocks
+   for (int64_t i = 0; i < 1000; i++)
+   {
+      pgvictoria_deque_add(deque, NULL, (uintptr_t)i, ValueInt64);
+   }
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 1000, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_peek(deque, NULL), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_peek_last(deque, NULL), 999, cleanup);
+
+   // Remove the odd entries while iterating
+   pgvictoria_deque_iterator_create(deque, &iter);
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      if (pgvictoria_value_data(iter->value) % 2 == 1)
+      {
+         pgvictoria_deque_iterator_remove(iter);
+      }
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+   iter = NULL;
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 500, cleanup);
+
+   // Remove the first entry of every block as well
+   pgvictoria_deque_iterator_create(deque, &iter);
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      if (pgvictoria_value_data(iter->value) % 6 == 0)
+      {
+         pgvictoria_deque_iterator_remove(iter);
+      }
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+   iter = NULL;
+
+   expected = 2;
+   while (!pgvictoria_deque_empty(deque))
+   {
+      v = (int64_t)pgvictoria_deque_poll(deque, NULL);
+      MCTF_ASSERT_INT_EQ((int)v, (int)expected, cleanup);
+      expected += expected % 6 == 4 ? 4 : 2;
+      if (!pgvictoria_deque_empty(deque))
+      {
+         v = (int64_t)pgvictoria_deque_poll_last(deque, NULL);
+         MCTF_ASSERT(v % 2 == 0 && v % 6 != 0, cleanup, "unexpected value %d", (int)v);
+      }
+   }
+
+   // The deque can be reused after it was drained
+   pgvictoria_deque_add(deque, "a", (uintptr_t)"1", ValueString);
+   pgvictoria_deque_add(deque, "b", (uintptr_t)"2", ValueString);
+   data = (char*)pgvictoria_deque_poll_last(deque, &tag);
+   MCTF_ASSERT_STR_EQ(tag, "b", cleanup);
+   MCTF_ASSERT_STR_EQ(data, "2", cleanup);
+   MCTF_ASSERT_STR_EQ((char*)pgvictoria_deque_get(deque, "a"), "1", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_clear(deque), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_deque_empty(deque), cleanup, "cleared deque should be empty");
+   pgvictoria_deque_add(deque, "c", (uintptr_t)"3", ValueString);
+   MCTF_ASSERT(pgvictoria_deque_exists(deque, "c"), cleanup, "tag c should exist");
+
+cleanup:
+   free(tag);
+   free(data);
+   pgvictoria_deque_iterator_destroy(iter);
+   pgvictoria_deque_destroy(deque);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_sort)
+{
+   struct deque* deque = NULL;
+   struct memory_arena* arena = NULL;
+   char* str = NULL;
+   char tag[16];
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+
+   // Equal tags keep their order
+   for (int i = 0; i < 100; i++)
+   {
+      snprintf(tag, sizeof(tag), "t%d", (i * 7) % 10);
+      pgvictoria_deque_add(deque, tag, (uintptr_t)i, ValueInt32);
+   }
+   pgvictoria_deque_add(deque, NULL, (uintptr_t)-1, ValueInt32);
+   pgvictoria_deque_remove(deque, "t5");
+   pgvictoria_deque_sort(deque);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 91, cleanup);
+
+   for (int t = 0; t < 10; t++)
+   {
+      int previous = -1;
+
+      if (t == 5)
+      {
+         continue;
+      }
+      for (int j = 0; j < 10; j++)
+      {
+         char* polled = NULL;
+         int v = (int)pgvictoria_deque_poll(deque, &polled);
+
+         snprintf(tag, sizeof(tag), "t%d", t);
+         MCTF_ASSERT_STR_EQ(polled, tag, cleanup);
+         MCTF_ASSERT(v > previous, cleanup, "tag %s is out of order", tag);
+         previous = v;
+         free(polled);
+      }
+   }
+   // Entries without a tag go last
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_poll(deque, NULL), -1, cleanup);
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   // Same for a deque in an arena
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(0, &arena), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_arena(arena, false, &deque), 0, cleanup);
+   pgvictoria_deque_add(deque, "work_mem", (uintptr_t)"4MB", ValueString);
+   pgvictoria_deque_add(deque, "fsync", (uintptr_t)"on", ValueString);
+   pgvictoria_deque_add(deque, "max_connections", (uintptr_t)100, ValueInt32);
+   pgvictoria_deque_sort(deque);
+   str = pgvictoria_deque_to_string(deque, FORMAT_JSON_COMPACT, NULL, 0);
+   MCTF_ASSERT_STR_EQ(str, "[fsync:\"on\",max_connections:100,work_mem:\"4MB\"]", cleanup);
+
+cleanup:
+   free(str);
+   if (arena == NULL)
+   {
+      pgvictoria_deque_destroy(deque);
+   }
+   pgvictoria_memory_arena_destroy(arena);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_sorted)
+{
+   struct deque* deque = NULL;
+   struct deque* streams[3] = {NULL, NULL, NULL};
+   struct deque* aliases[2];
+   struct deque* merged = NULL;
+   int expected[] = {1, 4, 2, 5, 6, 7, 3, 9};
+   char* tags[] = {"a", "b", "c", "c", "c", "d", "e", NULL};
+   char* tag = NULL;
+   uint32_t seed = 42;
+   int64_t key;
+
+   // Entries are key * 10000 + sequence, and compare by key only
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+   for (int64_t i = 0; i < 2000; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      key = (seed >> 16) % 50;
+      pgvictoria_deque_add(deque, NULL, (uintptr_t)(key * 10000 + i), ValueInt64);
+   }
+   pgvictoria_deque_sort_by(deque, deque_test_compare_key);
+   MCTF_ASSERT_INT_EQ(deque_test_check_sorted(deque, 2000), 0, cleanup, "sort_by should be stable");
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   // Sorted insertion in random order splits full blocks
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+   for (int64_t i = 0; i < 2000; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      key = (seed >> 16) % 50;
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_add_sorted(deque, NULL, (uintptr_t)(key * 10000 + i), ValueInt64, deque_test_compare_key), 0, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(deque_test_check_sorted(deque, 2000), 0, cleanup, "add_sorted should keep the deque sorted and stable");
+
+   // Polling from the head leaves room in front of the first block
+   pgvictoria_deque_poll(deque, NULL);
+   pgvictoria_deque_poll(deque, NULL);
+   pgvictoria_deque_add_sorted(deque, NULL, (uintptr_t)(int64_t)10000, ValueInt64, deque_test_compare_key);
+   pgvictoria_deque_add_sorted(deque, NULL, (uintptr_t)(int64_t)-10000, ValueInt64, deque_test_compare_key);
+   MCTF_ASSERT_INT_EQ((int)(int64_t)pgvictoria_deque_peek(deque, NULL), -10000, cleanup);
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   // A sorted insertion into a concurrent deque is polled from the blocks
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_concurrent(16, &deque), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_add_sorted(deque, NULL, (uintptr_t)(int64_t)20000, ValueInt64, deque_test_compare_key), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)(int64_t)pgvictoria_deque_poll(deque, NULL), 20000, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 0, cleanup);
+   pgvictoria_deque_add(deque, NULL, (uintptr_t)(int64_t)30000, ValueInt64);
+   pgvictoria_deque_add_sorted(deque, NULL, (uintptr_t)(int64_t)10000, ValueInt64, deque_test_compare_key);
+   MCTF_ASSERT_INT_EQ((int)(int64_t)pgvictoria_deque_poll(deque, NULL), 10000, cleanup);
+   MCTF_ASSERT_INT_EQ((int)(int64_t)pgvictoria_deque_poll(deque, NULL), 30000, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 0, cleanup);
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   // Merge three sorted streams, equal tags keep the order of the streams
+   for (int i = 0; i < 3; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &streams[i]), 0, cleanup);
+   }
+   pgvictoria_deque_add(streams[0], "a", (uintptr_t)1, ValueInt32);
+   pgvictoria_deque_add(streams[0], "c", (uintptr_t)2, ValueInt32);
+   pgvictoria_deque_add(streams[0], "e", (uintptr_t)3, ValueInt32);
+   pgvictoria_deque_add(streams[1], "b", (uintptr_t)4, ValueInt32);
+   pgvictoria_deque_add(streams[1], "c", (uintptr_t)5, ValueInt32);
+   pgvictoria_deque_add(streams[2], "c", (uintptr_t)6, ValueInt32);
+   pgvictoria_deque_add(streams[2], "d", (uintptr_t)7, ValueInt32);
+   pgvictoria_deque_add(streams[0], NULL, (uintptr_t)9, ValueInt32);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_merge(streams, 3, NULL, &merged), 1, cleanup);
+   aliases[0] = streams[1];
+   aliases[1] = streams[1];
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_merge(aliases, 2, deque_test_compare_tag, &merged), 1, cleanup, "a deque passed twice should be rejected");
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(streams[1]), 2, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_merge(streams, 3, deque_test_compare_tag, &merged), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_deque_empty(streams[0]) && pgvictoria_deque_empty(streams[1]) && pgvictoria_deque_empty(streams[2]),
+               cleanup, "merged deques should be left empty");
+
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(merged), 8, cleanup);
+   for (int i = 0; i < 8; i++)
+   {
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_poll(merged, &tag), expected[i], cleanup);
+      MCTF_ASSERT(pgvictoria_compare_string(tag, tags[i]) || (tag == NULL && tags[i] == NULL), cleanup, "wrong tag at %d", i);
+      free(tag);
+      tag = NULL;
+   }
+
+   // The deques can be used again
+   pgvictoria_deque_add(streams[1], "f", (uintptr_t)10, ValueInt32);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_peek(streams[1], NULL), 10, cleanup);
+
+cleanup:
+   free(tag);
+   pgvictoria_deque_destroy(deque);
+   pgvictoria_deque_destroy(merged);
+   for (int i = 0; i < 3; i++)
+   {
+      pgvictoria_deque_destroy(streams[i]);
+   }
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_inline_strings)
+{
+   struct deque* deque = NULL;
+   struct deque* streams[2] = {NULL, NULL};
+   struct deque* merged = NULL;
+   struct deque_iterator* iter = NULL;
+   char* polled = NULL;
+   char* tag = NULL;
+   char key[16];
+   char str[64];
+   uint32_t seed = 7;
+   int k;
+
+   // Short strings live in the entries, which sorted insertion moves around
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+   for (int i = 0; i < 1000; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      k = (seed >> 16) % 100000;
+      snprintf(key, sizeof(key), "k%05d", k);
+      deque_test_string(k, str, sizeof(str));
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_add_sorted(deque, key, (uintptr_t)str, ValueString, deque_test_compare_tag), 0, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(deque_test_check_strings(deque, 1000), 0, cleanup, "strings should follow their entries");
+
+   // Removing shifts the entries after it
+   pgvictoria_deque_iterator_create(deque, &iter);
+   for (int i = 0; pgvictoria_deque_iterator_next(iter); i++)
+   {
+      if (i % 3 == 0)
+      {
+         pgvictoria_deque_iterator_remove(iter);
+      }
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+   iter = NULL;
+   MCTF_ASSERT_INT_EQ(deque_test_check_strings(deque, 666), 0, cleanup, "strings should survive removal");
+
+   // Long strings move to the end
+   pgvictoria_deque_sort_by(deque, deque_test_compare_length);
+   MCTF_ASSERT_INT_EQ(deque_test_check_strings(deque, 666), 0, cleanup, "strings should survive sorting");
+
+   // The caller owns what is polled, also when it was stored inline
+   polled = (char*)pgvictoria_deque_poll(deque, &tag);
+   deque_test_string(atoi(tag + 1), str, sizeof(str));
+   MCTF_ASSERT_STR_EQ(polled, str, cleanup);
+   free(polled);
+   polled = NULL;
+   free(tag);
+   tag = NULL;
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   // Merged entries are copied into the new deque
+   for (int i = 0; i < 2; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &streams[i]), 0, cleanup);
+      for (int j = i; j < 600; j += 2)
+      {
+         snprintf(key, sizeof(key), "k%05d", j);
+         deque_test_string(j, str, sizeof(str));
+         pgvictoria_deque_add(streams[i], key, (uintptr_t)str, ValueString);
+      }
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_merge(streams, 2, deque_test_compare_tag, &merged), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(deque_test_check_strings(merged, 600), 0, cleanup, "strings should survive merging");
+
+   // The concurrent mode hands entries over from its ring
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_concurrent(128, &deque), 0, cleanup);
+   for (int i = 0; i < 100; i++)
+   {
+      snprintf(key, sizeof(key), "k%05d", i);
+      deque_test_string(i, str, sizeof(str));
+      pgvictoria_deque_add(deque, key, (uintptr_t)str, ValueString);
+   }
+   MCTF_ASSERT_INT_EQ(deque_test_check_strings(deque, 100), 0, cleanup, "strings should survive the ring");
+   polled = (char*)pgvictoria_deque_poll(deque, NULL);
+   MCTF_ASSERT_STR_EQ(polled, "v0", cleanup);
+
+cleanup:
+   free(polled);
+   free(tag);
+   pgvictoria_deque_iterator_destroy(iter);
+   pgvictoria_deque_destroy(deque);
+   pgvictoria_deque_destroy(merged);
+   for (int i = 0; i < 2; i++)
+   {
+      pgvictoria_deque_destroy(streams[i]);
+   }
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_deque_throughput, 60)
+{
+   struct deque* deque = NULL;
+   struct deque_iterator* iter = NULL;
+   struct timespec start;
+   double add = 0.0;
+   double iterate = 0.0;
+   double poll = 0.0;
+   int64_t sum = 0;
+
+   for (int r = 0; r < DEQUE_TEST_ROUNDS; r++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &deque), 0, cleanup);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int64_t i = 0; i < DEQUE_TEST_ENTRIES; i++)
+      {
+         pgvictoria_deque_add(deque, NULL, (uintptr_t)i, ValueInt64);
+      }
+      add += pgvictoria_test_elapsed(&start);
+
+      sum = 0;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      pgvictoria_deque_iterator_create(deque, &iter);
+      while (pgvictoria_deque_iterator_next(iter))
+      {
+         sum += (int64_t)pgvictoria_value_data(iter->value);
+      }
+      pgvictoria_deque_iterator_destroy(iter);
+      iter = NULL;
+      iterate += pgvictoria_test_elapsed(&start);
+      MCTF_ASSERT((sum == (int64_t)DEQUE_TEST_ENTRIES * (DEQUE_TEST_ENTRIES - 1) / 2), cleanup, "wrong sum of entries");
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      while (!pgvictoria_deque_empty(deque))
+      {
+         pgvictoria_deque_poll(deque, NULL);
+      }
+      poll += pgvictoria_test_elapsed(&start);
+
+      pgvictoria_deque_destroy(deque);
+      deque = NULL;
+   }
+
+   pgvictoria_log_info("deque: %d entries: add %.3fms iterate %.3fms poll %.3fms",
+                       DEQUE_TEST_ENTRIES,
+                       add * 1000.0 / DEQUE_TEST_ROUNDS, iterate * 1000.0 / DEQUE_TEST_ROUNDS, poll * 1000.0 / DEQUE_TEST_ROUNDS);
+
+cleanup:
+   pgvictoria_deque_iterator_destroy(iter);
+   pgvictoria_deque_destroy(deque);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_deque_merge_throughput, 60)
+{
+   struct deque* streams[8];
+   struct deque* all = NULL;
+   struct deque* merged = NULL;
+   struct timespec start;
+   double sorted = 0.0;
+   double merge = 0.0;
+   double inserted = 0.0;
+   double resorted = 0.0;
+   int per = DEQUE_TEST_ENTRIES / 8;
+
+   memset(streams, 0, sizeof(streams));
+
+   for (int r = 0; r < DEQUE_TEST_ROUNDS; r++)
+   {
+      // Eight sorted streams, as collected from eight servers
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &all), 0, cleanup);
+      for (int s = 0; s < 8; s++)
+      {
+         MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &streams[s]), 0, cleanup);
+         for (int64_t i = 0; i < per; i++)
+         {
+            pgvictoria_deque_add(streams[s], NULL, (uintptr_t)((i * 8 + s) * 10000), ValueInt64);
+            pgvictoria_deque_add(all, NULL, (uintptr_t)((i * 8 + s) * 10000), ValueInt64);
+         }
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      pgvictoria_deque_sort_by(all, deque_test_compare_key);
+      sorted += pgvictoria_test_elapsed(&start);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_merge(streams, 8, deque_test_compare_key, &merged), 0, cleanup);
+      merge += pgvictoria_test_elapsed(&start);
+      MCTF_ASSERT_INT_EQ(deque_test_check_sorted(merged, 8 * per), 0, cleanup);
+
+      pgvictoria_deque_destroy(all);
+      pgvictoria_deque_destroy(merged);
+      all = NULL;
+      merged = NULL;
+      for (int s = 0; s < 8; s++)
+      {
+         pgvictoria_deque_destroy(streams[s]);
+         streams[s] = NULL;
+      }
+
+      // Nearly sorted input, every 16th entry arrives 100 places late
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &all), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &merged), 0, cleanup);
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int64_t i = 0; i < DEQUE_TEST_ENTRIES; i++)
+      {
+         int64_t key = i % 16 == 0 && i >= 100 ? i - 100 : i;
+
+         pgvictoria_deque_add_sorted(merged, NULL, (uintptr_t)(key * 10000), ValueInt64, deque_test_compare_key);
+      }
+      inserted += pgvictoria_test_elapsed(&start);
+      MCTF_ASSERT_INT_EQ(deque_test_check_sorted(merged, DEQUE_TEST_ENTRIES), 0, cleanup);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int64_t i = 0; i < DEQUE_TEST_ENTRIES; i++)
+      {
+         int64_t key = i % 16 == 0 && i >= 100 ? i - 100 : i;
+
+         pgvictoria_deque_add(all, NULL, (uintptr_t)(key * 10000), ValueInt64);
+      }
+      pgvictoria_deque_sort_by(all, deque_test_compare_key);
+      resorted += pgvictoria_test_elapsed(&start);
+
+      pgvictoria_deque_destroy(all);
+      pgvictoria_deque_destroy(merged);
+      all = NULL;
+      merged = NULL;
+   }
+
+   pgvictoria_log_info("deque: 8 sorted streams of %d entries: sort %.3fms, merge %.3fms", per,
+                       sorted * 1000.0 / DEQUE_TEST_ROUNDS, merge * 1000.0 / DEQUE_TEST_ROUNDS);
+   pgvictoria_log_info("deque: %d nearly sorted entries: add and sort %.3fms, add_sorted %.3fms", DEQUE_TEST_ENTRIES,
+                       resorted * 1000.0 / DEQUE_TEST_ROUNDS, inserted * 1000.0 / DEQUE_TEST_ROUNDS);
+
+cleanup:
+   pgvictoria_deque_destroy(all);
+   pgvictoria_deque_destroy(merged);
+   for (int s = 0; s < 8; s++)
+   {
+      pgvictoria_deque_destroy(streams[s]);
+   }
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_deque_concurrent)
+{
+   struct deque* deque = NULL;
+   struct deque_iterator* iter = NULL;
+   char* tag = NULL;
+   char* data = NULL;
+   double seconds = 0.0;
+   int n = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_concurrent(5, &deque), 0, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(deque->ring, cleanup);
+   MCTF_ASSERT_INT_EQ((int)deque->ring->mask, 7, cleanup);
+
+   // The queue is bounded
+   for (int i = 1; i <= 8; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_add(deque, NULL, (uintptr_t)i, ValueInt32), 0, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_add(deque, NULL, (uintptr_t)9, ValueInt32), 1, cleanup);
+   // A copy made for an add that does not fit is released again
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_add(deque, "full", (uintptr_t)"a string too long to be kept inline", ValueString), 1, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 8, cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_poll(deque, NULL), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_add(deque, NULL, (uintptr_t)9, ValueInt32), 0, cleanup);
+
+   // Other operations move the queued entries to the blocks, and poll keeps the order
+   pgvictoria_deque_iterator_create(deque, &iter);
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_value_data(iter->value), n + 2, cleanup);
+      n++;
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+   iter = NULL;
+   MCTF_ASSERT_INT_EQ(n, 8, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_add(deque, "tag", (uintptr_t)"value", ValueString), 0, cleanup);
+   for (int i = 2; i <= 9; i++)
+   {
+      MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_poll(deque, NULL), i, cleanup);
+   }
+   data = (char*)pgvictoria_deque_poll(deque, &tag);
+   MCTF_ASSERT_STR_EQ(tag, "tag", cleanup);
+   MCTF_ASSERT_STR_EQ(data, "value", cleanup);
+   MCTF_ASSERT(pgvictoria_deque_empty(deque), cleanup, "deque should be empty");
+
+   // Entries left in the queue are released with the deque
+   pgvictoria_deque_add(deque, "left", (uintptr_t)"over", ValueString);
+   pgvictoria_deque_destroy(deque);
+   deque = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_concurrent(1024, &deque), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(deque_test_contention(deque, 8, &seconds), 0, cleanup, "every value should be polled once");
+
+cleanup:
+   free(tag);
+   free(data);
+   pgvictoria_deque_iterator_destroy(iter);
+   pgvictoria_deque_destroy(deque);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_deque_contention, 60)
+{
+   struct deque* deque = NULL;
+   int threads[] = {2, 4, 8, 16, 32, 64};
+   double locked = 0.0;
+   double lock_free = 0.0;
+
+   for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(true, &deque), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(deque_test_contention(deque, threads[i], &locked), 0, cleanup);
+      pgvictoria_deque_destroy(deque);
+      deque = NULL;
+
+      MCTF_ASSERT_INT_EQ(pgvictoria_deque_create_concurrent(4096, &deque), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(deque_test_contention(deque, threads[i], &lock_free), 0, cleanup);
+      pgvictoria_deque_destroy(deque);
+      deque = NULL;
+
+      pgvictoria_log_info("deque: %d threads, %d values: rwlock %.3fs %.0f values/s, lock-free %.3fs %.0f values/s",
+                          threads[i], DEQUE_TEST_ITEMS,
+                          locked, locked > 0.0 ? DEQUE_TEST_ITEMS / locked : 0.0,
+                          lock_free, lock_free > 0.0 ? DEQUE_TEST_ITEMS / lock_free : 0.0);
+   }
+
+cleanup:
+   pgvictoria_deque_destroy(deque);
+   MCTF_FINISH();
+}
+
+/*
+ * Run half of the threads as producers adding DEQUE_TEST_ITEMS values and
+ * the other half as consumers polling them, then check every value arrived once.
+ */
+static int
+deque_test_contention(struct deque* deque, int threads, double* seconds)
+{
+   pthread_t tids[64];
+   struct deque_test_worker workers[64];
+   atomic_int polled;
+   atomic_llong sum;
+   struct timespec start;
+   int producers = threads / 2;
+   int ret = 0;
+
+   *seconds = 0.0;
+
+   if (threads < 2 || threads > 64)
+   {
+      return 1;
+   }
+
+   atomic_init(&polled, 0);
+   atomic_init(&sum, 0);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for (int t = 0; t < threads; t++)
+   {
+      workers[t].deque = deque;
+      workers[t].polled = &polled;
+      workers[t].sum = &sum;
+      workers[t].total = DEQUE_TEST_ITEMS;
+      if (t < producers)
+      {
+         workers[t].first = 1 + t * (DEQUE_TEST_ITEMS / producers);
+         workers[t].count = t == producers - 1 ? DEQUE_TEST_ITEMS - t * (DEQUE_TEST_ITEMS / producers) : DEQUE_TEST_ITEMS / producers;
+      }
+      else
+      {
+         workers[t].first = 0;
+         workers[t].count = 0;
+      }
+      pthread_create(&tids[t], NULL, t < producers ? deque_test_produce : deque_test_consume, &workers[t]);
+   }
+
+   for (int t = 0; t < threads; t++)
+   {
+      pthread_join(tids[t], NULL);
+   }
+
+   *seconds = pgvictoria_test_elapsed(&start);
+
+   if (atomic_load(&polled) != DEQUE_TEST_ITEMS ||
+       atomic_load(&sum) != (long long)DEQUE_TEST_ITEMS * (DEQUE_TEST_ITEMS + 1) / 2 ||
+       !pgvictoria_deque_empty(deque))
+   {
+      ret = 1;
+   }
+
+   return ret;
+}
+
+static void*
+deque_test_produce(void* arg)
+{
+   struct deque_test_worker* worker = (struct deque_test_worker*)arg;
+
+   for (int i = worker->first; i < worker->first + worker->count; i++)
+   {
+      while (pgvictoria_deque_add(worker->deque, NULL, (uintptr_t)i, ValueInt32))
+      {
+         sched_yield();
+      }
+   }
+
+   return NULL;
+}
+
+static void*
+deque_test_consume(void* arg)
+{
+   struct deque_test_worker* worker = (struct deque_test_worker*)arg;
+   int v;
+
+   while (atomic_load(worker->polled) < worker->total)
+   {
+      v = (int)pgvictoria_deque_poll(worker->deque, NULL);
+      if (v == 0)
+      {
+         sched_yield();
+         continue;
+      }
+      atomic_fetch_add(worker->sum, v);
+      atomic_fetch_add(worker->polled, 1);
+   }
+
+   return NULL;
+}
+
+static int
+deque_test_compare_key(struct deque_entry* e1, struct deque_entry* e2)
+{
+   int64_t k1 = (int64_t)e1->value.data / 10000;
+   int64_t k2 = (int64_t)e2->value.data / 10000;
+
+   return k1 < k2 ? -1 : (k1 > k2 ? 1 : 0);
+}
+
+static int
+deque_test_compare_tag(struct deque_entry* e1, struct deque_entry* e2)
+{
+   if (e1->tag == NULL || e2->tag == NULL)
+   {
+      return (e1->tag == NULL) - (e2->tag == NULL);
+   }
+   return strcmp(e1->tag, e2->tag);
+}
+
+static int
+deque_test_compare_length(struct deque_entry* e1, struct deque_entry* e2)
+{
+   size_t l1 = strlen((char*)e1->value.data);
+   size_t l2 = strlen((char*)e2->value.data);
+
+   return l1 < l2 ? -1 : (l1 > l2 ? 1 : 0);
+}
+
+/*
+ * Check the deque holds the expected number of entries by key, and in the
+ * order they were added within a key.
+ */
+static int
+deque_test_check_sorted(struct deque* deque, int expected)
+{
+   struct deque_iterator* iter = NULL;
+   int64_t previous = INT64_MIN;
+   int64_t v;
+   int n = 0;
+   int ret = 0;
+
+   pgvictoria_deque_iterator_create(deque, &iter);
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      v = (int64_t)pgvictoria_value_data(iter->value);
+      if (v / 10000 < previous / 10000 || (v / 10000 == previous / 10000 && v < previous))
+      {
+         ret = 1;
+      }
+      previous = v;
+      n++;
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+
+   return n == expected ? ret : 1;
+}
+
+/*
+ * Every fifth key gets a string too long to be stored inline.
+ */
+static void
+deque_test_string(int key, char* str, size_t size)
+{
+   if (key % 5 == 0 && key > 0)
+   {
+      snprintf(str, size, "a value too long to inline %d", key);
+   }
+   else
+   {
+      snprintf(str, size, "v%d", key);
+   }
+}
+
+/*
+ * Check every entry holds the string of its tag, and short strings are inline.
+ */
+static int
+deque_test_check_strings(struct deque* deque, int expected)
+{
+   struct deque_iterator* iter = NULL;
+   char str[64];
+   int n = 0;
+   int ret = 0;
+
+   pgvictoria_deque_iterator_create(deque, &iter);
+   while (pgvictoria_deque_iterator_next(iter))
+   {
+      deque_test_string(atoi(iter->tag + 1), str, sizeof(str));
+      if (strcmp((char*)pgvictoria_value_data(iter->value), str) != 0 ||
+          iter->value->inlined != (strlen(str) < VALUE_INLINE_SIZE))
+      {
+         ret = 1;
+      }
+      n++;
+   }
+   pgvictoria_deque_iterator_destroy(iter);
+
+   return n == expected ? ret : 1;
+}
@@ -30,8 +30,11 @@
 #include <mctf.h>
 #include <tscommon.h>
 #include <guc.h>
+#include <json.h>
+#include <postgresql.h>
 #include <value.h>
 #include <stdbool.h>
+#include <strings.h>
 
 MCTF_TEST_SETUP(guc)
 {
@@ -190,3 +193,62 @@ MCTF_TEST(test_guc_numeric_different)
 cleanup:
    MCTF_FINISH();
 }
+
+/* Interning: every baseline setting has a dense id, in name order. */
+MCTF_TEST(test_guc_intern)
+{
+   struct json* baseline = NULL;
+   struct json_iterator* iter = NULL;
+   bool modified = true;
+   int number_of_names;
+   int id;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_guc_intern_init(), 0, cleanup);
+   number_of_names = pgvictoria_guc_number_of_names();
+   MCTF_ASSERT(number_of_names > 300, cleanup, "only %d names", number_of_names);
+
+   for (int i = 0; i < number_of_names; i++)
+   {
+      MCTF_ASSERT_PTR_NONNULL(pgvictoria_guc_name(i), cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_guc_id(pgvictoria_guc_name(i)), i, cleanup);
+      MCTF_ASSERT(i == 0 || strcasecmp(pgvictoria_guc_name(i - 1), pgvictoria_guc_name(i)) < 0, cleanup,
+                  "%s is out of order", pgvictoria_guc_name(i));
+   }
+   MCTF_ASSERT_PTR_NULL(pgvictoria_guc_name(-1), cleanup);
+   MCTF_ASSERT_PTR_NULL(pgvictoria_guc_name(number_of_names), cleanup);
+
+   /* Names match regardless of case and keep the spelling of the baseline */
+   id = pgvictoria_guc_id("DATESTYLE");
+   MCTF_ASSERT(id != GUC_UNKNOWN, cleanup, "DATESTYLE is unknown");
+   MCTF_ASSERT_INT_EQ(pgvictoria_guc_id("datestyle"), id, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_guc_name(id), "DateStyle", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_guc_id("pgvictoria.custom_setting"), GUC_UNKNOWN, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_guc_id(NULL), GUC_UNKNOWN, cleanup);
+
+   /* Every setting of every baseline is interned */
+   for (int version = pgvictoria_get_min_supported_version(); version <= pgvictoria_get_max_supported_version(); version++)
+   {
+      baseline = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_iterator_create(baseline, &iter), 0, cleanup);
+      while (pgvictoria_json_iterator_next(iter))
+      {
+         MCTF_ASSERT(pgvictoria_guc_id(iter->key) != GUC_UNKNOWN, cleanup, "pg%d: %s is unknown", version, iter->key);
+      }
+      pgvictoria_json_iterator_destroy(iter);
+      iter = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+   /* A resolved setting keeps its comparator */
+   MCTF_ASSERT_INT_EQ(pgvictoria_check_guc_id(pgvictoria_guc_id("lc_time"), ValueString, "en_US.utf8", "en_US.UTF-8", &modified), 0, cleanup);
+   MCTF_ASSERT(!modified, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_check_guc_id(GUC_UNKNOWN, ValueString, "en_US.utf8", "en_US.UTF-8", &modified), 0, cleanup);
+   MCTF_ASSERT(modified, cleanup);
+
+cleanup:
+   pgvictoria_json_iterator_destroy(iter);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
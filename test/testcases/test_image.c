@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <pgvictoria.h>
+#include <art.h>
+#include <deque.h>
+#include <image.h>
+#include <json.h>
+#include <logging.h>
+#include <mctf.h>
+#include <postgresql.h>
+#include <security.h>
+#include <tscommon.h>
+#include <utils.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define IMAGE_TEST_LOADS 100
+
+static int image_test_lookup(struct image* image, struct json* baseline, bool upper);
+
+MCTF_TEST_SETUP(image)
+{
+   pgvictoria_test_setup();
+}
+
+MCTF_TEST_TEARDOWN(image)
+{
+   pgvictoria_test_teardown();
+}
+
+MCTF_TEST(test_image_round_trip)
+{
+   struct json* baseline = NULL;
+   struct json* loaded = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   void* data = NULL;
+   size_t size = 0;
+   uintptr_t out = 0;
+   char* expected = NULL;
+   char* actual = NULL;
+   enum value_type type;
+
+   for (int version = 14; version <= 19; version++)
+   {
+      baseline = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueJSON, (uintptr_t)baseline, &data, &size), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(root.type, ValueJSON, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_load(image, &root, &out), 0, cleanup);
+      loaded = (struct json*)out;
+
+      expected = pgvictoria_json_to_string(baseline, FORMAT_JSON, NULL, 0);
+      actual = pgvictoria_json_to_string(loaded, FORMAT_JSON, NULL, 0);
+      MCTF_ASSERT_PTR_NONNULL(expected, cleanup);
+      MCTF_ASSERT_PTR_NONNULL(actual, cleanup);
+      MCTF_ASSERT_STR_EQ(actual, expected, cleanup, "pg%d: the loaded baseline should be the same", version);
+
+      /* The loaded object keeps matching keys regardless of case */
+      MCTF_ASSERT(pgvictoria_json_get_typed(loaded, "WORK_MEM", &type) != 0, cleanup, "pg%d: WORK_MEM", version);
+
+      pgvictoria_log_info("image: pg%d baseline, %zu bytes", version, size);
+
+      free(expected);
+      expected = NULL;
+      free(actual);
+      actual = NULL;
+      pgvictoria_json_destroy(loaded);
+      loaded = NULL;
+      pgvictoria_image_close(image);
+      image = NULL;
+      free(data);
+      data = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+cleanup:
+   free(expected);
+   free(actual);
+   pgvictoria_json_destroy(loaded);
+   pgvictoria_image_close(image);
+   free(data);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_image_lookup)
+{
+   struct json* baseline = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   struct image_value value;
+   void* data = NULL;
+   size_t size = 0;
+   char* key = NULL;
+   char* previous = NULL;
+
+   baseline = pgvictoria_get_baseline(18);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueJSON, (uintptr_t)baseline, &data, &size), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+
+   /* Every key is found in place, with the value of the object, in any case */
+   MCTF_ASSERT_INT_EQ(image_test_lookup(image, baseline, false), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(image_test_lookup(image, baseline, true), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "no_such_setting", &value), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "", &value), 1, cleanup);
+
+   /* Entries are in key order and keep their spelling */
+   for (uint32_t i = 0; i < root.length; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_at(image, &root, i, &key, &value), 0, cleanup);
+      MCTF_ASSERT_PTR_NONNULL(key, cleanup);
+      MCTF_ASSERT(previous == NULL || strcasecmp(previous, key) < 0, cleanup, "%s before %s", previous, key);
+      previous = key;
+   }
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_at(image, &root, root.length, &key, &value), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "DateStyle", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "datestyle", &value), 0, cleanup);
+
+cleanup:
+   pgvictoria_image_close(image);
+   free(data);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_image_types)
+{
+   struct art* t = NULL;
+   struct art* nested = NULL;
+   struct deque* deque = NULL;
+   struct json* array = NULL;
+   struct art* loaded = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   struct image_value value;
+   struct image_value item;
+   void* data = NULL;
+   size_t size = 0;
+   uintptr_t out = 0;
+   char* key = NULL;
+   char* expected = NULL;
+   char* actual = NULL;
+
+   pgvictoria_art_create(&t);
+   pgvictoria_art_create(&nested);
+   pgvictoria_deque_create(false, &deque);
+   pgvictoria_json_create(&array);
+
+   pgvictoria_art_insert(t, "int8", (uintptr_t)-8, ValueInt8);
+   pgvictoria_art_insert(t, "int64", (uintptr_t)INT64_MIN, ValueInt64);
+   pgvictoria_art_insert(t, "uint64", (uintptr_t)UINT64_MAX, ValueUInt64);
+   pgvictoria_art_insert(t, "bool", (uintptr_t)true, ValueBool);
+   pgvictoria_art_insert(t, "char", (uintptr_t)'c', ValueChar);
+   pgvictoria_art_insert(t, "double", pgvictoria_value_from_double(2.5), ValueDouble);
+   pgvictoria_art_insert(t, "float", pgvictoria_value_from_float(0.25f), ValueFloat);
+   pgvictoria_art_insert(t, "short", (uintptr_t)"on", ValueString);
+   pgvictoria_art_insert(t, "long", (uintptr_t)"a value too long to be inlined", ValueString);
+   pgvictoria_art_insert(t, "ref", (uintptr_t)"referenced", ValueStringRef);
+   pgvictoria_art_insert(t, "null", (uintptr_t)NULL, ValueString);
+
+   pgvictoria_art_insert(nested, "inner", (uintptr_t)42, ValueInt32);
+   pgvictoria_art_insert(t, "tree", (uintptr_t)nested, ValueART);
+   nested = NULL;
+
+   pgvictoria_deque_add(deque, "a", (uintptr_t)1, ValueInt32);
+   pgvictoria_deque_add(deque, "b", (uintptr_t)"two", ValueString);
+   pgvictoria_deque_add(deque, "a", (uintptr_t)3, ValueInt32);
+   pgvictoria_deque_add(deque, NULL, (uintptr_t)4, ValueInt32);
+   pgvictoria_art_insert(t, "deque", (uintptr_t)deque, ValueDeque);
+   deque = NULL;
+
+   pgvictoria_json_append(array, (uintptr_t)"x", ValueString);
+   pgvictoria_json_append(array, (uintptr_t)7, ValueInt32);
+   pgvictoria_art_insert(t, "array", (uintptr_t)array, ValueJSON);
+   array = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueART, (uintptr_t)t, &data, &size), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(root.type, ValueART, cleanup);
+   MCTF_ASSERT_INT_EQ((int)root.length, (int)t->size, cleanup);
+
+   /* Values are read in place */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "int8", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int8_t)value.data, -8, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "int64", &value), 0, cleanup);
+   MCTF_ASSERT((int64_t)value.data == INT64_MIN, cleanup, "int64");
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "double", &value), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_value_to_double(value.data) == 2.5, cleanup, "double");
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "long", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(value.type, ValueString, cleanup);
+   MCTF_ASSERT_STR_EQ((char*)value.data, "a value too long to be inlined", cleanup);
+   MCTF_ASSERT_INT_EQ((int)value.length, (int)strlen("a value too long to be inlined"), cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "ref", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(value.type, ValueString, cleanup, "references are stored as the data they point to");
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "null", &value), 0, cleanup);
+   MCTF_ASSERT(value.data == 0, cleanup, "a NULL string should stay NULL");
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "INT8", &value), 1, cleanup, "a tree is case-sensitive");
+
+   /* Nested containers */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "tree", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(value.type, ValueART, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &value, "inner", &item), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)item.data, 42, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "deque", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(value.type, ValueDeque, cleanup);
+   MCTF_ASSERT_INT_EQ((int)value.length, 4, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &value, "a", &item), 0, cleanup);
+   MCTF_ASSERT_INT_EQ((int)item.data, 1, cleanup, "the first entry with a tag wins");
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_at(image, &value, 3, &key, &item), 0, cleanup);
+   MCTF_ASSERT_PTR_NULL(key, cleanup);
+   MCTF_ASSERT_INT_EQ((int)item.data, 4, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "array", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(value.type, ValueJSON, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_at(image, &value, 0, NULL, &item), 0, cleanup);
+   MCTF_ASSERT_STR_EQ((char*)item.data, "x", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &value, "x", &item), 1, cleanup, "an array has no keys");
+
+   /* A value that is not a container is rejected as one */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "short", &value), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &value, "x", &item), 1, cleanup);
+
+   /* Loading gives the same tree */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_load(image, &root, &out), 0, cleanup);
+   loaded = (struct art*)out;
+   expected = pgvictoria_art_to_string(t, FORMAT_JSON, NULL, 0);
+   actual = pgvictoria_art_to_string(loaded, FORMAT_JSON, NULL, 0);
+   MCTF_ASSERT_PTR_NONNULL(expected, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(actual, cleanup);
+   MCTF_ASSERT_STR_EQ(actual, expected, cleanup);
+
+   /* Memory can not be written */
+   free(data);
+   data = NULL;
+   pgvictoria_art_insert(t, "mem", (uintptr_t)malloc(16), ValueMem);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueART, (uintptr_t)t, &data, &size), 1, cleanup);
+   MCTF_ASSERT_PTR_NULL(data, cleanup);
+
+cleanup:
+   free(expected);
+   free(actual);
+   pgvictoria_art_destroy(loaded);
+   pgvictoria_image_close(image);
+   free(data);
+   pgvictoria_json_destroy(array);
+   pgvictoria_deque_destroy(deque);
+   pgvictoria_art_destroy(nested);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_image_verify)
+{
+   struct json* baseline = NULL;
+   struct image* image = NULL;
+   char* data = NULL;
+   size_t size = 0;
+
+   baseline = pgvictoria_get_baseline(17);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueJSON, (uintptr_t)baseline, (void**)&data, &size), 0, cleanup);
+
+   /* A changed byte fails the checksum */
+   data[size / 2] ^= 0x20;
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 1, cleanup);
+   data[size / 2] ^= 0x20;
+
+   /* So does a bad header */
+   data[0] = 'X';
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 1, cleanup);
+   data[0] = 'P';
+
+   /* And a truncated image */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size - 8, &image), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, 16, &image), 1, cleanup);
+   MCTF_ASSERT_PTR_NULL(image, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+
+cleanup:
+   pgvictoria_image_close(image);
+   free(data);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_image_nesting)
+{
+   struct art* t = NULL;
+   struct art* nested = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   struct image_value value;
+   char* data = NULL;
+   size_t size = 0;
+   uintptr_t out = 0;
+   uint64_t child;
+   uint64_t parent;
+   uint32_t crc = 0;
+   bool patched = false;
+
+   /* A tree nested deeper than a load follows */
+   pgvictoria_art_create(&t);
+   for (int i = 0; i < 100; i++)
+   {
+      pgvictoria_art_create(&nested);
+      pgvictoria_art_insert(nested, "child", (uintptr_t)t, ValueART);
+      t = nested;
+      nested = NULL;
+   }
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueART, (uintptr_t)t, (void**)&data, &size), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_load(image, &root, &out), 1, cleanup, "the nesting should be too deep");
+   MCTF_ASSERT(out == 0, cleanup, "a failed load should give nothing");
+
+   pgvictoria_image_close(image);
+   image = NULL;
+   free(data);
+   data = NULL;
+   pgvictoria_art_destroy(t);
+
+   /* A reference back to the root is a cycle */
+   pgvictoria_art_create(&t);
+   pgvictoria_art_create(&nested);
+   pgvictoria_art_insert(nested, "inner", (uintptr_t)42, ValueInt32);
+   pgvictoria_art_insert(t, "tree", (uintptr_t)nested, ValueART);
+   nested = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_create(ValueART, (uintptr_t)t, (void**)&data, &size), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "tree", &value), 0, cleanup);
+   pgvictoria_image_close(image);
+   image = NULL;
+
+   child = value.offset;
+   parent = root.offset;
+   for (uint64_t offset = parent; offset + sizeof(uint64_t) <= child; offset += sizeof(uint64_t))
+   {
+      if (memcmp(data + offset, &child, sizeof(uint64_t)) == 0)
+      {
+         memcpy(data + offset, &parent, sizeof(uint64_t));
+         patched = true;
+      }
+   }
+   MCTF_ASSERT(patched, cleanup, "the reference to the nested tree is missing");
+
+   /* The checksum follows the magic, the version, the order and the size */
+   pgvictoria_init_crc32c(&crc);
+   pgvictoria_create_crc32c_buffer(data + 32, size - 32, &crc);
+   pgvictoria_finalize_crc32c(&crc);
+   memcpy(data + 24, &crc, sizeof(uint32_t));
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_attach(data, size, &image), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_load(image, &root, &out), 1, cleanup, "a cycle should not load");
+
+cleanup:
+   pgvictoria_image_close(image);
+   free(data);
+   pgvictoria_art_destroy(nested);
+   pgvictoria_art_destroy(t);
+   MCTF_FINISH();
+}
+
+MCTF_TEST_MAX(test_image_file_shared, 60)
+{
+   struct json* baseline = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   struct image_value value;
+   char path[MAX_PATH];
+   pid_t pid;
+   int status = 0;
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/image_pg18.img", TEST_BASE_DIR);
+
+   baseline = pgvictoria_get_baseline(18);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_write_file(path, ValueJSON, (uintptr_t)baseline), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_open(path, &image), 0, cleanup);
+   MCTF_ASSERT(image->mapped, cleanup, "a file should be mapped");
+   MCTF_ASSERT_INT_EQ(image_test_lookup(image, baseline, false), 0, cleanup);
+
+   /* A forked worker reads the same pages without loading anything */
+   pid = fork();
+   MCTF_ASSERT(pid != -1, cleanup, "fork");
+   if (pid == 0)
+   {
+      _exit(image_test_lookup(image, baseline, true));
+   }
+   waitpid(pid, &status, 0);
+   MCTF_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, cleanup, "the child should find every key");
+
+   /* Replacing the file leaves the mapping of the old one intact */
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_write_file(path, ValueJSON, (uintptr_t)baseline), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "shared_buffers", &value), 0, cleanup);
+   pgvictoria_image_close(image);
+   image = NULL;
+
+cleanup:
+   unlink(path);
+   pgvictoria_image_close(image);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_image_open_throughput, 60)
+{
+   struct json* baseline = NULL;
+   struct json* parsed = NULL;
+   struct image* image = NULL;
+   struct image_value root;
+   struct image_value value;
+   struct timespec start;
+   char path[MAX_PATH];
+   double parse;
+   double open;
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/image_pg18.img", TEST_BASE_DIR);
+
+   baseline = pgvictoria_get_baseline(18);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_image_write_file(path, ValueJSON, (uintptr_t)baseline), 0, cleanup);
+
+   /* Opening an image is checked, a parse is not needed */
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < IMAGE_TEST_LOADS; i++)
+   {
+      parsed = pgvictoria_get_baseline(18);
+      MCTF_ASSERT_PTR_NONNULL(parsed, cleanup);
+      pgvictoria_json_destroy(parsed);
+      parsed = NULL;
+   }
+   parse = pgvictoria_test_elapsed(&start);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < IMAGE_TEST_LOADS; i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_open(path, &image), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_root(image, &root), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_image_get(image, &root, "work_mem", &value), 0, cleanup);
+      pgvictoria_image_close(image);
+      image = NULL;
+   }
+   open = pgvictoria_test_elapsed(&start);
+
+   pgvictoria_log_info("image: pg18 baseline, parse %.3fms, open %.3fms",
+                       parse * 1000.0 / IMAGE_TEST_LOADS, open * 1000.0 / IMAGE_TEST_LOADS);
+
+cleanup:
+   unlink(path);
+   pgvictoria_image_close(image);
+   pgvictoria_json_destroy(parsed);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+static int
+image_test_lookup(struct image* image, struct json* baseline, bool upper)
+{
+   struct json_iterator* iter = NULL;
+   struct image_value root;
+   struct image_value value;
+   char key[128];
+   int ret = 1;
+
+   if (pgvictoria_image_root(image, &root) || pgvictoria_json_iterator_create(baseline, &iter))
+   {
+      goto done;
+   }
+
+   while (pgvictoria_json_iterator_next(iter))
+   {
+      pgvictoria_snprintf(key, sizeof(key), "%s", iter->key);
+      for (char* c = key; upper && *c != '\0'; c++)
+      {
+         *c = toupper((unsigned char)*c);
+      }
+
+      if (pgvictoria_image_get(image, &root, key, &value) || value.type != iter->value->type)
+      {
+         goto done;
+      }
+      if (value.type == ValueString && !pgvictoria_compare_string((char*)value.data, (char*)iter->value->data))
+      {
+         goto done;
+      }
+      if (value.type != ValueString && value.type != ValueJSON && value.data != iter->value->data)
+      {
+         goto done;
+      }
+   }
+
+   ret = 0;
+
+done:
+   pgvictoria_json_iterator_destroy(iter);
+   return ret;
+}
@@ -0,0 +1,663 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <json.h>
+#include <logging.h>
+#include <mctf.h>
+#include <postgresql.h>
+#include <tscommon.h>
+#include <utils.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define JSON_TEST_PARSES 200
+#define JSON_TEST_ROWS   16000
+#define JSON_TEST_LINES  100000
+#define JSON_TEST_PRINTS 200
+
+static int json_test_roundtrip(char* in, char* expected);
+static char* json_test_log(int rows, bool lines);
+static int json_test_events(char* in, char* expected);
+static int json_test_stream(char* in, struct json_stream** stream);
+static char* json_test_trace(struct json_stream* stream, int* ret);
+
+MCTF_TEST(test_json_parse)
+{
+   char* long_key = NULL;
+   char* doc = NULL;
+   char* expected = NULL;
+
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip("{\"b\": 1, \"a\": [true, false, null], \"c\": {}}",
+                                          "{\"a\":[true,false,null],\"b\":1,\"c\":{}}"), 0, cleanup);
+   // An empty array has no type yet, and prints as an object
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip(" \n[ -12 , 3.5 ,1e3, +7, 12345678901234567890, [ ], [[1]] ]\n",
+                                          "[-12,3.500000,1000.000000,7,12345678901234567168.000000,{},[[1]]]"), 0, cleanup);
+
+   // Structural characters and escaped quotes inside strings
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip("{\"k,{}\": \"v:[]\\\"\", \"q\": \"a\\\\\", \"e\": \"\"}",
+                                          "{\"e\":null,\"k,{}\":\"v:[]\\\"\",\"q\":\"a\\\\\"}"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip("[\"tab\\there\", \"\\u00e9\\u20ac\\ud83d\\ude00\\/\"]",
+                                          "[\"tab\\there\",\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80/\"]"), 0, cleanup);
+
+   // Duplicate keys, the last one wins
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip("{\"a\": 1, \"a\": 2}", "{\"a\":2}"), 0, cleanup);
+
+   // A trailing comma is accepted, and what follows the document is ignored
+   MCTF_ASSERT_INT_EQ(json_test_roundtrip("{\"a\": [1, 2,], \"b\": 3,} trailing", "{\"a\":[1,2],\"b\":3}"), 0, cleanup);
+
+   // Runs of backslashes across the 64 byte blocks of the index
+   for (int pad = 50; pad < 70; pad++)
+   {
+      free(doc);
+      free(long_key);
+      free(expected);
+      doc = NULL;
+      long_key = NULL;
+      expected = NULL;
+      for (int i = 0; i < pad; i++)
+      {
+         long_key = pgvictoria_append_char(long_key, 'x');
+      }
+      doc = pgvictoria_append(doc, "{\"");
+      doc = pgvictoria_append(doc, long_key);
+      doc = pgvictoria_append(doc, "\\\\\\\"\\\\\": \"}\"}");
+
+      long_key = pgvictoria_append(long_key, "\\\\\\\"\\\\");
+      expected = pgvictoria_append(expected, "{\"");
+      expected = pgvictoria_append(expected, long_key);
+      expected = pgvictoria_append(expected, "\":\"}\"}");
+      MCTF_ASSERT_INT_EQ(json_test_roundtrip(doc, expected), 0, cleanup, "escape runs with a key of %d bytes", pad);
+   }
+
+cleanup:
+   free(doc);
+   free(long_key);
+   free(expected);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_json_parse_errors)
+{
+   char* invalid[] = {
+      "",
+      "1",
+      "\"a\"",
+      "{",
+      "[1, 2",
+      "{\"a\" 1}",
+      "{\"a\": }",
+      "{\"\": 1}",
+      "{1: 2}",
+      "{\"a\": 1]",
+      "[1}",
+      "[\"unterminated]",
+      "[tru]",
+      "[nulls]",
+      "[1.2.3]",
+      "[-]",
+      "[\"\\x\"]",
+      "[\"\\u12\"]",
+      "[\"\\ud83d\"]",
+      "[1 2]",
+      "{\"a\": 1 \"b\": 2}",
+      "[,]",
+   };
+   struct json* j = NULL;
+
+   for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string(invalid[i], &j), 1, cleanup, "%s should not parse", invalid[i]);
+   }
+
+cleanup:
+   pgvictoria_json_destroy(j);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_json_parse_throughput, 60)
+{
+   struct json* baseline = NULL;
+   struct json* j = NULL;
+   struct timespec start;
+   char* text = NULL;
+   char* again = NULL;
+   char* expected = NULL;
+   double seconds = 0.0;
+   size_t bytes = 0;
+
+   for (int version = 14; version <= 19; version++)
+   {
+      baseline = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+      text = pgvictoria_json_to_string(baseline, FORMAT_JSON, NULL, 0);
+      expected = pgvictoria_json_to_string(baseline, FORMAT_JSON_COMPACT, NULL, 0);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int r = 0; r < JSON_TEST_PARSES; r++)
+      {
+         MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string(text, &j), 0, cleanup);
+         if (r + 1 < JSON_TEST_PARSES)
+         {
+            pgvictoria_json_destroy(j);
+            j = NULL;
+         }
+      }
+      seconds = pgvictoria_test_elapsed(&start);
+
+      pgvictoria_json_case_insensitive(j);
+      again = pgvictoria_json_to_string(j, FORMAT_JSON_COMPACT, NULL, 0);
+      MCTF_ASSERT_STR_EQ(again, expected, cleanup);
+
+      pgvictoria_log_info("json: pg%d baseline of %zu bytes: %.3fms per parse, %.1f MB/s",
+                          version, strlen(text), seconds * 1000.0 / JSON_TEST_PARSES,
+                          strlen(text) * JSON_TEST_PARSES / seconds / 1e6);
+
+      free(text);
+      free(again);
+      free(expected);
+      text = NULL;
+      again = NULL;
+      expected = NULL;
+      pgvictoria_json_destroy(j);
+      pgvictoria_json_destroy(baseline);
+      j = NULL;
+      baseline = NULL;
+   }
+
+   // A multi-megabyte jsonlog style document
+   text = json_test_log(JSON_TEST_ROWS, false);
+   MCTF_ASSERT_PTR_NONNULL(text, cleanup);
+   bytes = strlen(text);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string(text, &j), 0, cleanup);
+   seconds = pgvictoria_test_elapsed(&start);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_json_array_length(j), JSON_TEST_ROWS, cleanup);
+
+   pgvictoria_log_info("json: log of %d rows, %zu bytes: %.3fms, %.1f MB/s",
+                       JSON_TEST_ROWS, bytes, seconds * 1000.0, bytes / seconds / 1e6);
+
+cleanup:
+   free(text);
+   free(again);
+   free(expected);
+   pgvictoria_json_destroy(j);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_json_to_string_throughput, 60)
+{
+   struct json* j = NULL;
+   struct timespec start;
+   char* text = NULL;
+   char* out = NULL;
+   int formats[] = {FORMAT_JSON, FORMAT_JSON_COMPACT, FORMAT_TEXT};
+   int rows[] = {JSON_TEST_ROWS / 8, JSON_TEST_ROWS};
+   double per_byte[2];
+   double seconds = 0.0;
+   size_t bytes = 0;
+
+   for (int version = 14; version <= 19; version++)
+   {
+      j = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(j, cleanup);
+      for (int f = 0; f < 3; f++)
+      {
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         for (int r = 0; r < JSON_TEST_PRINTS; r++)
+         {
+            out = pgvictoria_json_to_string(j, formats[f], NULL, 0);
+            MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+            bytes = strlen(out);
+            free(out);
+            out = NULL;
+         }
+         seconds = pgvictoria_test_elapsed(&start);
+         pgvictoria_log_info("json: pg%d baseline to format %d, %zu bytes: %.3fms per print",
+                             version, formats[f], bytes, seconds * 1000.0 / JSON_TEST_PRINTS);
+      }
+      pgvictoria_json_destroy(j);
+      j = NULL;
+   }
+
+   // Printing is linear, so eight times the rows take about eight times as long
+   for (int i = 0; i < 2; i++)
+   {
+      text = json_test_log(rows[i], false);
+      MCTF_ASSERT_PTR_NONNULL(text, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string(text, &j), 0, cleanup);
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      out = pgvictoria_json_to_string(j, FORMAT_JSON, NULL, 0);
+      seconds = pgvictoria_test_elapsed(&start);
+      MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+      bytes = strlen(out);
+      per_byte[i] = seconds / bytes;
+      pgvictoria_log_info("json: log of %d rows to %zu bytes: %.3fms, %.1f MB/s",
+                          rows[i], bytes, seconds * 1000.0, bytes / seconds / 1e6);
+      free(out);
+      free(text);
+      out = NULL;
+      text = NULL;
+      pgvictoria_json_destroy(j);
+      j = NULL;
+   }
+   MCTF_ASSERT(per_byte[1] < per_byte[0] * 4, cleanup, "printing is not linear: %.2fns per byte, then %.2fns",
+               per_byte[0] * 1e9, per_byte[1] * 1e9);
+
+cleanup:
+   free(out);
+   free(text);
+   pgvictoria_json_destroy(j);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_json_stream)
+{
+   struct json_stream* stream = NULL;
+   struct json_event event;
+   char path[MAX_PATH];
+   char* doc = NULL;
+   char* trace = NULL;
+   FILE* f = NULL;
+   int ret = 0;
+   int pids = 0;
+
+   MCTF_ASSERT_INT_EQ(json_test_events("{\"b\": 1, \"a\": [true, false, null], \"c\": {}, \"\": \"\"}",
+                                       "{ k:b i:1 k:a [ t f n ] k:c { } k: s: } $"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(json_test_events(" \n[ -12 , 3.5 ,1e3, +7, 12345678901234567890, [ ], [[1]], ]\n",
+                                       "[ i:-12 f:3.5 f:1000 i:7 f:1.23457e+19 [ ] [ [ i:1 ] ] ] $"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(json_test_events("[\"a\\\"b\\\\c\\/\\n\", \"\\u00e9\\u20ac\\ud83d\\ude00\"]",
+                                       "[ s:a\"b\\c/\n s:\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 ] $"), 0, cleanup);
+   // A jsonlog file holds a document per line
+   MCTF_ASSERT_INT_EQ(json_test_events("{\"pid\": 1}\n{\"pid\": 2}\n\n7 \"x\"",
+                                       "{ k:pid i:1 } { k:pid i:2 } i:7 s:x $"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(json_test_events("", "$"), 0, cleanup);
+
+   char* invalid[] = {
+      "{",
+      "[1, 2",
+      "{\"a\" 1}",
+      "{\"a\": }",
+      "{1: 2}",
+      "{\"a\": 1]",
+      "[1}",
+      "]",
+      "[\"unterminated]",
+      "[tru]",
+      "[1.2.3]",
+      "[\"\\x\"]",
+      "[\"\\u12\"]",
+      "[\"\\ud83d\"]",
+      "[1 2]",
+      "[,]",
+   };
+   for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+   {
+      MCTF_ASSERT_INT_EQ(json_test_stream(invalid[i], &stream), 0, cleanup);
+      trace = json_test_trace(stream, &ret);
+      MCTF_ASSERT_INT_EQ(ret, 1, cleanup, "%s should not stream, got %s", invalid[i], trace);
+      // A failed stream stays failed
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 1, cleanup);
+      free(trace);
+      trace = NULL;
+      pgvictoria_json_stream_close(stream);
+      stream = NULL;
+   }
+
+   // Skip the value of a key, and the rest of an array
+   MCTF_ASSERT_INT_EQ(json_test_stream("{\"plan\": {\"a\": [\"]}\\\"\", {}]}, \"pid\": 4, \"tags\": [1, [2], 3], \"end\": true}",
+                                       &stream), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(event.string, "plan", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_skip(stream), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(event.string, "pid", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_skip(stream), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(event.string, "tags", cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(event.type, JSONEventArrayStart, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   // There is nothing to skip after a scalar
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_skip(stream), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(event.type, JSONEventArrayStart, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_skip(stream), 0, cleanup);
+   trace = json_test_trace(stream, &ret);
+   MCTF_ASSERT_INT_EQ(ret, 0, cleanup);
+   MCTF_ASSERT_STR_EQ(trace, "i:3 ] k:end t } $", cleanup);
+   free(trace);
+   trace = NULL;
+   pgvictoria_json_stream_close(stream);
+   stream = NULL;
+
+   // Strings and scalars that span reads
+   pgvictoria_snprintf(path, sizeof(path), "%s/json_stream.json", TEST_BASE_DIR);
+   doc = malloc(3 * DEFAULT_BUFFER_SIZE);
+   MCTF_ASSERT_PTR_NONNULL(doc, cleanup);
+   f = fopen(path, "w");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup);
+   memset(doc, 'x', 3 * DEFAULT_BUFFER_SIZE - 1);
+   doc[3 * DEFAULT_BUFFER_SIZE - 1] = '\0';
+   fprintf(f, "[\"%s\"", doc);
+   for (int i = 0; i < 50000; i++)
+   {
+      fprintf(f, ", {\"pid\": %d, \"m\": \"\\\"%d\\u00e9\"}", i, i);
+   }
+   fprintf(f, "]");
+   fclose(f);
+   f = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_init(path, &stream), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(event.type, JSONEventString, cleanup);
+   MCTF_ASSERT_INT_EQ((int)event.length, 3 * DEFAULT_BUFFER_SIZE - 1, cleanup);
+   MCTF_ASSERT_STR_EQ(event.string, doc, cleanup);
+   while (pgvictoria_json_stream_next(stream, &event) == 0 && event.type != JSONEventEnd)
+   {
+      if (event.type == JSONEventKey && !strcmp(event.string, "pid"))
+      {
+         MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+         MCTF_ASSERT_INT_EQ((int)event.integer, pids, cleanup);
+         MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+         MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+         pgvictoria_snprintf(doc, DEFAULT_BUFFER_SIZE, "\"%d\xc3\xa9", pids);
+         MCTF_ASSERT_STR_EQ(event.string, doc, cleanup);
+         pids++;
+      }
+   }
+   MCTF_ASSERT_INT_EQ(event.type, JSONEventEnd, cleanup);
+   MCTF_ASSERT_INT_EQ(pids, 50000, cleanup);
+
+cleanup:
+   if (f != NULL)
+   {
+      fclose(f);
+   }
+   unlink(path);
+   free(doc);
+   free(trace);
+   pgvictoria_json_stream_close(stream);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_json_stream_throughput, 60)
+{
+   struct json_stream* stream = NULL;
+   struct json_event event;
+   struct timespec start;
+   char path[MAX_PATH];
+   char* text = NULL;
+   FILE* f = NULL;
+   double seconds = 0.0;
+   size_t bytes = 0;
+   int64_t pids = 0;
+   int64_t expected_pids = 0;
+   int rows = 0;
+   int logs = 0;
+   uint64_t events = 0;
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/json_stream_log.json", TEST_BASE_DIR);
+   text = json_test_log(JSON_TEST_LINES, true);
+   MCTF_ASSERT_PTR_NONNULL(text, cleanup);
+   bytes = strlen(text);
+   f = fopen(path, "w");
+   MCTF_ASSERT_PTR_NONNULL(f, cleanup);
+   MCTF_ASSERT_INT_EQ((int)fwrite(text, 1, bytes, f), (int)bytes, cleanup);
+   fclose(f);
+   f = NULL;
+   free(text);
+   text = NULL;
+   for (int i = 0; i < JSON_TEST_LINES; i++)
+   {
+      expected_pids += 10000 + i;
+   }
+
+   // Sum the pids and count the LOG lines, skipping the tags
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_init(path, &stream), 0, cleanup);
+   while (true)
+   {
+      MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+      events++;
+      if (event.type == JSONEventEnd)
+      {
+         break;
+      }
+      if (event.type == JSONEventObjectStart && event.depth == 0)
+      {
+         rows++;
+      }
+      else if (event.type == JSONEventKey && event.depth == 1)
+      {
+         if (!strcmp(event.string, "pid"))
+         {
+            MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+            pids += event.integer;
+         }
+         else if (!strcmp(event.string, "error_severity"))
+         {
+            MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_next(stream, &event), 0, cleanup);
+            logs += !strcmp(event.string, "LOG");
+         }
+         else if (!strcmp(event.string, "tags"))
+         {
+            MCTF_ASSERT_INT_EQ(pgvictoria_json_stream_skip(stream), 0, cleanup);
+         }
+      }
+   }
+   seconds = pgvictoria_test_elapsed(&start);
+
+   MCTF_ASSERT_INT_EQ(rows, JSON_TEST_LINES, cleanup);
+   MCTF_ASSERT_INT_EQ(logs, JSON_TEST_LINES, cleanup);
+   MCTF_ASSERT(pids == expected_pids, cleanup, "pids sum to %" PRId64 ", expected %" PRId64, pids, expected_pids);
+   // Only the read buffer and the longest string that spans reads are kept
+   MCTF_ASSERT_INT_EQ((int)stream->buffer->size, DEFAULT_BUFFER_SIZE, cleanup);
+   MCTF_ASSERT(stream->token_size <= 1024, cleanup, "token buffer grew to %zu bytes", stream->token_size);
+
+   pgvictoria_log_info("json: stream of %d lines, %zu bytes, %" PRIu64 " events: %.3fms, %.1f MB/s, %zu bytes kept",
+                       JSON_TEST_LINES, bytes, events, seconds * 1000.0, bytes / seconds / 1e6,
+                       sizeof(struct json_stream) + stream->buffer->size + stream->token_size);
+
+cleanup:
+   if (f != NULL)
+   {
+      fclose(f);
+   }
+   unlink(path);
+   free(text);
+   pgvictoria_json_stream_close(stream);
+   MCTF_FINISH();
+}
+
+static int
+json_test_roundtrip(char* in, char* expected)
+{
+   struct json* j = NULL;
+   char* out = NULL;
+   int ret = 1;
+
+   if (pgvictoria_json_parse_string(in, &j))
+   {
+      pgvictoria_log_error("json: could not parse %s", in);
+      return 1;
+   }
+   out = pgvictoria_json_to_string(j, FORMAT_JSON_COMPACT, NULL, 0);
+   if (pgvictoria_compare_string(out, expected))
+   {
+      ret = 0;
+   }
+   else
+   {
+      pgvictoria_log_error("json: %s parsed as %s, expected %s", in, out, expected);
+   }
+   free(out);
+   pgvictoria_json_destroy(j);
+   return ret;
+}
+
+static char*
+json_test_log(int rows, bool lines)
+{
+   char* s = malloc((size_t)rows * 512 + 8);
+   size_t n = 0;
+
+   if (s == NULL)
+   {
+      return NULL;
+   }
+   n += sprintf(s + n, lines ? "" : "[\n");
+   for (int i = 0; i < rows; i++)
+   {
+      n += snprintf(s + n, 512,
+                    "%s{\"timestamp\": \"2026-10-16 12:00:%02d.123 UTC\", \"user\": \"postgres\", \"dbname\": \"db%d\", "
+                    "\"pid\": %d, \"error_severity\": \"LOG\", "
+                    "\"message\": \"duration: %d.%03d ms  statement: SELECT \\\"a\\\" FROM t WHERE x = 'y'\\n\", "
+                    "\"ratio\": 0.%d, \"ok\": true, \"tags\": [1, 2, 3], \"detail\": null}%s\n",
+                    lines ? "" : "  ", i % 60, i % 7, 10000 + i, i % 100, i % 1000, i % 9 + 1,
+                    !lines && i + 1 < rows ? "," : "");
+   }
+   sprintf(s + n, lines ? "" : "]");
+   return s;
+}
+
+static int
+json_test_events(char* in, char* expected)
+{
+   struct json_stream* stream = NULL;
+   char* trace = NULL;
+   int ret = 1;
+
+   if (json_test_stream(in, &stream))
+   {
+      return 1;
+   }
+   trace = json_test_trace(stream, &ret);
+   if (ret)
+   {
+      pgvictoria_log_error("json: could not stream %s, got %s", in, trace);
+   }
+   else if (!pgvictoria_compare_string(trace, expected))
+   {
+      pgvictoria_log_error("json: %s streamed as %s, expected %s", in, trace, expected);
+      ret = 1;
+   }
+   free(trace);
+   pgvictoria_json_stream_close(stream);
+   return ret;
+}
+
+static int
+json_test_stream(char* in, struct json_stream** stream)
+{
+   int fds[2];
+
+   // the inputs are small enough to fit in the pipe
+   if (pipe(fds))
+   {
+      return 1;
+   }
+   if (write(fds[1], in, strlen(in)) != (ssize_t)strlen(in))
+   {
+      close(fds[0]);
+      close(fds[1]);
+      return 1;
+   }
+   close(fds[1]);
+   if (pgvictoria_json_stream_init_fd(fds[0], stream))
+   {
+      close(fds[0]);
+      return 1;
+   }
+   (*stream)->owns_fd = true;
+   return 0;
+}
+
+static char*
+json_test_trace(struct json_stream* stream, int* ret)
+{
+   struct json_event event;
+   char* trace = NULL;
+   char buffer[64];
+
+   *ret = 1;
+   while (pgvictoria_json_stream_next(stream, &event) == 0)
+   {
+      switch (event.type)
+      {
+         case JSONEventObjectStart:
+            trace = pgvictoria_append(trace, "{ ");
+            break;
+         case JSONEventObjectEnd:
+            trace = pgvictoria_append(trace, "} ");
+            break;
+         case JSONEventArrayStart:
+            trace = pgvictoria_append(trace, "[ ");
+            break;
+         case JSONEventArrayEnd:
+            trace = pgvictoria_append(trace, "] ");
+            break;
+         case JSONEventKey:
+         case JSONEventString:
+            trace = pgvictoria_append(trace, event.type == JSONEventKey ? "k:" : "s:");
+            trace = pgvictoria_append(trace, event.string);
+            trace = pgvictoria_append(trace, " ");
+            break;
+         case JSONEventInteger:
+            pgvictoria_snprintf(buffer, sizeof(buffer), "i:%" PRId64 " ", event.integer);
+            trace = pgvictoria_append(trace, buffer);
+            break;
+         case JSONEventFloat:
+            pgvictoria_snprintf(buffer, sizeof(buffer), "f:%g ", event.number);
+            trace = pgvictoria_append(trace, buffer);
+            break;
+         case JSONEventBool:
+            trace = pgvictoria_append(trace, event.boolean ? "t " : "f ");
+            break;
+         case JSONEventNull:
+            trace = pgvictoria_append(trace, "n ");
+            break;
+         case JSONEventEnd:
+            trace = pgvictoria_append(trace, "$");
+            *ret = 0;
+            return trace;
+         default:
+            return trace;
+      }
+   }
+   return trace;
+}
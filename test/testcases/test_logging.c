@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <logging.h>
+#include <mctf.h>
+#include <tscommon.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define LOGGING_TEST_PRODUCERS 3
+#define LOGGING_TEST_LINES     2000
+#define LOGGING_TEST_FULL      (2 * PGVICTORIA_LOGGING_RING_SIZE / 512)
+
+static pid_t logging_test_writer(void);
+static int logging_test_stop(pid_t writer);
+
+MCTF_TEST(test_logging_writer)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   pid_t writer = -1;
+   pid_t pids[LOGGING_TEST_PRODUCERS];
+   int next[LOGGING_TEST_PRODUCERS + 1];
+   char* log = NULL;
+   char* p = NULL;
+   off_t offset;
+   int status;
+   int dropped = 0;
+   int lines = 0;
+
+   offset = pgvictoria_test_log_offset();
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_log_writer_init(), 0, cleanup);
+   writer = logging_test_writer();
+   MCTF_ASSERT(writer > 0, cleanup, "the log writer should start");
+
+   /* The forked producers log to the same ring as this process */
+   for (int i = 0; i < LOGGING_TEST_PRODUCERS; i++)
+   {
+      pids[i] = fork();
+      if (pids[i] == 0)
+      {
+         for (int j = 0; j < LOGGING_TEST_LINES; j++)
+         {
+            pgvictoria_log_info("logging_test %d %d", i, j);
+         }
+         _exit(0);
+      }
+   }
+
+   for (int j = 0; j < LOGGING_TEST_LINES; j++)
+   {
+      pgvictoria_log_info("logging_test %d %d", LOGGING_TEST_PRODUCERS, j);
+   }
+
+   for (int i = 0; i < LOGGING_TEST_PRODUCERS; i++)
+   {
+      waitpid(pids[i], &status, 0);
+   }
+
+   MCTF_ASSERT_INT_EQ(logging_test_stop(writer), 0, cleanup);
+   writer = -1;
+
+   log = pgvictoria_test_log_read(offset);
+   MCTF_ASSERT_PTR_NONNULL(log, cleanup);
+
+   /* Every line of a producer is written, in the order it was logged */
+   memset(next, 0, sizeof(next));
+   for (p = strstr(log, "logging_test "); p != NULL; p = strstr(p + 1, "logging_test "))
+   {
+      int producer;
+      int line;
+
+      if (sscanf(p, "logging_test %d %d", &producer, &line) != 2 || producer < 0 || producer > LOGGING_TEST_PRODUCERS)
+      {
+         continue;
+      }
+
+      MCTF_ASSERT(line >= next[producer], cleanup, "line %d of producer %d is out of order", line, producer);
+      next[producer] = line + 1;
+      lines++;
+   }
+
+   for (p = strstr(log, "WARN  "); p != NULL; p = strstr(p + 1, "WARN  "))
+   {
+      int n;
+
+      if (sscanf(p, "WARN  logging.c:%*d %d log lines were dropped", &n) == 1)
+      {
+         dropped += n;
+      }
+   }
+
+   MCTF_ASSERT_INT_EQ(lines + dropped, (LOGGING_TEST_PRODUCERS + 1) * LOGGING_TEST_LINES, cleanup);
+
+cleanup:
+   if (writer > 0)
+   {
+      logging_test_stop(writer);
+   }
+   pgvictoria_log_writer_destroy();
+   free(log);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_logging_writer_full)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   char line[512];
+   pid_t writer = -1;
+   char* log = NULL;
+   off_t offset;
+   offset = pgvictoria_test_log_offset();
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_log_writer_init(), 0, cleanup);
+
+   /* Without a writer the ring fills up, and logging drops lines instead of waiting */
+   memset(line, 'x', sizeof(line) - 1);
+   line[sizeof(line) - 1] = '\0';
+   for (int i = 0; i < LOGGING_TEST_FULL; i++)
+   {
+      pgvictoria_log_debug("logging_full %s", line);
+   }
+   MCTF_ASSERT(atomic_load(&config->common.log_dropped) > 0, cleanup, "a full ring should drop lines");
+
+   /* Start over with an empty ring, so the test log stays small */
+   pgvictoria_log_writer_destroy();
+   MCTF_ASSERT_INT_EQ(pgvictoria_log_writer_init(), 0, cleanup);
+   pgvictoria_log_info("logging_full %s", "kept");
+   atomic_store(&config->common.log_dropped, 42);
+
+   writer = logging_test_writer();
+   MCTF_ASSERT(writer > 0, cleanup, "the log writer should start");
+   MCTF_ASSERT_INT_EQ(logging_test_stop(writer), 0, cleanup);
+   writer = -1;
+
+   log = pgvictoria_test_log_read(offset);
+   MCTF_ASSERT_PTR_NONNULL(log, cleanup);
+   MCTF_ASSERT(strstr(log, "logging_full kept") != NULL, cleanup, "the lines in the ring should be written");
+   MCTF_ASSERT(strstr(log, "42 log lines were dropped") != NULL, cleanup, "the dropped lines should be reported");
+
+cleanup:
+   if (writer > 0)
+   {
+      logging_test_stop(writer);
+   }
+   pgvictoria_log_writer_destroy();
+   free(log);
+   MCTF_FINISH();
+}
+
+MCTF_TEST_NEGATIVE(test_logging_writer_full_error)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   char line[512];
+   char* log = NULL;
+   off_t offset;
+   unsigned long long dropped;
+
+   offset = pgvictoria_test_log_offset();
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_log_writer_init(), 0, cleanup);
+
+   memset(line, 'x', sizeof(line) - 1);
+   line[sizeof(line) - 1] = '\0';
+   for (int i = 0; i < LOGGING_TEST_FULL; i++)
+   {
+      pgvictoria_log_debug("logging_full %s", line);
+   }
+   MCTF_ASSERT(atomic_load(&config->common.log_dropped) > 0, cleanup, "a full ring should drop lines");
+
+   /* Fill what is left with lines shorter than the error */
+   for (int i = 0; i < LOGGING_TEST_FULL; i++)
+   {
+      dropped = atomic_load(&config->common.log_dropped);
+      pgvictoria_log_debug("lf");
+      if (atomic_load(&config->common.log_dropped) > dropped)
+      {
+         break;
+      }
+   }
+   dropped = atomic_load(&config->common.log_dropped);
+
+   /* An error is written directly when the ring is full */
+   pgvictoria_log_error("logging_full error");
+   MCTF_ASSERT(atomic_load(&config->common.log_dropped) == dropped, cleanup, "an error should not be dropped");
+
+   log = pgvictoria_test_log_read(offset);
+   MCTF_ASSERT_PTR_NONNULL(log, cleanup);
+   MCTF_ASSERT(strstr(log, "logging_full error") != NULL, cleanup, "the error should be in the log");
+   MCTF_ASSERT(strstr(log, "logging_full xxx") == NULL, cleanup, "the lines in the ring should wait for the writer");
+
+cleanup:
+   pgvictoria_log_writer_destroy();
+   atomic_store(&config->common.log_dropped, 0);
+   free(log);
+   MCTF_FINISH();
+}
+
+static pid_t
+logging_test_writer(void)
+{
+   sigset_t mask;
+   sigset_t old;
+   pid_t pid;
+
+   /* Hold a stop back until the writer has its handler in place */
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGTERM);
+   sigprocmask(SIG_BLOCK, &mask, &old);
+
+   pid = fork();
+   if (pid == 0)
+   {
+      pgvictoria_log_writer_run();
+   }
+
+   sigprocmask(SIG_SETMASK, &old, NULL);
+
+   return pid;
+}
+
+static int
+logging_test_stop(pid_t writer)
+{
+   int status = 0;
+
+   kill(writer, SIGTERM);
+   if (waitpid(writer, &status, 0) != writer)
+   {
+      return 1;
+   }
+
+   return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
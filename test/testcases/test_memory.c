@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <art.h>
+#include <deque.h>
+#include <json.h>
+#include <logging.h>
+#include <memory.h>
+#include <mctf.h>
+#include <tscommon.h>
+#include <postgresql.h>
+#include <utils.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MEMORY_TEST_REPORTS 200
+
+static int memory_test_copy(struct memory_arena* arena, struct json* from, struct json** to);
+static void memory_test_count(void* data);
+
+MCTF_TEST(test_memory_arena)
+{
+   struct memory_arena* arena = NULL;
+   char* p = NULL;
+   char* big = NULL;
+   char* s = NULL;
+   int cleanups = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(1024, &arena), 0, cleanup);
+
+   for (int i = 1; i < 200; i++)
+   {
+      p = pgvictoria_memory_arena_alloc(arena, i);
+      MCTF_ASSERT_PTR_NONNULL(p, cleanup);
+      MCTF_ASSERT_INT_EQ((int)((uintptr_t)p % 16), 0, cleanup, "allocation of %d bytes is not aligned", i);
+      for (int j = 0; j < i; j++)
+      {
+         MCTF_ASSERT_INT_EQ(p[j], 0, cleanup, "allocation of %d bytes is not zeroed", i);
+      }
+      memset(p, 0xff, i);
+   }
+
+   // Larger than a block
+   big = pgvictoria_memory_arena_alloc(arena, 10000);
+   MCTF_ASSERT_PTR_NONNULL(big, cleanup);
+   memset(big, 0xff, 10000);
+
+   s = pgvictoria_memory_arena_string(arena, "max_connections");
+   MCTF_ASSERT_STR_EQ(s, "max_connections", cleanup);
+   MCTF_ASSERT(pgvictoria_memory_arena_string(arena, NULL) == NULL, cleanup, "copy of NULL");
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_cleanup(arena, memory_test_count, &cleanups), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_cleanup(arena, memory_test_count, &cleanups), 0, cleanup);
+
+   // A reset runs the callbacks once and hands out zeroed memory again
+   pgvictoria_memory_arena_reset(arena);
+   MCTF_ASSERT_INT_EQ(cleanups, 2, cleanup);
+   MCTF_ASSERT_INT_EQ((int)arena->allocated, 0, cleanup);
+   p = pgvictoria_memory_arena_alloc(arena, 512);
+   MCTF_ASSERT_PTR_NONNULL(p, cleanup);
+   for (int j = 0; j < 512; j++)
+   {
+      MCTF_ASSERT_INT_EQ(p[j], 0, cleanup, "memory after a reset is not zeroed");
+   }
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_cleanup(arena, memory_test_count, &cleanups), 0, cleanup);
+   pgvictoria_memory_arena_destroy(arena);
+   arena = NULL;
+   MCTF_ASSERT_INT_EQ(cleanups, 3, cleanup);
+
+   // An oversized block linked behind the first one is not what a reset keeps
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(1024, &arena), 0, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(pgvictoria_memory_arena_alloc(arena, 10000), cleanup);
+   pgvictoria_memory_arena_reset(arena);
+   MCTF_ASSERT(arena->block == arena->first, cleanup, "a reset should keep the first block");
+   MCTF_ASSERT_INT_EQ((int)arena->block->size, 1024, cleanup);
+   MCTF_ASSERT_PTR_NULL(arena->block->next, cleanup);
+
+cleanup:
+   pgvictoria_memory_arena_destroy(arena);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_memory_arena_json)
+{
+   struct memory_arena* arena = NULL;
+   struct json* doc = NULL;
+   struct json* heap = NULL;
+   struct json* nested = NULL;
+   struct json* parsed = NULL;
+   struct deque* deque = NULL;
+   char* str = NULL;
+   char* tag = NULL;
+   char* data = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(0, &arena), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_create_arena(arena, &doc), 0, cleanup);
+
+   // Objects of the arena and of the heap mix freely
+   pgvictoria_json_create_arena(arena, &nested);
+   pgvictoria_json_put(nested, "default", (uintptr_t)"on", ValueString);
+   pgvictoria_json_put(doc, "fsync", (uintptr_t)nested, ValueJSON);
+   pgvictoria_json_create(&heap);
+   pgvictoria_json_put(heap, "default", (uintptr_t)"128MB", ValueString);
+   pgvictoria_json_put(doc, "shared_buffers", (uintptr_t)heap, ValueJSON);
+   pgvictoria_json_put(doc, "max_connections", (uintptr_t)100, ValueInt64);
+   pgvictoria_json_put(doc, "empty", (uintptr_t)"", ValueString);
+   pgvictoria_json_put(doc, "note", (uintptr_t)"first", ValueString);
+   pgvictoria_json_put(doc, "note", (uintptr_t)"second", ValueString);
+
+   str = pgvictoria_json_to_string(doc, FORMAT_JSON_COMPACT, NULL, 0);
+   MCTF_ASSERT_STR_EQ(str, "{\"empty\":null,\"fsync\":{\"default\":\"on\"},\"max_connections\":100,\"note\":\"second\",\"shared_buffers\":{\"default\":\"128MB\"}}", cleanup);
+   free(str);
+   str = NULL;
+
+   // Removing the heap object frees it now, the rest goes with the arena
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_remove(doc, "shared_buffers"), 0, cleanup);
+   pgvictoria_json_create(&heap);
+   pgvictoria_json_put(heap, "default", (uintptr_t)"4MB", ValueString);
+   pgvictoria_json_put(doc, "work_mem", (uintptr_t)heap, ValueJSON);
+   heap = NULL;
+
+   // Polled data belongs to the caller
+   pgvictoria_deque_create_arena(arena, false, &deque);
+   pgvictoria_deque_add(deque, "tag", (uintptr_t)"value", ValueString);
+   data = (char*)pgvictoria_deque_poll(deque, &tag);
+   MCTF_ASSERT_STR_EQ(tag, "tag", cleanup);
+   MCTF_ASSERT_STR_EQ(data, "value", cleanup);
+   MCTF_ASSERT_INT_EQ((int)pgvictoria_deque_size(deque), 0, cleanup);
+   pgvictoria_json_put(doc, "list", (uintptr_t)deque, ValueDeque);
+
+   pgvictoria_json_destroy(doc);
+   pgvictoria_memory_arena_destroy(arena);
+   arena = NULL;
+
+   // A parsed document owns its arena
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string("{\"a\":{\"b\":[1,2,\"three\"]},\"c\":true}", &parsed), 0, cleanup);
+   MCTF_ASSERT(parsed->owner, cleanup, "parsed document should own its arena");
+   pgvictoria_json_put(parsed, "d", (uintptr_t)"four", ValueString);
+   str = pgvictoria_json_to_string(parsed, FORMAT_JSON_COMPACT, NULL, 0);
+   MCTF_ASSERT_STR_EQ(str, "{\"a\":{\"b\":[1,2,\"three\"]},\"c\":true,\"d\":\"four\"}", cleanup);
+
+cleanup:
+   free(str);
+   free(tag);
+   free(data);
+   pgvictoria_json_destroy(parsed);
+   pgvictoria_memory_arena_destroy(arena);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_memory_arena_report, 60)
+{
+   struct memory_arena* arena = NULL;
+   struct json* baseline = NULL;
+   struct json* copy = NULL;
+   struct timespec start;
+   double heap_build = 0.0;
+   double heap_release = 0.0;
+   double arena_build = 0.0;
+   double arena_release = 0.0;
+   char* expected = NULL;
+   char* str = NULL;
+
+   for (int version = 14; version <= 19; version++)
+   {
+      baseline = pgvictoria_get_baseline(version);
+      MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+
+      for (int r = 0; r < MEMORY_TEST_REPORTS; r++)
+      {
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         MCTF_ASSERT_INT_EQ(memory_test_copy(NULL, baseline, &copy), 0, cleanup);
+         heap_build += pgvictoria_test_elapsed(&start);
+         if (r == 0)
+         {
+            MCTF_ASSERT_INT_EQ((int)((struct art*)copy->elements)->size, (int)((struct art*)baseline->elements)->size, cleanup);
+            expected = pgvictoria_json_to_string(copy, FORMAT_JSON_COMPACT, NULL, 0);
+         }
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         pgvictoria_json_destroy(copy);
+         copy = NULL;
+         heap_release += pgvictoria_test_elapsed(&start);
+
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         MCTF_ASSERT_INT_EQ(pgvictoria_memory_arena_create(0, &arena), 0, cleanup);
+         MCTF_ASSERT_INT_EQ(memory_test_copy(arena, baseline, &copy), 0, cleanup);
+         arena_build += pgvictoria_test_elapsed(&start);
+         if (r == 0)
+         {
+            str = pgvictoria_json_to_string(copy, FORMAT_JSON_COMPACT, NULL, 0);
+            MCTF_ASSERT_STR_EQ(str, expected, cleanup);
+            free(str);
+            str = NULL;
+         }
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         pgvictoria_json_destroy(copy);
+         copy = NULL;
+         pgvictoria_memory_arena_destroy(arena);
+         arena = NULL;
+         arena_release += pgvictoria_test_elapsed(&start);
+      }
+
+      free(expected);
+      expected = NULL;
+      pgvictoria_json_destroy(baseline);
+      baseline = NULL;
+   }
+
+   pgvictoria_log_info("memory: %d documents of pg14-19 baselines: heap build %.3fms release %.3fms, arena build %.3fms release %.3fms per document",
+                       6 * MEMORY_TEST_REPORTS,
+                       heap_build * 1000.0 / (6 * MEMORY_TEST_REPORTS), heap_release * 1000.0 / (6 * MEMORY_TEST_REPORTS),
+                       arena_build * 1000.0 / (6 * MEMORY_TEST_REPORTS), arena_release * 1000.0 / (6 * MEMORY_TEST_REPORTS));
+
+cleanup:
+   free(str);
+   free(expected);
+   if (arena == NULL)
+   {
+      pgvictoria_json_destroy(copy);
+   }
+   pgvictoria_memory_arena_destroy(arena);
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+static int
+memory_test_copy(struct memory_arena* arena, struct json* from, struct json** to)
+{
+   struct json_iterator* iter = NULL;
+   struct json* o = NULL;
+   struct json* child = NULL;
+   enum value_type type;
+   uintptr_t data;
+
+   if (pgvictoria_json_create_arena(arena, &o) || pgvictoria_json_iterator_create(from, &iter))
+   {
+      pgvictoria_json_destroy(o);
+      return 1;
+   }
+
+   while (pgvictoria_json_iterator_next(iter))
+   {
+      type = pgvictoria_value_type(iter->value);
+      data = pgvictoria_value_data(iter->value);
+      if (type == ValueJSON)
+      {
+         if (memory_test_copy(arena, (struct json*)data, &child))
+         {
+            pgvictoria_json_iterator_destroy(iter);
+            pgvictoria_json_destroy(o);
+            return 1;
+         }
+         data = (uintptr_t)child;
+      }
+      if (from->type == JSONArray)
+      {
+         pgvictoria_json_append(o, data, type);
+      }
+      else
+      {
+         pgvictoria_json_put(o, iter->key, data, type);
+      }
+   }
+   pgvictoria_json_iterator_destroy(iter);
+
+   *to = o;
+   return 0;
+}
+
+static void
+memory_test_count(void* data)
+{
+   (*(int*)data)++;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <deque.h>
+#include <guc.h>
+#include <mctf.h>
+#include <prometheus.h>
+#include <report.h>
+#include <tscommon.h>
+#include <value.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int prometheus_test_item(struct deque* items, char* key, char* status);
+static bool prometheus_test_line(char* line);
+
+static struct server prometheus_test_servers[1];
+static struct server* saved_servers = NULL;
+static int saved_number_of_servers = 0;
+
+MCTF_TEST_SETUP(prometheus)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+
+   pgvictoria_test_setup();
+
+   saved_servers = config->common.servers;
+   saved_number_of_servers = config->common.number_of_servers;
+
+   memset(prometheus_test_servers, 0, sizeof(prometheus_test_servers));
+   snprintf(prometheus_test_servers[0].name, MISC_LENGTH, "%s", "pri\"mary");
+   config->common.servers = prometheus_test_servers;
+   config->common.number_of_servers = 1;
+}
+
+MCTF_TEST_TEARDOWN(prometheus)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+
+   pgvictoria_prometheus_destroy();
+
+   config->common.servers = saved_servers;
+   config->common.number_of_servers = saved_number_of_servers;
+
+   pgvictoria_test_teardown();
+}
+
+MCTF_TEST(test_prometheus_render)
+{
+   struct deque* items = NULL;
+   struct collector_result result;
+   char* drift = NULL;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_init(), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_deque_create(false, &items), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(prometheus_test_item(items, "shared_buffers", "Modified"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(prometheus_test_item(items, "work_mem", "Default"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(prometheus_test_item(items, "my.setting", "Custom"), 0, cleanup);
+
+   memset(&result, 0, sizeof(struct collector_result));
+   result.up = true;
+   result.version = 17;
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_drift(0, items, &result, &drift), 0, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(drift, cleanup);
+   MCTF_ASSERT_INT_EQ((int)result.drift_length, (int)strlen(drift), cleanup);
+   MCTF_ASSERT_INT_EQ(result.number_of_default, 1, cleanup);
+   MCTF_ASSERT_INT_EQ(result.number_of_modified, 1, cleanup);
+   MCTF_ASSERT_INT_EQ(result.number_of_custom, 1, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_update(&result, drift), 0, cleanup);
+   drift = NULL;
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_render(), 0, cleanup);
+
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_server_up{name=\"pri\\\"mary\"} 1"), cleanup, "the server should be up");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_server_version{name=\"pri\\\"mary\"} 17"), cleanup, "the version should be rendered");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_settings{name=\"pri\\\"mary\",status=\"modified\"} 1"), cleanup, "the modified count should be rendered");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_setting_drift{name=\"pri\\\"mary\",setting=\"shared_buffers\",status=\"modified\"} 1"),
+               cleanup, "a modified setting should drift");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_setting_drift{name=\"pri\\\"mary\",setting=\"my.setting\",status=\"custom\"} 1"),
+               cleanup, "a custom setting should drift");
+   MCTF_ASSERT(!prometheus_test_line("pgvictoria_setting_drift{name=\"pri\\\"mary\",setting=\"work_mem\",status=\"default\"} 1"),
+               cleanup, "a default setting should not drift");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_collections_total{name=\"pri\\\"mary\"} 1"), cleanup, "the collection should be counted");
+
+   /* A failed scrape takes the drift samples with it */
+   memset(&result, 0, sizeof(struct collector_result));
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_update(&result, NULL), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_prometheus_render(), 0, cleanup);
+
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_server_up{name=\"pri\\\"mary\"} 0"), cleanup, "the server should be down");
+   MCTF_ASSERT(!prometheus_test_line("pgvictoria_setting_drift{name=\"pri\\\"mary\",setting=\"shared_buffers\",status=\"modified\"} 1"),
+               cleanup, "the drift should be cleared when a scrape fails");
+   MCTF_ASSERT(prometheus_test_line("pgvictoria_collection_errors_total{name=\"pri\\\"mary\"} 1"), cleanup, "the error should be counted");
+
+cleanup:
+   free(drift);
+   pgvictoria_deque_destroy(items);
+   MCTF_FINISH();
+}
+
+static int
+prometheus_test_item(struct deque* items, char* key, char* status)
+{
+   struct pgvictoria_diff_item* item = NULL;
+
+   item = (struct pgvictoria_diff_item*)calloc(1, sizeof(struct pgvictoria_diff_item));
+   if (item == NULL)
+   {
+      return 1;
+   }
+
+   item->id = pgvictoria_guc_id(key);
+   snprintf(item->key, sizeof(item->key), "%s", key);
+   snprintf(item->status, sizeof(item->status), "%s", status);
+
+   return pgvictoria_deque_add(items, NULL, (uintptr_t)item, ValueMem);
+}
+
+/* Is the line in the rendered metrics, as a whole line */
+static bool
+prometheus_test_line(char* line)
+{
+   char* metrics = NULL;
+   size_t length = 0;
+   size_t n = strlen(line);
+
+   metrics = pgvictoria_prometheus_metrics(&length);
+
+   for (size_t i = 0; i + n <= length; i++)
+   {
+      if ((i == 0 || metrics[i - 1] == '\n') && !strncmp(metrics + i, line, n) && metrics[i + n] == '\n')
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <pgvictoria.h>
+#include <mctf.h>
+#include <registry.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REGISTRY_TEST_SERVERS 12000
+#define REGISTRY_TEST_USERS   12000
+
+static void registry_test_server(int i, struct server* srv);
+
+MCTF_TEST(test_registry_add_find)
+{
+   struct common_configuration config = {0};
+   struct server srv;
+   struct user usr = {0};
+   int index = -1;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_create(&config, 4, 4), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "primary"), -1, cleanup);
+
+   registry_test_server(0, &srv);
+   snprintf(srv.name, sizeof(srv.name), "primary");
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_server(&config, &srv, &index), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(index, 0, cleanup);
+
+   registry_test_server(1, &srv);
+   snprintf(srv.name, sizeof(srv.name), "replica");
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_server(&config, &srv, &index), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(index, 1, cleanup);
+   MCTF_ASSERT_INT_EQ(config.number_of_servers, 2, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "primary"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "replica"), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "standby"), -1, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_endpoint(&config, srv.host, srv.port), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_endpoint(&config, srv.host, srv.port + 1), -1, cleanup);
+
+   snprintf(usr.username, sizeof(usr.username), "postgres");
+   snprintf(usr.password, sizeof(usr.password), "secret");
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_user(&config, &usr, NULL), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_user(&config, "postgres"), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(config.users[0].password, "secret", cleanup, "user should be stored");
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_user(&config, "repl"), -1, cleanup);
+
+cleanup:
+   pgvictoria_registry_destroy(&config);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_registry_duplicate)
+{
+   struct common_configuration config = {0};
+   struct server srv;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_create(&config, 4, 4), 0, cleanup);
+
+   registry_test_server(0, &srv);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_server(&config, &srv, NULL), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_server(&config, &srv, NULL), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(config.number_of_servers, 2, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, srv.name), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_endpoint(&config, srv.host, srv.port), 0, cleanup);
+
+cleanup:
+   pgvictoria_registry_destroy(&config);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_registry_grow)
+{
+   struct common_configuration config = {0};
+   struct server srv;
+   struct user usr = {0};
+   char name[MISC_LENGTH];
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_create(&config, 1, 1), 0, cleanup);
+
+   for (int i = 0; i < REGISTRY_TEST_SERVERS; i++)
+   {
+      registry_test_server(i, &srv);
+      MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_server(&config, &srv, NULL), 0, cleanup);
+   }
+
+   for (int i = 0; i < REGISTRY_TEST_USERS; i++)
+   {
+      snprintf(usr.username, sizeof(usr.username), "user%d", i);
+      snprintf(usr.password, sizeof(usr.password), "password%d", i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_registry_add_user(&config, &usr, NULL), 0, cleanup);
+   }
+
+   MCTF_ASSERT_INT_EQ(config.number_of_servers, REGISTRY_TEST_SERVERS, cleanup);
+   MCTF_ASSERT_INT_EQ(config.number_of_users, REGISTRY_TEST_USERS, cleanup);
+
+   for (int i = 0; i < REGISTRY_TEST_SERVERS; i++)
+   {
+      registry_test_server(i, &srv);
+      MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, srv.name), i, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_endpoint(&config, srv.host, srv.port), i, cleanup);
+      MCTF_ASSERT_STR_EQ(config.servers[i].username, srv.username, cleanup, "server should survive growing");
+   }
+
+   for (int i = 0; i < REGISTRY_TEST_USERS; i++)
+   {
+      snprintf(name, sizeof(name), "user%d", i);
+      MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_user(&config, name), i, cleanup);
+   }
+
+   pgvictoria_registry_clear_users(&config);
+   MCTF_ASSERT_INT_EQ(config.number_of_users, 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_user(&config, "user0"), -1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "server0"), 0, cleanup);
+
+   pgvictoria_registry_clear_servers(&config);
+   MCTF_ASSERT_INT_EQ(config.number_of_servers, 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_registry_find_server(&config, "server0"), -1, cleanup);
+
+cleanup:
+   pgvictoria_registry_destroy(&config);
+   MCTF_FINISH();
+}
+
+static void
+registry_test_server(int i, struct server* srv)
+{
+   memset(srv, 0, sizeof(struct server));
+
+   snprintf(srv->name, sizeof(srv->name), "server%d", i);
+   snprintf(srv->host, sizeof(srv->host), "10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+   srv->port = 5432 + (i % 4);
+   snprintf(srv->username, sizeof(srv->username), "user%d", i % 100);
+}
@@ -29,6 +29,8 @@
 
 #include <mctf.h>
 #include <tscommon.h>
+#include <json.h>
+#include <postgresql.h>
 #include <report.h>
 #include <utils.h>
 #include <stdbool.h>
@@ -545,6 +547,65 @@ cleanup:
    MCTF_FINISH();
 }
 
+/* Format: HTML output escapes the values, which may hold markup. */
+MCTF_TEST(test_report_html_escape)
+{
+   char* report = NULL;
+
+   int rc = run_file_report("html_escape", "application_name = 'a&b <c>'\n",
+                            PGVICTORIA_OUTPUT_HTML, PGVICTORIA_REPORT_FULL, 18, &report);
+   MCTF_ASSERT_INT_EQ(rc, 0, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(report, cleanup);
+   MCTF_ASSERT(strstr(report, "<td>a&amp;b &lt;c&gt;</td>") != NULL, cleanup);
+   MCTF_ASSERT(strstr(report, "<c>") == NULL, cleanup);
+   MCTF_ASSERT(strstr(report, "</html>") != NULL, cleanup);
+
+cleanup:
+   free(report);
+   MCTF_FINISH();
+}
+
+/* Format: the fleet report embeds the rows as JSON, stores each distinct
+ * string once and keeps values from closing the script element. */
+MCTF_TEST(test_report_format_fleet)
+{
+   char* report = NULL;
+   char* data = NULL;
+   char* end = NULL;
+   char* p = NULL;
+   struct json* json = NULL;
+   int occurrences = 0;
+
+   int rc = run_file_report("fmt_fleet", "max_connections = 200\nmax_wal_senders = 200\napplication_name = '</script>'\n",
+                            PGVICTORIA_OUTPUT_FLEET, PGVICTORIA_REPORT_FULL, 18, &report);
+   MCTF_ASSERT_INT_EQ(rc, 0, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(report, cleanup);
+   MCTF_ASSERT(strstr(report, "id=\"viewport\"") != NULL, cleanup);
+   MCTF_ASSERT(strstr(report, "\\u003c/script\\u003e") != NULL, cleanup);
+
+   for (p = strstr(report, "\"200\""); p != NULL; p = strstr(p + 1, "\"200\""))
+   {
+      occurrences++;
+   }
+   MCTF_ASSERT_INT_EQ(occurrences, 1, cleanup);
+
+   data = strstr(report, "type=\"application/json\">");
+   MCTF_ASSERT_PTR_NONNULL(data, cleanup);
+   data = strchr(data, '>') + 1;
+   end = strstr(data, "</script>");
+   MCTF_ASSERT_PTR_NONNULL(end, cleanup);
+   *end = '\0';
+   MCTF_ASSERT(strncmp(data, "{\"rows\":[0,", 11) == 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_json_parse_string(data, &json), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_json_contains_key(json, "strings"), cleanup);
+   MCTF_ASSERT(pgvictoria_json_contains_key(json, "servers"), cleanup);
+
+cleanup:
+   pgvictoria_json_destroy(json);
+   free(report);
+   MCTF_FINISH();
+}
+
 /* Parser: a single-quoted value is unquoted before comparison. */
 MCTF_TEST(test_report_quoted_value)
 {
@@ -630,3 +691,46 @@ cleanup:
    unlink(conf_path);
    MCTF_FINISH();
 }
+
+/* Classification: a single setting is classified against the baseline without a file. */
+MCTF_TEST(test_report_classify_single_setting)
+{
+   struct json* baseline = NULL;
+   struct pgvictoria_diff_item item;
+
+   baseline = pgvictoria_get_baseline(18);
+   MCTF_ASSERT_PTR_NONNULL(baseline, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_report_classify(baseline, "max_connections", "200", &item), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(item.status, "Modified", cleanup);
+   MCTF_ASSERT_STR_EQ(item.current_val, "200", cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_report_classify(baseline, "max_connections", item.baseline_val, &item), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(item.status, "Default", cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_report_classify(baseline, "no_such_setting", "1", &item), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(item.status, "Custom", cleanup);
+
+cleanup:
+   pgvictoria_json_destroy(baseline);
+   MCTF_FINISH();
+}
+
+/* Parser: a single line is split into key and value, including include directives. */
+MCTF_TEST(test_report_extract_key_value)
+{
+   char line[1024];
+   char key[128];
+   char value[1024];
+
+   snprintf(line, sizeof(line), "include_dir = 'conf.d'  # local overrides\n");
+   MCTF_ASSERT_INT_EQ(pgvictoria_report_extract_key_value(line, key, value), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(key, "include_dir", cleanup);
+   MCTF_ASSERT_STR_EQ(value, "conf.d", cleanup);
+
+   snprintf(line, sizeof(line), "   # shared_buffers = 1GB\n");
+   MCTF_ASSERT_INT_EQ(pgvictoria_report_extract_key_value(line, key, value), 1, cleanup);
+
+cleanup:
+   MCTF_FINISH();
+}
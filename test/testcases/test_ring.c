@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <pgvictoria.h>
+#include <logging.h>
+#include <mctf.h>
+#include <ring.h>
+#include <tscommon.h>
+
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#define RING_TEST_PRODUCERS 4
+#define RING_TEST_RECORDS   20000
+
+struct ring_test_record
+{
+   uint32_t producer;
+   uint32_t sequence;
+   char payload[40];
+};
+
+static int ring_test_contention(struct ring* ring, int producers, int records, double* seconds);
+
+MCTF_TEST(test_ring_push_pop)
+{
+   struct ring* ring = NULL;
+   char buffer[64];
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(1024, &ring), 0, cleanup);
+   MCTF_ASSERT(pgvictoria_ring_empty(ring), cleanup, "a new ring should be empty");
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_EMPTY, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, "first", 6), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, "second", 7), RING_OK, cleanup);
+   MCTF_ASSERT(!pgvictoria_ring_empty(ring), cleanup, "ring with records should not be empty");
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_peek(ring, &length), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ((int)length, 6, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "first", cleanup, "records should come out in push order");
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "second", cleanup, "records should come out in push order");
+
+   MCTF_ASSERT(pgvictoria_ring_empty(ring), cleanup, "a drained ring should be empty");
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_wrap_around)
+{
+   struct ring* ring = NULL;
+   char in[100];
+   char out[100];
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(256, &ring), 0, cleanup);
+
+   /* Odd lengths walk the records across the end of the buffer many times */
+   for (int i = 0; i < 1000; i++)
+   {
+      size_t l = 1 + (i * 7) % 90;
+
+      memset(in, 'a' + (i % 26), l);
+
+      MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, in, l), RING_OK, cleanup);
+      MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, out, sizeof(out), &length), RING_OK, cleanup);
+      MCTF_ASSERT_INT_EQ((int)length, (int)l, cleanup);
+      MCTF_ASSERT(memcmp(in, out, l) == 0, cleanup, "record %d should survive the wrap", i);
+   }
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_full_and_too_big)
+{
+   struct ring* ring = NULL;
+   char data[32];
+   char big[512];
+   size_t length = 0;
+   int pushed = 0;
+
+   memset(data, 'x', sizeof(data));
+   memset(big, 'y', sizeof(big));
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(256, &ring), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, big, sizeof(big)), RING_TOO_BIG, cleanup);
+
+   while (pgvictoria_ring_push(ring, data, sizeof(data)) == RING_OK)
+   {
+      pushed++;
+   }
+
+   /* 32 bytes plus an 8 byte header per record */
+   MCTF_ASSERT_INT_EQ(pushed, 256 / 40, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, data, sizeof(data)), RING_FULL, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, data, sizeof(data), &length), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, data, sizeof(data)), RING_OK, cleanup);
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_pop_buffer_too_small)
+{
+   struct ring* ring = NULL;
+   char small[4];
+   char buffer[32];
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(256, &ring), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, "too long", 9), RING_OK, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, small, sizeof(small), &length), RING_TOO_SMALL, cleanup);
+   MCTF_ASSERT_INT_EQ((int)length, 9, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "too long", cleanup, "record should be left in place on a short buffer");
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_pushv)
+{
+   struct ring* ring = NULL;
+   struct iovec iov[3];
+   char buffer[32];
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(256, &ring), 0, cleanup);
+
+   iov[0].iov_base = "head";
+   iov[0].iov_len = 4;
+   iov[1].iov_base = NULL;
+   iov[1].iov_len = 0;
+   iov[2].iov_base = "-tail";
+   iov[2].iov_len = 6;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pushv(ring, iov, 3), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ((int)length, 10, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "head-tail", cleanup, "buffers should be gathered in order");
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_init_in_place)
+{
+   struct ring* ring = NULL;
+   void* memory = NULL;
+   size_t size = pgvictoria_ring_size(100);
+   char buffer[16];
+   size_t length = 0;
+
+   MCTF_ASSERT_INT_EQ((int)(size - sizeof(struct ring)), 128, cleanup);
+
+   memory = aligned_alloc(64, size);
+   MCTF_ASSERT_PTR_NONNULL(memory, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_init((char*)memory + 8, 100, &ring), 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_init(memory, 100, &ring), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, "abc", 4), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "abc", cleanup);
+
+   /* Destroying a ring in caller owned memory leaves the memory alone */
+   pgvictoria_ring_destroy(ring);
+
+cleanup:
+   free(memory);
+   MCTF_FINISH();
+}
+
+/* A record claimed by a producer that died before publishing it is skipped */
+MCTF_TEST(test_ring_abandoned)
+{
+   struct ring* ring = NULL;
+   char buffer[64];
+   size_t length = 0;
+   void* page = MAP_FAILED;
+   pid_t pid;
+   int status = 0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(1024, &ring), 0, cleanup);
+
+   page = mmap(NULL, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   MCTF_ASSERT(page != MAP_FAILED, cleanup, "mmap should succeed");
+
+   pid = fork();
+   MCTF_ASSERT(pid != -1, cleanup, "fork should succeed");
+   if (pid == 0)
+   {
+      /* The copy faults after the space has been claimed */
+      signal(SIGSEGV, SIG_DFL);
+      pgvictoria_ring_push(ring, page, 32);
+      _exit(0);
+   }
+
+   waitpid(pid, &status, 0);
+   MCTF_ASSERT(WIFSIGNALED(status), cleanup, "the producer should die while copying");
+
+   MCTF_ASSERT(!pgvictoria_ring_empty(ring), cleanup, "the claimed record should still be in the ring");
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_push(ring, "abc", 4), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_peek(ring, &length), RING_OK, cleanup);
+   MCTF_ASSERT_INT_EQ((int)length, 4, cleanup);
+   MCTF_ASSERT_INT_EQ((int)ring->skipped, 1, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_pop(ring, buffer, sizeof(buffer), &length), RING_OK, cleanup);
+   MCTF_ASSERT_STR_EQ(buffer, "abc", cleanup);
+   MCTF_ASSERT(pgvictoria_ring_empty(ring), cleanup, "the ring should be empty");
+
+cleanup:
+   if (page != MAP_FAILED)
+   {
+      munmap(page, 4096);
+   }
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_ring_multiple_producers)
+{
+   struct ring* ring = NULL;
+   double seconds = 0.0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(16384, &ring), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(ring_test_contention(ring, RING_TEST_PRODUCERS, RING_TEST_RECORDS, &seconds), 0, cleanup,
+                      "every record should arrive once and in order per producer");
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+MCTF_BENCHMARK(test_ring_throughput, 60)
+{
+   struct ring* ring = NULL;
+   int producers[] = {1, 2, 4, 8};
+   int records = 100000;
+   double seconds = 0.0;
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_ring_create(65536, &ring), 0, cleanup);
+
+   for (size_t i = 0; i < sizeof(producers) / sizeof(producers[0]); i++)
+   {
+      MCTF_ASSERT_INT_EQ(ring_test_contention(ring, producers[i], records, &seconds), 0, cleanup);
+
+      pgvictoria_log_info("ring: %d producer(s), %d records of %zu bytes: %.3fs, %.0f records/s",
+                          producers[i], producers[i] * records, sizeof(struct ring_test_record),
+                          seconds, seconds > 0.0 ? (producers[i] * records) / seconds : 0.0);
+   }
+
+cleanup:
+   pgvictoria_ring_destroy(ring);
+   MCTF_FINISH();
+}
+
+/*
+ * Fork producers that each push a numbered sequence while this process
+ * consumes, then check every sequence arrived complete and in order.
+ */
+static int
+ring_test_contention(struct ring* ring, int producers, int records, double* seconds)
+{
+   pid_t pids[16];
+   uint32_t next[16];
+   struct ring_test_record record;
+   struct timespec start;
+   size_t length = 0;
+   long total = 0;
+   int status;
+   int ret = 0;
+
+   *seconds = 0.0;
+
+   if (producers > 16)
+   {
+      return 1;
+   }
+
+   memset(next, 0, sizeof(next));
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for (int p = 0; p < producers; p++)
+   {
+      pids[p] = fork();
+      if (pids[p] == -1)
+      {
+         /* Only wait for, and consume from, the producers that were started */
+         producers = p;
+         ret = 1;
+         break;
+      }
+      else if (pids[p] == 0)
+      {
+         struct ring_test_record r;
+
+         memset(&r, 0, sizeof(r));
+         r.producer = p;
+
+         for (int i = 0; i < records; i++)
+         {
+            r.sequence = i;
+            while (pgvictoria_ring_push(ring, &r, sizeof(r)) == RING_FULL)
+            {
+               sched_yield();
+            }
+         }
+
+         _exit(0);
+      }
+   }
+
+   while (total < (long)producers * records)
+   {
+      if (pgvictoria_ring_pop(ring, &record, sizeof(record), &length) != RING_OK)
+      {
+         sched_yield();
+         continue;
+      }
+
+      if (length != sizeof(record) || record.producer >= (uint32_t)producers ||
+          record.sequence != next[record.producer])
+      {
+         ret = 1;
+      }
+      else
+      {
+         next[record.producer]++;
+      }
+
+      total++;
+   }
+
+   *seconds = pgvictoria_test_elapsed(&start);
+
+   for (int p = 0; p < producers; p++)
+   {
+      waitpid(pids[p], &status, 0);
+   }
+
+   if (!pgvictoria_ring_empty(ring))
+   {
+      ret = 1;
+   }
+
+   return ret;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <logging.h>
+#include <message.h>
+#include <mctf.h>
+#include <tscommon.h>
+#include <trace.h>
+#include <utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static size_t trace_test_add(char* buffer, size_t offset, char kind, char* payload);
+
+MCTF_TEST(test_trace_sample)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   int sample = config->common.trace[TRACE_PROTOCOL].sample;
+   int sampled = 0;
+
+   config->common.trace[TRACE_PROTOCOL].sample = 0;
+   MCTF_ASSERT(!pgvictoria_trace_sample(TRACE_PROTOCOL), cleanup, "a sample of 0 should disable tracing");
+
+   config->common.trace[TRACE_PROTOCOL].sample = 100;
+   MCTF_ASSERT(pgvictoria_trace_sample(TRACE_PROTOCOL), cleanup, "a sample of 100 should trace everything");
+   MCTF_ASSERT(!pgvictoria_trace_sample(TRACE_SECURITY), cleanup, "the subsystems should be sampled on their own");
+   MCTF_ASSERT(!pgvictoria_trace_sample(NUMBER_OF_TRACE_SUBSYSTEMS), cleanup, "an unknown subsystem should not be traced");
+
+   config->common.trace[TRACE_PROTOCOL].sample = 25;
+   for (int i = 0; i < 10000; i++)
+   {
+      if (pgvictoria_trace_sample(TRACE_PROTOCOL))
+      {
+         sampled++;
+      }
+   }
+   MCTF_ASSERT(sampled > 2000 && sampled < 3000, cleanup, "about a quarter should be sampled, got %d", sampled);
+
+cleanup:
+   config->common.trace[TRACE_PROTOCOL].sample = sample;
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_trace_rate)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   int rate = config->common.trace[TRACE_PROTOCOL].rate;
+   int allowed = 0;
+
+   config->common.trace[TRACE_PROTOCOL].rate = 0;
+   for (int i = 0; i < 1000; i++)
+   {
+      MCTF_ASSERT(pgvictoria_trace_allow(TRACE_PROTOCOL), cleanup, "a rate of 0 should not limit");
+   }
+
+   /* A full bucket holds a second worth of lines */
+   config->common.trace[TRACE_PROTOCOL].rate = 10;
+   for (int i = 0; i < 100; i++)
+   {
+      if (pgvictoria_trace_allow(TRACE_PROTOCOL))
+      {
+         allowed++;
+      }
+   }
+   MCTF_ASSERT(allowed >= 10 && allowed <= 11, cleanup, "the bucket should allow 10 lines, got %d", allowed);
+
+   /* and refills at the rate, up to a full bucket however long the sleep took */
+   SLEEP(300000000L);
+   allowed = 0;
+   for (int i = 0; i < 100; i++)
+   {
+      if (pgvictoria_trace_allow(TRACE_PROTOCOL))
+      {
+         allowed++;
+      }
+   }
+   MCTF_ASSERT(allowed >= 2 && allowed <= 10, cleanup, "the bucket should refill at least 2 lines, got %d", allowed);
+
+cleanup:
+   config->common.trace[TRACE_PROTOCOL].rate = rate;
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_trace_response)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   char data[512];
+   size_t size = 0;
+   char* log = NULL;
+   off_t offset;
+   int rate = config->common.trace[TRACE_PROTOCOL].rate;
+   int payload = config->common.trace_payload;
+
+   config->common.trace[TRACE_PROTOCOL].rate = 0;
+   config->common.trace_payload = 8;
+
+   size = trace_test_add(data, size, 'T', "name column");
+   size = trace_test_add(data, size, 'D', "max_connections");
+   size = trace_test_add(data, size, 'D', "shared_buffers");
+   size = trace_test_add(data, size, 'D', "work_mem");
+   size = trace_test_add(data, size, 'C', "SELECT 3");
+   size = trace_test_add(data, size, 'Z', "I");
+
+   offset = pgvictoria_test_log_offset();
+   pgvictoria_trace_response(TRACE_PROTOCOL, data, size, 1500, 2250);
+
+   log = pgvictoria_test_log_read(offset);
+   MCTF_ASSERT_PTR_NONNULL(log, cleanup);
+   MCTF_ASSERT(strstr(log, "trace protocol < T 1 message 17 bytes \"name col...\"") != NULL, cleanup, "the T line is missing");
+   MCTF_ASSERT(strstr(log, "trace protocol < D 3 messages 55 bytes \"max_conn...\"") != NULL, cleanup, "the D messages should share a line");
+   MCTF_ASSERT(strstr(log, "trace protocol < Z 1 message 7 bytes \"I.\"") != NULL, cleanup, "a short payload should not be cut");
+   MCTF_ASSERT(strstr(log, "trace protocol < 93 bytes in 2.250 ms, first read after 1.500 ms") != NULL, cleanup, "the timing line is missing");
+   MCTF_ASSERT(strstr(log, "shared_buffers") == NULL, cleanup, "only the first payload of a type should be traced");
+
+cleanup:
+   config->common.trace[TRACE_PROTOCOL].rate = rate;
+   config->common.trace_payload = payload;
+   free(log);
+   MCTF_FINISH();
+}
+
+MCTF_TEST(test_trace_security_payload)
+{
+   struct main_configuration* config = (struct main_configuration*)shmem;
+   struct message msg;
+   char data[64];
+   char* log = NULL;
+   off_t offset;
+   int rate = config->common.trace[TRACE_SECURITY].rate;
+   int payload = config->common.trace_payload;
+
+   config->common.trace[TRACE_SECURITY].rate = 0;
+   config->common.trace_payload = 32;
+
+   msg.kind = 'p';
+   msg.length = trace_test_add(data, 0, 'p', "SCRAM-SHA-256 secret");
+   msg.data = data;
+
+   offset = pgvictoria_test_log_offset();
+   pgvictoria_trace_message(TRACE_SECURITY, '>', &msg);
+
+   log = pgvictoria_test_log_read(offset);
+   MCTF_ASSERT_PTR_NONNULL(log, cleanup);
+   MCTF_ASSERT(strstr(log, "trace security > p 26 bytes \"\"") != NULL, cleanup, "the message should be traced");
+   MCTF_ASSERT(strstr(log, "secret") == NULL, cleanup, "a security payload should never be traced");
+
+cleanup:
+   config->common.trace[TRACE_SECURITY].rate = rate;
+   config->common.trace_payload = payload;
+   free(log);
+   MCTF_FINISH();
+}
+
+static size_t
+trace_test_add(char* buffer, size_t offset, char kind, char* payload)
+{
+   size_t length = strlen(payload) + 1;
+
+   pgvictoria_write_byte(buffer + offset, kind);
+   pgvictoria_write_int32(buffer + offset + 1, 4 + length);
+   memcpy(buffer + offset + 5, payload, length);
+
+   return offset + 5 + length;
+}
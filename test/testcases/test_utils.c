@@ -105,3 +105,46 @@ MCTF_TEST(test_utils_compare_string)
 cleanup:
    MCTF_FINISH();
 }
+
+MCTF_TEST(test_utils_string_builder)
+{
+   struct string_builder builder;
+   char* s = NULL;
+
+   pgvictoria_string_builder_init(&builder);
+   /* Nothing appended gives NULL, like pgvictoria_append() */
+   pgvictoria_string_builder_append(&builder, NULL);
+   pgvictoria_string_builder_append(&builder, "");
+   s = pgvictoria_string_builder_finish(&builder);
+   MCTF_ASSERT_PTR_NULL(s, cleanup, "an empty builder should finish as NULL");
+
+   pgvictoria_string_builder_indent(&builder, "tag: ", 3);
+   pgvictoria_string_builder_append_char(&builder, '"');
+   pgvictoria_string_builder_append_escaped(&builder, "a\"b\\c\nd\te\rf");
+   pgvictoria_string_builder_append_char(&builder, '"');
+   pgvictoria_string_builder_append_format(&builder, " %d %s %.2f", -7, "x", 1.5);
+   pgvictoria_string_builder_append_length(&builder, "xyz", 2);
+   s = pgvictoria_string_builder_finish(&builder);
+   MCTF_ASSERT_STR_EQ(s, "   tag: \"a\\\"b\\\\c\\nd\\te\\rf\" -7 x 1.50xy", cleanup, "unexpected built string");
+   MCTF_ASSERT_PTR_NULL(builder.str, cleanup, "finish should leave the builder empty");
+   free(s);
+   s = NULL;
+
+   /* A formatted string longer than the room left, and geometric growth */
+   for (int i = 0; i < 10000; i++)
+   {
+      pgvictoria_string_builder_append_format(&builder, "%0300d", i);
+      MCTF_ASSERT_INT_EQ((int)builder.length, (i + 1) * 300, cleanup);
+   }
+   MCTF_ASSERT(builder.capacity < 2 * builder.length + 2, cleanup, "capacity %zu for %zu bytes", builder.capacity, builder.length);
+   MCTF_ASSERT_INT_EQ(atoi(builder.str + 9999 * 300), 9999, cleanup);
+
+   pgvictoria_string_builder_clear(&builder);
+   pgvictoria_string_builder_append(&builder, "again");
+   MCTF_ASSERT_STR_EQ(builder.str, "again", cleanup, "clear should empty the builder");
+
+cleanup:
+   free(s);
+   pgvictoria_string_builder_destroy(&builder);
+   MCTF_FINISH();
+}
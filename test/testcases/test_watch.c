@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2026 The pgvictoria community
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pgvictoria.h>
+#include <tscommon.h>
+#include <utils.h>
+#include <watch.h>
+#include <mctf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define WATCH_TEST_TIMEOUT 2000
+
+static int watch_test_write(char* directory, char* name, char* contents);
+static int watch_test_directory(char* name, char* path);
+
+/* An include is applied at the position of its directive, so a later assignment in the parent wins */
+MCTF_TEST(test_watch_include_position)
+{
+   struct watch_state* watch = NULL;
+   FILE* out = NULL;
+   char* output = NULL;
+   size_t size = 0;
+   char directory[MAX_PATH];
+   char path[MAX_PATH];
+   char* files[1];
+
+   MCTF_ASSERT_INT_EQ(watch_test_directory("watch_position", directory), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf",
+                                       "max_connections = 100\ninclude 'a.conf'\nmax_connections = 200\nwork_mem = 4MB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "a.conf",
+                                       "max_connections = 300\nshared_buffers = 1GB\nwork_mem = 8MB\n"), 0, cleanup);
+
+   out = open_memstream(&output, &size);
+   MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/postgresql.conf", directory);
+   files[0] = path;
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_create(files, 1, 18, out, &watch), 0, cleanup);
+
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "max_connections"), "200", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "shared_buffers"), "1GB", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "4MB", cleanup);
+
+   /* Only the setting that is not overridden after the include is reported */
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "a.conf", "max_connections = 400\nshared_buffers = 2GB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "max_connections"), "200", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "shared_buffers"), "2GB", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(output, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, "Configuration drift in "), cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, "1GB                  -> 2GB"), cleanup);
+   MCTF_ASSERT(strstr(output, "max_connections") == NULL, cleanup, "max_connections should not drift");
+   MCTF_ASSERT(strstr(output, "work_mem") == NULL, cleanup, "work_mem should not drift");
+
+cleanup:
+   pgvictoria_watch_destroy(watch);
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   free(output);
+   pgvictoria_delete_directory(directory);
+   MCTF_FINISH();
+}
+
+/* include_dir files are applied in name order, and the directory is followed through removal and recreation */
+MCTF_TEST(test_watch_include_dir)
+{
+   struct watch_state* watch = NULL;
+   FILE* out = NULL;
+   char* output = NULL;
+   size_t size = 0;
+   size_t offset = 0;
+   char directory[MAX_PATH];
+   char conf_d[MAX_PATH];
+   char path[MAX_PATH];
+   char* files[1];
+
+   MCTF_ASSERT_INT_EQ(watch_test_directory("watch_include_dir", directory), 0, cleanup);
+   pgvictoria_snprintf(conf_d, sizeof(conf_d), "%s/conf.d", directory);
+   MCTF_ASSERT_INT_EQ(mkdir(conf_d, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "work_mem = 4MB\ninclude_dir 'conf.d'\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(conf_d, "01.conf", "work_mem = 8MB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(conf_d, "02.conf", "work_mem = 16MB\n"), 0, cleanup);
+
+   out = open_memstream(&output, &size);
+   MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/postgresql.conf", directory);
+   files[0] = path;
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_create(files, 1, 18, out, &watch), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "16MB", cleanup);
+
+   /* Deleting the last file falls back to the previous one */
+   pgvictoria_snprintf(path, sizeof(path), "%s/02.conf", conf_d);
+   MCTF_ASSERT_INT_EQ(unlink(path), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "8MB", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(output, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, "16MB                 -> 8MB"), cleanup);
+   offset = size;
+
+   /* Moving the directory away drops its settings */
+   pgvictoria_snprintf(path, sizeof(path), "%s/moved.d", directory);
+   MCTF_ASSERT_INT_EQ(rename(conf_d, path), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "4MB", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output + offset, "8MB                  -> 4MB"), cleanup);
+   offset = size;
+   MCTF_ASSERT_INT_EQ(pgvictoria_delete_directory(path), 0, cleanup);
+
+   /* A recreated directory is watched again */
+   MCTF_ASSERT_INT_EQ(mkdir(conf_d, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(conf_d, "03.conf", "work_mem = 32MB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "32MB", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output + offset, "4MB                  -> 32MB"), cleanup);
+   offset = size;
+
+   /* Removing it does the same, and it is picked up again when created with its files at once */
+   MCTF_ASSERT_INT_EQ(pgvictoria_delete_directory(conf_d), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "4MB", cleanup);
+   MCTF_ASSERT_INT_EQ(mkdir(conf_d, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(conf_d, "03.conf", "work_mem = 32MB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "32MB", cleanup);
+   fflush(out);
+   offset = size;
+
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "include_dir 'conf.d'\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(conf_d, "03.conf", "\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+   MCTF_ASSERT(pgvictoria_watch_value(watch, 0, "work_mem") == NULL, cleanup, "work_mem should be unset");
+   MCTF_ASSERT_PTR_NONNULL(strstr(output + offset, "Removed"), cleanup);
+
+cleanup:
+   pgvictoria_watch_destroy(watch);
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   free(output);
+   pgvictoria_delete_directory(directory);
+   MCTF_FINISH();
+}
+
+/* Every file on the command line is a configuration of its own */
+MCTF_TEST(test_watch_roots)
+{
+   struct watch_state* watch = NULL;
+   FILE* out = NULL;
+   char* output = NULL;
+   size_t size = 0;
+   char directory[MAX_PATH];
+   char first_directory[MAX_PATH];
+   char second_directory[MAX_PATH];
+   char first[MAX_PATH];
+   char second[MAX_PATH];
+   char header[MAX_PATH + 32];
+   char* files[2];
+
+   MCTF_ASSERT_INT_EQ(watch_test_directory("watch_roots", directory), 0, cleanup);
+   pgvictoria_snprintf(first_directory, sizeof(first_directory), "%s/first", directory);
+   pgvictoria_snprintf(second_directory, sizeof(second_directory), "%s/second", directory);
+   MCTF_ASSERT_INT_EQ(mkdir(first_directory, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(mkdir(second_directory, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(first_directory, "postgresql.conf", "max_connections = 100\nwork_mem = 4MB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(second_directory, "postgresql.conf", "max_connections = 500\n"), 0, cleanup);
+
+   out = open_memstream(&output, &size);
+   MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+
+   pgvictoria_snprintf(first, sizeof(first), "%s/postgresql.conf", first_directory);
+   pgvictoria_snprintf(second, sizeof(second), "%s/postgresql.conf", second_directory);
+   files[0] = first;
+   files[1] = second;
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_create(files, 2, 18, out, &watch), 0, cleanup);
+
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "max_connections"), "100", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 1, "max_connections"), "500", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "4MB", cleanup);
+   MCTF_ASSERT(pgvictoria_watch_value(watch, 1, "work_mem") == NULL, cleanup, "work_mem should not leak into the second configuration");
+
+   MCTF_ASSERT_INT_EQ(watch_test_write(second_directory, "postgresql.conf", "max_connections = 600\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "max_connections"), "100", cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 1, "max_connections"), "600", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(output, cleanup);
+   pgvictoria_snprintf(header, sizeof(header), "Configuration drift in %s\n", second);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, header), cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, "500                  -> 600"), cleanup);
+   pgvictoria_snprintf(header, sizeof(header), "Configuration drift in %s\n", first);
+   MCTF_ASSERT(strstr(output, header) == NULL, cleanup, "the first configuration should not drift");
+
+cleanup:
+   pgvictoria_watch_destroy(watch);
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   free(output);
+   pgvictoria_delete_directory(directory);
+   MCTF_FINISH();
+}
+
+/* An include through an aliased path shares the watch of the directory it resolves to */
+MCTF_TEST(test_watch_alias)
+{
+   struct watch_state* watch = NULL;
+   FILE* out = NULL;
+   char* output = NULL;
+   size_t size = 0;
+   char directory[MAX_PATH];
+   char sub[MAX_PATH];
+   char path[MAX_PATH];
+   char* files[1];
+
+   MCTF_ASSERT_INT_EQ(watch_test_directory("watch_alias", directory), 0, cleanup);
+   pgvictoria_snprintf(sub, sizeof(sub), "%s/sub", directory);
+   MCTF_ASSERT_INT_EQ(mkdir(sub, 0700), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "work_mem = 4MB\ninclude 'sub/../a.conf'\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "a.conf", "shared_buffers = 1GB\n"), 0, cleanup);
+
+   out = open_memstream(&output, &size);
+   MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/postgresql.conf", directory);
+   files[0] = path;
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_create(files, 1, 18, out, &watch), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "shared_buffers"), "1GB", cleanup);
+
+   /* Both files live in the same directory, so both are still followed */
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "work_mem = 8MB\ninclude 'sub/../a.conf'\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "8MB", cleanup);
+
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "a.conf", "shared_buffers = 2GB\n"), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "shared_buffers"), "2GB", cleanup);
+
+cleanup:
+   pgvictoria_watch_destroy(watch);
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   free(output);
+   pgvictoria_delete_directory(directory);
+   MCTF_FINISH();
+}
+
+/* A lost event must not leave a stale value behind, so an overflowed queue reads every file again */
+MCTF_TEST(test_watch_overflow)
+{
+   struct watch_state* watch = NULL;
+   FILE* out = NULL;
+   FILE* limit = NULL;
+   char* output = NULL;
+   size_t size = 0;
+   int max_queued_events = 0;
+   char directory[MAX_PATH];
+   char path[MAX_PATH];
+   char flood[MAX_PATH];
+   char* files[1];
+
+   limit = fopen("/proc/sys/fs/inotify/max_queued_events", "r");
+   if (limit == NULL)
+   {
+      MCTF_SKIP("the inotify queue limit is unknown");
+   }
+   if (fscanf(limit, "%d", &max_queued_events) != 1)
+   {
+      max_queued_events = 0;
+   }
+   fclose(limit);
+   if (max_queued_events <= 0 || max_queued_events > 1024 * 1024)
+   {
+      MCTF_SKIP("the inotify queue limit of %d is out of reach", max_queued_events);
+   }
+
+   MCTF_ASSERT_INT_EQ(watch_test_directory("watch_overflow", directory), 0, cleanup);
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "work_mem = 4MB\n"), 0, cleanup);
+
+   out = open_memstream(&output, &size);
+   MCTF_ASSERT_PTR_NONNULL(out, cleanup);
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/postgresql.conf", directory);
+   files[0] = path;
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_create(files, 1, 18, out, &watch), 0, cleanup);
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "4MB", cleanup);
+
+   /* Every pair of events differs from the one before it, so the kernel cannot merge them; change the configuration once the queue is full */
+   pgvictoria_snprintf(flood, sizeof(flood), "%s/flood", directory);
+   for (int i = 0; i <= max_queued_events / 2; i++)
+   {
+      MCTF_ASSERT_INT_EQ(mkdir(flood, 0700), 0, cleanup);
+      MCTF_ASSERT_INT_EQ(rmdir(flood), 0, cleanup);
+   }
+   MCTF_ASSERT_INT_EQ(watch_test_write(directory, "postgresql.conf", "work_mem = 8MB\n"), 0, cleanup);
+
+   MCTF_ASSERT_INT_EQ(pgvictoria_watch_process(watch, WATCH_TEST_TIMEOUT), 0, cleanup);
+   fflush(out);
+
+   MCTF_ASSERT_STR_EQ(pgvictoria_watch_value(watch, 0, "work_mem"), "8MB", cleanup);
+   MCTF_ASSERT_PTR_NONNULL(output, cleanup);
+   MCTF_ASSERT_PTR_NONNULL(strstr(output, "4MB                  -> 8MB"), cleanup);
+
+cleanup:
+   pgvictoria_watch_destroy(watch);
+   if (out != NULL)
+   {
+      fclose(out);
+   }
+   free(output);
+   pgvictoria_delete_directory(directory);
+   MCTF_FINISH();
+}
+
+static int
+watch_test_write(char* directory, char* name, char* contents)
+{
+   char path[MAX_PATH];
+   FILE* file = NULL;
+
+   pgvictoria_snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+   file = fopen(path, "w");
+   if (file == NULL)
+   {
+      return 1;
+   }
+
+   fputs(contents, file);
+   fclose(file);
+
+   return 0;
+}
+
+static int
+watch_test_directory(char* name, char* path)
+{
+   char base[MAX_PATH];
+
+   /* The watch compares resolved paths */
+   if (realpath(TEST_BASE_DIR, base) == NULL)
+   {
+      return 1;
+   }
+
+   pgvictoria_snprintf(path, MAX_PATH, "%s/%s", base, name);
+   pgvictoria_delete_directory(path);
+
+   return mkdir(path, 0700) == 0 ? 0 : 1;
+}